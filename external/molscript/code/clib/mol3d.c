@@ -70,6 +70,9 @@ struct s_at3d {
   at3d *next;
   res3d *res;
   named_data *data;
+  int serial;
+  int bond_count;
+  at3d **bonds;
 };
 
 #define MOL3D_INIT_NOBLANKS         0x00000001
@@ -169,6 +172,9 @@ at3d_create (void)
   at->next = NULL;
   at->res = NULL;
   at->data = NULL;
+  at->serial = 0;
+  at->bond_count = 0;
+  at->bonds = NULL;
 
   return at;
 }
@@ -219,6 +225,8 @@ at3d_clone (at3d *at)
   new->next = NULL;
   new->res = NULL;
   new->data = NULL;
+  new->bond_count = 0;
+  new->bonds = NULL;
 
   return new;
 }
@@ -293,6 +301,7 @@ at3d_delete (at3d *at)
   assert (at);
 
   if (at->data) nd_delete (at->data);
+  if (at->bonds) free (at->bonds);
   free (at);
 }
 
@@ -921,3 +930,57 @@ mol3d_do_atoms_all (mol3d *first_mol, void (*proc) (at3d *at))
     }
   }
 }
+
+
+/*------------------------------------------------------------*/
+static void
+at3d_append_bond (at3d *at, at3d *other)
+{
+  int slot;
+
+  for (slot = 0; slot < at->bond_count; slot++) {
+    if (at->bonds[slot] == other) return;
+  }
+
+  at->bonds = realloc (at->bonds, (at->bond_count + 1) * sizeof (at3d *));
+  at->bonds[at->bond_count++] = other;
+}
+
+
+/*------------------------------------------------------------*/
+void
+at3d_add_bond (at3d *at1, at3d *at2)
+     /*
+       Add an explicit bond between the two atoms, if not already present.
+     */
+{
+  /* pre */
+  assert (at1);
+  assert (at2);
+
+  if (at1 == at2) return;
+
+  at3d_append_bond (at1, at2);
+  at3d_append_bond (at2, at1);
+}
+
+
+/*------------------------------------------------------------*/
+boolean
+at3d_bonded (at3d *at1, at3d *at2)
+     /*
+       Is there an explicit bond between the two atoms?
+     */
+{
+  int slot;
+
+  /* pre */
+  assert (at1);
+  assert (at2);
+
+  for (slot = 0; slot < at1->bond_count; slot++) {
+    if (at1->bonds[slot] == at2) return TRUE;
+  }
+
+  return FALSE;
+}
@@ -55,6 +55,9 @@ struct s_at3d {
   at3d *next;
   res3d *res;
   named_data *data;
+  int serial;
+  int bond_count;
+  at3d **bonds;
 };
 
 #define MOL3D_INIT_NOBLANKS         0x00000001
@@ -179,4 +182,10 @@ mol3d_do_atoms (mol3d *mol, void (*proc) (at3d *at));
 void
 mol3d_do_atoms_all (mol3d *first_mol, void (*proc) (at3d *at));
 
+void
+at3d_add_bond (at3d *at1, at3d *at2);
+
+boolean
+at3d_bonded (at3d *at1, at3d *at2);
+
 #endif
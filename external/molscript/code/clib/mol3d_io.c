@@ -74,6 +74,7 @@ static char HETATM[] = "HETATM";
 static char MODEL[] = "MODEL";
 static char ENDMDL[] = "ENDMDL";
 static char END[] = "END";
+static char CONECT[] = "CONECT";
 static char FORMAT_VERSION[] = "FORMAT_VERSION";
 
 
@@ -170,6 +171,80 @@ mol3d_append_pdb_named_data (mol3d *mol, char *name,
 }
 
 
+/*------------------------------------------------------------*/
+static int
+at3d_serial_compare (const void *a, const void *b)
+{
+  return (*(at3d **) a)->serial - (*(at3d **) b)->serial;
+}
+
+
+/*------------------------------------------------------------*/
+static at3d *
+at3d_serial_lookup (at3d **index, int count, int serial)
+{
+  at3d key, *keyp = &key, **found;
+
+  if (serial <= 0) return NULL;
+
+  key.serial = serial;
+  found = bsearch (&keyp, index, count, sizeof (at3d *), at3d_serial_compare);
+
+  return found ? *found : NULL;
+}
+
+
+/*------------------------------------------------------------*/
+static at3d **
+at3d_serial_index (mol3d *mol, int *count)
+     /*
+       Return the atoms of the molecule that have serial numbers,
+       sorted by serial number for lookup.
+     */
+{
+  res3d *res;
+  at3d *at, **index;
+  int slot = 0;
+
+  index = malloc ((mol3d_count_atoms (mol) + 1) * sizeof (at3d *));
+
+  for (res = mol->first; res; res = res->next) {
+    for (at = res->first; at; at = at->next) {
+      if (at->serial > 0) index[slot++] = at;
+    }
+  }
+
+  qsort (index, slot, sizeof (at3d *), at3d_serial_compare);
+  *count = slot;
+
+  return index;
+}
+
+
+/*------------------------------------------------------------*/
+static void
+mol3d_read_pdb_conect (char *record, int length, at3d **index, int count)
+     /*
+       Add the explicit bonds given in a CONECT record.
+     */
+{
+  char field [6];
+  at3d *at, *bonded;
+  int pos;
+
+  field[5] = '\0';
+  strncpy (field, record + 6, 5);
+  at = at3d_serial_lookup (index, count, atoi (field));
+  if (at == NULL) return;
+
+  for (pos = 11; pos + 5 <= length && pos < 31; pos += 5) {
+    strncpy (field, record + pos, 5);
+    bonded = at3d_serial_lookup (index, count, atoi (field));
+    if (bonded) at3d_add_bond (at, bonded);
+  }
+}
+
+
 /*------------------------------------------------------------*/
 mol3d *
 mol3d_read_pdb_file (FILE *file)
@@ -192,6 +267,9 @@ mol3d_read_pdb_file (FILE *file)
   char prev_restype [RES3D_TYPE_LENGTH + 1];
   boolean new_format = FALSE;
   key_value *first_ss = NULL, *ss;
+  at3d **serial_index = NULL;
+  int serial_count = 0;
+  char serial [6];
 
   /* pre */
   assert (file);
@@ -311,6 +389,9 @@ mol3d_read_pdb_file (FILE *file)
 	(str_eq_min (HETATM, record))) {
 
       new_at = at3d_create();
+      strncpy (serial, record + 6, 5);
+      serial[5] = '\0';
+      new_at->serial = atoi (serial);
       record[66] = '\0';	/* this is faster than using sscanf */
       new_at->bfactor = atof_ (record + 60);
       record[60] = '\0';
@@ -377,6 +458,14 @@ mol3d_read_pdb_file (FILE *file)
       res = NULL;
       at = NULL;
 
+    } else if (str_eq_min (CONECT, record)) {
+				/* bonds refer to the first model */
+      if (serial_index == NULL) {
+	serial_index = at3d_serial_index (first_mol, &serial_count);
+      }
+      if ((length > 0) && (record[length-1] == '\n')) record[--length] = '\0';
+      mol3d_read_pdb_conect (record, length, serial_index, serial_count);
+
     } else if (str_eq_min (END, record)) {
       break;
     }
@@ -385,6 +474,8 @@ mol3d_read_pdb_file (FILE *file)
     if (str == NULL) break;
   }
 
+  if (serial_index) free (serial_index);
+
   if (first_mol->first == NULL) goto error;
 
   for (mol = first_mol; mol->next; mol = mol->next) { /* remove mol's */
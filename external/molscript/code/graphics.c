@@ -307,6 +307,29 @@ depthcue (double depth, state *st)
 }
 
 
+/*------------------------------------------------------------*/
+static boolean
+is_bonded (at3d *at1, at3d *at2)
+     /*
+       Are the atoms bonded? An explicit bond (from a CONECT record)
+       always counts. Between two HETATM atoms that both have explicit
+       bonds those are taken as complete, otherwise it is decided by
+       distance, as CONECT records often give only some of the bonds
+       of an atom (eg. a metal to its ligands).
+     */
+{
+  double dist;
+
+  if (at3d_bonded (at1, at2)) return TRUE;
+
+  if (at1->bond_count && at2->bond_count &&
+      at1->res && at2->res && at1->res->heterogen && at2->res->heterogen) return FALSE;
+
+  dist = v3_distance (&(at1->xyz), &(at2->xyz));
+  return (dist <= current_state->bonddistance) && (dist >= 0.001);
+}
+
+
 /*------------------------------------------------------------*/
 void
 ball_and_stick (int single_selection)
@@ -314,7 +337,7 @@ ball_and_stick (int single_selection)
   at3d **atoms1, **atoms2;
   int atom_count1, atom_count2, slot1, slot2, start;
   vector3 *v1, *v2;
-  double radius, dist;
+  double radius;
 
   if (single_selection) {
 
@@ -378,8 +401,7 @@ ball_and_stick (int single_selection)
 
 	v2 = &(atoms2[slot2]->xyz);
 
-	dist = v3_distance (v1, v2);
-	if ((dist > current_state->bonddistance) || (dist < 0.001)) continue;
+	if (! is_bonded (atoms1[slot1], atoms2[slot2])) continue;
 
 	if (colour_unequal (&(atoms1[slot1]->colour),
 			    &(atoms2[slot2]->colour))) {
@@ -415,8 +437,7 @@ ball_and_stick (int single_selection)
 
 	v2 = &(atoms2[slot2]->xyz);
 
-	dist = v3_distance (v1, v2);
-	if ((dist > current_state->bonddistance) || (dist < 0.001)) continue;
+	if (! is_bonded (atoms1[slot1], atoms2[slot2])) continue;
 
 	output_stick (v1, v2,
 		      0.25 * atoms1[slot1]->radius,
@@ -448,7 +469,6 @@ bonds (int single_selection)
   vector3 *v1, *v2;
   colour *col1;
   line_segment *ls;
-  double dist;
 
   if (single_selection) {
 
@@ -507,8 +527,7 @@ bonds (int single_selection)
 	v2 = &(atoms2[slot2]->xyz);
 	if (v2 == v1) continue;
 
-	dist = v3_distance (v1, v2);
-	if ((dist > current_state->bonddistance) || (dist < 0.001)) continue;
+	if (! is_bonded (atoms1[slot1], atoms2[slot2])) continue;
 
 	if (colour_unequal (col1, &(atoms2[slot2]->colour))) {
 	  v3_middle (&middle, v1, v2);
@@ -556,8 +575,7 @@ bonds (int single_selection)
 	v2 = &(atoms2[slot2]->xyz);
 	if (v2 == v1) continue;
 
-	dist = v3_distance (v1, v2);
-	if ((dist > current_state->bonddistance) || (dist < 0.001)) continue;
+	if (! is_bonded (atoms1[slot1], atoms2[slot2])) continue;
 
 	ls = line_segment_next();
 	ls->p = *v1;
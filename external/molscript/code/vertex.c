@@ -19,6 +19,7 @@
 
 
 #define MAX_VERTEX 1000000
+#define MAX_IMPOSTOR 250000
 
 
 /*============================================================*/
@@ -81,11 +82,48 @@ struct compact_header
 
 #define OPTION_COLOR      1
 #define OPTION_INTERLEAVE 2
+#define OPTION_IMPOSTORS  4
+
+
+// with impostors spheres and cylinders (and sticks) are stored as instances rather than triangles, for the
+// viewer to ray cast. they follow the strips in the compacted data, after an impostor_header, and always have colour
+
+struct sphere_inst
+{
+  short centre[3];
+  short radius;         // hundredths of an angstrom
+  unsigned char col[4];
+};
+
+
+struct cylinder_inst
+{
+  short p1[3];
+  short p2[3];
+  short radius;         // hundredths of an angstrom
+  short caps;           // 1 if the ends are closed
+  unsigned char col[4];
+};
+
+
+struct impostor_header
+{
+  int num_spheres;
+  int num_cylinders;
+};
 
 
 static struct fp *store_   = NULL;
 static struct fp *store_s_ = NULL;
 
+static struct sphere_inst   *spheres_   = NULL;
+static struct cylinder_inst *cylinders_ = NULL;
+
+static int impostors_ = 0; // output spheres and cylinders as instances
+
+static int sphere_counter_   = 0;
+static int cylinder_counter_ = 0;
+
 static int out_mode_ = 0;
 
 static int counter_   = 0;
@@ -122,6 +160,18 @@ void vertex_free()
 
   free(store_s_);
   store_s_ = NULL;
+
+  free(spheres_);
+  spheres_ = NULL;
+
+  free(cylinders_);
+  cylinders_ = NULL;
+}
+
+
+void vertex_set_impostors(int on)
+{
+  impostors_ = on;
 }
 
 
@@ -132,6 +182,9 @@ void vertex_clear()
 
   strip_counter_ = 0;
 
+  sphere_counter_   = 0;
+  cylinder_counter_ = 0;
+
   printed_already_ = 0;
 }
 
@@ -158,7 +211,32 @@ int vertex_strip_size()
 }
 
 
-// compact the data, optionally include colours interleaved or seperate
+// the impostor header and instances, if asked for
+
+static void compact_impostors(char* p, int options)
+{
+  if (!(options & OPTION_IMPOSTORS))
+    return;
+
+  struct impostor_header h;
+
+  h.num_spheres   = sphere_counter_;
+  h.num_cylinders = cylinder_counter_;
+
+  memcpy(p, &h, sizeof(struct impostor_header));
+  p += sizeof(struct impostor_header);
+
+  if (h.num_spheres)
+    memcpy(p, spheres_, h.num_spheres * sizeof(struct sphere_inst));
+
+  p += h.num_spheres * sizeof(struct sphere_inst);
+
+  if (h.num_cylinders)
+    memcpy(p, cylinders_, h.num_cylinders * sizeof(struct cylinder_inst));
+}
+
+
+// compact the data, optionally include colours interleaved or seperate, followed by the impostors
 
 int compact(char** cdata, int options)
 {
@@ -174,6 +252,14 @@ int compact(char** cdata, int options)
   else
     total_size += (h.num_triangles + h.num_strips) * (sizeof(struct fp) - sizeof(struct cols));
 
+  int impostors_size = 0;
+
+  if (options & OPTION_IMPOSTORS)
+    impostors_size = sizeof(struct impostor_header) + sphere_counter_ * sizeof(struct sphere_inst) +
+                                                      cylinder_counter_ * sizeof(struct cylinder_inst);
+
+  total_size += impostors_size;
+
   *cdata = malloc(total_size);
 
   if (*cdata == NULL)
@@ -196,6 +282,10 @@ int compact(char** cdata, int options)
 
     memcpy(p, store_s_, h.num_strips * sizeof(struct fp));
 
+    p += h.num_strips * sizeof(struct fp);
+
+    compact_impostors(p, options);
+
     return total_size;
   }
 
@@ -238,6 +328,8 @@ int compact(char** cdata, int options)
     }
   }
 
+  compact_impostors(p, options);
+
   return total_size;
 }
 
@@ -251,6 +343,9 @@ void out_start()
 {
   counter_   = 0;
   counter_s_ = 0;
+
+  sphere_counter_   = 0;
+  cylinder_counter_ = 0;
 }
 
 
@@ -368,6 +463,77 @@ void print_out_of_space()
 }
 
 
+// add a sphere or cylinder instance in the current colour
+
+static void output_sphere_inst(vector3 *v, double radius)
+{
+  if (spheres_ == NULL)
+  {
+    spheres_ = malloc(sizeof(struct sphere_inst) * MAX_IMPOSTOR);
+
+    if (spheres_ == NULL)
+    {
+      printf("unable to malloc spheres\n");
+      return;
+    }
+  }
+
+  if (sphere_counter_ >= MAX_IMPOSTOR)
+  {
+    print_out_of_space();
+    return;
+  }
+
+  struct sphere_inst* s = &spheres_[sphere_counter_++];
+
+  s->centre[0] = to_short(v->x);
+  s->centre[1] = to_short(v->y);
+  s->centre[2] = to_short(v->z);
+
+  s->radius = radius * 100.0 + 0.5;
+
+  for (int i = 0; i < 4; ++i)
+    s->col[i] = current_colour_s_[i];
+}
+
+
+static void output_cylinder_inst(vector3 *v1, vector3 *v2, double radius, int caps)
+{
+  if (cylinders_ == NULL)
+  {
+    cylinders_ = malloc(sizeof(struct cylinder_inst) * MAX_IMPOSTOR);
+
+    if (cylinders_ == NULL)
+    {
+      printf("unable to malloc cylinders\n");
+      return;
+    }
+  }
+
+  if (cylinder_counter_ >= MAX_IMPOSTOR)
+  {
+    print_out_of_space();
+    return;
+  }
+
+  struct cylinder_inst* c = &cylinders_[cylinder_counter_++];
+
+  c->p1[0] = to_short(v1->x);
+  c->p1[1] = to_short(v1->y);
+  c->p1[2] = to_short(v1->z);
+
+  c->p2[0] = to_short(v2->x);
+  c->p2[1] = to_short(v2->y);
+  c->p2[2] = to_short(v2->z);
+
+  c->radius = radius * 100.0 + 0.5;
+  c->caps   = caps;
+
+  for (int i = 0; i < 4; ++i)
+    c->col[i] = current_colour_s_[i];
+}
+
+
 void glVertex3d(float n0, float n1, float n2)
 {
   if (store_ == NULL)
@@ -576,6 +742,9 @@ void vertex_start_plot (void)
   counter_   = 0;
   counter_s_ = 0;
   strip_counter_ = 0;
+
+  sphere_counter_   = 0;
+  cylinder_counter_ = 0;
 }
 
 
@@ -797,6 +966,12 @@ void vertex_cylinder (vector3 *v1, vector3 *v2)
   assert (v3_distance (v1, v2) > 0.0);
 
   set_colour_property (&(current_state->planecolour));
+
+  if (impostors_) {
+    output_cylinder_inst (v1, v2, current_state->cylinderradius, 1);
+    return;
+  }
+
   //ogl_cylinder_faces (v1, v2, current_state->cylinderradius, segments, TRUE);
   ogl_cylinder_faces (v1, v2, current_state->cylinderradius, segments - 2, TRUE);
 }
@@ -960,6 +1135,12 @@ vertex_sphere (at3d *at, double radius)
   assert (radius > 0.0);
 
   set_colour_property (&(at->colour));
+
+  if (impostors_) {
+    output_sphere_inst (&(at->xyz), radius);
+    return;
+  }
+
   //ogl_sphere_faces_globe (&(at->xyz), radius, 2 * current_state->segments);
   ogl_sphere_faces_globe (&(at->xyz), radius, current_state->segments - 2);
 }
@@ -978,6 +1159,12 @@ vertex_stick (vector3 *v1, vector3 *v2, double r1, double r2, colour *c)
   } else {
     set_colour_property (&(current_state->planecolour));
   }
+
+  if (impostors_) {
+    output_cylinder_inst (v1, v2, current_state->stickradius, 0);
+    return;
+  }
+
   //ogl_cylinder_faces (v1, v2, current_state->stickradius, current_state->segments + 5, FALSE);
   ogl_cylinder_faces (v1, v2, current_state->stickradius, current_state->segments, FALSE);
 }
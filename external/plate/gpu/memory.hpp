@@ -0,0 +1,147 @@
+#pragma once
+
+#include <string_view>
+#include <unordered_map>
+#include <map>
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef __EMSCRIPTEN__
+  #include <emscripten/heap.h>
+  #include <malloc.h>
+#endif
+
+
+/*
+    accounting of gpu memory: each buffer records the size of its last upload here, keyed by its gpu id, with a
+    tag saying who owns it (eg. a layer name), the frame it is for and what it is used for. untagged buffers
+    are owned by "plate".
+
+    owner and usage must be string literals (or otherwise outlive the buffer).
+
+    also the wasm heap of this module: its size, which only grows, and how much of it is allocated.
+*/
+
+namespace plate {
+
+
+class gpu_memory
+{
+
+public:
+
+  struct tag
+  {
+    std::string_view owner{"plate"};
+    int              frame{-1};
+    std::string_view usage{"buffer"};
+  };
+
+
+  struct totals
+  {
+    std::size_t buffers{0};
+    std::size_t bytes{0};
+  };
+
+
+  static void set(std::uint32_t id, const tag& t, std::size_t bytes) noexcept
+  {
+    auto& e = entries_[id];
+
+    total_ += bytes - e.bytes;
+
+    e = { t, bytes };
+  }
+
+
+  static void remove(std::uint32_t id) noexcept
+  {
+    if (auto it = entries_.find(id); it != entries_.end())
+    {
+      total_ -= it->second.bytes;
+      entries_.erase(it);
+    }
+  }
+
+
+  static std::size_t get_total() noexcept
+  {
+    return total_;
+  }
+
+
+  static std::size_t get_buffers() noexcept
+  {
+    return entries_.size();
+  }
+
+
+  // totals by owner and usage
+
+  static std::map<std::pair<std::string_view, std::string_view>, totals> by_owner() noexcept
+  {
+    std::map<std::pair<std::string_view, std::string_view>, totals> r;
+
+    for (auto& [id, e] : entries_)
+    {
+      auto& t = r[{ e.t.owner, e.t.usage }];
+
+      ++t.buffers;
+      t.bytes += e.bytes;
+    }
+
+    return r;
+  }
+
+
+  // bytes per frame of an owner, indexed by frame
+
+  static std::vector<std::size_t> by_frame(std::string_view owner) noexcept
+  {
+    std::vector<std::size_t> r;
+
+    for (auto& [id, e] : entries_)
+    {
+      if (e.t.owner != owner || e.t.frame < 0)
+        continue;
+
+      if (static_cast<std::size_t>(e.t.frame) >= r.size())
+        r.resize(e.t.frame + 1);
+
+      r[e.t.frame] += e.bytes;
+    }
+
+    return r;
+  }
+
+
+  // the size of the heap and the bytes allocated from it, or 0s where unknown
+
+  static std::pair<std::size_t, std::size_t> get_heap() noexcept
+  {
+#ifdef __EMSCRIPTEN__
+    return { emscripten_get_heap_size(), mallinfo().uordblks };
+#else
+    return { 0, 0 };
+#endif
+  }
+
+
+private:
+
+  struct entry
+  {
+    tag         t;
+    std::size_t bytes{0};
+  };
+
+  inline static std::unordered_map<std::uint32_t, entry> entries_;
+
+  inline static std::size_t total_{0};
+};
+
+
+} // namespace plate
@@ -19,8 +19,10 @@
 //#include "shaders/text/shader.hpp"
 #include "shaders/text_msdf/shader.hpp"
 #include "shaders/object/shader.hpp"
+#include "shaders/object_blend/shader.hpp"
 #include "shaders/object_instanced/shader.hpp"
 #include "shaders/spheres/shader.hpp"
+#include "shaders/cylinders/shader.hpp"
 //#include "shaders/example_geom/shader.hpp"
 //#include "shaders/circle/shader.hpp"
 #include "shaders/rounded_box/shader.hpp"
@@ -205,8 +207,10 @@ std::shared_ptr<plate::state> arch_create(std::string canvas_name, std::string f
 //  s->shader_text_                   = new shader_text(true);
   s->shader_text_msdf_              = new shader_text_msdf(true, s->version_);
   s->shader_object_                 = new shader_object(true);
+  s->shader_object_blend_           = new shader_object_blend(true);
   s->shader_object_instanced_       = new shader_object_instanced(true);
   s->shader_spheres_                = new shader_spheres(s->version_);
+  s->shader_cylinders_              = new shader_cylinders(s->version_);
 //  s->shader_example_geom_           = new shader_example_geom(true);
 //  s->shader_circle_                 = new shader_circle(true, s->version_);
   s->shader_rounded_box_            = new shader_rounded_box(true, s->version_);
@@ -217,8 +221,10 @@ std::shared_ptr<plate::state> arch_create(std::string canvas_name, std::string f
 //  s->shader_text_->link();
   s->shader_text_msdf_->link();
   s->shader_object_->link();
+  s->shader_object_blend_->link();
   s->shader_object_instanced_->link();
   s->shader_spheres_->link();
+  s->shader_cylinders_->link();
 //  s->shader_example_geom_->link();
 //  s->shader_circle_->link();
   s->shader_rounded_box_->link();
@@ -229,8 +235,10 @@ std::shared_ptr<plate::state> arch_create(std::string canvas_name, std::string f
 //  s->shader_text_->check();
   s->shader_text_msdf_->check();
   s->shader_object_->check();
+  s->shader_object_blend_->check();
   s->shader_object_instanced_->check();
   s->shader_spheres_->check();
+  s->shader_cylinders_->check();
 //  s->shader_example_geom_->check();
 //  s->shader_circle_->check();
   s->shader_rounded_box_->check();
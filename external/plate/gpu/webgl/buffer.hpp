@@ -8,6 +8,8 @@
 
 #include "pfr.hpp"
 
+#include "../memory.hpp"
+
 /*
 
   Represents a buffer of memory used by the gpu.
@@ -34,6 +36,8 @@
 
   (which are used by webgl functions to push and interpret the supplied data)
 
+  Each upload is accounted in gpu_memory under the buffer's tag, see set_tag().
+
 */
 
 
@@ -48,7 +52,21 @@ public:
   ~buffer()
   {
     if (id_)
+    {
+      gpu_memory::remove(id_);
       glDeleteBuffers(1, &id_);
+    }
+  }
+
+
+  // who the buffer's memory is accounted to
+
+  void set_tag(std::string_view owner, int frame = -1, std::string_view usage = "buffer") noexcept
+  {
+    tag_ = { owner, frame, usage };
+
+    if (id_)
+      gpu_memory::set(id_, tag_, count_ * sizeof(T));
   }
 
 
@@ -118,6 +136,35 @@ public:
     glBindBuffer(GL_ARRAY_BUFFER, id_);
     glBufferData(GL_ARRAY_BUFFER, count * sizeof(T), data, GL_STATIC_DRAW);
 
+    gpu_memory::set(id_, tag_, count * sizeof(T));
+
+    return true;
+  }
+
+
+  // for data replaced every frame: the storage is kept while the count is unchanged
+
+  bool stream(const T* data, int count, int mode = GL_TRIANGLES) noexcept
+  {
+    if (!id_ || count != count_)
+    {
+      if (!id_)
+        glGenBuffers(1, &id_);
+
+      glBindBuffer(GL_ARRAY_BUFFER, id_);
+      glBufferData(GL_ARRAY_BUFFER, count * sizeof(T), data, GL_STREAM_DRAW);
+
+      gpu_memory::set(id_, tag_, count * sizeof(T));
+    }
+    else
+    {
+      glBindBuffer(GL_ARRAY_BUFFER, id_);
+      glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(T), data);
+    }
+
+    count_ = count;
+    mode_  = mode;
+
     return true;
   }
 
@@ -181,6 +228,8 @@ public:
   std::vector<T> data_;
 
   int mode_{0};
+
+  gpu_memory::tag tag_;
 };
  
 } // namespace plate
@@ -0,0 +1,82 @@
+#extension GL_EXT_frag_depth : enable
+
+uniform highp mat4 u_proj;
+
+varying highp vec3  out_pos;
+varying highp vec3  out_ray;
+varying highp vec3  out_p1;
+varying highp vec3  out_axis;
+varying highp float out_radius;
+varying highp float out_caps;
+varying highp vec4  out_color;
+
+void main()
+{
+  // intersect the ray through this fragment with the cylinder, in view coordinates
+
+  highp vec3  d   = normalize(out_ray);
+  highp float len = length(out_axis);
+  highp vec3  u   = out_axis / len;
+
+  highp vec3  o  = out_pos - out_p1;
+  highp float od = dot(o, u);
+  highp float dd = dot(d, u);
+
+  highp vec3 op = o - od * u; // perpendicular to the axis
+  highp vec3 dp = d - dd * u;
+
+  highp float a = dot(dp, dp);
+  highp float b = dot(dp, op);
+  highp float c = dot(op, op) - out_radius * out_radius;
+
+  highp float disc = b * b - a * c;
+
+  if (disc < 0.0 || a < 1.0e-8)
+  {
+    discard;
+  }
+
+  // the intersection nearest the viewer, who looks down z
+
+  highp float s = sqrt(disc);
+  highp float t = (d.z > 0.0 ? -b + s : -b - s) / a;
+
+  highp float h = od + t * dd; // distance along the axis
+
+  highp vec3 normal;
+
+  if (h < 0.0 || h > len) // past an end, so through its cap if it has one
+  {
+    if (out_caps < 0.5)
+    {
+      discard;
+    }
+
+    highp float e = h < 0.0 ? 0.0 : len;
+
+    t = (e - od) / dd;
+
+    highp vec3 q = op + t * dp;
+
+    if (dot(q, q) > out_radius * out_radius)
+    {
+      discard;
+    }
+
+    normal = h < 0.0 ? -u : u;
+  }
+  else
+    normal = (op + t * dp) / out_radius;
+
+  highp vec3 hit = out_pos + t * d;
+
+  highp float diffuse = 1.0 - (0.7 * (1.0 - max(normal.z, 0.0)));
+
+  gl_FragColor = vec4(out_color.xyz * diffuse, out_color.a);
+
+  highp vec4 proj_hit = u_proj * vec4(hit, 1.0);
+
+#ifdef GL_EXT_frag_depth
+  gl_FragDepthEXT = proj_hit.z / proj_hit.w * 0.5 + 0.5;
+#endif
+}
@@ -0,0 +1,75 @@
+attribute vec3 v_position; // a corner of the unit box, x along the axis
+
+attribute vec3  i_p1;
+attribute vec3  i_p2;
+attribute vec2  i_shape;   // radius (in the units of i_scale of spheres), caps
+attribute vec4  i_color;
+
+uniform mat4 u_proj;
+
+uniform vec4 u_offset;
+uniform vec4 u_rot;
+uniform vec4 u_scale;
+
+varying highp vec3  out_pos;
+varying highp vec3  out_ray;
+varying highp vec3  out_p1;
+varying highp vec3  out_axis;
+varying highp float out_radius;
+varying highp float out_caps;
+varying highp vec4  out_color;
+
+
+void main()
+{
+  // uniform
+
+  highp float u_sin_x = sin(u_rot.x);
+  highp float u_cos_x = cos(u_rot.x);
+  highp float u_sin_y = sin(u_rot.y);
+  highp float u_cos_y = cos(u_rot.y);
+  highp float u_sin_z = sin(u_rot.z);
+  highp float u_cos_z = cos(u_rot.z);
+
+  mat4 u_m_rot = mat4(u_cos_y * u_cos_z, u_cos_y * u_sin_z, -u_sin_y,   0,
+                    u_cos_z * u_sin_x * u_sin_y - u_cos_x * u_sin_z, u_cos_x * u_cos_z + u_sin_x * u_sin_y * u_sin_z, u_cos_y * u_sin_x, 0,
+                    u_cos_x * u_cos_z * u_sin_y + u_sin_x * u_sin_z, u_cos_x * u_sin_y * u_sin_z - u_cos_z * u_sin_x, u_cos_x * u_cos_y, 0,
+                    0, 0, 0, 1 );
+
+  mat4 u_m_scale = mat4(u_scale.x, 0.0, 0.0, 0.0,
+                        0.0, u_scale.y, 0.0, 0.0,
+                        0.0, 0.0, u_scale.z, 0.0,
+                        0.0, 0.0, 0.0, u_scale.w);
+
+  // the end points and radius according to the view
+
+  highp vec3 p1 = (u_m_scale * (u_m_rot * vec4(i_p1, 1.0)) + u_offset).xyz;
+  highp vec3 p2 = (u_m_scale * (u_m_rot * vec4(i_p2, 1.0)) + u_offset).xyz;
+
+  highp float r = u_scale.z * i_shape.x / (100.0 * 400.0);
+
+  // a box around the cylinder, aligned to its axis
+
+  highp vec3 axis = p2 - p1;
+  highp vec3 u    = normalize(axis);
+  highp vec3 v    = normalize(cross(u, abs(u.x) < 0.9 ? vec3(1.0, 0.0, 0.0) : vec3(0.0, 1.0, 0.0)));
+  highp vec3 w    = cross(u, v);
+
+  highp vec3 pos = p1 + axis * (v_position.x * 0.5 + 0.5) + (v * v_position.y + w * v_position.z) * r;
+
+  // output
+
+  gl_Position = u_proj * vec4(pos, 1.0);
+
+  // the viewer is where w becomes 0, at the centre of the view
+
+  highp vec3 eye = vec3(1.0 / u_proj[0][0], 1.0 / u_proj[1][1], -1.0 / u_proj[2][3]);
+
+  out_pos    = pos;
+  out_ray    = pos - eye;
+  out_p1     = p1;
+  out_axis   = axis;
+  out_radius = r;
+  out_caps   = i_shape.y;
+  out_color  = i_color;
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include "../shader.hpp"
+#include "../../../gpu.hpp"
+#include "../../buffer.hpp"
+#include "../../../../system/common/projection.hpp"
+#include "../../texture.hpp"
+
+#include "../object/shader.hpp" // for ubo
+
+#include "gl.vert.h"
+#include "gl.frag.h"
+#include "gl2.vert.h"
+#include "gl2.frag.h"
+
+
+namespace plate {
+
+
+// instanced cylinders, ray cast in the fragment shader from a box around each. the radius is in the units of
+// the scale of shader_spheres, so sticks meet the spheres of their atoms
+
+class shader_cylinders {
+
+public:
+
+
+// the ubo used is shader_object::ubo
+
+
+  template<class T1, class T2> // eg: float
+  struct basic_vert
+  {
+    std::array<T1, 3> position; // a corner of the box from -1 to 1, x along the axis
+  };
+
+
+  template<class T1, class T2> // eg: short, std::uint8_t
+  struct basic_inst
+  {
+    std::array<T1, 3> p1;
+    std::array<T1, 3> p2;
+    std::array<T1, 2> shape;  // radius, and 1 if the ends are capped
+    std::array<T2, 4> color;
+  };
+
+
+  shader_cylinders(int version) noexcept
+  {
+    if (version == 1)
+      std::tie(vertex_shader_, fragment_shader_) = plate::compile(
+                      {reinterpret_cast<const char*>(cylinders_gl_vert), cylinders_gl_vert_len},
+                      {reinterpret_cast<const char*>(cylinders_gl_frag), cylinders_gl_frag_len});
+    else // version == 2
+      std::tie(vertex_shader_, fragment_shader_) = plate::compile(
+                      {reinterpret_cast<const char*>(cylinders_gl2_vert), cylinders_gl2_vert_len},
+                      {reinterpret_cast<const char*>(cylinders_gl2_frag), cylinders_gl2_frag_len});
+  }
+
+
+  void link() noexcept
+  {
+    program_ = plate::link(vertex_shader_,       fragment_shader_);
+  }
+
+
+  bool check() noexcept
+  {
+    if (!plate::check(vertex_shader_, fragment_shader_, program_))
+      return false;
+
+    attrib_position_ = glGetAttribLocation   (program_, "v_position");
+
+    attrib_p1_       = glGetAttribLocation   (program_, "i_p1");
+    attrib_p2_       = glGetAttribLocation   (program_, "i_p2");
+    attrib_shape_    = glGetAttribLocation   (program_, "i_shape");
+    attrib_color_    = glGetAttribLocation   (program_, "i_color");
+
+    uniform_proj_    = glGetUniformLocation(program_, "u_proj");
+    uniform_offset_  = glGetUniformLocation(program_, "u_offset");
+    uniform_rot_     = glGetUniformLocation(program_, "u_rot");
+    uniform_scale_   = glGetUniformLocation(program_, "u_scale");
+
+    return true;
+  }
+
+  // store the buffer configs into a vertex_array_object and use that for drawing
+
+  template<class VB, class IB>
+  void draw(const projection& p, buffer<shader_object::ubo>& ubuf, const buffer<VB>& vbuf,
+                                                        const buffer<IB>& ibuf, std::uint32_t* vertex_array_object)
+  {
+    if (*vertex_array_object == 0) // create the Vertex Array
+    {
+      glGenVertexArrays(1, vertex_array_object);
+
+      glBindVertexArray(*vertex_array_object);
+
+      // object/vertex buffer
+
+      glBindBuffer(GL_ARRAY_BUFFER, vbuf.id_);
+
+      const auto pos_type = vbuf.template get_type<0>();
+
+      glEnableVertexAttribArray(attrib_position_);
+      glVertexAttribPointer(attrib_position_, 3, pos_type, pos_type == GL_FLOAT ? GL_FALSE : GL_TRUE, sizeof(VB), nullptr);
+
+      // instance buffer
+
+      glBindBuffer(GL_ARRAY_BUFFER, ibuf.id_);
+
+      const auto p1_type    = ibuf.template get_type<0>();
+      const auto p2_type    = ibuf.template get_type<1>();
+      const auto shape_type = ibuf.template get_type<2>();
+      const auto color_type = ibuf.template get_type<3>();
+
+      glEnableVertexAttribArray(attrib_p1_);
+      glVertexAttribDivisor(attrib_p1_, 1);
+      glVertexAttribPointer(attrib_p1_, 3, p1_type, p1_type == GL_FLOAT ? GL_FALSE : GL_TRUE, sizeof(IB), nullptr);
+
+      glEnableVertexAttribArray(attrib_p2_);
+      glVertexAttribDivisor(attrib_p2_, 1);
+      glVertexAttribPointer(attrib_p2_, 3, p2_type, p2_type == GL_FLOAT ? GL_FALSE : GL_TRUE, sizeof(IB), (const GLvoid *)(0 + ibuf.template get_size_in_bytes_up_to<1>()));
+
+      glEnableVertexAttribArray(attrib_shape_);
+      glVertexAttribDivisor(attrib_shape_, 1);
+      glVertexAttribPointer(attrib_shape_, 2, shape_type, GL_FALSE, sizeof(IB), (const GLvoid *)(0 + ibuf.template get_size_in_bytes_up_to<2>()));
+
+      glEnableVertexAttribArray(attrib_color_);
+      glVertexAttribDivisor(attrib_color_, 1);
+      glVertexAttribPointer(attrib_color_, 4, color_type, color_type == GL_FLOAT ? GL_FALSE : GL_TRUE, sizeof(IB), (const GLvoid *)(0 + ibuf.template get_size_in_bytes_up_to<3>()));
+
+      glBindVertexArray(0);
+
+      glDisableVertexAttribArray(attrib_position_);
+
+      glDisableVertexAttribArray(attrib_p1_);
+      glDisableVertexAttribArray(attrib_p2_);
+      glDisableVertexAttribArray(attrib_shape_);
+      glDisableVertexAttribArray(attrib_color_);
+    }
+
+    // draw
+
+    glUseProgram(program_);
+
+    auto u = ubuf.map_staging();
+
+    glUniformMatrix4fv(uniform_proj_, 1, GL_FALSE, p.matrix_.data());
+
+    glUniform4f(uniform_offset_, u->offset.x, u->offset.y, u->offset.z, u->offset.w);
+    glUniform4f(uniform_rot_,    u->rot.x, u->rot.y, u->rot.z, u->rot.w);
+    glUniform4f(uniform_scale_,  u->scale.x, u->scale.y, u->scale.z, u->scale.w);
+
+    glBindVertexArray(*vertex_array_object);
+
+    glDrawArraysInstanced(vbuf.get_mode(), 0, vbuf.count_, ibuf.count_);
+
+    glBindVertexArray(0);
+  }
+
+
+private:
+
+
+  GLuint program_         = 0;
+
+  GLuint vertex_shader_   = 0;
+  GLuint fragment_shader_ = 0;
+
+  GLint  attrib_position_ = 0;
+
+  GLint  attrib_p1_       = 0;
+  GLint  attrib_p2_       = 0;
+  GLint  attrib_shape_    = 0;
+  GLint  attrib_color_    = 0;
+
+  GLint  uniform_proj_   = 0;
+  GLint  uniform_offset_ = 0;
+  GLint  uniform_rot_    = 0;
+  GLint  uniform_scale_  = 0;
+
+}; // shader_cylinders
+
+
+} // namespace plate
@@ -0,0 +1,179 @@
+#pragma once
+
+#include "../shader.hpp"
+#include "../../../gpu.hpp"
+#include "../../buffer.hpp"
+#include "../../../../system/common/projection.hpp"
+
+#include "../object/shader.hpp" // for ubo
+
+#include "gl.vert.h"
+#include "gl.frag.h"
+
+
+namespace plate {
+
+
+// as shader_object, with the positions and normals blended towards those of a second vertex buffer of the same
+// layout, eg. for drawing between two frames of a trajectory
+
+class shader_object_blend {
+
+public:
+
+
+// the ubo used is shader_object::ubo, the vertex buffers of either form of shader_object: with colours interleaved,
+// or with a separate color buffer
+
+
+  shader_object_blend(bool compile) noexcept
+  {
+    if (compile)
+      std::tie(vertex_shader_, fragment_shader_) = plate::compile(
+                                {reinterpret_cast<const char*>(object_blend_gl_vert), object_blend_gl_vert_len},
+                                {reinterpret_cast<const char*>(object_blend_gl_frag), object_blend_gl_frag_len});
+  }
+
+
+  void link() noexcept
+  {
+    program_ = plate::link(vertex_shader_, fragment_shader_);
+  }
+
+
+  bool check() noexcept
+  {
+    if (!plate::check(vertex_shader_, fragment_shader_, program_))
+      return false;
+
+    attrib_position_      = glGetAttribLocation   (program_, "position");
+    attrib_normal_        = glGetAttribLocation   (program_, "normal");
+    attrib_color_         = glGetAttribLocation   (program_, "color");
+    attrib_next_position_ = glGetAttribLocation   (program_, "next_position");
+    attrib_next_normal_   = glGetAttribLocation   (program_, "next_normal");
+
+    uniform_proj_     = glGetUniformLocation(program_, "proj");
+    uniform_offset_   = glGetUniformLocation(program_, "offset");
+    uniform_rot_      = glGetUniformLocation(program_, "rot");
+    uniform_scale_    = glGetUniformLocation(program_, "scale");
+    uniform_bg_color_ = glGetUniformLocation(program_, "bg_color");
+    uniform_blend_    = glGetUniformLocation(program_, "blend");
+
+    return true;
+  }
+
+
+  // draw vbuf blended by blend, from 0 to 1, towards next. next must have as many vertices as vbuf
+
+  template<class V>
+  void draw(const projection& p, const gpu::color& bg_color, buffer<shader_object::ubo>& ubuf, const buffer<V>& vbuf,
+                                                                                const buffer<V>& next, float blend)
+  {
+    use(p, bg_color, ubuf, blend);
+
+    bind_vertex(vbuf, attrib_position_, attrib_normal_);
+
+    const auto col_type = vbuf.template get_type<2>();
+
+    glEnableVertexAttribArray(attrib_color_);
+    glVertexAttribPointer(attrib_color_, 4, col_type, col_type == GL_FLOAT ? GL_FALSE : GL_TRUE, sizeof(V),
+                   (const GLvoid *)(0 + vbuf.template get_size_in_bytes<0>() + vbuf.template get_size_in_bytes<1>()));
+
+    finish(vbuf, next);
+  }
+
+
+  template<class V, class C>
+  void draw(const projection& p, const gpu::color& bg_color, buffer<shader_object::ubo>& ubuf, const buffer<V>& vbuf,
+                                                          const buffer<C>& cbuf, const buffer<V>& next, float blend)
+  {
+    use(p, bg_color, ubuf, blend);
+
+    bind_vertex(vbuf, attrib_position_, attrib_normal_);
+
+    glBindBuffer(GL_ARRAY_BUFFER, cbuf.id_);
+
+    const auto col_type = cbuf.template get_type<0>();
+
+    glEnableVertexAttribArray(attrib_color_);
+    glVertexAttribPointer(attrib_color_, 4, col_type, col_type == GL_FLOAT ? GL_FALSE : GL_TRUE, sizeof(C), nullptr);
+
+    finish(vbuf, next);
+  }
+
+
+private:
+
+
+  void use(const projection& p, const gpu::color& bg_color, buffer<shader_object::ubo>& ubuf, float blend) noexcept
+  {
+    auto u = ubuf.map_staging();
+
+    glUseProgram(program_);
+
+    glUniformMatrix4fv(uniform_proj_, 1, GL_FALSE, p.matrix_.data());
+
+    glUniform4f(uniform_offset_,   u->offset.x, u->offset.y, u->offset.z, u->offset.w);
+    glUniform4f(uniform_rot_,      u->rot.x, u->rot.y, u->rot.z, u->rot.w);
+    glUniform4f(uniform_scale_,    u->scale.x, u->scale.y, u->scale.z, u->scale.w);
+    glUniform4f(uniform_bg_color_, bg_color.r, bg_color.g, bg_color.b, bg_color.a);
+    glUniform1f(uniform_blend_,    blend);
+  }
+
+
+  // the positions and normals of vbuf to the given attributes
+
+  template<class V>
+  void bind_vertex(const buffer<V>& vbuf, GLint position, GLint normal) noexcept
+  {
+    const auto pos_type  = vbuf.template get_type<0>();
+    const auto norm_type = vbuf.template get_type<1>();
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbuf.id_);
+
+    glEnableVertexAttribArray(position);
+    glVertexAttribPointer(position, 3, pos_type, pos_type == GL_FLOAT ? GL_FALSE : GL_TRUE, sizeof(V), nullptr);
+
+    glEnableVertexAttribArray(normal);
+    glVertexAttribPointer(normal, 3, norm_type, norm_type == GL_FLOAT ? GL_FALSE : GL_TRUE, sizeof(V),
+                                                              (const GLvoid *)(0 + vbuf.template get_size_in_bytes<0>()));
+  }
+
+
+  template<class V>
+  void finish(const buffer<V>& vbuf, const buffer<V>& next) noexcept
+  {
+    bind_vertex(next, attrib_next_position_, attrib_next_normal_);
+
+    glDrawArrays(vbuf.get_mode(), 0, vbuf.count_);
+
+    glDisableVertexAttribArray(attrib_position_);
+    glDisableVertexAttribArray(attrib_normal_);
+    glDisableVertexAttribArray(attrib_color_);
+    glDisableVertexAttribArray(attrib_next_position_);
+    glDisableVertexAttribArray(attrib_next_normal_);
+  }
+
+
+  GLuint program_         = 0;
+
+  GLuint vertex_shader_   = 0;
+  GLuint fragment_shader_ = 0;
+
+  GLint  attrib_position_      = 0;
+  GLint  attrib_normal_        = 0;
+  GLint  attrib_color_         = 0;
+  GLint  attrib_next_position_ = 0;
+  GLint  attrib_next_normal_   = 0;
+
+  GLint  uniform_proj_     = 0;
+  GLint  uniform_offset_   = 0;
+  GLint  uniform_rot_      = 0;
+  GLint  uniform_scale_    = 0;
+  GLint  uniform_bg_color_ = 0;
+  GLint  uniform_blend_    = 0;
+
+}; // shader_object_blend
+
+
+} // namespace plate
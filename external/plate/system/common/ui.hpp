@@ -14,6 +14,7 @@
 #include "ui_event.hpp"
 #include "../../gpu/gpu.hpp"
 #include "../log.hpp"
+#include "../trace.hpp"
 
 
 /*
@@ -28,8 +29,10 @@ namespace plate {
 class shader_basic;
 //class shader_compute_template;
 class shader_object;
+class shader_object_blend;
 class shader_object_instanced;
 class shader_spheres;
+class shader_cylinders;
 //class shader_text;
 class shader_text_msdf;
 class shader_texture;
@@ -274,6 +277,8 @@ public:
 
   void display_all()
   {
+    trace_zone("ui::display_all");
+
     projection_.reset();
 
     if (anim_.process(frame_diff_, frame_time_correct_))
@@ -1153,8 +1158,10 @@ public:
   shader_basic*                  shader_basic_                  = nullptr;
 //  shader_compute_template*       shader_compute_template_       = nullptr;
   shader_object*                 shader_object_                 = nullptr;
+  shader_object_blend*           shader_object_blend_           = nullptr;
   shader_object_instanced*       shader_object_instanced_       = nullptr;
   shader_spheres*                shader_spheres_                = nullptr;
+  shader_cylinders*              shader_cylinders_              = nullptr;
 //  shader_text*                   shader_text_                   = nullptr;
   shader_text_msdf*              shader_text_msdf_              = nullptr;
   shader_texture*                shader_texture_                = nullptr;
@@ -0,0 +1,285 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <span>
+#include <vector>
+#include <set>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __EMSCRIPTEN__
+  #include <emscripten/emscripten.h>
+#endif
+
+#include "log.hpp"
+
+
+/*
+    chrome trace event recording, for chrome://tracing or perfetto. compiled in with PLATE_TRACE, otherwise
+    the macros are empty and nothing is recorded:
+
+      trace_zone(name)              - a complete event from here to the end of the scope
+      trace_counter(name, value)    - a counter value
+      trace_flow_begin(name, id)    - a flow arrow from the enclosing zone..
+      trace_flow_end(name, id)      - ..to the enclosing zone, eg. from a worker call to its callback
+      trace_async_begin(name, id)   - an async span, eg. a fetch, which may end in a later callback
+      trace_async_end(name, id)
+
+    names must be string literals (or otherwise outlive the trace). events are recorded from one thread.
+
+    workers record into their own trace, which is sent back at the end of a response (append_to) and merged
+    into the main trace by the worker client (strip_from) with the worker's number as its thread.
+
+    times are microseconds since the epoch, so main thread and worker events line up.
+*/
+
+#ifdef PLATE_TRACE
+  #define PLATE_TRACE_CAT2(a, b) a##b
+  #define PLATE_TRACE_CAT(a, b) PLATE_TRACE_CAT2(a, b)
+
+  #define trace_zone(name)            plate::trace::zone PLATE_TRACE_CAT(trace_zone_, __LINE__)(name)
+  #define trace_counter(name, value)  plate::trace::counter(name, value)
+  #define trace_flow_begin(name, id)  plate::trace::record(name, 's', id)
+  #define trace_flow_end(name, id)    plate::trace::record(name, 'f', id)
+  #define trace_async_begin(name, id) plate::trace::record(name, 'b', id)
+  #define trace_async_end(name, id)   plate::trace::record(name, 'e', id)
+#else
+  #define trace_zone(name)
+  #define trace_counter(name, value)
+  #define trace_flow_begin(name, id)
+  #define trace_flow_end(name, id)
+  #define trace_async_begin(name, id)
+  #define trace_async_end(name, id)
+#endif
+
+
+namespace plate
+{
+
+class trace
+{
+
+public:
+
+  static constexpr std::size_t max_events = 1 << 18;
+
+  static constexpr char magic[4] = { 'P', 'L', 'T', 'R' };
+
+
+  struct event
+  {
+    const char*   name;
+    double        ts;    // microseconds
+    double        dur;   // microseconds, for complete events
+    double        value; // for counters
+    std::uint64_t id;    // for flow and async events
+    std::uint32_t tid;   // 0 for this thread, n for worker n
+    char          ph;    // chrome trace event phase
+  };
+
+
+  static double now_us() noexcept
+  {
+#ifdef __EMSCRIPTEN__
+    return EM_ASM_DOUBLE({ return (performance.timeOrigin + performance.now()) * 1000; });
+#else
+    return std::chrono::duration<double, std::micro>(std::chrono::system_clock::now().time_since_epoch()).count();
+#endif
+  }
+
+
+  class zone
+  {
+
+  public:
+
+    zone(const char* name) noexcept :
+      name_(name),
+      start_(now_us())
+    {
+    }
+
+    ~zone() noexcept
+    {
+      add({ name_, start_, now_us() - start_, 0, 0, 0, 'X' });
+    }
+
+  private:
+
+    const char* name_;
+    double      start_;
+  };
+
+
+  static void counter(const char* name, double value) noexcept
+  {
+    add({ name, now_us(), 0, value, 0, 0, 'C' });
+  }
+
+
+  static void record(const char* name, char ph, std::uint64_t id) noexcept
+  {
+    add({ name, now_us(), 0, 0, id, 0, ph });
+  }
+
+
+  // a new id for flow or async events
+
+  static std::uint64_t next_id() noexcept
+  {
+    return ++id_;
+  }
+
+
+  static void clear() noexcept
+  {
+    events_.clear();
+    dropped_ = 0;
+  }
+
+
+  // append the recorded events to out, as a block ending with its size and magic, and clear them
+
+  static void append_to(std::vector<char>& out) noexcept
+  {
+    auto put = [&out] (const void* p, std::size_t n)
+    {
+      out.insert(out.end(), static_cast<const char*>(p), static_cast<const char*>(p) + n);
+    };
+
+    auto start = out.size();
+
+    for (auto& e : events_)
+    {
+      std::uint8_t len = std::min<std::size_t>(std::strlen(e.name), 255);
+
+      put(&e.ph, 1);
+      put(&len, 1);
+      put(e.name, len);
+      put(&e.ts, 8);
+      put(&e.dur, 8);
+      put(&e.value, 8);
+      put(&e.id, 8);
+    }
+
+    std::uint32_t size = out.size() - start + 8;
+
+    put(&size, 4);
+    put(magic, 4);
+
+    events_.clear();
+  }
+
+
+  // remove an appended block from the end of data if it has one, adding its events as thread tid
+
+  static void strip_from(std::span<char>& data, std::uint32_t tid) noexcept
+  {
+    if (data.size() < 8 || std::memcmp(data.data() + data.size() - 4, magic, 4) != 0)
+      return;
+
+    std::uint32_t size;
+    std::memcpy(&size, data.data() + data.size() - 8, 4);
+
+    if (size < 8 || size > data.size())
+      return;
+
+    auto p = data.data() + data.size() - size, end = data.data() + data.size() - 8;
+
+    while (end - p >= 2 && end - p >= 2 + static_cast<std::uint8_t>(p[1]) + 32)
+    {
+      event e{};
+
+      e.ph  = p[0];
+      e.tid = tid;
+
+      std::uint8_t len = p[1];
+
+      e.name = names_.emplace(p + 2, len).first->c_str();
+
+      p += 2 + len;
+
+      std::memcpy(&e.ts,    p,      8);
+      std::memcpy(&e.dur,   p + 8,  8);
+      std::memcpy(&e.value, p + 16, 8);
+      std::memcpy(&e.id,    p + 24, 8);
+
+      e.id |= static_cast<std::uint64_t>(tid) << 48; // distinct from the ids of other threads
+
+      p += 32;
+
+      add(e);
+    }
+
+    data = data.first(data.size() - size);
+  }
+
+
+  // the events as chrome trace json
+
+  static std::string to_json()
+  {
+    std::string s = R"({"displayTimeUnit":"ms","traceEvents":[)";
+
+    s += R"({"name":"process_name","ph":"M","pid":1,"tid":0,"args":{"name":"plate"}})";
+
+    std::uint32_t max_tid = 0;
+
+    for (auto& e : events_)
+      max_tid = std::max(max_tid, e.tid);
+
+    for (std::uint32_t t = 0; t <= max_tid; ++t)
+      s += fmt::format(FMT_COMPILE(R"(,{{"name":"thread_name","ph":"M","pid":1,"tid":{},"args":{{"name":"{}"}}}})"), t,
+                                                                        t ? fmt::format("worker {}", t) : std::string("main"));
+
+    for (auto& e : events_)
+    {
+      switch (e.ph)
+      {
+        case 'X':
+          s += fmt::format(FMT_COMPILE(R"(,{{"name":"{}","ph":"X","ts":{:.3f},"dur":{:.3f},"pid":1,"tid":{}}})"), e.name, e.ts, e.dur, e.tid);
+          break;
+
+        case 'C':
+          s += fmt::format(FMT_COMPILE(R"(,{{"name":"{}","ph":"C","ts":{:.3f},"pid":1,"tid":{},"args":{{"value":{}}}}})"), e.name, e.ts, e.tid, e.value);
+          break;
+
+        case 's':
+        case 'f':
+          s += fmt::format(FMT_COMPILE(R"(,{{"name":"{}","cat":"flow","ph":"{}","id":{},"ts":{:.3f},"pid":1,"tid":{}{}}})"), e.name, e.ph, e.id,
+                                                                                e.ts, e.tid, e.ph == 'f' ? R"(,"bp":"e")" : "");
+          break;
+
+        default:
+          s += fmt::format(FMT_COMPILE(R"(,{{"name":"{}","cat":"async","ph":"{}","id":{},"ts":{:.3f},"pid":1,"tid":{}}})"), e.name, e.ph, e.id, e.ts, e.tid);
+      }
+    }
+
+    s += fmt::format(FMT_COMPILE(R"(],"otherData":{{"dropped_events":{}}}}})"), dropped_);
+
+    return s;
+  }
+
+
+private:
+
+  static void add(const event& e) noexcept
+  {
+    if (events_.size() < max_events)
+      events_.push_back(e);
+    else
+      ++dropped_;
+  }
+
+
+  inline static std::vector<event> events_;
+
+  inline static std::set<std::string> names_; // of worker events
+
+  inline static std::uint64_t id_{0};
+  inline static std::uint64_t dropped_{0};
+};
+
+} // namespace plate
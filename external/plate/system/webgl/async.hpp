@@ -17,6 +17,7 @@
 #include <SDL/SDL_image.h>
 
 #include "../log.hpp"
+#include "../trace.hpp"
 #include "../common/data_store.hpp"
 
 
@@ -148,12 +149,17 @@ public:
     attr.requestHeaders = headers;
     attr.withCredentials = true;
 
+    trace_async_begin("async::fetch_get", fetch_trace_id + c);
+
     attr.onsuccess  = [] (emscripten_fetch_t *fetch) -> void
     {
       auto c = reinterpret_cast<std::size_t>(fetch->userData);
 
       //log_debug(FMT_COMPILE("Finished downloading {} bytes from URL {} counter: {}"), fetch->numBytes, fetch->url, c);
 
+      trace_async_end("async::fetch_get", fetch_trace_id + c);
+      trace_zone("async::fetch_get on_load");
+
       std::function<void (std::size_t, data_store&&, std::uint16_t)> on_load;
 
       {
@@ -188,6 +194,8 @@ public:
       log_debug(FMT_COMPILE("Failed to download from URL {} code: {} counter: {}"),
                                                                 fetch->url, fetch->status, c);
 
+      trace_async_end("async::fetch_get", fetch_trace_id + c);
+
       std::function<void (std::size_t, int)> on_error;
 
       {
@@ -230,6 +238,9 @@ public:
 
       [] (unsigned int handle, [[maybe_unused]] void* user_data, void* data, unsigned int data_size) -> void
       {
+        trace_async_end("async::request", request_trace_id + handle);
+        trace_zone("async::request on_load");
+
         auto it = cbs_.find(handle);
         if (it != cbs_.end())
         {
@@ -243,6 +254,8 @@ public:
 
       [] (unsigned int handle, [[maybe_unused]] void* user_data, int error_code, const char* error_msg)
       {
+        trace_async_end("async::request", request_trace_id + handle);
+
         auto it = cbs_.find(handle);
         if (it != cbs_.end())
         {
@@ -266,6 +279,8 @@ public:
 
     cbs_[handle] = { on_load, on_error, on_progress };
 
+    trace_async_begin("async::request", request_trace_id + handle);
+
     return handle;
   };
 
@@ -473,6 +488,11 @@ private:
 
   inline static std::map<std::size_t, std::pair<std::function<void (int, int, int, std::byte*)>, data_store>> decode_cbs_;
 
+  // trace ids of fetches and requests, apart as their counters overlap
+
+  static constexpr std::uint64_t fetch_trace_id   = 1ull << 40;
+  static constexpr std::uint64_t request_trace_id = 2ull << 40;
+
 
   #ifdef __EMSCRIPTEN_PTHREADS__
 
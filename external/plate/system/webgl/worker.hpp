@@ -4,6 +4,8 @@
 #include <vector>
 #include <queue>
 
+#include "../trace.hpp"
+
 /*
     client interface to call user worker code.
 
@@ -75,6 +77,22 @@ public:
   template<class DATA>
   bool call(std::string fname, DATA& data_to_send, std::function< void (std::span<char>)>&& cb) noexcept
   {
+#ifdef PLATE_TRACE
+    trace_zone("worker::call");
+
+    auto id = plate::trace::next_id();
+
+    trace_flow_begin("worker", id);
+
+    cb = [id, cb{std::move(cb)}] (std::span<char> d)
+    {
+      trace_zone("worker::callback");
+      trace_flow_end("worker", id);
+
+      cb(d);
+    };
+#endif
+
     if (queue_.empty())
     {
       for (int i = 0; i < num_workers_; ++i)
@@ -107,6 +125,8 @@ public:
 
     queue_.emplace(fname, std::move(data_to_send_copy), std::move(cb));
 
+    trace_counter("worker queue", queue_.size());
+
     return false; // request has been queued
   }
 
@@ -148,7 +168,13 @@ private:
     auto cb = std::move(work->cb);
     work->cb = nullptr;
 
-    cb(std::span<char>(d, s));
+    std::span<char> data(d, s);
+
+#ifdef PLATE_TRACE
+    plate::trace::strip_from(data, work - workers_.data() + 1); // the worker's own events
+#endif
+
+    cb(data);
 
     // can we process anything in the queue?
 
@@ -168,6 +194,8 @@ private:
 
           queue_.pop();
 
+          trace_counter("worker queue", queue_.size());
+
           break; // can be a maximum of 1 queue entry invoked as we've only freed 1 worker
         }
       }
@@ -7,6 +7,7 @@
 #include "../system/common/quaternion.hpp"
 #include "../system/common/ui_event_destination.hpp"
 #include "../gpu/shader_object.hpp"
+#include "../gpu/webgl/shaders/object_blend/shader.hpp"
 #include "../gpu/webgl/buffer.hpp"
 
 #include "../system/common/json/json.hpp"
@@ -72,12 +73,27 @@ public:
     }
     else // use supplied buffers
     {
-      for (auto& m : model_ptrs_)
+      for (std::size_t i = 0; i < model_ptrs_.size(); ++i)
       {
+        auto& m = model_ptrs_[i];
+
+        auto blend = blend_ > 0.0f && i < blend_next_.size() && blend_next_[i];
+
         if constexpr (std::is_same_v<bool, CTYPE>)
-          ui_->shader_object_->draw(ui_->projection_, bg, ext_ubuf_ ? *ext_ubuf_ : ubuf_, *m.vertex);
+        {
+          if (blend)
+            ui_->shader_object_blend_->draw(ui_->projection_, bg, ext_ubuf_ ? *ext_ubuf_ : ubuf_, *m.vertex, *blend_next_[i], blend_);
+          else
+            ui_->shader_object_->draw(ui_->projection_, bg, ext_ubuf_ ? *ext_ubuf_ : ubuf_, *m.vertex);
+        }
         else
-          ui_->shader_object_->draw(ui_->projection_, bg, ext_ubuf_ ? *ext_ubuf_ : ubuf_, *m.vertex, *m.color);
+        {
+          if (blend)
+            ui_->shader_object_blend_->draw(ui_->projection_, bg, ext_ubuf_ ? *ext_ubuf_ : ubuf_, *m.vertex, *m.color,
+                                                                                                  *blend_next_[i], blend_);
+          else
+            ui_->shader_object_->draw(ui_->projection_, bg, ext_ubuf_ ? *ext_ubuf_ : ubuf_, *m.vertex, *m.color);
+        }
       }
     }
 
@@ -107,6 +123,8 @@ public:
   {
     model_ptrs_.clear();
     model_ptrs_.push_back({buf, col_buf});
+
+    set_blend({}, 0.0f);
   }
 
 
@@ -116,6 +134,16 @@ public:
   }
 
 
+  // draw the supplied models blended by blend, from 0 to 1, towards next: a buffer of the same layout for each
+  // model, or nullptr to draw it as is. the colours are those of the model, and the blend is cleared by set_model
+
+  void set_blend(std::vector<Vert*> next, float blend) noexcept
+  {
+    blend_next_ = std::move(next);
+    blend_      = blend;
+  }
+
+
   void set_scale(float scale) noexcept
   {
     scale_ = scale;
@@ -384,6 +412,9 @@ private:
 
   std::vector<model> model_ptrs_;
 
+  std::vector<Vert*> blend_next_; // for each model
+  float              blend_{0.0f};
+
   bool mouse_down_{false};
   int  touch_id_;
 
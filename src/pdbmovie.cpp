@@ -142,6 +142,18 @@ public:
   }
 
 
+  // the chrome trace event json of the viewer and its workers, empty unless built with PLATE_TRACE
+
+  std::string get_trace()
+  {
+#ifdef PLATE_TRACE
+    return plate::trace::to_json();
+#else
+    return "";
+#endif
+  }
+
+
   void open_local(std::string url_objects)
   {
     emscripten_webgl_make_context_current(s_->ctx_);
@@ -192,13 +204,68 @@ public:
         local_files_.push_back(url_objects.substr(start, end - start));
     }
 
-    if (local_files_.size() != 2)
-      log_debug(FMT_COMPILE("Bad number of dcd files, wanted 2, got: {}"), local_files_.size());
+    if (local_files_.size() != 2 && local_files_.size() != 1) // psf and trajectory, or an amt file holding both
+      log_debug(FMT_COMPILE("Bad number of dcd files, wanted 1 or 2, got: {}"), local_files_.size());
     else
       animate();
   }
 
 
+  // decode cartoons with levels of detail, drawing the coarsest that looks the same at the current zoom. applies
+  // from the next structure loaded
+
+  void set_lod(bool lod)
+  {
+    lod_ = lod;
+
+    if (w_)
+      w_->set_lod(lod);
+  }
+
+
+  // sort spacefill atoms by position, for locality when drawn. applies from the next structure loaded
+
+  void set_spatial_order(bool spatial_order)
+  {
+    spatial_order_ = spatial_order;
+
+    if (w_)
+      w_->set_spatial_order(spatial_order);
+  }
+
+
+  // load every frame of a trajectory coarse first so it can be scrubbed early, then refine from the playhead out.
+  // applies from the next structure loaded
+
+  void set_progressive(bool progressive)
+  {
+    progressive_ = progressive;
+
+    if (w_)
+      w_->set_progressive(progressive);
+  }
+
+
+  // draw cartoons between frames while playing: "none", "linear" or "hermite" on the cpu, or "shader" for linear
+  // on the gpu. applies from the next structure loaded
+
+  void set_interpolation(std::string mode)
+  {
+    auto i = magic_enum::enum_cast<animol::interpolation>(mode);
+
+    if (!i)
+    {
+      log_debug(FMT_COMPILE("unknown interpolation: {}"), mode);
+      return;
+    }
+
+    interpolation_ = *i;
+
+    if (w_)
+      w_->set_interpolation(*i);
+  }
+
+
 private:
 
 
@@ -275,6 +342,11 @@ private:
 
     w_ = plate::ui_event_destination::make_ui<animol::widget_main>(s_, b, url_, code_, description_, mode_);
 
+    w_->set_lod(lod_);
+    w_->set_progressive(progressive_);
+    w_->set_spatial_order(spatial_order_);
+    w_->set_interpolation(interpolation_);
+
     if (restyle_needed_)
     {
       restyle_needed_ = false;
@@ -289,7 +361,13 @@ private:
     {
       if (is_dcd_)
       {
-        w_->start_local_dcd(local_files_[0], local_files_[1]);
+        if (local_files_.size() == 1)
+        {
+          std::string no_psf;
+          w_->start_local_dcd(no_psf, local_files_[0]);
+        }
+        else
+          w_->start_local_dcd(local_files_[0], local_files_[1]);
       }
       else
         w_->start_local("", local_files_);
@@ -324,6 +402,11 @@ private:
 
   bool is_remote_{false};
   bool is_dcd_{false};
+  bool lod_{false};
+  bool progressive_{false};
+  bool spatial_order_{false};
+
+  animol::interpolation interpolation_{animol::interpolation::none};
 
   std::shared_ptr<animol::widget_main> w_{};
 
@@ -344,7 +427,12 @@ EMSCRIPTEN_BINDINGS(movie)
     .function("set_style_json",             &movie::set_style_json)
     .function("get_json",                   &movie::get_json)
     .function("get_style_json",             &movie::get_style_json)
+    .function("get_trace",                  &movie::get_trace)
     .function("open_local",                 &movie::open_local)
     .function("open_local_dcd",             &movie::open_local_dcd)
+    .function("set_lod",                    &movie::set_lod)
+    .function("set_progressive",            &movie::set_progressive)
+    .function("set_spatial_order",          &movie::set_spatial_order)
+    .function("set_interpolation",          &movie::set_interpolation)
     ;
 }
@@ -0,0 +1,611 @@
+#include "../worker/pipeline.hpp"
+#include "../worker/frame_bundle.hpp"
+#include "../worker/geometry_delta.hpp"
+
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+
+#include <iostream>
+#include <string_view>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <functional>
+#include <vector>
+#include <charconv>
+#include <cstring>
+#include <chrono>
+#include <thread>
+
+
+/*
+    bake the cartoon geometry of every frame of a dataset into a geometry bundle, which the viewer uploads
+    directly instead of asking its workers to build it.
+
+    this runs the same pipeline as decoder_worker: the molauto script is generated once from the initial
+    frame, then each frame is converted to pdb, run through molscript and compacted with its colours after its
+    vertices and spheres and cylinders as impostors. molscript keeps its state in globals, so frames are shared
+    between forked worker processes rather than threads. each worker writes its frames to a file of its own,
+    which are gathered into the bundle in order.
+
+    with -d, frames are stored as deltas of the frame before, with every keyframe'th frame stored whole so a frame
+    is at most that many decodes from one, and the compression and the throughput of decoding them are reported.
+*/
+
+extern "C" {
+
+float fast_float_c(const char* s)
+{
+  float f;
+
+  if (animol::string_data::parse_float(f, std::string_view{s, strlen(s)}))
+    return f;
+
+  return 0;
+}
+
+} // extern "C"
+
+
+// map a file into memory, returns an empty span on failure
+
+std::span<const std::byte> map_file(const std::string& filename)
+{
+  auto fd = open(filename.c_str(), O_RDONLY);
+
+  if (fd == -1)
+  {
+    fmt::print("cannot open file: {}\n", filename);
+    return {};
+  }
+
+  struct stat sb;
+
+  if (fstat(fd, &sb) == -1)
+  {
+    fmt::print("cannot stat file: {}\n", filename);
+    close(fd);
+    return {};
+  }
+
+  std::size_t size = sb.st_size;
+
+  if (size == 0)
+  {
+    close(fd);
+    return {};
+  }
+
+  auto data = static_cast<const std::byte*>(mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0));
+
+  close(fd);
+
+  if (data == MAP_FAILED)
+    return {};
+
+  return { data, size };
+}
+
+
+bool read_file(const std::filesystem::path& filename, std::string& out)
+{
+  std::ifstream in(filename, std::ios::binary);
+
+  if (!in)
+    return false;
+
+  std::ostringstream ss;
+  ss << in.rdbuf();
+
+  out = std::move(ss).str();
+
+  return true;
+}
+
+
+// the pdb of a frame, as the worker would give molscript
+
+using frame_to_pdb = std::function<bool (int frame, std::string& pdb)>;
+
+
+// the compacted geometry of pdb, from molscript run with script in the current directory
+
+std::string decode(animol::pipeline& p, const std::string& script, const std::string& pdb) noexcept
+{
+  std::string r;
+
+  p.make_geometry(script, pdb, OPTION_COLOR | OPTION_IMPOSTORS, [&r] (std::span<const char> g)
+  {
+    r.assign(g.data(), g.size());
+  });
+
+  return r;
+}
+
+
+// a worker process: bake frames worker, worker + number_workers.. into dir/frames.bin as (frame, size, geometry)
+//
+// the first molscript run in a process leaves some strip colours unset, later runs carry them over from the
+// run before, so the initial frame is decoded first so every frame is baked as a running viewer worker would
+
+int bake_worker(const frame_to_pdb& get_pdb, int number_frames, int master_frame, int worker, int number_workers,
+                                                      const std::filesystem::path& dir, const std::string& script)
+{
+  std::filesystem::create_directory(dir);
+  std::filesystem::current_path(dir);
+
+  animol::pipeline p(std::make_shared<animol::file_fetcher>(), "");
+
+  std::ofstream out("frames.bin", std::ios::binary);
+
+  std::string pdb;
+
+  if (!get_pdb(master_frame, pdb))
+    return EXIT_FAILURE;
+
+  decode(p, script, pdb);
+
+  for (int f = worker; f < number_frames; f += number_workers)
+  {
+    if (!get_pdb(f, pdb))
+    {
+      fmt::print("unable to convert frame: {}\n", f);
+      return EXIT_FAILURE;
+    }
+
+    auto g = decode(p, script, pdb);
+
+    std::uint32_t h[2] = { static_cast<std::uint32_t>(f), static_cast<std::uint32_t>(g.size()) };
+
+    out.write(reinterpret_cast<const char*>(h), sizeof(h));
+    out << g;
+  }
+
+  out.close();
+
+  return out ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+// the compression of the delta frames, and the throughput of decoding them, checked against the frames
+
+bool report_deltas(const std::vector<std::string_view>& frames, const std::vector<std::vector<char>>& deltas)
+{
+  std::uint64_t raw_bytes = 0, delta_bytes = 0, number_deltas = 0;
+
+  for (std::size_t f = 0; f < frames.size(); ++f)
+    if (!deltas[f].empty())
+    {
+      raw_bytes   += frames[f].size();
+      delta_bytes += deltas[f].size();
+
+      ++number_deltas;
+    }
+
+  if (number_deltas == 0)
+  {
+    fmt::print("deltas: none smaller than their frames\n");
+    return true;
+  }
+
+  std::vector<char> out;
+
+  for (std::size_t f = 0; f < frames.size(); ++f)
+    if (!deltas[f].empty() && (!animol::geometry_delta::decode(deltas[f], frames[f - 1], out) ||
+                                                  std::string_view(out.data(), out.size()) != frames[f]))
+    {
+      fmt::print("delta of frame: {} does not decode to it\n", f);
+      return false;
+    }
+
+  constexpr int repeat = 10;
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (int r = 0; r < repeat; ++r)
+    for (std::size_t f = 0; f < frames.size(); ++f)
+      if (!deltas[f].empty())
+        animol::geometry_delta::decode(deltas[f], frames[f - 1], out);
+
+  auto decode_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  fmt::print("deltas: {} frames {} bytes of {} ratio: {:.2f} decode: {:.0f} MB/s\n", number_deltas, delta_bytes, raw_bytes,
+                          static_cast<double>(raw_bytes) / delta_bytes, repeat * raw_bytes / decode_time / 1e6);
+
+  return true;
+}
+
+
+int main(int argc, char* argv[])
+{
+  using namespace magic_enum::bitwise_operators;
+
+  const std::string exitArgMessage = fmt::format("usage: {} [-j<workers>] [-d[<keyframe>]] <dataset directory> [<out.geometry>]\n"
+                                                 "       {} [-j<workers>] [-d[<keyframe>]] <psffile.psf> <trajectory.dcd|xtc> <out.geometry>\n"
+                                                 "  bakes the cartoon geometry of each frame of a movie.plan dataset or trajectory into a geometry\n"
+                                                 "  bundle, by default movie.geometry in the dataset directory. workers defaults to the number of cores\n"
+                                                 "  -d stores frames as deltas of the frame before, every keyframe'th (default 16) whole\n", argv[0], argv[0]);
+
+  int number_workers = std::max(1u, std::thread::hardware_concurrency());
+
+  int keyframe = 0; // no deltas
+
+  int i = 1;
+
+  for (; i < argc && argv[i][0] == '-'; ++i)
+  {
+    std::string_view sv(argv[i]);
+
+    if (sv.starts_with("-j"))
+    {
+      auto s = sv.substr(2);
+
+      if (std::from_chars(s.data(), s.data() + s.size(), number_workers).ec == std::errc() && number_workers > 0)
+        continue;
+    }
+
+    if (sv.starts_with("-d"))
+    {
+      auto s = sv.substr(2);
+
+      keyframe = 16;
+
+      if (s.empty() || (std::from_chars(s.data(), s.data() + s.size(), keyframe).ec == std::errc() && keyframe > 0))
+        continue;
+    }
+
+    fmt::print("{}", exitArgMessage);
+    return EXIT_FAILURE;
+  }
+
+  const int args = argc - i;
+
+  if (args < 1 || args > 3)
+  {
+    fmt::print("{}", exitArgMessage);
+    return EXIT_FAILURE;
+  }
+
+  frame_to_pdb get_pdb;
+
+  int number_frames = 0;
+  int master_frame  = 0;
+
+  std::filesystem::path out_filename;
+
+  // structure file per frame: read on demand and converted as the worker does for the cartoon
+
+  std::filesystem::path dir;
+  std::vector<std::string> files;
+
+  // trajectory: a ca only template populated per frame
+
+  animol::dcd2pdb converter;
+
+  std::span<const std::byte> trajectory;
+
+  std::optional<animol::dcd2pdb::info> dcd_info;
+
+  std::vector<std::uint64_t> xtc_offsets, xtc_sizes;
+  animol::xtc2pdb xtc_decoder;
+  std::vector<float> xyz;
+
+  if (args < 3)
+  {
+    dir          = argv[i];
+    out_filename = (args == 2) ? std::filesystem::path(argv[i + 1]) : dir / "movie.geometry";
+
+    std::string plan;
+
+    if (!read_file(dir / "movie.plan", plan))
+    {
+      fmt::print("cannot read: {}\n", (dir / "movie.plan").string());
+      return EXIT_FAILURE;
+    }
+
+    master_frame = -1;
+
+    std::string_view sv(plan);
+
+    for (std::size_t start = 0; start < sv.size();)
+    {
+      auto end = std::min(sv.find('\n', start), sv.size());
+
+      if (end == start)
+        master_frame = std::max<int>(0, files.size() - 1);
+      else
+        files.emplace_back(sv.substr(start, end - start));
+
+      start = end + 1;
+    }
+
+    number_frames = files.size();
+
+    if (master_frame == -1) // as the viewer, the middle frame
+      master_frame = std::max(0, number_frames / 2 - 1);
+
+    get_pdb = [&] (int frame, std::string& pdb)
+    {
+      std::string file, converted;
+
+      if (!read_file(dir / files[frame], file))
+        return false;
+
+      auto r = to_pdb(std::as_bytes(std::span(file)), animol::cif2pdb::options::ca_atoms | animol::cif2pdb::options::sheet |
+                                                                                 animol::cif2pdb::options::helix, converted);
+      if (!r)
+        return false;
+
+      pdb.assign(r->data(), r->size());
+
+      return true;
+    };
+  }
+  else
+  {
+    out_filename = argv[i + 2];
+
+    auto psf   = map_file(argv[i]);
+    trajectory = map_file(argv[i + 1]);
+
+    if (psf.empty() || trajectory.empty())
+      return EXIT_FAILURE;
+
+    if (!converter.generate_template(psf, true, false))
+    {
+      fmt::print("cannot generate template\n");
+      return EXIT_FAILURE;
+    }
+
+    std::uint64_t number_atoms;
+
+    if (animol::xtc2pdb::is_xtc(trajectory))
+    {
+      auto h = animol::xtc2pdb::read_header(trajectory);
+
+      if (!h)
+      {
+        fmt::print("cannot read xtc header\n");
+        return EXIT_FAILURE;
+      }
+
+      number_atoms  = h->number_atoms;
+
+      animol::xtc2pdb::scan(trajectory, 0, number_atoms, xtc_offsets, xtc_sizes);
+
+      number_frames = xtc_offsets.size();
+
+      get_pdb = [&] (int frame, std::string& pdb)
+      {
+        if (!xtc_decoder.decode(trajectory.subspan(xtc_offsets[frame], xtc_sizes[frame]), xyz) || !converter.populate_template(xyz))
+          return false;
+
+        pdb = converter.get_pdb_data();
+
+        return true;
+      };
+    }
+    else
+    {
+      dcd_info = animol::dcd2pdb::get_dcd_data_info(trajectory);
+
+      if (!dcd_info || dcd_info->get_frame_offset(dcd_info->number_frames) > trajectory.size())
+      {
+        fmt::print("cannot get dcd data info\n");
+        return EXIT_FAILURE;
+      }
+
+      number_atoms  = dcd_info->number_atoms;
+      number_frames = dcd_info->number_frames;
+
+      get_pdb = [&] (int frame, std::string& pdb)
+      {
+        if (!converter.populate_template(trajectory.subspan(dcd_info->get_frame_offset(frame), dcd_info->get_frame_size())))
+          return false;
+
+        pdb = converter.get_pdb_data();
+
+        return true;
+      };
+    }
+
+    if (number_atoms != static_cast<std::uint64_t>(converter.get_number_of_atoms()))
+    {
+      fmt::print("bad number of atoms, trajectory has: {} psf has: {}\n", number_atoms, converter.get_number_of_atoms());
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (number_frames == 0)
+  {
+    fmt::print("no frames\n");
+    return EXIT_FAILURE;
+  }
+
+  number_workers = std::min(number_workers, number_frames);
+
+  out_filename = std::filesystem::absolute(out_filename);
+
+  if (!dir.empty())
+    dir = std::filesystem::absolute(dir);
+
+  char tmp_template[] = "/tmp/bakeXXXXXX";
+
+  if (!mkdtemp(tmp_template))
+  {
+    fmt::print("cannot create temporary directory\n");
+    return EXIT_FAILURE;
+  }
+
+  std::filesystem::path tmp(tmp_template);
+
+  auto start = std::chrono::steady_clock::now();
+
+  // the script, generated once from the initial frame
+
+  std::string pdb, script;
+
+  std::filesystem::current_path(tmp);
+
+  if (!get_pdb(master_frame, pdb))
+  {
+    fmt::print("unable to convert initial frame: {}\n", master_frame);
+    return EXIT_FAILURE;
+  }
+
+  script = animol::pipeline(std::make_shared<animol::file_fetcher>(), "").make_script(pdb);
+
+  if (script.empty())
+  {
+    fmt::print("unable to generate script\n");
+    return EXIT_FAILURE;
+  }
+
+  // bake
+
+  std::vector<pid_t> workers;
+
+  std::cout.flush();
+
+  for (int w = 0; w < number_workers; ++w)
+  {
+    auto pid = fork();
+
+    if (pid == 0)
+      _exit(bake_worker(get_pdb, number_frames, master_frame, w, number_workers, tmp / fmt::format("w{}", w), script));
+
+    if (pid < 0)
+    {
+      fmt::print("unable to start worker: {}\n", w);
+      return EXIT_FAILURE;
+    }
+
+    workers.push_back(pid);
+  }
+
+  bool ok = true;
+
+  for (auto pid : workers)
+  {
+    int status;
+
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+      ok = false;
+  }
+
+  if (!ok)
+  {
+    fmt::print("a worker failed\n");
+    std::filesystem::remove_all(tmp);
+    return EXIT_FAILURE;
+  }
+
+  auto bake_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  // gather into the bundle
+
+  std::vector<std::string> results(number_workers);
+  std::vector<std::string_view> frames(number_frames);
+
+  for (int w = 0; w < number_workers; ++w)
+  {
+    read_file(tmp / fmt::format("w{}", w) / "frames.bin", results[w]);
+
+    std::string_view r(results[w]);
+
+    while (r.size() >= 8)
+    {
+      std::uint32_t h[2];
+      std::memcpy(h, r.data(), sizeof(h));
+
+      if (h[0] >= static_cast<std::uint32_t>(number_frames) || r.size() < 8 + h[1])
+        break;
+
+      frames[h[0]] = r.substr(8, h[1]);
+      r.remove_prefix(8 + h[1]);
+    }
+  }
+
+  std::filesystem::remove_all(tmp);
+
+  // deltas, each of the frame before unless a keyframe or no smaller
+
+  std::vector<std::vector<char>> deltas(number_frames);
+
+  for (int f = 0; f < number_frames && keyframe > 0; ++f)
+    if (f % keyframe != 0)
+      deltas[f] = animol::geometry_delta::encode(frames[f], frames[f - 1], f - 1);
+
+  auto get_stored = [&] (int f) -> std::string_view
+  {
+    return deltas[f].empty() ? frames[f] : std::string_view(deltas[f].data(), deltas[f].size());
+  };
+
+  animol::frame_bundle::header h{};
+
+  std::memcpy(h.magic, animol::frame_bundle::magic.data(), 4);
+
+  h.version       = animol::frame_bundle::version;
+  h.number_frames = number_frames;
+  h.master_frame  = master_frame;
+  h.number_parts  = 1;
+  h.flags         = static_cast<std::uint32_t>(animol::frame_bundle::bundle_flags::geometry) |
+                    static_cast<std::uint32_t>(animol::frame_bundle::bundle_flags::non_interleaved);
+
+  if (keyframe > 0)
+    h.flags |= static_cast<std::uint32_t>(animol::frame_bundle::bundle_flags::delta);
+
+  h.index_offset  = sizeof(h);
+  h.data_offset   = animol::frame_bundle::get_index_end(h);
+
+  std::vector<animol::frame_bundle::index_entry> index(number_frames);
+
+  std::uint64_t offset = h.data_offset;
+
+  for (int f = 0; f < number_frames; ++f)
+  {
+    if (frames[f].empty())
+    {
+      fmt::print("missing frame: {}\n", f);
+      return EXIT_FAILURE;
+    }
+
+    offset = (offset + 3) & ~std::uint64_t(3); // so the viewer reads the header in place
+
+    index[f] = { offset, static_cast<std::uint32_t>(get_stored(f).size()), static_cast<std::uint32_t>(frames[f].size()) };
+    offset  += get_stored(f).size();
+  }
+
+  std::ofstream out_file(out_filename, std::ios::binary);
+
+  out_file.write(reinterpret_cast<const char*>(&h), sizeof(h));
+  out_file.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(animol::frame_bundle::index_entry));
+
+  for (int f = 0; f < number_frames; ++f)
+  {
+    while (static_cast<std::uint64_t>(out_file.tellp()) < index[f].offset)
+      out_file.put(0);
+
+    out_file << get_stored(f);
+  }
+
+  if (!out_file)
+  {
+    fmt::print("cannot write: {}\n", out_filename.string());
+    return EXIT_FAILURE;
+  }
+
+  fmt::print("frames: {} workers: {} bake: {:.2f} s {:.1f} frames/s\n", number_frames, number_workers, bake_time, number_frames / bake_time);
+  fmt::print("geometry: {} bytes\n", offset);
+
+  if (keyframe > 0)
+    return report_deltas(frames, deltas) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
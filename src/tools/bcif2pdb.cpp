@@ -0,0 +1,162 @@
+#include "../worker/bcif2pdb.hpp"
+
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+
+#include <iostream>
+#include <string_view>
+#include <fstream>
+#include <vector>
+#include <charconv>
+#include <array>
+#include <iomanip>
+#include <cstddef>
+#include <cstring>
+#include <chrono>
+
+
+// map a file into memory, returns an empty span on failure
+
+std::span<const std::byte> map_file(const std::string& filename)
+{
+  auto fd = open(filename.c_str(), O_RDONLY);
+
+  if (fd == -1)
+  {
+    fmt::print("cannot open file: {}\n", filename);
+    return {};
+  }
+
+  struct stat sb;
+
+  if (fstat(fd, &sb) == -1)
+  {
+    fmt::print("cannot stat file: {}\n", filename);
+    close(fd);
+    return {};
+  }
+
+  std::size_t size = sb.st_size;
+
+  auto data = static_cast<const std::byte*>(mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0));
+
+  close(fd);
+
+  if (data == MAP_FAILED)
+    return {};
+
+  return { data, size };
+}
+
+
+int main(int argc, char* argv[])
+{
+  using namespace magic_enum::bitwise_operators;
+
+  const std::string exitArgMessage = fmt::format("usage: {} [-sheet | -helix | -atom[=ca, =nca] | -hetatm | -compare=<PDBx/mmCIF.cif>] <BinaryCIF.bcif> <out.pdb>\n"
+                                                 "  no options defaults to output everything.\n"
+                                                 "  -compare times conversion of the same entry in text form and checks the output matches.\n", argv[0]);
+
+  if (argc < 3)
+  {
+    fmt::print("{}", exitArgMessage);
+    return EXIT_FAILURE;
+  }
+
+  animol::cif2pdb::options opt = animol::cif2pdb::options::none;
+
+  std::string compare_filename;
+
+  for (int i = 1; i < argc - 2; ++i)
+  {
+    std::string_view sv(argv[i]);
+
+    if (sv == "-sheet")   { opt |= animol::cif2pdb::options::sheet; continue; }
+    if (sv == "-helix")   { opt |= animol::cif2pdb::options::helix; continue; }
+    if (sv == "-hetatm")  { opt |= animol::cif2pdb::options::hetatm; continue; }
+    if (sv == "-atom=ca") { opt |= animol::cif2pdb::options::ca_atoms; continue; }
+    if (sv == "-atom=nca"){ opt |= animol::cif2pdb::options::non_ca_atoms; continue; }
+    if (sv == "-atom")    { opt |= animol::cif2pdb::options::ca_atoms | animol::cif2pdb::options::non_ca_atoms; continue; }
+
+    if (sv.starts_with("-compare=")) { compare_filename = sv.substr(9); continue; }
+
+    fmt::print("{}", exitArgMessage);
+    return EXIT_FAILURE;
+  }
+
+  if (opt == animol::cif2pdb::options::none) // default to all
+    opt = animol::cif2pdb::options::sheet | animol::cif2pdb::options::helix | animol::cif2pdb::options::hetatm |
+          animol::cif2pdb::options::ca_atoms | animol::cif2pdb::options::non_ca_atoms;
+
+  std::string bcif_filename(argv[argc - 2]);
+  std::string pdb_filename(argv[argc - 1]);
+
+  auto data = map_file(bcif_filename);
+
+  if (data.empty())
+    return EXIT_FAILURE;
+
+  if (!animol::bcif2pdb::is_bcif(data))
+  {
+    fmt::print("not a BinaryCIF file: {}\n", bcif_filename);
+    return EXIT_FAILURE;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  animol::bcif2pdb converter(data, opt);
+
+  auto r = converter.convert();
+
+  auto bcif_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  if (!r)
+  {
+    fmt::print("unable to convert: {}\n", bcif_filename);
+    return EXIT_FAILURE;
+  }
+
+  std::ofstream out_file(pdb_filename);
+  out_file << *r;
+
+  if (compare_filename.empty())
+    return EXIT_SUCCESS;
+
+  auto cif_data = map_file(compare_filename);
+
+  if (cif_data.empty())
+    return EXIT_FAILURE;
+
+  start = std::chrono::steady_clock::now();
+
+  animol::cif2pdb cif_converter(cif_data, opt);
+
+  auto cr = cif_converter.convert();
+
+  auto cif_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  if (!cr)
+  {
+    fmt::print("unable to convert: {}\n", compare_filename);
+    return EXIT_FAILURE;
+  }
+
+  fmt::print("bcif: {: >10} bytes {: >9.3f} ms\n", data.size(), bcif_time * 1000);
+  fmt::print("cif:  {: >10} bytes {: >9.3f} ms\n", cif_data.size(), cif_time * 1000);
+  fmt::print("size ratio: {:.2f} speedup: {:.2f}\n", static_cast<double>(cif_data.size()) / data.size(), cif_time / bcif_time);
+
+  if (*r != *cr)
+  {
+    fmt::print("outputs differ\n");
+    return EXIT_FAILURE;
+  }
+
+  fmt::print("outputs match\n");
+
+  return EXIT_SUCCESS;
+}
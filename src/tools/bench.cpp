@@ -0,0 +1,742 @@
+#include "../worker/pipeline.hpp"
+
+#include <malloc.h>
+#include <stdlib.h>
+
+
+#include <iostream>
+#include <string_view>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <vector>
+#include <map>
+#include <charconv>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <random>
+
+
+/*
+    time each stage of the worker pipeline natively:
+
+      convert           - cif, bcif or mmtf to pdb (cif2pdb etc.), for fixtures not already pdb
+      generate_atoms    - visualise::generate_atoms, the spacefill atoms
+      spatial_order     - atom_order: the atoms sorted into spatial order
+      molauto           - the script
+      molscript         - parse the script and pdb and generate the geometry
+      compact           - compact the geometry, coloured and interleaved
+      generate_template - dcd2pdb template from a psf
+      populate_template - a dcd frame into the template, per frame
+
+    fixtures are structure files, a psf and dcd pair, a synthetic helical structure of a given number of atoms,
+    or a synthetic trajectory of such a structure. each stage is run a number of times and the median kept.
+
+    the peak memory of a stage is how far the resident size rose above that at its start: freed memory is
+    returned to the system and the peak reset (/proc/self/clear_refs) before each stage, so the peak of one
+    stage is not hidden by that of an earlier one.
+
+    make bench-check runs the fixtures of check/bench_baseline.json: a structure the size of crambin (1CRN), a
+    complex of 100k atoms and a trajectory of 10k frames, all synthetic so they are the same on any machine.
+
+    results can be written as json, one result per line, and compared against a stored baseline: a stage
+    slower than its baseline by more than the threshold is a regression and fails the run.
+*/
+
+extern "C" {
+
+float fast_float_c(const char* s)
+{
+  float f;
+
+  if (animol::string_data::parse_float(f, std::string_view{s, strlen(s)}))
+    return f;
+
+  return 0;
+}
+
+} // extern "C"
+
+
+struct result
+{
+  std::string fixture;
+  std::string stage;
+
+  std::uint64_t atoms;
+  std::uint64_t bytes;   // processed by the stage
+  std::uint64_t ns;      // median per run
+  std::uint64_t peak_kb; // the most the resident size rose by during the stage
+};
+
+
+struct measured
+{
+  std::uint64_t ns;
+  std::uint64_t peak_kb;
+};
+
+
+bool read_file(const std::filesystem::path& filename, std::string& out)
+{
+  std::ifstream in(filename, std::ios::binary);
+
+  if (!in)
+    return false;
+
+  std::ostringstream ss;
+  ss << in.rdbuf();
+
+  out = std::move(ss).str();
+
+  return true;
+}
+
+
+// write the trace events recorded, as chrome trace json
+
+bool write_trace(const std::string& filename)
+{
+#ifdef PLATE_TRACE
+  std::ofstream out(filename);
+
+  out << plate::trace::to_json();
+
+  if (!out)
+  {
+    fmt::print("cannot write: {}\n", filename);
+    return false;
+  }
+
+  return true;
+#else
+  fmt::print("cannot write: {}, built without PLATE_TRACE (make TRACE=1)\n", filename);
+  return false;
+#endif
+}
+
+
+void write_file(const std::string& filename, std::string_view data)
+{
+  std::ofstream out(filename, std::ios::binary);
+  out << data;
+}
+
+
+// a size in kB from /proc/self/status, eg. VmRSS (resident) or VmHWM (peak resident)
+
+std::uint64_t status_kb(std::string_view field)
+{
+  std::ifstream in("/proc/self/status");
+
+  for (std::string line; std::getline(in, line);)
+    if (line.starts_with(field) && line.size() > field.size() && line[field.size()] == ':')
+    {
+      auto v = std::string_view(line).substr(field.size() + 1);
+
+      v.remove_prefix(std::min(v.find_first_not_of(" \t"), v.size()));
+
+      std::uint64_t kb = 0;
+      std::from_chars(v.data(), v.data() + v.size(), kb);
+
+      return kb;
+    }
+
+  return 0;
+}
+
+
+// return freed memory to the system and reset the peak resident size to the current, which is returned
+
+std::uint64_t reset_peak()
+{
+  malloc_trim(0);
+
+  std::ofstream("/proc/self/clear_refs") << "5";
+
+  return status_kb("VmRSS");
+}
+
+
+// the median time of repeat runs of f, each a trace zone named stage, and the most the resident size rose by
+
+template<typename F>
+measured measure([[maybe_unused]] const char* stage, int repeat, F&& f)
+{
+  auto start_kb = reset_peak();
+
+  std::vector<std::uint64_t> t;
+
+  for (int r = 0; r < repeat; ++r)
+  {
+    trace_zone(stage);
+
+    auto start = std::chrono::steady_clock::now();
+
+    f();
+
+    t.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+  }
+
+  std::sort(t.begin(), t.end());
+
+  auto peak_kb = status_kb("VmHWM");
+
+  return { t[t.size() / 2], peak_kb > start_kb ? peak_kb - start_kb : 0 };
+}
+
+
+// an alpha helical poly-alanine of about number_atoms atoms, in chains of up to 500 residues
+
+std::string synthetic_pdb(int number_atoms)
+{
+  static constexpr std::array<std::string_view, 5> names = { " N  ", " CA ", " C  ", " O  ", " CB " };
+  static constexpr std::array<std::string_view, 5> elements = { "N", "C", "C", "O", "C" };
+
+  // cylindrical coordinates per atom about the helix axis: radius, angle offset (degrees) and rise offset
+
+  static constexpr std::array<std::array<float, 3>, 5> offsets = {{ { 1.55f, -28.0f, -0.85f }, { 2.3f, 0.0f, 0.0f },
+                                                                     { 1.65f, 28.0f, 0.75f }, { 1.75f, 45.0f, 1.95f },
+                                                                     { 3.3f, -10.0f, -0.6f } }};
+
+  static constexpr std::string_view chains = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+
+  std::string pdb;
+
+  int residues = std::max(1, number_atoms / 5);
+
+  for (int i = 0, serial = 1; i < residues; ++i)
+  {
+    int chain = i / 500, res = i % 500;
+
+    float angle = res * 100.0f, rise = res * 1.5f;
+    float cx = (chain % 16) * 30.0f, cy = (chain / 16) * 30.0f;
+
+    for (std::size_t a = 0; a < names.size(); ++a, ++serial)
+    {
+      float t = (angle + offsets[a][1]) * 3.14159265f / 180.0f;
+
+      pdb += fmt::format("ATOM  {:5d} {} ALA {}{:4d}    {:8.3f}{:8.3f}{:8.3f}  1.00  0.00          {:>2}\n",
+                         serial % 100000, names[a], chains[chain % chains.size()], res + 1,
+                         cx + offsets[a][0] * std::cos(t), cy + offsets[a][0] * std::sin(t), rise + offsets[a][2], elements[a]);
+    }
+
+    if (res == 499 || i == residues - 1)
+      pdb += "TER\n";
+  }
+
+  pdb += "END\n";
+
+  return pdb;
+}
+
+
+// the structure stages of one fixture, data in any supported format
+
+bool bench_structure(const std::string& name, std::string_view data, int repeat, const std::filesystem::path& tmp,
+                                                                                  std::vector<result>& results)
+{
+  using namespace magic_enum::bitwise_operators;
+
+  auto bytes = std::as_bytes(std::span(data.data(), data.size()));
+
+  auto options = animol::cif2pdb::options::ca_atoms | animol::cif2pdb::options::sheet | animol::cif2pdb::options::helix;
+
+  std::string converted;
+  std::optional<std::span<const char>> pdb;
+
+  auto convert_stage = measure("convert", repeat, [&] { pdb = to_pdb(bytes, options, converted); });
+
+  if (!pdb)
+  {
+    fmt::print("unable to convert: {}\n", name);
+    return false;
+  }
+
+  std::string cartoon_pdb(pdb->data(), pdb->size());
+
+  // the atoms
+
+  auto atoms_options = animol::cif2pdb::options::ca_atoms | animol::cif2pdb::options::non_ca_atoms;
+
+  auto all_pdb = to_pdb(bytes, atoms_options, converted);
+
+  if (!all_pdb)
+  {
+    fmt::print("unable to convert: {}\n", name);
+    return false;
+  }
+
+  std::string atoms_pdb(all_pdb->data(), all_pdb->size());
+
+  std::vector<animol::visualise::atom> atoms;
+
+  auto atoms_stage = measure("generate_atoms", repeat, [&]
+  {
+    atoms.clear();
+
+    animol::visualise v(atoms_pdb);
+
+    v.generate_atoms(atoms, animol::visualise::ATOMS | animol::visualise::HETATOMS | animol::visualise::SHIFT_TO_CENTER_OF_MASS);
+  });
+
+  std::uint64_t number_atoms = atoms.size();
+
+  if (bytes.data() != reinterpret_cast<const std::byte*>(pdb->data())) // converted rather than pdb already
+    results.push_back({ name, "convert", number_atoms, data.size(), convert_stage.ns, convert_stage.peak_kb });
+
+  results.push_back({ name, "generate_atoms", number_atoms, atoms_pdb.size(), atoms_stage.ns, atoms_stage.peak_kb });
+
+  auto order_stage = measure("spatial_order", repeat, [&]
+  {
+    auto sorted = atoms;
+
+    animol::atom_order::sort(sorted);
+  });
+
+  results.push_back({ name, "spatial_order", number_atoms, atoms.size() * sizeof(animol::visualise::atom), order_stage.ns,
+                                                                                                 order_stage.peak_kb });
+
+  // the script, geometry and compaction
+
+  animol::pipeline p(std::make_shared<animol::file_fetcher>(), tmp.string() + "/");
+
+  std::string script;
+
+  auto molauto_stage = measure("molauto", repeat, [&] { script = p.make_script(cartoon_pdb); });
+
+  if (script.empty())
+  {
+    fmt::print("unable to generate script: {}\n", name);
+    return false;
+  }
+
+  results.push_back({ name, "molauto", number_atoms, cartoon_pdb.size(), molauto_stage.ns, molauto_stage.peak_kb });
+
+  write_file(tmp / "i.script", script);
+  write_file(tmp / "i.pdb", cartoon_pdb);
+
+  auto script_file = (tmp / "i.script").string();
+
+  const char *argv[] = { "molscript", "-vertex", "-s", "-in", script_file.c_str() };
+
+  auto run_molscript = [&]
+  {
+    vertex_clear();
+
+    molscript(sizeof(argv) / sizeof(argv[0]), const_cast<char**>(argv));
+  };
+
+  run_molscript(); // the first run in a process differs, see bake
+
+  auto molscript_stage = measure("molscript", repeat, run_molscript);
+
+  results.push_back({ name, "molscript", number_atoms, cartoon_pdb.size(), molscript_stage.ns, molscript_stage.peak_kb });
+
+  std::uint64_t compact_bytes = 0;
+
+  auto compact_stage = measure("compact", repeat, [&]
+  {
+    char* cdata = nullptr;
+
+    compact_bytes = compact(&cdata, OPTION_COLOR | OPTION_INTERLEAVE);
+
+    free(cdata);
+  });
+
+  results.push_back({ name, "compact", number_atoms, compact_bytes, compact_stage.ns, compact_stage.peak_kb });
+
+  return true;
+}
+
+
+// a psf and dcd of the synthetic structure of about number_atoms atoms, each frame moved a little from the last
+
+std::pair<std::string, std::string> synthetic_dcd(int number_atoms, int number_frames)
+{
+  std::vector<float> xyz; // the first frame, interleaved
+
+  auto pdb = synthetic_pdb(number_atoms);
+
+  std::string psf;
+
+  for (std::string_view v(pdb); !v.empty();)
+  {
+    auto line = v.substr(0, v.find('\n'));
+
+    v.remove_prefix(std::min(line.size() + 1, v.size()));
+
+    if (!line.starts_with("ATOM"))
+      continue;
+
+    for (int c = 0; c < 3; ++c)
+    {
+      float f = 0;
+      animol::string_data::parse_float(f, line.substr(30 + c * 8, 8));
+      xyz.push_back(f);
+    }
+
+    psf += fmt::format("{:8d} P1   {:<4} ALA  {:<4} CT     0.000000       12.0110 0\n", xyz.size() / 3,
+                                                                  line.substr(22, 4), line.substr(12, 4));
+  }
+
+  const std::int32_t n = xyz.size() / 3;
+
+  psf = fmt::format("PSF\n\n       1 !NTITLE\n REMARKS synthetic\n\n{:8d} !NATOM\n", n) + psf;
+
+  std::string dcd;
+
+  auto put = [&dcd] (const auto& v) { dcd.append(reinterpret_cast<const char*>(&v), sizeof(v)); };
+
+  animol::dcd2pdb::dcd_header h{};
+
+  h.len         = 84;
+  h.nset        = number_frames;
+  h.nsavc       = 1;
+  h.dt          = 0.1f;
+  h.len_confirm = 84;
+
+  std::memcpy(h.cord, "CORD", 4);
+
+  put(h);
+
+  char title[80] = "synthetic";
+
+  put(std::int32_t{84}); put(std::int32_t{1}); put(title); put(std::int32_t{84});
+  put(std::int32_t{4});  put(n);               put(std::int32_t{4});
+
+  std::mt19937 rng(1);
+  std::normal_distribution<float> step(0.0f, 0.05f);
+
+  std::vector<float> c(n);
+
+  for (int f = 0; f < number_frames; ++f)
+  {
+    for (auto& v : xyz)
+      v += step(rng);
+
+    for (int k = 0; k < 3; ++k)
+    {
+      for (int i = 0; i < n; ++i)
+        c[i] = xyz[i * 3 + k];
+
+      put(n * 4);
+      dcd.append(reinterpret_cast<const char*>(c.data()), n * 4);
+      put(n * 4);
+    }
+  }
+
+  return { std::move(psf), std::move(dcd) };
+}
+
+
+// the trajectory stages of a psf and dcd pair
+
+bool bench_dcd(const std::string& name, std::string_view psf, std::string_view dcd, int repeat, std::vector<result>& results)
+{
+  auto psf_bytes = std::as_bytes(std::span(psf.data(), psf.size()));
+  auto dcd_bytes = std::as_bytes(std::span(dcd.data(), dcd.size()));
+
+  animol::dcd2pdb converter;
+
+  bool ok = true;
+
+  auto template_stage = measure("generate_template", repeat, [&] { ok = converter.generate_template(psf_bytes, true, true); });
+
+  auto info = converter.get_dcd_data_info(dcd_bytes);
+
+  if (!ok || !info || info->number_atoms != converter.get_number_of_atoms())
+  {
+    fmt::print("unable to read: {}\n", name);
+    return false;
+  }
+
+  std::uint64_t number_atoms = info->number_atoms;
+
+  results.push_back({ name, "generate_template", number_atoms, psf.size(), template_stage.ns, template_stage.peak_kb });
+
+  std::uint64_t frame_size = (4 + 4 + (4 * number_atoms)) * 3;
+
+  int number_frames = std::min<std::uint64_t>(info->number_frames, (dcd.size() - info->start_offset) / frame_size);
+
+  auto populate_stage = measure("populate_template", repeat, [&]
+  {
+    for (int f = 0; f < number_frames && ok; ++f)
+      ok = converter.populate_template(dcd_bytes.subspan(info->start_offset + f * frame_size, frame_size));
+  });
+
+  if (!ok || number_frames == 0)
+  {
+    fmt::print("unable to populate template: {}\n", name);
+    return false;
+  }
+
+  results.push_back({ name, "populate_template", number_atoms, frame_size, populate_stage.ns / number_frames, populate_stage.peak_kb });
+
+  return true;
+}
+
+
+std::string to_json(const result& r)
+{
+  return fmt::format("{{\"fixture\":\"{}\",\"stage\":\"{}\",\"atoms\":{},\"bytes\":{},\"ns\":{},\"ns_per_atom\":{:.3f},"
+                     "\"bytes_per_s\":{:.0f},\"peak_kb\":{}}}", r.fixture, r.stage, r.atoms, r.bytes, r.ns,
+                     r.atoms ? static_cast<double>(r.ns) / r.atoms : 0.0, r.ns ? r.bytes * 1e9 / r.ns : 0.0, r.peak_kb);
+}
+
+
+// the value of "key": in a json line written by to_json
+
+std::string_view json_value(std::string_view line, std::string_view key)
+{
+  auto k = line.find(fmt::format("\"{}\":", key));
+
+  if (k == std::string_view::npos)
+    return {};
+
+  auto v = line.substr(k + key.size() + 3);
+
+  if (v.starts_with('"'))
+    return v.substr(1, v.find('"', 1) - 1);
+
+  return v.substr(0, v.find_first_of(",}"));
+}
+
+
+// read baseline median ns by fixture and stage
+
+bool read_baseline(const std::string& filename, std::map<std::pair<std::string, std::string>, std::uint64_t>& baseline)
+{
+  std::ifstream in(filename);
+
+  if (!in)
+    return false;
+
+  for (std::string line; std::getline(in, line);)
+  {
+    auto fixture = json_value(line, "fixture"), stage = json_value(line, "stage"), ns = json_value(line, "ns");
+
+    std::uint64_t v;
+
+    if (!fixture.empty() && !stage.empty() && std::from_chars(ns.data(), ns.data() + ns.size(), v).ec == std::errc())
+      baseline[{ std::string(fixture), std::string(stage) }] = v;
+  }
+
+  return true;
+}
+
+
+int main(int argc, char* argv[])
+{
+  const std::string exitArgMessage = fmt::format("usage: {} [-repeat=N] [-synthetic=atoms]... [-synthetic-dcd=atoms,frames]... [-dcd=<psf>,<dcd>]...\n"
+                                                 "          [-json=<out.json>] [-baseline=<baseline.json>] [-threshold=percent] [-trace=<trace.json>]\n"
+                                                 "          [structure file]...\n"
+                                                 "  times each worker pipeline stage per fixture, median of N runs (default 5). with a baseline,\n"
+                                                 "  fails if a stage is slower than it by more than the threshold (default 10%)\n", argv[0]);
+
+  int repeat = 5;
+  double threshold = 10;
+
+  std::vector<int> synthetic;
+  std::vector<std::pair<int, int>> synthetic_dcds;
+  std::vector<std::pair<std::string, std::string>> dcds;
+  std::vector<std::string> files;
+
+  std::string json_filename, baseline_filename, trace_filename;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string_view sv(argv[i]);
+
+    if (!sv.starts_with("-"))
+    {
+      files.emplace_back(sv);
+      continue;
+    }
+
+    auto value = sv.substr(std::min(sv.find('=') + 1, sv.size()));
+
+    if (sv.starts_with("-repeat="))
+    {
+      if (std::from_chars(value.data(), value.data() + value.size(), repeat).ec == std::errc() && repeat > 0)
+        continue;
+    }
+    else if (sv.starts_with("-synthetic="))
+    {
+      int n;
+
+      if (std::from_chars(value.data(), value.data() + value.size(), n).ec == std::errc() && n > 0)
+      {
+        synthetic.push_back(n);
+        continue;
+      }
+    }
+    else if (sv.starts_with("-synthetic-dcd="))
+    {
+      int n, frames;
+
+      if (auto comma = value.find(','); comma != std::string_view::npos &&
+          std::from_chars(value.data(), value.data() + comma, n).ec == std::errc() && n > 0 &&
+          std::from_chars(value.data() + comma + 1, value.data() + value.size(), frames).ec == std::errc() && frames > 0)
+      {
+        synthetic_dcds.emplace_back(n, frames);
+        continue;
+      }
+    }
+    else if (sv.starts_with("-dcd="))
+    {
+      if (auto comma = value.find(','); comma != std::string_view::npos)
+      {
+        dcds.emplace_back(value.substr(0, comma), value.substr(comma + 1));
+        continue;
+      }
+    }
+    else if (sv.starts_with("-json="))
+    {
+      json_filename = value;
+      continue;
+    }
+    else if (sv.starts_with("-trace="))
+    {
+      trace_filename = value;
+      continue;
+    }
+    else if (sv.starts_with("-baseline="))
+    {
+      baseline_filename = value;
+      continue;
+    }
+    else if (sv.starts_with("-threshold="))
+    {
+      if (std::from_chars(value.data(), value.data() + value.size(), threshold).ec == std::errc() && threshold >= 0)
+        continue;
+    }
+
+    fmt::print("{}", exitArgMessage);
+    return EXIT_FAILURE;
+  }
+
+  if (synthetic.empty() && synthetic_dcds.empty() && dcds.empty() && files.empty())
+  {
+    fmt::print("{}", exitArgMessage);
+    return EXIT_FAILURE;
+  }
+
+  char tmp_template[] = "/tmp/benchXXXXXX";
+
+  if (!mkdtemp(tmp_template))
+  {
+    fmt::print("cannot create temporary directory\n");
+    return EXIT_FAILURE;
+  }
+
+  std::filesystem::path tmp(tmp_template);
+
+  std::vector<result> results;
+
+  bool ok = true;
+
+  for (auto n : synthetic)
+    ok &= bench_structure(fmt::format("synthetic_{}", n), synthetic_pdb(n), repeat, tmp, results);
+
+  for (auto& f : files)
+  {
+    std::string data;
+
+    if (!read_file(f, data))
+    {
+      fmt::print("cannot read: {}\n", f);
+      ok = false;
+      continue;
+    }
+
+    ok &= bench_structure(std::filesystem::path(f).filename().string(), data, repeat, tmp, results);
+  }
+
+  for (auto [n, frames] : synthetic_dcds)
+  {
+    auto [psf, dcd] = synthetic_dcd(n, frames);
+
+    ok &= bench_dcd(fmt::format("synthetic_{}x{}.dcd", n, frames), psf, dcd, repeat, results);
+  }
+
+  for (auto& [psf_filename, dcd_filename] : dcds)
+  {
+    std::string psf, dcd;
+
+    if (!read_file(psf_filename, psf) || !read_file(dcd_filename, dcd))
+    {
+      fmt::print("cannot read: {} {}\n", psf_filename, dcd_filename);
+      ok = false;
+      continue;
+    }
+
+    ok &= bench_dcd(std::filesystem::path(dcd_filename).filename().string(), psf, dcd, repeat, results);
+  }
+
+  std::filesystem::remove_all(tmp);
+
+  if (!trace_filename.empty() && !write_trace(trace_filename))
+    return EXIT_FAILURE;
+
+  fmt::print("{: <24} {: <18} {: >9} {: >14} {: >11} {: >12} {: >10}\n", "fixture", "stage", "atoms", "ns", "ns/atom", "MB/s", "peak kB");
+
+  for (auto& r : results)
+    fmt::print("{: <24} {: <18} {: >9} {: >14} {: >11.2f} {: >12.1f} {: >10}\n", r.fixture, r.stage, r.atoms, r.ns,
+               r.atoms ? static_cast<double>(r.ns) / r.atoms : 0.0, r.ns ? r.bytes * 1e3 / r.ns : 0.0, r.peak_kb);
+
+  if (!json_filename.empty())
+  {
+    std::ofstream out(json_filename);
+
+    out << "[\n";
+
+    for (std::size_t i = 0; i < results.size(); ++i)
+      out << to_json(results[i]) << (i + 1 < results.size() ? ",\n" : "\n");
+
+    out << "]\n";
+
+    if (!out)
+    {
+      fmt::print("cannot write: {}\n", json_filename);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (!baseline_filename.empty())
+  {
+    std::map<std::pair<std::string, std::string>, std::uint64_t> baseline;
+
+    if (!read_baseline(baseline_filename, baseline))
+    {
+      fmt::print("cannot read: {}\n", baseline_filename);
+      return EXIT_FAILURE;
+    }
+
+    int regressions = 0;
+
+    for (auto& r : results)
+    {
+      auto it = baseline.find({ r.fixture, r.stage });
+
+      if (it == baseline.end() || it->second == 0)
+        continue;
+
+      double change = (static_cast<double>(r.ns) / it->second - 1) * 100;
+
+      if (change > threshold)
+      {
+        fmt::print("regression: {} {} {} ns, baseline {} ns ({:+.1f}%)\n", r.fixture, r.stage, r.ns, it->second, change);
+        ++regressions;
+      }
+    }
+
+    fmt::print("{} regressions against: {} (threshold {}%)\n", regressions, baseline_filename, threshold);
+
+    if (regressions)
+      return EXIT_FAILURE;
+  }
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
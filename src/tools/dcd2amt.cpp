@@ -0,0 +1,310 @@
+#include "../worker/dcd2pdb.hpp"
+#include "../worker/amtraj.hpp"
+
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <zlib.h>
+
+
+#include <iostream>
+#include <string_view>
+#include <fstream>
+#include <vector>
+#include <charconv>
+#include <array>
+#include <iomanip>
+#include <cstddef>
+#include <cstring>
+#include <chrono>
+
+
+// map a file into memory, returns an empty span on failure
+
+std::span<const std::byte> map_file(const std::string& filename)
+{
+  auto fd = open(filename.c_str(), O_RDONLY);
+
+  if (fd == -1)
+  {
+    fmt::print("cannot open file: {}\n", filename);
+    return {};
+  }
+
+  struct stat sb;
+
+  if (fstat(fd, &sb) == -1)
+  {
+    fmt::print("cannot stat file: {}\n", filename);
+    close(fd);
+    return {};
+  }
+
+  std::size_t size = sb.st_size;
+
+  auto data = static_cast<const std::byte*>(mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0));
+
+  close(fd);
+
+  if (data == MAP_FAILED)
+    return {};
+
+  return { data, size };
+}
+
+
+// zlib compress data, returns an empty string on failure
+
+std::string deflate_block(std::string_view data, int level)
+{
+  std::string out(compressBound(data.size()), '\0');
+
+  uLongf size = out.size();
+
+  if (compress2(reinterpret_cast<Bytef*>(out.data()), &size, reinterpret_cast<const Bytef*>(data.data()), data.size(), level) != Z_OK)
+    return {};
+
+  out.resize(size);
+
+  return out;
+}
+
+
+int main(int argc, char* argv[])
+{
+  const std::string exitArgMessage = fmt::format("usage: {} [-keyframe=<interval>] [-precision=<steps per angstrom>] [-deflate[=level]] [-verify] <psffile.psf> <trajectory.dcd> <out.amt>\n"
+                                                 "  defaults: keyframe every 10 frames, precision 100 (0.01 angstroms), no deflate.\n"
+                                                 "  -verify decodes every frame, checks it against the dcd and reports decode speed\n", argv[0]);
+
+  std::uint32_t keyframe_interval = 10;
+  float         precision         = 100;
+  int           deflate_level     = 0;
+  bool          verify            = false;
+
+  int i = 1;
+
+  for (; i < argc && argv[i][0] == '-'; ++i)
+  {
+    std::string_view sv(argv[i]);
+
+    auto value = [&] (auto& v)
+    {
+      auto s = sv.substr(sv.find('=') + 1);
+      return std::from_chars(s.data(), s.data() + s.size(), v).ec == std::errc();
+    };
+
+    if      (sv.starts_with("-keyframe=")  && value(keyframe_interval) && keyframe_interval > 0) continue;
+    else if (sv.starts_with("-precision=") && value(precision) && precision > 0) continue;
+    else if (sv.starts_with("-deflate=")   && value(deflate_level) && deflate_level > 0 && deflate_level <= 9) continue;
+    else if (sv == "-deflate") { deflate_level = 6; continue; }
+    else if (sv == "-verify")  { verify = true; continue; }
+
+    fmt::print("{}", exitArgMessage);
+    return EXIT_FAILURE;
+  }
+
+  if (argc - i != 3)
+  {
+    fmt::print("{}", exitArgMessage);
+    return EXIT_FAILURE;
+  }
+
+  std::string psf_filename(argv[i]);
+  std::string dcd_filename(argv[i + 1]);
+  std::string amt_filename(argv[i + 2]);
+
+  auto psf = map_file(psf_filename);
+  auto dcd = map_file(dcd_filename);
+
+  if (psf.empty() || dcd.empty())
+    return EXIT_FAILURE;
+
+  animol::dcd2pdb converter;
+
+  if (!converter.generate_template(psf, true, true))
+  {
+    fmt::print("cannot generate template\n");
+    return EXIT_FAILURE;
+  }
+
+  auto info = animol::dcd2pdb::get_dcd_data_info(dcd);
+
+  if (!info)
+  {
+    fmt::print("cannot get dcd data info\n");
+    return EXIT_FAILURE;
+  }
+
+  if (info->number_atoms != converter.get_number_of_atoms())
+  {
+    fmt::print("bad number of atoms, dcd has: {} psf has: {}\n", info->number_atoms, converter.get_number_of_atoms());
+    return EXIT_FAILURE;
+  }
+
+  if (info->get_frame_offset(info->number_frames) > dcd.size())
+  {
+    fmt::print("dcd too short for {} frames\n", info->number_frames);
+    return EXIT_FAILURE;
+  }
+
+  const std::uint32_t n = info->number_atoms;
+
+  // planar float coordinates of a dcd frame, skipping the fortran record lengths
+
+  auto dcd_plane = [&] (int frame, int axis)
+  {
+    return reinterpret_cast<const float*>(dcd.data() + info->get_frame_offset(frame) + axis * (4 + 4 + 4 * n) + 4);
+  };
+
+  animol::amtraj::header h{};
+
+  std::memcpy(h.magic, animol::amtraj::magic.data(), 4);
+
+  h.version           = animol::amtraj::version;
+  h.number_atoms      = n;
+  h.number_frames     = info->number_frames;
+  h.keyframe_interval = keyframe_interval;
+  h.precision         = precision;
+  h.time_step         = reinterpret_cast<const animol::dcd2pdb::dcd_header*>(dcd.data())->dt * animol::dcd2pdb::time_multiplier / 1000;
+
+  std::string topology(reinterpret_cast<const char*>(psf.data()), psf.size());
+
+  if (deflate_level)
+    topology = deflate_block(topology, deflate_level);
+
+  std::vector<animol::amtraj::index_entry> index(h.number_frames);
+
+  h.index_offset    = sizeof(h);
+  h.topology_offset = h.index_offset + index.size() * sizeof(animol::amtraj::index_entry);
+  h.topology_size   = topology.size();
+  h.frames_offset   = h.topology_offset + h.topology_size;
+
+  // encode frames
+
+  std::string frames, block;
+
+  std::vector<std::int32_t> q(n * 3), key(n * 3);
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (std::uint32_t f = 0; f < h.number_frames; ++f)
+  {
+    for (int a = 0; a < 3; ++a)
+    {
+      auto p = dcd_plane(f, a);
+
+      for (std::uint32_t j = 0; j < n; ++j)
+        q[a * n + j] = animol::amtraj::quantise(p[j], precision);
+    }
+
+    const bool is_key = (f % keyframe_interval) == 0;
+
+    if (is_key)
+      key = q;
+
+    block.clear();
+    animol::amtraj::encode_block(q, is_key ? std::span<const std::int32_t>{} : std::span<const std::int32_t>(key), n, block);
+
+    auto& e = index[f];
+
+    e.offset   = h.frames_offset + frames.size();
+    e.raw_size = block.size();
+    e.keyframe = f - (f % keyframe_interval);
+    e.flags    = is_key ? static_cast<std::uint32_t>(animol::amtraj::frame_flags::keyframe) : 0;
+
+    if (deflate_level)
+    {
+      auto d = deflate_block(block, deflate_level);
+
+      if (!d.empty() && d.size() < block.size())
+      {
+        block = std::move(d);
+        e.flags |= static_cast<std::uint32_t>(animol::amtraj::frame_flags::deflate);
+      }
+    }
+
+    e.size = block.size();
+
+    frames += block;
+  }
+
+  auto encode_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  // write out
+
+  std::string file(reinterpret_cast<const char*>(&h), sizeof(h));
+
+  file.append(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(animol::amtraj::index_entry));
+  file += topology;
+  file += frames;
+
+  std::ofstream out_file(amt_filename, std::ios::binary);
+  out_file << file;
+
+  const double frame_bytes = info->number_frames * info->get_frame_size();
+
+  fmt::print("atoms: {} frames: {} encode: {:.1f} MB/s\n", n, info->number_frames, frame_bytes / encode_time / 1e6);
+  fmt::print("dcd: {: >12} bytes\namt: {: >12} bytes\nsize ratio: {:.2f}\n", dcd.size(), file.size(), static_cast<double>(dcd.size()) / file.size());
+
+  if (!verify)
+    return EXIT_SUCCESS;
+
+  // decode every frame in order, as a player would, and compare against the source
+
+  animol::amtraj reader;
+
+  auto data = std::span(reinterpret_cast<const std::byte*>(file.data()), file.size());
+
+  if (!reader.open(data))
+  {
+    fmt::print("unable to open written file\n");
+    return EXIT_FAILURE;
+  }
+
+  std::vector<float> xyz;
+
+  start = std::chrono::steady_clock::now();
+
+  for (std::uint32_t f = 0; f < h.number_frames; ++f)
+  {
+    if (!reader.decode(f, data, 0, xyz))
+    {
+      fmt::print("unable to decode frame: {}\n", f);
+      return EXIT_FAILURE;
+    }
+  }
+
+  auto decode_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  double max_error = 0;
+
+  for (std::uint32_t f = 0; f < h.number_frames; ++f)
+  {
+    reader.decode(f, data, 0, xyz);
+
+    for (int a = 0; a < 3; ++a)
+    {
+      auto p = dcd_plane(f, a);
+
+      for (std::uint32_t j = 0; j < n; ++j)
+        max_error = std::max(max_error, static_cast<double>(std::abs(xyz[j * 3 + a] - p[j])));
+    }
+  }
+
+  const double coordinate_bytes = static_cast<double>(h.number_frames) * n * 3 * sizeof(float);
+
+  fmt::print("decode: {:.1f} frames/s {:.2f} GB/s of coordinates\n", h.number_frames / decode_time, coordinate_bytes / decode_time / 1e9);
+  fmt::print("max error: {:.4f} angstroms (quantisation step {:.4f})\n", max_error, 1 / precision);
+
+  if (max_error > 0.5 / precision + 1e-3)
+  {
+    fmt::print("error too large\n");
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,356 @@
+#include "../worker/pipeline.hpp"
+
+#include <stdlib.h>
+
+
+#include <iostream>
+#include <string_view>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <vector>
+#include <charconv>
+#include <cstring>
+#include <chrono>
+
+
+/*
+    run a stage of the worker's decode pipeline natively on local files, to check its output against a golden
+    file and to time it without a browser.
+
+    input is a structure file, or a frame descriptor as the viewer sends the worker (eg. a dcd, xtc or amt
+    frame) whose urls are local paths. the stages are:
+
+      script  - the molauto script
+      cartoon - the compacted cartoon geometry, coloured and interleaved, from the script of the same input
+      atoms   - the visualise::atom array
+
+    molscript keeps state between runs, so the cartoon geometry is built once before the runs kept, giving
+    what a viewer worker that has already decoded a frame would.
+
+    -cache keeps results in a directory as the worker keeps them in indexeddb, so a second run with the same
+    directory is answered from it, as a second visit to the viewer is.
+
+    -table follows the cartoon or atoms with the atom table of the frame, as the viewer asks for when another
+    layer will make its representation from it. the cartoon before the table is the same as without it.
+*/
+
+extern "C" {
+
+float fast_float_c(const char* s)
+{
+  float f;
+
+  if (animol::string_data::parse_float(f, std::string_view{s, strlen(s)}))
+    return f;
+
+  return 0;
+}
+
+} // extern "C"
+
+
+bool read_file(const std::filesystem::path& filename, std::string& out)
+{
+  std::ifstream in(filename, std::ios::binary);
+
+  if (!in)
+    return false;
+
+  std::ostringstream ss;
+  ss << in.rdbuf();
+
+  out = std::move(ss).str();
+
+  return true;
+}
+
+
+// write the trace events recorded, as chrome trace json
+
+bool write_trace(const std::string& filename)
+{
+#ifdef PLATE_TRACE
+  std::ofstream out(filename);
+
+  out << plate::trace::to_json();
+
+  if (!out)
+  {
+    fmt::print("cannot write: {}\n", filename);
+    return false;
+  }
+
+  return true;
+#else
+  fmt::print("cannot write: {}, built without PLATE_TRACE (make TRACE=1)\n", filename);
+  return false;
+#endif
+}
+
+
+// script with its read mol line replaced by that of generated, which reads the structure being decoded
+
+bool use_structure(std::string& script, std::string_view generated)
+{
+  auto line = [] (std::string_view s) -> std::string_view
+  {
+    auto b = s.find("read mol");
+
+    if (b == std::string_view::npos)
+      return {};
+
+    return s.substr(b, s.find('\n', b) - b);
+  };
+
+  auto from = line(script);
+  auto to   = line(generated);
+
+  if (from.empty() || to.empty())
+    return false;
+
+  script.replace(from.data() - script.data(), from.size(), to);
+
+  return true;
+}
+
+
+std::uint64_t fnv1a(std::string_view data)
+{
+  std::uint64_t h = 0xcbf29ce484222325;
+
+  for (unsigned char c : data)
+    h = (h ^ c) * 0x100000001b3;
+
+  return h;
+}
+
+
+int main(int argc, char* argv[])
+{
+  const std::string exitArgMessage = fmt::format("usage: {} [-stage=script|cartoon|atoms] [-out=<file>] [-check=<golden>]\n"
+                                                 "          [-repeat=N] [-trace=<trace.json>] [-cache=<dir>] [-script=<file>] [-impostors] [-sorted]\n"
+                                                 "          [-table] <structure file | frame descriptor>\n"
+                                                 "  runs a stage of the worker pipeline (default cartoon) and reports the size, hash and time\n"
+                                                 "  of its output. -check exits with failure if the output differs from the golden file\n"
+                                                 "  -impostors gives cartoon spheres and cylinders as instances and the colours after the\n"
+                                                 "  vertices, as the viewer asks for\n"
+                                                 "  -cache keeps results in dir, up to 1GB, and answers from it\n"
+                                                 "  -script builds the cartoon with the molscript script in file rather than molauto's, its\n"
+                                                 "  read mol line replaced by one reading the input\n"
+                                                 "  -sorted gives atoms in spatial order\n"
+                                                 "  -table follows the cartoon or atoms with the atom table of the input\n", argv[0]);
+
+  std::string stage = "cartoon", out_filename, check_filename, trace_filename, cache_dir, script_filename;
+
+  int repeat = 1;
+
+  bool sorted = false, with_table = false;
+
+  int options = OPTION_COLOR | OPTION_INTERLEAVE;
+
+  int i = 1;
+
+  for (; i < argc && argv[i][0] == '-'; ++i)
+  {
+    std::string_view sv(argv[i]);
+
+    if (sv.starts_with("-stage="))
+    {
+      stage = sv.substr(7);
+
+      if (stage == "script" || stage == "cartoon" || stage == "atoms")
+        continue;
+    }
+    else if (sv.starts_with("-out="))
+    {
+      out_filename = sv.substr(5);
+      continue;
+    }
+    else if (sv.starts_with("-check="))
+    {
+      check_filename = sv.substr(7);
+      continue;
+    }
+    else if (sv.starts_with("-trace="))
+    {
+      trace_filename = sv.substr(7);
+      continue;
+    }
+    else if (sv.starts_with("-cache="))
+    {
+      cache_dir = sv.substr(7);
+      continue;
+    }
+    else if (sv.starts_with("-script="))
+    {
+      script_filename = sv.substr(8);
+      continue;
+    }
+    else if (sv == "-sorted")
+    {
+      sorted = true;
+      continue;
+    }
+    else if (sv == "-table")
+    {
+      with_table = true;
+      continue;
+    }
+    else if (sv == "-impostors")
+    {
+      options = OPTION_COLOR | OPTION_IMPOSTORS;
+      continue;
+    }
+    else if (sv.starts_with("-repeat="))
+    {
+      auto s = sv.substr(8);
+
+      if (std::from_chars(s.data(), s.data() + s.size(), repeat).ec == std::errc() && repeat > 0)
+        continue;
+    }
+
+    fmt::print("{}", exitArgMessage);
+    return EXIT_FAILURE;
+  }
+
+  if (argc - i != 1)
+  {
+    fmt::print("{}", exitArgMessage);
+    return EXIT_FAILURE;
+  }
+
+  std::string input(argv[i]);
+
+  // molauto and molscript files go in a directory of our own
+
+  char tmp_template[] = "/tmp/decodeXXXXXX";
+
+  if (!mkdtemp(tmp_template))
+  {
+    fmt::print("cannot create temporary directory\n");
+    return EXIT_FAILURE;
+  }
+
+  std::filesystem::path tmp(tmp_template);
+
+  std::shared_ptr<animol::result_store> store;
+
+  if (!cache_dir.empty())
+    store = std::make_shared<animol::directory_store>(cache_dir, 1024 * 1024 * 1024);
+
+  animol::pipeline p(std::make_shared<animol::file_fetcher>(), tmp.string() + "/", store);
+
+  std::string result, script;
+
+  bool ok = true;
+
+  auto keep = [&result, &ok] (std::span<const char> r)
+  {
+    result.assign(r.data(), r.size());
+    ok = !r.empty();
+  };
+
+  if (stage == "cartoon")
+  {
+    animol::pipeline warm(std::make_shared<animol::file_fetcher>(), tmp.string() + "/"); // the first build isn't stored
+
+    warm.script(input, [&script] (std::span<const char> r) { script.assign(r.data(), r.size()); });
+
+    if (script.empty())
+    {
+      fmt::print("unable to generate script for: {}\n", input);
+      std::filesystem::remove_all(tmp);
+      return EXIT_FAILURE;
+    }
+
+    if (!script_filename.empty())
+    {
+      std::string generated = std::move(script);
+
+      if (!read_file(script_filename, script) || !use_structure(script, generated))
+      {
+        fmt::print("cannot read a script with a read mol line from: {}\n", script_filename);
+        std::filesystem::remove_all(tmp);
+        return EXIT_FAILURE;
+      }
+    }
+
+    warm.decode(script, input, options, keep, with_table);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (int r = 0; r < repeat && ok; ++r)
+  {
+    trace_zone("decode");
+
+    animol::pipeline::take_stats(); // keep those of the last run
+
+    if (stage == "script")
+      p.script(input, keep);
+    else if (stage == "cartoon")
+      p.decode(script, input, options, keep, with_table);
+    else
+      p.atoms(input, keep, with_table, sorted);
+  }
+
+  auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  auto stats = animol::pipeline::take_stats();
+
+  std::filesystem::remove_all(tmp);
+
+  if (!trace_filename.empty() && !write_trace(trace_filename))
+    return EXIT_FAILURE;
+
+  if (!ok)
+  {
+    fmt::print("{} failed for: {}\n", stage, input);
+    return EXIT_FAILURE;
+  }
+
+  fmt::print("{}: {} bytes hash: {:016x} time: {:.3f} ms\n", stage, result.size(), fnv1a(result), elapsed * 1000 / repeat);
+
+  for (int s = 0; s < animol::decode_stats::number_stages; ++s)
+    if (stats.stage_ms[s] > 0)
+      fmt::print("  {: <10} {:.3f} ms\n", animol::decode_stats::stage_names[s], stats.stage_ms[s]);
+
+  fmt::print("  fetched: {} bytes atoms: {} vertices: {} stored: {}\n", stats.bytes_fetched, stats.atoms, stats.vertices, stats.stored);
+
+  if (!out_filename.empty())
+  {
+    std::ofstream out_file(out_filename, std::ios::binary);
+
+    out_file << result;
+
+    if (!out_file)
+    {
+      fmt::print("cannot write: {}\n", out_filename);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (!check_filename.empty())
+  {
+    std::string golden;
+
+    if (!read_file(check_filename, golden))
+    {
+      fmt::print("cannot read: {}\n", check_filename);
+      return EXIT_FAILURE;
+    }
+
+    if (golden != result)
+    {
+      auto [a, b] = std::mismatch(golden.begin(), golden.end(), result.begin(), result.end());
+
+      fmt::print("mismatch with: {} ({} bytes) at byte: {}\n", check_filename, golden.size(), a - golden.begin());
+      return EXIT_FAILURE;
+    }
+
+    fmt::print("matches: {}\n", check_filename);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,157 @@
+#include "../worker/mmtf2pdb.hpp"
+
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+
+#include <iostream>
+#include <string_view>
+#include <fstream>
+#include <vector>
+#include <charconv>
+#include <array>
+#include <iomanip>
+#include <cstddef>
+#include <cstring>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+
+
+// map a file into memory, returns an empty span on failure
+
+std::span<const std::byte> map_file(const std::string& filename)
+{
+  auto fd = open(filename.c_str(), O_RDONLY);
+
+  if (fd == -1)
+  {
+    fmt::print("cannot open file: {}\n", filename);
+    return {};
+  }
+
+  struct stat sb;
+
+  if (fstat(fd, &sb) == -1)
+  {
+    fmt::print("cannot stat file: {}\n", filename);
+    close(fd);
+    return {};
+  }
+
+  std::size_t size = sb.st_size;
+
+  auto data = static_cast<const std::byte*>(mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0));
+
+  close(fd);
+
+  if (data == MAP_FAILED)
+    return {};
+
+  return { data, size };
+}
+
+
+int main(int argc, char* argv[])
+{
+  using namespace magic_enum::bitwise_operators;
+
+  const std::string exitArgMessage = fmt::format("usage: {} [-sheet | -helix | -atom[=ca, =nca] | -hetatm | -bench=<repeats>] <MMTF.mmtf> <out.pdb>\n"
+                                                 "  no options defaults to output everything.\n"
+                                                 "  -bench repeats the conversion and reports the decode throughput.\n", argv[0]);
+
+  if (argc < 3)
+  {
+    fmt::print("{}", exitArgMessage);
+    return EXIT_FAILURE;
+  }
+
+  animol::cif2pdb::options opt = animol::cif2pdb::options::none;
+
+  int repeats = 0;
+
+  for (int i = 1; i < argc - 2; ++i)
+  {
+    std::string_view sv(argv[i]);
+
+    if (sv == "-sheet")   { opt |= animol::cif2pdb::options::sheet; continue; }
+    if (sv == "-helix")   { opt |= animol::cif2pdb::options::helix; continue; }
+    if (sv == "-hetatm")  { opt |= animol::cif2pdb::options::hetatm; continue; }
+    if (sv == "-atom=ca") { opt |= animol::cif2pdb::options::ca_atoms; continue; }
+    if (sv == "-atom=nca"){ opt |= animol::cif2pdb::options::non_ca_atoms; continue; }
+    if (sv == "-atom")    { opt |= animol::cif2pdb::options::ca_atoms | animol::cif2pdb::options::non_ca_atoms; continue; }
+
+    if (sv.starts_with("-bench="))
+    {
+      auto n = sv.substr(7);
+
+      if (auto [p, ec] = std::from_chars(n.begin(), n.end(), repeats); ec == std::errc() && p == n.end() && repeats > 0)
+        continue;
+    }
+
+    fmt::print("{}", exitArgMessage);
+    return EXIT_FAILURE;
+  }
+
+  if (opt == animol::cif2pdb::options::none) // default to all
+    opt = animol::cif2pdb::options::sheet | animol::cif2pdb::options::helix | animol::cif2pdb::options::hetatm |
+          animol::cif2pdb::options::ca_atoms | animol::cif2pdb::options::non_ca_atoms;
+
+  std::string mmtf_filename(argv[argc - 2]);
+  std::string pdb_filename(argv[argc - 1]);
+
+  auto data = map_file(mmtf_filename);
+
+  if (data.empty())
+    return EXIT_FAILURE;
+
+  if (!animol::mmtf2pdb::is_mmtf(data))
+  {
+    fmt::print("not an MMTF file: {}\n", mmtf_filename);
+    return EXIT_FAILURE;
+  }
+
+  animol::mmtf2pdb converter(data, opt);
+
+  auto r = converter.convert();
+
+  if (!r)
+  {
+    fmt::print("unable to convert: {}\n", mmtf_filename);
+    return EXIT_FAILURE;
+  }
+
+  std::ofstream out_file(pdb_filename);
+  out_file << *r;
+
+  if (repeats == 0)
+    return EXIT_SUCCESS;
+
+  double best = std::numeric_limits<double>::max();
+  double total = 0;
+
+  for (int i = 0; i < repeats; ++i)
+  {
+    auto start = std::chrono::steady_clock::now();
+
+    animol::mmtf2pdb c(data, opt);
+
+    if (!c.convert())
+      return EXIT_FAILURE;
+
+    auto t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    best = std::min(best, t);
+    total += t;
+  }
+
+  fmt::print("mmtf: {} bytes -> pdb: {} bytes\n", data.size(), r->size());
+  fmt::print("best: {:.3f} ms mean: {:.3f} ms over: {} runs\n", best * 1000, total * 1000 / repeats, repeats);
+  fmt::print("throughput: {:.1f} MB/s in, {:.1f} MB/s out\n", data.size() / best / 1e6, r->size() / best / 1e6);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,117 @@
+#include "../worker/pdb_models.hpp"
+
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+
+#include <iostream>
+#include <string_view>
+#include <fstream>
+#include <vector>
+#include <chrono>
+
+
+// map a file into memory, returns an empty string_view on failure
+
+std::string_view map_file(const std::string& filename)
+{
+  auto fd = open(filename.c_str(), O_RDONLY);
+
+  if (fd == -1)
+  {
+    fmt::print("cannot open file: {}\n", filename);
+    return {};
+  }
+
+  struct stat sb;
+
+  if (fstat(fd, &sb) == -1)
+  {
+    fmt::print("cannot stat file: {}\n", filename);
+    close(fd);
+    return {};
+  }
+
+  std::size_t size = sb.st_size;
+
+  auto data = static_cast<const char*>(mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0));
+
+  close(fd);
+
+  if (data == MAP_FAILED)
+    return {};
+
+  return { data, size };
+}
+
+
+int main(int argc, char* argv[])
+{
+  const std::string exitArgMessage = fmt::format("usage: {} <models.pdb> [<output directory> <file prefix>]\n"
+                                                 "  indexes the MODEL records and reports the speed of the index.\n"
+                                                 "  with an output directory each model is written as {{prefix}}{{model}}.pdb along with a movie.plan\n", argv[0]);
+
+  if (argc != 2 && argc != 4)
+  {
+    fmt::print("{}", exitArgMessage);
+    return EXIT_FAILURE;
+  }
+
+  std::string pdb_filename(argv[1]);
+
+  auto data = map_file(pdb_filename);
+
+  if (data.empty())
+    return EXIT_FAILURE;
+
+  animol::pdb_models models;
+
+  // index a few times so the file is paged in and the timing is of the scan
+
+  constexpr int runs = 5;
+
+  bool ok = false;
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < runs; ++i)
+    ok = models.index(data);
+
+  auto index_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / runs;
+
+  if (!ok)
+  {
+    fmt::print("no MODEL records found in: {}\n", pdb_filename);
+    return EXIT_FAILURE;
+  }
+
+  fmt::print("models: {} bytes: {} index: {:.3f} ms {:.2f} GB/s\n", models.size(), data.size(), index_time * 1e3, data.size() / index_time / 1e9);
+
+  if (argc == 2)
+    return EXIT_SUCCESS;
+
+  std::string output_dir(argv[2]);
+  std::string file_prefix(argv[3]);
+
+  std::ofstream plan(fmt::format("{}/movie.plan", output_dir));
+
+  std::string pdb;
+
+  for (int i = 0; i < models.size(); ++i)
+  {
+    models.get_model(data, i, pdb);
+
+    auto filename = fmt::format("{}{}.pdb", file_prefix, i);
+
+    std::ofstream out_file(fmt::format("{}/{}", output_dir, filename));
+    out_file << pdb;
+
+    plan << filename << '\n';
+  }
+
+  return EXIT_SUCCESS;
+}
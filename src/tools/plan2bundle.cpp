@@ -0,0 +1,222 @@
+#include "../worker/frame_bundle.hpp"
+
+#include <stdlib.h>
+
+#include <zlib.h>
+
+
+#include <iostream>
+#include <string_view>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <vector>
+#include <charconv>
+#include <cstring>
+
+
+// read a whole file, returns false if it cannot be opened
+
+bool read_file(const std::filesystem::path& filename, std::string& out)
+{
+  std::ifstream in(filename, std::ios::binary);
+
+  if (!in)
+    return false;
+
+  std::ostringstream ss;
+  ss << in.rdbuf();
+
+  out = std::move(ss).str();
+
+  return true;
+}
+
+
+// zlib compress data, returns an empty string on failure
+
+std::string deflate_block(std::string_view data, int level)
+{
+  std::string out(compressBound(data.size()), '\0');
+
+  uLongf size = out.size();
+
+  if (compress2(reinterpret_cast<Bytef*>(out.data()), &size, reinterpret_cast<const Bytef*>(data.data()), data.size(), level) != Z_OK)
+    return {};
+
+  out.resize(size);
+
+  return out;
+}
+
+
+int main(int argc, char* argv[])
+{
+  const std::string exitArgMessage = fmt::format("usage: {} [-deflate[=level]] <dataset directory> [<out.bundle>]\n"
+                                                 "  packs the files listed in the directory's movie.plan, and their nonCA_ companions, into\n"
+                                                 "  one frame bundle. defaults to writing movie.bundle in the dataset directory\n", argv[0]);
+
+  int deflate_level = 0;
+
+  int i = 1;
+
+  for (; i < argc && argv[i][0] == '-'; ++i)
+  {
+    std::string_view sv(argv[i]);
+
+    if (sv.starts_with("-deflate="))
+    {
+      auto s = sv.substr(9);
+
+      if (std::from_chars(s.data(), s.data() + s.size(), deflate_level).ec == std::errc() && deflate_level > 0 && deflate_level <= 9)
+        continue;
+    }
+    else if (sv == "-deflate")
+    {
+      deflate_level = 6;
+      continue;
+    }
+
+    fmt::print("{}", exitArgMessage);
+    return EXIT_FAILURE;
+  }
+
+  if (argc - i != 1 && argc - i != 2)
+  {
+    fmt::print("{}", exitArgMessage);
+    return EXIT_FAILURE;
+  }
+
+  std::filesystem::path dir(argv[i]);
+  std::filesystem::path out_filename = (argc - i == 2) ? std::filesystem::path(argv[i + 1]) : dir / "movie.bundle";
+
+  // read the plan, as the viewer does: a blank line follows the initial structure
+
+  std::string plan;
+
+  if (!read_file(dir / "movie.plan", plan))
+  {
+    fmt::print("cannot read: {}\n", (dir / "movie.plan").string());
+    return EXIT_FAILURE;
+  }
+
+  std::vector<std::string> files;
+
+  std::int32_t master_frame = -1;
+
+  std::string_view sv(plan);
+
+  for (std::size_t start = 0; start < sv.size();)
+  {
+    auto end = std::min(sv.find('\n', start), sv.size());
+
+    if (end == start)
+      master_frame = std::max<std::int32_t>(0, files.size() - 1);
+    else
+      files.emplace_back(sv.substr(start, end - start));
+
+    start = end + 1;
+  }
+
+  if (files.empty())
+  {
+    fmt::print("movie.plan contains no frames\n");
+    return EXIT_FAILURE;
+  }
+
+  std::uint32_t number_parts = 1;
+
+  for (auto& f : files)
+    if (std::filesystem::exists(dir / ("nonCA_" + f)))
+    {
+      number_parts = 2;
+      break;
+    }
+
+  animol::frame_bundle::header h{};
+
+  std::memcpy(h.magic, animol::frame_bundle::magic.data(), 4);
+
+  h.version       = animol::frame_bundle::version;
+  h.number_frames = files.size();
+  h.master_frame  = master_frame;
+  h.number_parts  = number_parts;
+  h.index_offset  = sizeof(h);
+  h.data_offset   = animol::frame_bundle::get_index_end(h);
+
+  std::vector<animol::frame_bundle::index_entry> index(h.number_frames * number_parts);
+
+  std::string payloads, file;
+
+  std::uint64_t raw_bytes = 0;
+
+  for (std::size_t f = 0; f < files.size(); ++f)
+  {
+    for (std::uint32_t p = 0; p < number_parts; ++p)
+    {
+      auto& e = index[f * number_parts + p];
+
+      e.offset = h.data_offset + payloads.size();
+
+      if (!read_file(dir / (p ? "nonCA_" + files[f] : files[f]), file))
+      {
+        if (p == 0)
+        {
+          fmt::print("cannot read: {}\n", files[f]);
+          return EXIT_FAILURE;
+        }
+
+        continue; // missing companion, leave empty
+      }
+
+      e.raw_size = file.size();
+      raw_bytes += file.size();
+
+      if (deflate_level)
+      {
+        auto d = deflate_block(file, deflate_level);
+
+        if (!d.empty() && d.size() < file.size())
+          file = std::move(d);
+      }
+
+      e.size = file.size();
+
+      payloads += file;
+    }
+  }
+
+  std::ofstream out_file(out_filename, std::ios::binary);
+
+  out_file.write(reinterpret_cast<const char*>(&h), sizeof(h));
+  out_file.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(animol::frame_bundle::index_entry));
+  out_file << payloads;
+
+  if (!out_file)
+  {
+    fmt::print("cannot write: {}\n", out_filename.string());
+    return EXIT_FAILURE;
+  }
+
+  out_file.close();
+
+  // report the requests a viewer makes to load every frame: one per file before, the index and a range per window after
+
+  std::string bundle;
+
+  read_file(out_filename, bundle);
+
+  animol::frame_bundle reader;
+
+  if (!reader.open(std::as_bytes(std::span(bundle))))
+  {
+    fmt::print("unable to open written bundle\n");
+    return EXIT_FAILURE;
+  }
+
+  fmt::print("frames: {} parts: {} master: {}\n", h.number_frames, number_parts, master_frame);
+  fmt::print("files: {: >12} bytes\nbundle: {: >11} bytes\n", raw_bytes, bundle.size());
+  fmt::print("requests: {} -> {}\n", 1 + h.number_frames * number_parts, 1 + reader.get_number_windows());
+
+  return EXIT_SUCCESS;
+}
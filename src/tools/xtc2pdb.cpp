@@ -0,0 +1,205 @@
+#include "../worker/dcd2pdb.hpp"
+#include "../worker/xtc2pdb.hpp"
+
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+
+#include <iostream>
+#include <string_view>
+#include <fstream>
+#include <vector>
+#include <charconv>
+#include <array>
+#include <iomanip>
+#include <cstddef>
+#include <cstring>
+#include <chrono>
+
+
+// map a file into memory, returns an empty span on failure
+
+std::span<const std::byte> map_file(const std::string& filename)
+{
+  auto fd = open(filename.c_str(), O_RDONLY);
+
+  if (fd == -1)
+  {
+    fmt::print("cannot open file: {}\n", filename);
+    return {};
+  }
+
+  struct stat sb;
+
+  if (fstat(fd, &sb) == -1)
+  {
+    fmt::print("cannot stat file: {}\n", filename);
+    close(fd);
+    return {};
+  }
+
+  std::size_t size = sb.st_size;
+
+  auto data = static_cast<const std::byte*>(mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0));
+
+  close(fd);
+
+  if (data == MAP_FAILED)
+    return {};
+
+  return { data, size };
+}
+
+
+int main(int argc, char* argv[])
+{
+  const std::string exitArgMessage = fmt::format("usage: {} [-atom[=ca, =nca]] [-bench=<trajectory.dcd>] <psffile.psf> <trajectory.xtc> [<output directory> <file prefix>]\n"
+                                                 "  no atom options defaults to keep all atoms. without an output directory no files are written.\n"
+                                                 "  -bench times decoding every frame, and if given the same trajectory in dcd form, compares frames per second\n", argv[0]);
+
+  bool keepCAs    = true;
+  bool keepNonCAs = true;
+
+  std::string dcd_filename;
+  bool bench = false;
+
+  int i = 1;
+
+  for (; i < argc && argv[i][0] == '-'; ++i)
+  {
+    std::string_view sv(argv[i]);
+
+    if      (sv == "-atom=ca")  { keepCAs = true;  keepNonCAs = false; }
+    else if (sv == "-atom=nca") { keepCAs = false; keepNonCAs = true;  }
+    else if (sv == "-atom")     { keepCAs = true;  keepNonCAs = true;  }
+    else if (sv == "-bench")    { bench = true; }
+    else if (sv.starts_with("-bench=")) { bench = true; dcd_filename = sv.substr(7); }
+    else                        { fmt::print("{}", exitArgMessage); return EXIT_FAILURE; }
+  }
+
+  if (argc - i != 2 && argc - i != 4)
+  {
+    fmt::print("{}", exitArgMessage);
+    return EXIT_FAILURE;
+  }
+
+  std::string psf_filename(argv[i]);
+  std::string xtc_filename(argv[i + 1]);
+
+  std::string output_dir = argc - i == 4 ? argv[i + 2] : "";
+  std::string filePrefix = argc - i == 4 ? argv[i + 3] : "";
+
+  auto psf = map_file(psf_filename);
+  auto xtc = map_file(xtc_filename);
+
+  if (psf.empty() || xtc.empty())
+    return EXIT_FAILURE;
+
+  animol::dcd2pdb converter;
+
+  if (!converter.generate_template(psf, keepCAs, keepNonCAs))
+  {
+    fmt::print("cannot generate template\n");
+    return EXIT_FAILURE;
+  }
+
+  // index the frames
+
+  auto start = std::chrono::steady_clock::now();
+
+  auto header = animol::xtc2pdb::read_header(xtc);
+
+  if (!header)
+  {
+    fmt::print("not an xtc file: {}\n", xtc_filename);
+    return EXIT_FAILURE;
+  }
+
+  if (header->number_atoms != converter.get_number_of_atoms())
+  {
+    fmt::print("bad number of atoms, xtc has: {} psf has: {}\n", header->number_atoms, converter.get_number_of_atoms());
+    return EXIT_FAILURE;
+  }
+
+  std::vector<std::uint64_t> offsets, sizes;
+
+  auto end = animol::xtc2pdb::scan(xtc, 0, header->number_atoms, offsets, sizes);
+
+  auto index_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  if (end != xtc.size())
+    fmt::print("warning: trailing data after frame {} at offset: {}\n", offsets.size(), end);
+
+  // decode every frame
+
+  animol::xtc2pdb decoder;
+
+  std::vector<float> xyz;
+
+  start = std::chrono::steady_clock::now();
+
+  for (std::size_t f = 0; f < offsets.size(); ++f)
+  {
+    if (!decoder.decode(xtc.subspan(offsets[f], sizes[f]), xyz) || !converter.populate_template(xyz))
+    {
+      fmt::print("unable to decode frame: {}\n", f);
+      return EXIT_FAILURE;
+    }
+
+    if (!output_dir.empty())
+    {
+      std::ofstream out_file(fmt::format("{}/{}{}.pdb", output_dir, filePrefix, f));
+      out_file << converter.get_pdb_data();
+    }
+  }
+
+  auto xtc_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  if (!bench)
+    return EXIT_SUCCESS;
+
+  const double frames = offsets.size();
+
+  fmt::print("atoms: {} frames: {} index: {:.3f} ms\n", header->number_atoms, offsets.size(), index_time * 1000);
+  fmt::print("xtc: {: >12} bytes {: >10.1f} bytes/frame {: >9.1f} frames/s\n", xtc.size(), xtc.size() / frames, frames / xtc_time);
+
+  if (dcd_filename.empty())
+    return EXIT_SUCCESS;
+
+  auto dcd = map_file(dcd_filename);
+
+  if (dcd.empty())
+    return EXIT_FAILURE;
+
+  auto info = animol::dcd2pdb::get_dcd_data_info(dcd);
+
+  if (!info || info->number_atoms != header->number_atoms)
+  {
+    fmt::print("dcd does not match the xtc: {}\n", dcd_filename);
+    return EXIT_FAILURE;
+  }
+
+  start = std::chrono::steady_clock::now();
+
+  for (int f = 0; f < info->number_frames; ++f)
+  {
+    if (!converter.populate_template(dcd.subspan(info->get_frame_offset(f), info->get_frame_size())))
+    {
+      fmt::print("unable to populate dcd frame: {}\n", f);
+      return EXIT_FAILURE;
+    }
+  }
+
+  auto dcd_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  fmt::print("dcd: {: >12} bytes {: >10.1f} bytes/frame {: >9.1f} frames/s\n", dcd.size(), static_cast<double>(info->get_frame_size()),
+                                                                              info->number_frames / dcd_time);
+
+  fmt::print("size ratio: {:.2f} speed ratio: {:.2f}\n", static_cast<double>(dcd.size()) / xtc.size(), (frames / xtc_time) / (info->number_frames / dcd_time));
+
+  return EXIT_SUCCESS;
+}
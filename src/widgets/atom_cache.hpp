@@ -0,0 +1,314 @@
+#pragma once
+
+#include <string>
+#include <span>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+
+#include "frame_source.hpp"
+#include "../worker/atom_table.hpp"
+
+
+namespace animol {
+
+/*
+    the atom tables of the frames of a frame source, as returned by the worker with a frame's first representation,
+    so other layers make theirs from the table rather than fetching and converting the frame again.
+
+    frames with the same topology share it: it is reference counted by the frames using it, and forgotten when
+    the last is. with the topology are the coordinates of the first frame kept with it, its reference, and the
+    coordinates of each frame are kept as their differences from those, zigzag varint coded. atoms move little
+    between frames, so a coordinate mostly takes one or two bytes rather than four.
+
+    tables are kept up to max_bytes, the least recently used dropped first. the cache is of one frame source,
+    and is emptied when used with another.
+*/
+
+class atom_cache
+{
+
+public:
+
+  static constexpr std::size_t max_bytes = 64 * 1024 * 1024;
+
+
+  // keep the table of a frame part
+
+  void add(const std::shared_ptr<const frame_source>& frames, int frame, int part, std::span<const char> table) noexcept
+  {
+    auto f = atom_table::get_footer(table);
+
+    if (!f || f->size != table.size())
+      return;
+
+    use(frames);
+
+    std::span<const char> coords(table.data() + f->topology_size, table.size() - f->topology_size - sizeof(atom_table::footer));
+
+    if (auto it = entries_.find({ frame, part }); it != entries_.end())
+      drop(it);
+
+    std::string_view topology_text(table.data(), f->topology_size);
+
+    auto& weak = topologies_[f->topology_hash];
+    auto t = weak.lock();
+
+    entry e;
+
+    if (t && t->text == topology_text && t->as_given == (f->as_given != 0))
+      encode(coords, t->reference, e.deltas);
+    else
+    {
+      auto n = std::make_shared<kept_topology>();
+
+      n->text.assign(topology_text);
+      n->as_given = f->as_given;
+      n->reference.resize(coords.size() / sizeof(std::int32_t));
+
+      std::memcpy(n->reference.data(), coords.data(), n->reference.size() * sizeof(std::int32_t));
+
+      bytes_ += n->text.size() + coords.size();
+
+      t = std::move(n);
+      weak = t;
+    }
+
+    bytes_ += e.deltas.size();
+
+    e.topology = std::move(t);
+    e.hash     = f->topology_hash;
+    e.last_use = ++use_counter_;
+
+    entries_[{ frame, part }] = std::move(e);
+
+    trim();
+  }
+
+
+  // append the table of a frame part to out, false if it is not kept
+
+  bool append_to(const std::shared_ptr<const frame_source>& frames, int frame, int part, std::vector<char>& out) noexcept
+  {
+    if (frames != frames_)
+      return false;
+
+    auto it = entries_.find({ frame, part });
+
+    if (it == entries_.end())
+      return false;
+
+    auto& e = it->second;
+    auto& t = *e.topology;
+
+    e.last_use = ++use_counter_;
+
+    atom_table::footer f;
+
+    f.topology_hash = e.hash;
+    f.atoms         = t.reference.size() / 3;
+    f.topology_size = t.text.size();
+    f.as_given      = t.as_given;
+    f.version       = atom_table::version;
+    f.size          = t.text.size() + t.reference.size() * sizeof(std::int32_t) + sizeof(atom_table::footer);
+
+    std::memcpy(f.magic, atom_table::magic, sizeof(f.magic));
+
+    auto p = reinterpret_cast<const char*>(&f);
+
+    out.insert(out.end(), t.text.begin(), t.text.end());
+
+    auto coords = out.size();
+
+    out.resize(coords + t.reference.size() * sizeof(std::int32_t));
+
+    decode(e.deltas, t.reference, out.data() + coords);
+
+    out.insert(out.end(), p, p + sizeof(f));
+
+    return true;
+  }
+
+
+  void clear() noexcept
+  {
+    entries_.clear();
+    topologies_.clear();
+
+    bytes_ = 0;
+    frames_.reset();
+  }
+
+
+  std::size_t get_tables() const noexcept
+  {
+    return entries_.size();
+  }
+
+
+  // the number of distinct topologies, and the bytes of the topologies, their references and the differences
+  // from them kept
+
+  std::size_t get_topologies() const noexcept
+  {
+    std::size_t n = 0;
+
+    for (auto& [hash, weak] : topologies_)
+      n += !weak.expired();
+
+    return n;
+  }
+
+
+  std::size_t get_bytes() const noexcept
+  {
+    return bytes_;
+  }
+
+
+private:
+
+  struct kept_topology
+  {
+    std::string               text;
+    bool                      as_given;
+    std::vector<std::int32_t> reference; // x, y then z of the first frame kept with it
+  };
+
+
+  struct entry
+  {
+    std::shared_ptr<const kept_topology> topology;
+    std::uint64_t                        hash{0};
+    std::vector<unsigned char>           deltas;      // from the reference, empty for the reference itself
+    unsigned int                         last_use{0};
+  };
+
+  using entries = std::map<std::pair<int, int>, entry>;
+
+
+  void use(const std::shared_ptr<const frame_source>& frames) noexcept
+  {
+    if (frames != frames_)
+    {
+      clear();
+      frames_ = frames;
+    }
+  }
+
+
+  // forget an entry, and its topology if it was the last to use it
+
+  void drop(entries::iterator it) noexcept
+  {
+    auto t    = std::move(it->second.topology);
+    auto hash = it->second.hash;
+
+    bytes_ -= it->second.deltas.size();
+
+    entries_.erase(it);
+
+    if (t.use_count() == 1)
+    {
+      bytes_ -= t->text.size() + t->reference.size() * sizeof(std::int32_t);
+
+      t.reset();
+
+      if (auto w = topologies_.find(hash); w != topologies_.end() && w->second.expired())
+        topologies_.erase(w);
+    }
+  }
+
+
+  // drop the least recently used tables until within max_bytes
+
+  void trim() noexcept
+  {
+    while (bytes_ > max_bytes && !entries_.empty())
+    {
+      auto lru = entries_.begin();
+
+      for (auto i = entries_.begin(); i != entries_.end(); ++i)
+        if (i->second.last_use < lru->second.last_use)
+          lru = i;
+
+      drop(lru);
+    }
+  }
+
+
+  // the coordinates less those of reference, wrapping so any int32 round trips, as zigzag varints. nothing if
+  // they are the reference
+
+  static void encode(std::span<const char> coords, const std::vector<std::int32_t>& reference, std::vector<unsigned char>& out) noexcept
+  {
+    if (coords.size() != reference.size() * sizeof(std::int32_t) ||
+                                           std::memcmp(coords.data(), reference.data(), coords.size()) == 0)
+      return;
+
+    out.reserve(reference.size() * 2);
+
+    for (std::size_t i = 0; i < reference.size(); ++i)
+    {
+      std::int32_t v;
+      std::memcpy(&v, coords.data() + i * sizeof(std::int32_t), sizeof(v));
+
+      std::uint32_t d = static_cast<std::uint32_t>(v) - static_cast<std::uint32_t>(reference[i]);
+      std::uint32_t z = (d << 1) ^ (0u - (d >> 31));
+
+      for (; z >= 0x80; z >>= 7)
+        out.push_back(static_cast<unsigned char>(z | 0x80));
+
+      out.push_back(static_cast<unsigned char>(z));
+    }
+
+    out.shrink_to_fit();
+  }
+
+
+  // the coordinates coded by encode written to out as int32
+
+  static void decode(const std::vector<unsigned char>& deltas, const std::vector<std::int32_t>& reference, char* out) noexcept
+  {
+    if (deltas.empty())
+    {
+      std::memcpy(out, reference.data(), reference.size() * sizeof(std::int32_t));
+      return;
+    }
+
+    auto p = deltas.data();
+
+    for (std::size_t i = 0; i < reference.size(); ++i)
+    {
+      std::uint32_t z = 0;
+
+      for (int shift = 0;; shift += 7)
+      {
+        z |= static_cast<std::uint32_t>(*p & 0x7f) << shift;
+
+        if (!(*p++ & 0x80))
+          break;
+      }
+
+      std::uint32_t d = (z >> 1) ^ (0u - (z & 1));
+      std::int32_t  v = static_cast<std::int32_t>(static_cast<std::uint32_t>(reference[i]) + d);
+
+      std::memcpy(out + i * sizeof(std::int32_t), &v, sizeof(v));
+    }
+  }
+
+
+  entries entries_; // by frame and part
+
+  std::unordered_map<std::uint64_t, std::weak_ptr<const kept_topology>> topologies_; // by hash, while used
+
+  std::size_t  bytes_{0}; // of topologies, references and deltas
+  unsigned int use_counter_{0};
+
+  std::shared_ptr<const frame_source> frames_; // kept so another cannot take its place
+};
+
+} // namespace animol
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <algorithm>
+#include <cstddef>
+
+
+/*
+    drawing between frames: the same script run on frames of the same topology gives the same vertices in the same
+    order, so when two frames have as many of each, each vertex is blended towards its partner in the other.
+
+    the blends are over the positions and normals of vertices as {position[3], normal[3]} of shorts, any colours are
+    those of the frame being left. each is a weighted sum of the frames over plain arrays, so the loops vectorise
+    when built for simd.
+*/
+
+namespace animol {
+
+enum class interpolation { none, linear, hermite, shader }; // linear and hermite on the cpu, shader linear on the gpu
+
+
+class frame_blend
+{
+
+public:
+
+  // a + (b - a) * t
+
+  template<class V>
+  static void linear(std::span<const V> a, std::span<const V> b, float t, std::span<V> out) noexcept
+  {
+    weigh<V, 2>({ a, b }, { 1.0f - t, t }, out);
+  }
+
+
+  // the catmull-rom spline through p0 to p3, from p1 at t of 0 to p2 at 1
+
+  template<class V>
+  static void hermite(std::span<const V> p0, std::span<const V> p1, std::span<const V> p2, std::span<const V> p3,
+                                                                                   float t, std::span<V> out) noexcept
+  {
+    weigh<V, 4>({ p0, p1, p2, p3 }, hermite_weights(t), out);
+  }
+
+
+  static std::array<float, 4> hermite_weights(float t) noexcept
+  {
+    auto t2 = t * t;
+    auto t3 = t2 * t;
+
+    return { 0.5f * (-t + 2.0f * t2 - t3), 0.5f * (2.0f - 5.0f * t2 + 3.0f * t3),
+             0.5f * (t + 4.0f * t2 - 3.0f * t3), 0.5f * (t3 - t2) };
+  }
+
+
+private:
+
+  // out is the sum of the frames by their weights, with the colours of the frame at t of 0
+
+  template<class V, std::size_t N>
+  static void weigh(const std::array<std::span<const V>, N>& frames, const std::array<float, N>& w, std::span<V> out) noexcept
+  {
+    constexpr std::size_t from = N / 2 - 1; // a, or p1
+
+    for (auto& f : frames)
+      if (f.size() != out.size())
+        return;
+
+    for (std::size_t i = 0; i < out.size(); ++i)
+    {
+      for (int c = 0; c < 3; ++c)
+      {
+        float p = 0.0f, n = 0.0f;
+
+        for (std::size_t k = 0; k < N; ++k)
+        {
+          p += w[k] * frames[k][i].position[c];
+          n += w[k] * frames[k][i].normal[c];
+        }
+
+        out[i].position[c] = to_short(p);
+        out[i].normal[c]   = to_short(n);
+      }
+
+      if constexpr (requires { out[i].color; })
+        out[i].color = frames[from][i].color;
+    }
+  }
+
+
+  static short to_short(float v) noexcept // a spline may overshoot
+  {
+    return static_cast<short>(std::clamp(v, -32767.0f, 32767.0f));
+  }
+};
+
+} // namespace animol
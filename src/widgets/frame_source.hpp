@@ -0,0 +1,792 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <list>
+#include <span>
+#include <array>
+#include <algorithm>
+#include <cstdint>
+
+#include "plate.hpp"
+
+#include "../worker/dcd2pdb.hpp"
+#include "../worker/xtc2pdb.hpp"
+#include "../worker/amtraj.hpp"
+#include "../worker/pdb_models.hpp"
+#include "../worker/frame_bundle.hpp"
+#include "../worker/inflate.hpp"
+#include "../worker/geometry_delta.hpp"
+
+
+/*
+    where the frames of an animation come from. each frame has a descriptor passed to the worker, either
+    the url of a structure file or a json message describing a trajectory frame. descriptors are built on
+    demand so opening a source and asking for a frame cost the same whatever the trajectory length.
+
+    packed sources instead fetch the frames themselves, so neighbouring frames can share a request or a file
+    is fetched once for all its frames, and the worker is given the contents of the frame.
+*/
+
+namespace animol {
+
+class frame_source
+{
+
+public:
+
+  virtual ~frame_source()
+  {
+  }
+
+
+  virtual int size() const noexcept = 0;
+
+
+  // the descriptor of frame. prefix is placed before the file name of per file sources (used for the
+  // remote companion non-CA files) and ignored by trajectories
+
+  virtual std::string get(int frame, std::string_view prefix = "") const noexcept = 0;
+
+
+  // release any local file objects referenced
+
+  virtual void release() noexcept
+  {
+  }
+
+
+  virtual bool is_packed() const noexcept
+  {
+    return false;
+  }
+
+
+  // packed sources only: call cb with the contents of part of frame (0 the frame, 1 its nonCA_ companion),
+  // empty if it could not be fetched
+
+  virtual void fetch(int frame, int part, std::function<void (std::span<const char>)> cb) const noexcept
+  {
+    cb({});
+  }
+};
+
+
+// a structure file per frame, either a movie.plan listing on a server or a set of local file objects
+
+class frame_source_files : public frame_source
+{
+
+public:
+
+  frame_source_files(std::string url, std::vector<std::string> files, bool local) noexcept :
+    url_(std::move(url)),
+    files_(std::move(files)),
+    local_(local)
+  {
+  }
+
+
+  int size() const noexcept override
+  {
+    return files_.size();
+  }
+
+
+  std::string get(int frame, std::string_view prefix = "") const noexcept override
+  {
+    return url_ + std::string(prefix) + files_[frame];
+  }
+
+
+  void release() noexcept override
+  {
+    if (local_)
+      for (auto& f : files_)
+        plate::ui_event::clear_file_object(f);
+  }
+
+
+private:
+
+  std::string              url_;   // prepended to each file, eg. the directory of a movie.plan
+  std::vector<std::string> files_;
+  bool                     local_;
+};
+
+
+// frames read by range from a dcd trajectory with a psf topology
+
+class frame_source_dcd : public frame_source
+{
+
+public:
+
+  frame_source_dcd(std::string psf_url, std::string dcd_url, const dcd2pdb::info& info) noexcept :
+    psf_url_(std::move(psf_url)),
+    dcd_url_(std::move(dcd_url)),
+    info_(info)
+  {
+  }
+
+
+  int size() const noexcept override
+  {
+    return info_.number_frames;
+  }
+
+
+  std::string get(int frame, std::string_view prefix = "") const noexcept override
+  {
+    plate::json_handler_struct<dcd2pdb::interface> msg;
+
+    msg.data.psf_url         = psf_url_;
+    msg.data.dcd_url         = dcd_url_;
+    msg.data.frame           = frame;
+    msg.data.number_atoms    = info_.number_atoms;
+    msg.data.dcd_data_offset = info_.start_offset;
+
+    return msg.to_json();
+  }
+
+
+  void release() noexcept override
+  {
+    plate::ui_event::clear_file_object(psf_url_);
+    plate::ui_event::clear_file_object(dcd_url_);
+  }
+
+
+private:
+
+  std::string   psf_url_;
+  std::string   dcd_url_;
+  dcd2pdb::info info_;
+};
+
+
+// frames read by range from an xtc trajectory, using a frame index built by scanning the file
+
+class frame_source_xtc : public frame_source
+{
+
+public:
+
+  frame_source_xtc(std::string psf_url, std::string xtc_url, int number_atoms,
+                   std::vector<std::uint64_t> offsets, std::vector<std::uint64_t> sizes) noexcept :
+    psf_url_(std::move(psf_url)),
+    xtc_url_(std::move(xtc_url)),
+    number_atoms_(number_atoms),
+    offsets_(std::move(offsets)),
+    sizes_(std::move(sizes))
+  {
+  }
+
+
+  int size() const noexcept override
+  {
+    return offsets_.size();
+  }
+
+
+  std::string get(int frame, std::string_view prefix = "") const noexcept override
+  {
+    plate::json_handler_struct<xtc2pdb::interface> msg;
+
+    msg.data.psf_url      = psf_url_;
+    msg.data.xtc_url      = xtc_url_;
+    msg.data.frame        = frame;
+    msg.data.number_atoms = number_atoms_;
+    msg.data.frame_offset = offsets_[frame];
+    msg.data.frame_size   = sizes_[frame];
+
+    return msg.to_json();
+  }
+
+
+  void release() noexcept override
+  {
+    plate::ui_event::clear_file_object(psf_url_);
+    plate::ui_event::clear_file_object(xtc_url_);
+  }
+
+
+private:
+
+  std::string psf_url_;
+  std::string xtc_url_;
+  int         number_atoms_;
+
+  std::vector<std::uint64_t> offsets_;
+  std::vector<std::uint64_t> sizes_;
+};
+
+
+// frames of an amt trajectory, which holds its own topology and index
+
+class frame_source_amt : public frame_source
+{
+
+public:
+
+  frame_source_amt(std::string amt_url, int number_frames) noexcept :
+    amt_url_(std::move(amt_url)),
+    number_frames_(number_frames)
+  {
+  }
+
+
+  int size() const noexcept override
+  {
+    return number_frames_;
+  }
+
+
+  std::string get(int frame, std::string_view prefix = "") const noexcept override
+  {
+    plate::json_handler_struct<amtraj::interface> msg;
+
+    msg.data.amt_url = amt_url_;
+    msg.data.frame   = frame;
+
+    return msg.to_json();
+  }
+
+
+  void release() noexcept override
+  {
+    plate::ui_event::clear_file_object(amt_url_);
+  }
+
+
+private:
+
+  std::string amt_url_;
+  int         number_frames_;
+};
+
+
+// a single structure file, fetched once and kept. if it is a pdb file with more than one model, its models are the
+// frames, each cut from the file, otherwise the file is the one frame. either way the workers are given the
+// contents, so none fetches the file again. part 1 is a remote file's nonCA_ companion, fetched and kept in the
+// same way when first asked for
+
+class frame_source_single : public frame_source, public std::enable_shared_from_this<frame_source_single>
+{
+
+public:
+
+  frame_source_single(std::string url, std::string file, bool local) noexcept :
+    url_(std::move(url)),
+    file_(std::move(file)),
+    local_(local)
+  {
+  }
+
+
+  // fetch the file, then call cb with the number of frames, 0 if it could not be fetched
+
+  void open(std::function<void (int number_frames)> cb) noexcept
+  {
+    load(0, [wself{weak_from_this()}, cb{std::move(cb)}] ()
+    {
+      if (auto p = wself.lock())
+        cb(p->parts_[0].data.empty() ? 0 : p->size());
+    });
+  }
+
+
+  int size() const noexcept override
+  {
+    return std::max(parts_[0].models.size(), 1); // a file of one model is the frame as it is
+  }
+
+
+  std::string get(int frame, std::string_view prefix = "") const noexcept override
+  {
+    return url_ + std::string(prefix) + file_;
+  }
+
+
+  void release() noexcept override
+  {
+    if (local_)
+      plate::ui_event::clear_file_object(file_);
+  }
+
+
+  bool is_packed() const noexcept override
+  {
+    return true;
+  }
+
+
+  void fetch(int frame, int part, std::function<void (std::span<const char>)> cb) const noexcept override
+  {
+    if (part != 0 && (local_ || part != 1)) // local files have no companion
+    {
+      cb({});
+      return;
+    }
+
+    load(part, [wself{weak_from_this()}, frame, part, cb{std::move(cb)}] ()
+    {
+      if (auto p = wself.lock())
+        p->serve(frame, part, cb);
+    });
+  }
+
+
+private:
+
+  struct file
+  {
+    std::string data;  // decompressed
+    pdb_models  models;
+
+    bool loading{false};
+    bool loaded{false};
+
+    std::vector<std::function<void ()>> waiting;
+  };
+
+
+  // call cb once part is fetched, fetching it if it is not already
+
+  void load(int part, std::function<void ()> cb) const noexcept
+  {
+    auto& f = parts_[part];
+
+    if (f.loaded)
+    {
+      cb();
+      return;
+    }
+
+    f.waiting.push_back(std::move(cb));
+
+    if (f.loading)
+      return;
+
+    f.loading = true;
+
+    plate::async::fetch_get(get(0, part ? "nonCA_" : ""), nullptr, [wself{weak_from_this()}, part]
+                                                      (std::size_t counter, plate::data_store&& d, std::uint16_t status)
+    {
+      if (auto p = wself.lock())
+        p->loaded(part, { d.data(), d.size() });
+
+    }, [wself{weak_from_this()}, part] (std::size_t error_code, int error_msg)
+    {
+      log_debug(FMT_COMPILE("failed to download single file part: {} error_code: {} msg: {}"), part, error_code, error_msg);
+
+      if (auto p = wself.lock())
+        p->loaded(part, {});
+    });
+  }
+
+
+  void loaded(int part, std::span<const std::byte> d) const noexcept
+  {
+    auto& f = parts_[part];
+
+    if (inflate::is_compressed(d))
+    {
+      if (!inflate::decompress(d, f.data))
+      {
+        log_debug(FMT_COMPILE("unable to decompress: {}"), get(0, part ? "nonCA_" : ""));
+        f.data.clear();
+      }
+    }
+    else
+      f.data.assign(reinterpret_cast<const char*>(d.data()), d.size());
+
+    f.models.index(f.data);
+
+    f.loading = false;
+    f.loaded  = true;
+
+    auto waiting = std::move(f.waiting);
+
+    for (auto& cb : waiting)
+      cb();
+  }
+
+
+  // the model frame of part, or the whole part if it does not have more than one
+
+  void serve(int frame, int part, const std::function<void (std::span<const char>)>& cb) const noexcept
+  {
+    auto& f = parts_[part];
+
+    if (f.models.size() <= 1)
+    {
+      cb(f.data);
+      return;
+    }
+
+    if (frame >= f.models.size())
+    {
+      cb({});
+      return;
+    }
+
+    std::string pdb;
+
+    f.models.get_model(f.data, frame, pdb);
+
+    cb(pdb);
+  }
+
+
+  std::string url_;  // prepended to file, eg. the directory of a remote item
+  std::string file_;
+  bool        local_;
+
+  mutable std::array<file, 2> parts_;
+};
+
+
+// the frames of a movie.plan dataset packed into one frame bundle. frames are fetched a window at a time with
+// a range request, and the last few windows are kept for the frames that follow. frames coded as deltas are
+// decoded by a worker against their reference, itself fetched if it is not the last frame decoded
+
+class frame_source_bundle : public frame_source, public std::enable_shared_from_this<frame_source_bundle>
+{
+
+public:
+
+  // calls a worker to decode data, a geometry delta followed by its reference, giving cb the frame or nothing
+
+  using decoder = std::function<void (std::vector<char>& data, std::function<void (std::span<char>)>&& cb)>;
+
+
+  frame_source_bundle(std::string bundle_url, frame_bundle bundle, decoder decode) noexcept :
+    bundle_url_(std::move(bundle_url)),
+    bundle_(std::move(bundle)),
+    decoder_(std::move(decode))
+  {
+  }
+
+
+  int size() const noexcept override
+  {
+    return bundle_.get_header().number_frames;
+  }
+
+
+  std::string get(int frame, std::string_view prefix = "") const noexcept override
+  {
+    return bundle_url_;
+  }
+
+
+  bool is_packed() const noexcept override
+  {
+    return true;
+  }
+
+
+  void fetch(int frame, int part, std::function<void (std::span<const char>)> cb) const noexcept override
+  {
+    if (!bundle_.is_delta())
+    {
+      fetch_stored(frame, part, std::move(cb));
+      return;
+    }
+
+    if (join(frame, part, cb))
+      return;
+
+    fetch_stored(frame, part, [wself{weak_from_this()}, frame, part, cb{std::move(cb)}] (std::span<const char> d)
+    {
+      if (auto p = wself.lock())
+        p->decode(frame, part, d, cb);
+    });
+  }
+
+
+private:
+
+  static constexpr std::size_t max_windows = 4;
+
+  struct waiting
+  {
+    int frame;
+    int part;
+
+    std::function<void (std::span<const char>)> cb;
+  };
+
+  struct window
+  {
+    int id;
+
+    std::uint64_t    offset; // in the file of data
+    plate::data_store data;
+
+    bool         loading;
+    bool         failed;  // to load, so fetched again by a new window and dropped once no longer serving
+    unsigned int last_use;
+    int          serving; // callbacks given its data in progress, which may fetch again, so it is not dropped
+
+    std::vector<waiting> waiting;
+  };
+
+  struct decoded
+  {
+    int frame{-1};
+    int part{-1};
+
+    std::vector<char> data;
+  };
+
+  struct decoding
+  {
+    int frame;
+    int part;
+
+    std::vector<std::function<void (std::span<const char>)>> waiting;
+  };
+
+
+  // d as stored, or decoded against its reference
+
+  void decode(int frame, int part, std::span<const char> d, const std::function<void (std::span<const char>)>& cb) const noexcept
+  {
+    auto reference = geometry_delta::get_reference(d);
+
+    if (!reference)
+    {
+      cb(d);
+      return;
+    }
+
+    if (join(frame, part, cb))
+      return;
+
+    decoding_.push_back({ frame, part, { cb } });
+
+    if (last_decoded_.frame == static_cast<int>(*reference) && last_decoded_.part == part)
+    {
+      apply(frame, part, d, last_decoded_.data);
+      return;
+    }
+
+    if (*reference >= bundle_.get_header().number_frames || static_cast<int>(*reference) == frame)
+    {
+      log_debug(FMT_COMPILE("bad geometry delta reference: {} of frame: {}"), *reference, frame);
+      decoded_to(frame, part, {});
+      return;
+    }
+
+    // kept, as the window of d may be dropped while the reference is fetched
+
+    fetch(*reference, part, [wself{weak_from_this()}, frame, part, stored{std::vector<char>(d.begin(), d.end())}]
+                                                                                        (std::span<const char> r)
+    {
+      if (auto p = wself.lock())
+      {
+        if (r.empty())
+          p->decoded_to(frame, part, {});
+        else
+          p->apply(frame, part, stored, r);
+      }
+    });
+  }
+
+
+  // wait for frame if it is being decoded, so it is given to all that ask for it
+
+  bool join(int frame, int part, const std::function<void (std::span<const char>)>& cb) const noexcept
+  {
+    auto i = std::find_if(decoding_.begin(), decoding_.end(), [frame, part] (const auto& d)
+    {
+      return d.frame == frame && d.part == part;
+    });
+
+    if (i == decoding_.end())
+      return false;
+
+    i->waiting.push_back(cb);
+
+    return true;
+  }
+
+
+  // send d and its reference r to a worker to decode
+
+  void apply(int frame, int part, std::span<const char> d, std::span<const char> r) const noexcept
+  {
+    std::vector<char> data;
+
+    data.reserve(d.size() + r.size());
+    data.insert(data.end(), d.begin(), d.end());
+    data.insert(data.end(), r.begin(), r.end());
+
+    decoder_(data, [wself{weak_from_this()}, frame, part] (std::span<char> out)
+    {
+      if (auto p = wself.lock())
+        p->decoded_to(frame, part, out);
+    });
+  }
+
+
+  // give those waiting for frame its decoded data, kept as the reference of the next
+
+  void decoded_to(int frame, int part, std::span<const char> out) const noexcept
+  {
+    auto i = std::find_if(decoding_.begin(), decoding_.end(), [frame, part] (const auto& d)
+    {
+      return d.frame == frame && d.part == part;
+    });
+
+    if (i == decoding_.end())
+      return;
+
+    auto waiting = std::move(i->waiting);
+
+    decoding_.erase(i);
+
+    if (out.empty())
+    {
+      for (auto& cb : waiting)
+        cb({});
+
+      return;
+    }
+
+    last_decoded_ = { frame, part, std::vector<char>(out.begin(), out.end()) };
+
+    for (auto& cb : waiting)
+      cb(last_decoded_.data);
+  }
+
+
+  void fetch_stored(int frame, int part, std::function<void (std::span<const char>)> cb) const noexcept
+  {
+    if (part >= static_cast<int>(bundle_.get_header().number_parts) || bundle_.get_entry(frame, part).size == 0)
+    {
+      cb({});
+      return;
+    }
+
+    auto id = bundle_.get_window(frame);
+
+    std::erase_if(windows_, [] (const auto& w) { return w.failed && w.serving == 0; });
+
+    auto w = std::find_if(windows_.begin(), windows_.end(), [id] (const auto& w) { return w.id == id && !w.failed; });
+
+    if (w != windows_.end())
+    {
+      w->last_use = ++use_counter_;
+
+      if (w->loading)
+        w->waiting.push_back({ frame, part, std::move(cb) });
+      else
+        serve(*w, frame, part, cb);
+
+      return;
+    }
+
+    // drop the least recently used windows that have loaded to make room
+
+    while (windows_.size() >= max_windows)
+    {
+      auto lru = windows_.end();
+
+      for (auto i = windows_.begin(); i != windows_.end(); ++i)
+        if (!i->loading && i->serving == 0 && (lru == windows_.end() || i->last_use < lru->last_use))
+          lru = i;
+
+      if (lru == windows_.end())
+        break;
+
+      windows_.erase(lru);
+    }
+
+    auto [first, last] = bundle_.get_window_range(id);
+
+    w = windows_.insert(windows_.end(), { id, first, {}, true, false, ++use_counter_, 0, {} });
+
+    w->waiting.push_back({ frame, part, std::move(cb) });
+
+    auto range = fmt::format(FMT_COMPILE("bytes={}-{}"), first, last - 1);
+
+    const char* headers[] = {"Range", range.data(), NULL};
+
+    plate::async::fetch_get(bundle_url_, headers, [wself{weak_from_this()}, id] (std::size_t counter, plate::data_store&& d, std::uint16_t status)
+    {
+      if (auto p = wself.lock())
+        p->loaded(id, std::move(d), status);
+
+    }, [wself{weak_from_this()}, id] (std::size_t error_code, int error_msg)
+    {
+      log_debug(FMT_COMPILE("failed to download frame bundle window, error_code: {} msg: {}"), error_code, error_msg);
+
+      if (auto p = wself.lock())
+        p->loaded(id, {}, 0);
+    });
+  }
+
+
+  std::span<const char> get_part(window& w, int frame, int part) const noexcept
+  {
+    const auto& e = bundle_.get_entry(frame, part);
+
+    if (e.offset < w.offset || e.offset + e.size > w.offset + w.data.size())
+      return {};
+
+    return { reinterpret_cast<const char*>(w.data.data()) + (e.offset - w.offset), e.size };
+  }
+
+
+  void loaded(int id, plate::data_store&& d, std::uint16_t status) const noexcept
+  {
+    auto w = std::find_if(windows_.begin(), windows_.end(), [id] (const auto& w) { return w.id == id && w.loading; });
+
+    if (w == windows_.end())
+      return;
+
+    w->offset  = status == 200 ? 0 : w->offset; // range ignored, so data is the whole file
+    w->data    = std::move(d);
+    w->loading = false;
+    w->failed  = w->data.size() == 0; // so the next fetch tries again
+
+    auto waiting = std::move(w->waiting);
+
+    for (auto& c : waiting)
+      serve(*w, c.frame, c.part, c.cb);
+
+    if (w->failed && w->serving == 0)
+      windows_.erase(w);
+  }
+
+
+  // give cb its part of w, keeping w while it runs
+
+  void serve(window& w, int frame, int part, const std::function<void (std::span<const char>)>& cb) const noexcept
+  {
+    ++w.serving;
+
+    cb(get_part(w, frame, part));
+
+    --w.serving;
+  }
+
+
+  std::string  bundle_url_;
+  frame_bundle bundle_;
+
+  mutable std::list<window>   windows_;
+  mutable unsigned int        use_counter_{0};
+
+  decoder decoder_;
+
+  mutable std::list<decoding> decoding_;
+  mutable decoded             last_decoded_;
+};
+
+} // namespace animol
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <string_view>
+#include <span>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+
+#include "../worker/geometry_bounds.hpp"
+
+
+namespace animol {
+
+/*
+    the results of worker calls on frames, keyed by a hash of the function and the data sent: the script and
+    the frame's url or descriptor (so its byte range), or its contents, and by the size of the data sent, so a
+    hash collision must also match its size. a repeated call, eg. for a file listed twice in a movie.plan or a
+    layer shown again, is answered from the cache, and a call made while the same one is in flight waits for
+    its result rather than asking a worker again.
+
+    results are kept up to max_bytes, the least recently used dropped first, and are shared by all given them
+    rather than copied. failures are not kept.
+*/
+
+class result_cache
+{
+
+public:
+
+  static constexpr std::size_t max_bytes = 64 * 1024 * 1024;
+
+  using result_cb = std::function<void (std::span<const char>)>;
+
+
+  struct key
+  {
+    std::uint64_t hash;
+    std::size_t   size;
+
+    bool operator==(const key&) const = default;
+  };
+
+
+  static key get_key(std::string_view fname, std::span<const char> data) noexcept
+  {
+    return { geometry_bounds::hash(data, geometry_bounds::hash(fname)), data.size() };
+  }
+
+
+  // true if cb is answered from the cache or waits for the same call in flight. otherwise the call is marked in
+  // flight, with cb waiting, and the caller makes it and passes the result to add
+
+  bool wait(const key& k, result_cb cb) noexcept
+  {
+    auto it = entries_.find(k);
+
+    if (it == entries_.end())
+    {
+      entries_[k].waiting.push_back(std::move(cb));
+      return false;
+    }
+
+    auto& e = it->second;
+
+    if (e.loading)
+    {
+      e.waiting.push_back(std::move(cb));
+      return true;
+    }
+
+    e.last_use = ++use_counter_;
+
+    ++hits_;
+
+    auto data = e.data; // kept should cb drop it from the cache
+
+    cb(*data);
+
+    return true;
+  }
+
+
+  // the result of a call marked in flight by wait, given as it is to those waiting for it
+
+  void add(const key& k, std::span<const char> d) noexcept
+  {
+    auto it = entries_.find(k);
+
+    if (it == entries_.end() || !it->second.loading)
+      return;
+
+    auto waiting = std::move(it->second.waiting);
+
+    if (d.empty() || d.size() > max_bytes)
+      entries_.erase(it);
+    else
+    {
+      auto& e = it->second;
+
+      e.data     = std::make_shared<const std::vector<char>>(d.begin(), d.end());
+      e.loading  = false;
+      e.last_use = ++use_counter_;
+
+      bytes_ += d.size();
+
+      trim();
+    }
+
+    hits_ += waiting.size() - 1;
+
+    for (auto& cb : waiting)
+      cb(d);
+  }
+
+
+  void clear() noexcept
+  {
+    std::erase_if(entries_, [] (const auto& e) { return !e.second.loading; }); // those in flight still answer
+
+    bytes_ = 0;
+  }
+
+
+  std::size_t get_results() const noexcept
+  {
+    return std::count_if(entries_.begin(), entries_.end(), [] (const auto& e) { return !e.second.loading; });
+  }
+
+
+  std::size_t get_bytes() const noexcept
+  {
+    return bytes_;
+  }
+
+
+  // calls answered without a worker
+
+  std::size_t get_hits() const noexcept
+  {
+    return hits_;
+  }
+
+
+private:
+
+  struct entry
+  {
+    std::shared_ptr<const std::vector<char>> data;
+    bool                                     loading{true};
+    unsigned int                             last_use{0};
+    std::vector<result_cb>                   waiting;
+  };
+
+
+  // drop the least recently used results until within max_bytes
+
+  void trim() noexcept
+  {
+    while (bytes_ > max_bytes)
+    {
+      auto lru = entries_.end();
+
+      for (auto i = entries_.begin(); i != entries_.end(); ++i)
+        if (!i->second.loading && (lru == entries_.end() || i->second.last_use < lru->second.last_use))
+          lru = i;
+
+      if (lru == entries_.end())
+        break;
+
+      bytes_ -= lru->second.data->size();
+
+      entries_.erase(lru);
+    }
+  }
+
+
+  struct key_hash
+  {
+    std::size_t operator()(const key& k) const noexcept
+    {
+      return k.hash;
+    }
+  };
+
+
+  std::unordered_map<key, entry, key_hash> entries_;
+
+  std::size_t  bytes_{0};
+  std::size_t  hits_{0};
+  unsigned int use_counter_{0};
+};
+
+} // namespace animol
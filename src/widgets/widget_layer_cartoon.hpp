@@ -1,14 +1,23 @@
 #pragma once
 
 #include <array>
+#include <bit>
+#include <memory>
+#include <unordered_map>
 #include <type_traits>
 
 #include "plate.hpp"
 
 #include "widgets/widget_object.hpp"
+#include "widgets/widget_spheres.hpp"
+#include "widgets/widget_cylinders.hpp"
 #include "widgets/anim_alpha.hpp"
 
 #include "widget_layer.hpp"
+#include "frame_source.hpp"
+#include "frame_blend.hpp"
+#include "../worker/lod_table.hpp"
+#include "../worker/geometry_bounds.hpp"
 
 
 namespace animol {
@@ -26,10 +35,29 @@ public:
   };
 
 
-  struct vert_with_color
+  // spheres and cylinders may follow the strips as instances, drawn as impostors. geometry without them (eg.
+  // baked before them) just ends after the strips
+
+  struct impostor_header
+  {
+    int num_spheres;
+    int num_cylinders;
+  };
+
+
+  // frames are stored as positions and normals, with the colours of the master frame unless their own differ. frames
+  // after the master are asked for without colours, so arrive as verts. those with colours have them after their
+  // verts, as vert_colors
+
+  struct vert
+  {
+    std::array<short,3> position;
+    std::array<short,3> normal;
+  };
+
+
+  struct vert_color
   {
-    std::array<short,3>        position;
-    std::array<short,3>        normal;
     std::array<std::uint8_t,4> color;
   };
 
@@ -53,22 +81,43 @@ public:
 
   inline bool has_frame(int frame_id) noexcept override
   {
-    return store_[frame_id].vertex.is_ready() || store_[frame_id].vertex_strip.is_ready();
+    auto& g = store_[frame_id].g;
+
+    return g && (g->levels[0].vertex.is_ready() || g->levels[0].vertex_strip.is_ready());
   }
 
 
   bool set_frame(int frame_id) noexcept override
   {
+    trace_zone("layer_cartoon::set_frame");
+
     if (!has_frame(frame_id))
+    {
+      // while loading progressively, stand in the nearest frame loaded so the whole trajectory can be scrubbed
+
+      if (auto n = get_nearest_loaded(frame_id); progressive_ && n >= 0 && widget_object_)
+        show(n);
+
       return false;
+    }
 
-    widget_object_->set_model(&(store_[frame_id].vertex));
-    widget_object_->add_model(&(store_[frame_id].vertex_strip));
+    show(frame_id);
 
     return true;
   }
 
 
+  // switch to the level of detail of the current zoom, and draw between frames while playing
+
+  void display() noexcept override
+  {
+    if (shown_frame_ >= 0 && get_level(shown_frame_) != shown_level_)
+      show(shown_frame_);
+
+    blend();
+  }
+
+
   std::string_view name() const noexcept override
   {
     return "layer_cartoon";
@@ -77,47 +126,144 @@ public:
 
 private:
 
+  struct level
+  {
+    plate::buffer<vert>         vertex;
+    plate::buffer<vert>         vertex_strip;
+
+    plate::buffer<vert_color>   vertex_color;          // its own colours, if not those of the master frame
+    plate::buffer<vert_color>   vertex_strip_color;
+
+    plate::buffer<vert_color>*  colors{nullptr};       // drawn with: its own or the master frame's
+    plate::buffer<vert_color>*  strip_colors{nullptr};
+
+    std::vector<vert>           vertex_data;           // kept for blending on the cpu
+    std::vector<vert>           vertex_strip_data;
+  };
+
+  enum class load_state { none, coarse, refining, full };
+
+  // the buffers of a frame: each level's vertices, and the impostors of the finest. frames whose results are
+  // identical share one, reference counted by the frames drawing it
+
+  struct geometry
+  {
+    geometry() = default;
+    geometry(const geometry&) = delete;
+
+    ~geometry()
+    {
+      if (spheres_vao)
+        glDeleteVertexArrays(1, &spheres_vao);
+
+      if (cylinders_vao)
+        glDeleteVertexArrays(1, &cylinders_vao);
+    }
+
+    std::array<level, lod_table::max_levels> levels;   // finest first
+    std::array<int, lod_table::max_levels>   segments{};
+    int                                      level_count{0};
+
+    plate::buffer<plate::widget_spheres::inst>   spheres;
+    std::uint32_t                                spheres_vao{0};
+    plate::buffer<plate::widget_cylinders::inst> cylinders;
+    std::uint32_t                                cylinders_vao{0};
+
+    bool          colored{false}; // uploaded from a result with colours
+    std::uint64_t hash{0};        // of the result, 0 if it had no bounds
+    std::uint64_t colors{0};      // of the colours of the result, 0 if it had none or no bounds
+  };
+
+  struct frame
+  {
+    load_state                state{load_state::none};
+    std::shared_ptr<geometry> g; // null until loaded
+  };
+
 
   void start() noexcept
   {
     clear();
 
-    if (main_->get_total_frames() <= 0)
+    frames_ = main_->get_frames();
+    baked_  = main_->get_baked();
+
+    if (main_->get_total_frames() <= 0 || !frames_)
       return;
 
     store_.resize(main_->get_total_frames());
 
-    // setup the load order- from initial+1 up, and then from initial-1 down..
+    blend_.vertex.set_tag(name(), -1, "blend triangles");
+    blend_.vertex_strip.set_tag(name(), -1, "blend strips");
 
-    for (int i = main_->get_master_frame_id() + 1; i < main_->get_total_frames(); ++i)
-      to_load_.push(i);
-
-    for (int i = main_->get_master_frame_id() - 1; i >= 0; --i)
-      to_load_.push(i);
+    progressive_ = main_->get_progressive() && !baked_;
 
     generate_script();
   }
 
 
-  void generate_script() noexcept
+  // the order to load the frames after the master frame in, once progressive_ is settled by the script
+
+  void queue_frames() noexcept
   {
-    // request the worker to download the pdb file and generate the script
+    if (progressive_)
+    {
+      // every frame coarse first, spread over the trajectory by halving the stride between those loaded, then
+      // refined from the playhead out as the workers become free
+
+      std::vector<bool> queued(main_->get_total_frames());
 
-    auto per_frame_files = main_->get_frame_files();
+      queued[main_->get_master_frame_id()] = true;
 
-    std::string u;
+      auto stride = std::bit_floor(static_cast<unsigned>(main_->get_total_frames()));
 
-    if (main_->is_remote())
-      u = main_->get_url() + main_->get_item() + "/" + per_frame_files[main_->get_master_frame_id()];
+      for (; stride > 0; stride /= 2)
+        for (int i = 0; i < main_->get_total_frames(); i += stride)
+          if (!queued[i])
+          {
+            queued[i] = true;
+            to_load_.push(i);
+          }
+    }
     else
-      u = per_frame_files[main_->get_master_frame_id()];
+    {
+      // setup the load order- from initial+1 up, and then from initial-1 down..
+
+      for (int i = main_->get_master_frame_id() + 1; i < main_->get_total_frames(); ++i)
+        to_load_.push(i);
+
+      for (int i = main_->get_master_frame_id() - 1; i >= 0; --i)
+        to_load_.push(i);
+    }
+  }
+
+
+  void generate_script() noexcept
+  {
+    if (baked_) // no script needed
+    {
+      queue_frames();
+
+      load_baked(main_->get_master_frame_id(), true);
+      return;
+    }
+
+    // request the worker to download the pdb file and generate the script, from its atoms if another layer has them
 
-    main_->worker_->call("script", u, [this, wself{this->weak_from_this()} ] (std::span<char> d)
+    main_->call_frame_cached(frames_, main_->get_master_frame_id(), 0, "script", "script_with", "script_table", {},
+                                                                  [this, wself{this->weak_from_this()} ] (std::span<const char> d)
     {
       if (auto w = wself.lock())
       {
         script_ = std::string(d.data(), d.size());
 
+        coarse_script_ = lod_table::set_segments(script_, coarse_segments);
+
+        if (coarse_script_ == script_) // no segments to lower, so nothing to refine
+          progressive_ = false;
+
+        queue_frames();
+
         get_first_frame();
       }
     });
@@ -130,15 +276,6 @@ private:
   {
     // script has been generated, so run the decoder with the main frame,
 
-    auto per_frame_files = main_->get_frame_files();
-
-    std::string u;
-
-    if (main_->is_remote())
-      u = main_->get_url() +main_->get_item() + "/" + per_frame_files[main_->get_master_frame_id()];
-    else
-      u = per_frame_files[main_->get_master_frame_id()];
-
     std::vector<char> data_to_send(4);
 
     std::uint32_t script_size = script_.size();
@@ -146,9 +283,11 @@ private:
     std::memcpy(data_to_send.data(), &script_size, 4);
 
     data_to_send.insert(data_to_send.end(), script_.begin(), script_.end());
-    data_to_send.insert(data_to_send.end(),       u.begin(),       u.end());
 
-    main_->worker_->call("decode_url_color_interleaved", data_to_send, [this, wself{this->weak_from_this()} ] (std::span<char> d)
+    auto [url_fn, contents_fn, table_fn] = get_decode_fns();
+
+    main_->call_frame_cached(frames_, main_->get_master_frame_id(), 0, url_fn, contents_fn, table_fn,
+                                        std::move(data_to_send), [this, wself{this->weak_from_this()} ] (std::span<const char> d)
     {
       if (auto w = wself.lock())
       {
@@ -162,75 +301,138 @@ private:
 
   void process_next() noexcept
   {
-    if (to_load_.empty()) // nothing left to ask for
-      return;
+    int  to_load;
+    bool recolor = false;
+
+    if (!to_recolor_.empty()) // frames without colours that do not fit those of the master frame
+    {
+      to_load = to_recolor_.front();
+      to_recolor_.pop();
+
+      recolor = true;
+    }
+    else if (!to_load_.empty())
+    {
+      to_load = to_load_.front();
+      to_load_.pop();
+    }
+    else if (progressive_ && (to_load = get_frame_to_refine()) >= 0)
+      store_[to_load].state = load_state::refining;
+    else
+      return; // nothing left to ask for
 
-    auto to_load = to_load_.front();
-    to_load_.pop();
+    if (baked_)
+    {
+      load_baked(to_load, false);
+      return;
+    }
 
-    auto per_frame_files = main_->get_frame_files();
+    auto coarse = progressive_ && store_[to_load].state != load_state::refining;
 
-    std::string u;
+    auto& script = coarse ? coarse_script_ : script_;
 
-    if (main_->is_remote())
-      u = main_->get_url() + main_->get_item() + "/" + per_frame_files[to_load];
-    else
-      u = per_frame_files[to_load];
+    auto colored = recolor || coarse; // the master frame's colours only fit geometry from its script
 
     std::vector<char> data_to_send(4);
 
-    std::uint32_t script_size = script_.size();
+    std::uint32_t script_size = script.size();
 
     std::memcpy(data_to_send.data(), &script_size, 4);
 
-    data_to_send.insert(data_to_send.end(), script_.begin(), script_.end());
-    data_to_send.insert(data_to_send.end(),       u.begin(),       u.end());
+    data_to_send.insert(data_to_send.end(), script.begin(), script.end());
+
+    auto [url_fn, contents_fn, table_fn] = get_decode_fns(colored);
 
-    main_->worker_->call("decode_url_color_interleaved", data_to_send,
-                                    [this, wself{this->weak_from_this()}, entry = to_load] (std::span<char> d)
+    main_->call_frame_cached(frames_, to_load, 0, url_fn, contents_fn, table_fn, std::move(data_to_send),
+                                    [this, wself{this->weak_from_this()}, entry = to_load, colored] (std::span<const char> d)
     {
       if (auto w = wself.lock())
       {
         emscripten_webgl_make_context_current(this->ui_->ctx_);
-        process_decoded(entry, d);
+        process_decoded(entry, d, colored);
       }
     });
   }
 
 
-  void process_decoded(int entry, std::span<char> d) noexcept
+  // baked geometry skips the worker, each frame is stored as the worker would return it and uploaded from where
+  // it was fetched to. frames start at multiples of 4 bytes in the bundle, so their headers are aligned
+
+  void load_baked(int entry, bool main_frame) noexcept
   {
-    compact_header* h = new (d.data()) compact_header;
+    baked_->fetch(entry, 0, [this, wself{this->weak_from_this()}, entry, main_frame] (std::span<const char> d)
+    {
+      if (auto w = wself.lock())
+      {
+        emscripten_webgl_make_context_current(this->ui_->ctx_);
+
+        static constexpr compact_header none{};
+
+        if (d.size() < sizeof(compact_header)) // an empty frame reads as no triangles
+          d = { reinterpret_cast<const char*>(&none), sizeof(none) };
+
+        if (main_frame)
+          process_main_frame(d);
+        else
+          process_decoded(entry, d);
+      }
+    });
+
+    main_->update_loading();
+  }
 
-    auto p = reinterpret_cast<std::byte*>(d.data()) + sizeof(compact_header);
 
-    store_[entry].vertex.upload(p, h->num_triangles, GL_TRIANGLES);
-    p += h->num_triangles * sizeof(vert_with_color);
+  void process_decoded(int entry, std::span<const char> d, bool colored = true) noexcept
+  {
+    auto refined = store_[entry].state == load_state::refining; // replaces the coarse buffers, already counted
 
-    store_[entry].vertex_strip.upload(p, h->num_strips, GL_TRIANGLE_STRIP);
+    auto bounds = geometry_bounds::strip(d);
 
-    if (main_->get_current_frame() == entry) // we've caught up with main frame position
+    if (!upload(entry, lod_table::get_levels(d), colored, bounds ? bounds->hash : 0, bounds ? bounds->colors : 0))
     {
-      widget_object_->set_model(&(store_[entry].vertex));
-      widget_object_->add_model(&(store_[entry].vertex_strip));
+      log_debug(FMT_COMPILE("frame: {} does not fit the colours of the master frame"), entry);
+
+      to_recolor_.push(entry);
+      process_next();
+      return;
     }
 
-    process_frame();
+    store_[entry].state = progressive_ && !refined ? load_state::coarse : load_state::full;
+
+    if ((main_->get_current_frame() == entry || shown_frame_ == entry) && has_frame(entry)) // caught up with main
+      show(entry);                                                                                // frame position
+
+    if (!refined)
+      process_frame();
+
     process_next();
   }
 
 
-  void process_main_frame(std::span<char> d) noexcept
+  void process_main_frame(std::span<const char> d) noexcept
   {
-    // main frame has been converted to geometry
+    // main frame has been converted to geometry, levels of detail finest first, then its bounds
+
+    auto bounds = geometry_bounds::strip(d);
 
-    compact_header* h = new (d.data()) compact_header;
+    auto levels = lod_table::get_levels(d);
 
-    auto p = reinterpret_cast<std::byte*>(d.data()) + sizeof(compact_header);
+    if (levels.empty() || levels[0].first.size() < sizeof(compact_header))
+    {
+      main_->set_error("Failed to process");
+      return;
+    }
+
+    d = levels[0].first;
 
-    log_debug(FMT_COMPILE("main frame triangles: {} strips: {}"), h->num_triangles, h->num_strips);
+    auto h = reinterpret_cast<const compact_header*>(d.data());
 
-    if (h->num_triangles == 0 && h->num_strips == 0)
+    auto impostors = get_impostors(d);
+
+    log_debug(FMT_COMPILE("main frame triangles: {} strips: {} spheres: {} cylinders: {}"), h->num_triangles, h->num_strips,
+                                                                          impostors.spheres.size(), impostors.cylinders.size());
+
+    if (h->num_triangles == 0 && h->num_strips == 0 && impostors.spheres.empty() && impostors.cylinders.empty())
     {
       main_->set_error("Failed to process");
       return;
@@ -238,43 +440,55 @@ private:
 
     // upload the vertices
 
-    store_[main_->get_master_frame_id()].vertex.upload(p, h->num_triangles, GL_TRIANGLES);
-    p += h->num_triangles * sizeof(vert_with_color);
-        
-    store_[main_->get_master_frame_id()].vertex_strip.upload(p, h->num_strips, GL_TRIANGLE_STRIP);
-    p += h->num_strips * sizeof(vert_with_color);
+    upload(main_->get_master_frame_id(), levels, true, bounds ? bounds->hash : 0, bounds ? bounds->colors : 0);
+
+    store_[main_->get_master_frame_id()].state = load_state::full;
 
     // start number_of_worker_threads processing
 
     for (int i = 0; i < worker::get_max_workers(); ++i)
       process_next();
 
-    widget_object_ = plate::ui_event_destination::make_ui<plate::widget_object<vert_with_color>>(this->ui_, this->coords_,
+    widget_object_ = plate::ui_event_destination::make_ui<plate::widget_object<vert, vert_color>>(this->ui_, this->coords_,
                                       plate::ui_event_destination::Prop::Display, this->shared_from_this(), main_->get_shared_ubuf());
 
+    widget_spheres_ = plate::ui_event_destination::make_ui<plate::widget_spheres>(this->ui_, this->coords_,
+                                                              this->shared_from_this(), main_->get_shared_ubuf());
+
+    widget_cylinders_ = plate::ui_event_destination::make_ui<plate::widget_cylinders>(this->ui_, this->coords_,
+                                                              this->shared_from_this(), main_->get_shared_ubuf());
+
     if (main_->get_current_frame() ==  main_->get_master_frame_id())
-    {
-      widget_object_->set_model(&store_[main_->get_master_frame_id()].vertex);
-      widget_object_->add_model(&store_[main_->get_master_frame_id()].vertex_strip);
-    }
+      show(main_->get_master_frame_id());
 
     auto fade_in = plate::ui_event_destination::make_anim<plate::anim_alpha>(this->ui_, widget_object_, plate::ui_anim::Dir::Forward, 0.3f);
 
-    // loop through data to find protein width
+    // the protein width from its bounds, or by looping through the data of geometry without them
 
     if (!main_->scale_has_been_set())
     {
-      p = reinterpret_cast<std::byte*>(d.data()) + sizeof(compact_header);
-
       int max = 0;
 
-      auto v = reinterpret_cast<vert_with_color*>(p);
-
-      for (int i = 0; i < h->num_triangles + h->num_strips; ++i, ++v)
+      if (bounds)
+        max = geometry_bounds::get_extent(*bounds);
+      else
       {
-        if (abs(v->position[0]) > max) max = abs(v->position[0]);
-        if (abs(v->position[1]) > max) max = abs(v->position[1]);
-        if (abs(v->position[2]) > max) max = abs(v->position[2]);
+        auto v = reinterpret_cast<const vert*>(d.data() + sizeof(compact_header));
+
+        for (int i = 0; i < h->num_triangles + h->num_strips; ++i, ++v)
+        {
+          if (abs(v->position[0]) > max) max = abs(v->position[0]);
+          if (abs(v->position[1]) > max) max = abs(v->position[1]);
+          if (abs(v->position[2]) > max) max = abs(v->position[2]);
+        }
+
+        for (auto& s : impostors.spheres)
+          for (auto c : s.offset)
+            if (abs(c) > max) max = abs(c);
+
+        for (auto& c : impostors.cylinders)
+          for (int i = 0; i < 3; ++i)
+            max = std::max({ max, abs(c.p1[i]), abs(c.p2[i]) });
       }
 
       // values are int16 and so range from +/- 32'768
@@ -295,6 +509,394 @@ private:
   }
 
 
+  // the worker functions for geometry from a url, from contents or from an atom table, with levels of detail if
+  // the viewer asks for them. those from a url or contents return the atom table only if another layer will use it
+
+  std::array<const char*, 3> get_decode_fns(bool colored = true) const noexcept
+  {
+    const bool table = main_->shares_atom_tables();
+
+    if (!colored)
+    {
+      if (main_->get_lod())
+        return { table ? "decode_url_no_color_lod_with_table"      : "decode_url_no_color_lod",
+                 table ? "decode_contents_no_color_lod_with_table" : "decode_contents_no_color_lod", "decode_table_no_color_lod" };
+
+      return { table ? "decode_url_no_color_with_table"      : "decode_url_no_color_impostors",
+               table ? "decode_contents_no_color_with_table" : "decode_contents_no_color_impostors", "decode_table_no_color" };
+    }
+
+    if (main_->get_lod())
+      return { table ? "decode_url_color_non_interleaved_lod_with_table"      : "decode_url_color_non_interleaved_lod",
+               table ? "decode_contents_color_non_interleaved_lod_with_table" : "decode_contents_color_non_interleaved_lod",
+                                                                                  "decode_table_color_non_interleaved_lod" };
+
+    return { table ? "decode_url_color_non_interleaved_with_table"      : "decode_url_color_non_interleaved_impostors",
+             table ? "decode_contents_color_non_interleaved_with_table" : "decode_contents_color_non_interleaved_impostors",
+                                                                                  "decode_table_color_non_interleaved" };
+  }
+
+
+  // the coarse frame nearest the playhead, or -1 if all are refined
+
+  int get_frame_to_refine() const noexcept
+  {
+    auto current = main_->get_current_frame();
+    int  found   = -1;
+
+    for (int i = 0; i < static_cast<int>(store_.size()); ++i)
+      if (store_[i].state == load_state::coarse && (found < 0 || std::abs(i - current) < std::abs(found - current)))
+        found = i;
+
+    return found;
+  }
+
+
+  // the loaded frame nearest frame_id, or -1 if none are
+
+  int get_nearest_loaded(int frame_id) noexcept
+  {
+    for (int d = 1; d < static_cast<int>(store_.size()); ++d)
+    {
+      if (frame_id - d >= 0 && has_frame(frame_id - d))
+        return frame_id - d;
+
+      if (frame_id + d < static_cast<int>(store_.size()) && has_frame(frame_id + d))
+        return frame_id + d;
+    }
+
+    return -1;
+  }
+
+
+  // upload each level of a frame, and the impostors of the finest. a frame without colours takes those of the
+  // master frame, and is not uploaded if it does not have the same vertices. a frame with colours takes them too if
+  // its colours hash as the master frame's, as the worker gives. the vertices are kept too if they are blended on the
+  // cpu. a frame whose result has the hash of one already uploaded shares its geometry instead
+
+  bool upload(int entry, const std::vector<std::pair<std::span<const char>, int>>& levels, bool colored, std::uint64_t hash,
+                                                                                       std::uint64_t colors_hash) noexcept
+  {
+    if (auto it = by_hash_.find(hash); hash && it != by_hash_.end())
+      if (auto g = it->second.lock(); g && g->colored == colored)
+      {
+        store_[entry].g = std::move(g);
+        return true;
+      }
+
+    auto master = store_[main_->get_master_frame_id()].g.get(); // uploaded first
+
+    auto vertex_size = colored ? sizeof(vert) + sizeof(vert_color) : sizeof(vert);
+
+    int count = 0;
+
+    for (auto& [g, segments] : levels)
+    {
+      if (count == lod_table::max_levels || g.size() < sizeof(compact_header))
+        break;
+
+      auto h = reinterpret_cast<const compact_header*>(g.data());
+
+      if (h->num_triangles < 0 || h->num_strips < 0 ||
+                g.size() < sizeof(compact_header) + (static_cast<std::size_t>(h->num_triangles) + h->num_strips) * vertex_size)
+        break;
+
+      if (!colored && (!master || count >= master->level_count || h->num_triangles != master->levels[count].vertex.count_ ||
+                                                                 h->num_strips != master->levels[count].vertex_strip.count_))
+        return false;
+
+      ++count;
+    }
+
+    auto& f = get_geometry(entry);
+
+    if (auto it = by_hash_.find(f.hash); it != by_hash_.end() && it->second.lock().get() == &f) // its previous result,
+      by_hash_.erase(it);                                                                           // eg. when coarse
+
+    if (!master) // this is the master frame
+      master = &f;
+
+    auto keep = main_->get_interpolation() == interpolation::linear || main_->get_interpolation() == interpolation::hermite;
+
+    auto own_colors = colored && (&f == master || !colors_hash || colors_hash != master->colors);
+
+    for (int i = 0; i < count; ++i)
+    {
+      auto& [g, segments] = levels[i];
+
+      auto h = reinterpret_cast<const compact_header*>(g.data());
+      auto n = static_cast<std::size_t>(h->num_triangles) + h->num_strips;
+
+      auto& l = f.levels[i];
+
+      std::span<const vert> v(reinterpret_cast<const vert*>(g.data() + sizeof(compact_header)), n);
+
+      l.vertex.upload(v.data(), h->num_triangles, GL_TRIANGLES);
+      l.vertex_strip.upload(v.data() + h->num_triangles, h->num_strips, GL_TRIANGLE_STRIP);
+
+      if (own_colors)
+      {
+        auto colors = reinterpret_cast<const vert_color*>(v.data() + n);
+
+        l.vertex_color.upload(colors, h->num_triangles, GL_TRIANGLES);
+        l.vertex_strip_color.upload(colors + h->num_triangles, h->num_strips, GL_TRIANGLE_STRIP);
+
+        l.colors       = &l.vertex_color;
+        l.strip_colors = &l.vertex_strip_color;
+      }
+      else
+      {
+        if (l.vertex_color.count_ || l.vertex_strip_color.count_) // its own from before, eg. when coarse
+        {
+          l.vertex_color.upload(static_cast<const vert_color*>(nullptr), 0, GL_TRIANGLES);
+          l.vertex_strip_color.upload(static_cast<const vert_color*>(nullptr), 0, GL_TRIANGLE_STRIP);
+        }
+
+        l.colors       = &master->levels[i].vertex_color;
+        l.strip_colors = &master->levels[i].vertex_strip_color;
+      }
+
+      if (keep)
+      {
+        l.vertex_data.assign(v.begin(), v.begin() + h->num_triangles);
+        l.vertex_strip_data.assign(v.begin() + h->num_triangles, v.end());
+      }
+      else
+      {
+        l.vertex_data.clear();
+        l.vertex_strip_data.clear();
+      }
+
+      f.segments[i] = segments;
+    }
+
+    f.level_count = count;
+    f.colored     = colored;
+    f.hash        = hash;
+    f.colors      = colored ? colors_hash : 0;
+
+    if (count)
+      upload_impostors(f, levels[0].first, vertex_size);
+
+    if (hash)
+      by_hash_[hash] = store_[entry].g;
+
+    return true;
+  }
+
+
+  // the geometry of entry to upload to: its own, or a new one if it has none or shares another's
+
+  geometry& get_geometry(int entry) noexcept
+  {
+    auto& g = store_[entry].g;
+
+    if (g && g.use_count() == 1)
+      return *g;
+
+    g = std::make_shared<geometry>();
+
+    for (auto& l : g->levels)
+    {
+      l.vertex.set_tag(name(), entry, "triangles");
+      l.vertex_strip.set_tag(name(), entry, "strips");
+      l.vertex_color.set_tag(name(), entry, "triangle colours");
+      l.vertex_strip_color.set_tag(name(), entry, "strip colours");
+    }
+
+    g->spheres.set_tag(name(), entry, "spheres");
+    g->cylinders.set_tag(name(), entry, "cylinders");
+
+    return *g;
+  }
+
+
+  // the level of detail to draw a frame at, from the size of an angstrom on screen
+
+  int get_level(int frame_id) const noexcept
+  {
+    if (!store_[frame_id].g)
+      return 0;
+
+    auto& f = *store_[frame_id].g;
+
+    return lod_table::select({ f.segments.data(), static_cast<std::size_t>(f.level_count) }, main_->get_scale() / scale_angstroms);
+  }
+
+
+  void show(int frame_id) noexcept
+  {
+    blending_    = false;
+    shown_frame_ = frame_id;
+    shown_level_ = get_level(frame_id);
+
+    auto& l = store_[frame_id].g->levels[shown_level_];
+
+    widget_object_->set_model(&l.vertex, l.colors);
+    widget_object_->add_model(&l.vertex_strip, l.strip_colors);
+
+    set_impostors(frame_id);
+  }
+
+
+  // whether frames a and b have their shown level of detail with the same vertices, so can be blended
+
+  bool can_blend(int a, int b) const noexcept
+  {
+    if (b < 0 || b >= static_cast<int>(store_.size()))
+      return false;
+
+    if (!store_[a].g || !store_[b].g)
+      return false;
+
+    auto& fa = *store_[a].g;
+    auto& fb = *store_[b].g;
+
+    if (fa.level_count != fb.level_count || shown_level_ >= fa.level_count)
+      return false;
+
+    auto& la = fa.levels[shown_level_];
+    auto& lb = fb.levels[shown_level_];
+
+    auto kept = [] (const level& l) // for the cpu
+    {
+      return l.vertex_data.size() == static_cast<std::size_t>(l.vertex.count_) &&
+                                          l.vertex_strip_data.size() == static_cast<std::size_t>(l.vertex_strip.count_);
+    };
+
+    return lb.vertex.is_ready() && la.vertex.count_ == lb.vertex.count_ && la.vertex_strip.count_ == lb.vertex_strip.count_ &&
+                                          (main_->get_interpolation() == interpolation::shader || (kept(la) && kept(lb)));
+  }
+
+
+  // draw the shown frame blended towards the one playback is heading for, if it has the same vertices: on the gpu,
+  // or into blend_ on the cpu, along a spline through the frames either side if they do too
+
+  void blend() noexcept
+  {
+    auto mode = main_->get_interpolation();
+
+    if (mode == interpolation::none || shown_frame_ < 0 || !widget_object_)
+      return;
+
+    auto [next, t] = main_->get_blend();
+
+    if (shown_frame_ != main_->get_current_frame() || t <= 0.0f || !can_blend(shown_frame_, next))
+    {
+      if (blending_)
+        show(shown_frame_);
+
+      return;
+    }
+
+    auto& a = store_[shown_frame_].g->levels[shown_level_];
+    auto& b = store_[next].g->levels[shown_level_];
+
+    if (mode == interpolation::shader)
+    {
+      widget_object_->set_blend({ &b.vertex, &b.vertex_strip }, t);
+    }
+    else
+    {
+      auto prev  = shown_frame_ - (next - shown_frame_);
+      auto after = next + (next - shown_frame_);
+
+      bool spline = mode == interpolation::hermite && can_blend(shown_frame_, prev) && can_blend(shown_frame_, after);
+
+      auto stream = [&] (std::vector<vert> level::* data, plate::buffer<vert> level::* buf, int gl_mode)
+      {
+        auto& out = blend_data_;
+
+        out.resize((a.*data).size());
+
+        if (spline)
+          frame_blend::hermite<vert>(store_[prev].g->levels[shown_level_].*data, a.*data, b.*data,
+                                                                  store_[after].g->levels[shown_level_].*data, t, out);
+        else
+          frame_blend::linear<vert>(a.*data, b.*data, t, out);
+
+        (blend_.*buf).stream(out.data(), out.size(), gl_mode);
+      };
+
+      stream(&level::vertex_data,       &level::vertex,       GL_TRIANGLES);
+      stream(&level::vertex_strip_data, &level::vertex_strip, GL_TRIANGLE_STRIP);
+
+      widget_object_->set_model(&blend_.vertex, a.colors);
+      widget_object_->add_model(&blend_.vertex_strip, a.strip_colors);
+    }
+
+    blending_ = true;
+  }
+
+
+  struct impostor_spans
+  {
+    std::span<const plate::widget_spheres::inst>   spheres;
+    std::span<const plate::widget_cylinders::inst> cylinders;
+  };
+
+
+  // the impostors following the strips of geometry d, none if it has none or they do not fit it
+
+  impostor_spans get_impostors(std::span<const char> d, std::size_t vertex_size = sizeof(vert) + sizeof(vert_color)) const noexcept
+  {
+    auto h = reinterpret_cast<const compact_header*>(d.data());
+
+    auto start = sizeof(compact_header) + (static_cast<std::size_t>(h->num_triangles) + h->num_strips) * vertex_size;
+
+    if (d.size() < start + sizeof(impostor_header))
+      return {};
+
+    auto ih = reinterpret_cast<const impostor_header*>(d.data() + start);
+
+    if (ih->num_spheres < 0 || ih->num_cylinders < 0 || d.size() != start + sizeof(impostor_header) +
+                                                         ih->num_spheres * sizeof(plate::widget_spheres::inst) +
+                                                         ih->num_cylinders * sizeof(plate::widget_cylinders::inst))
+    {
+      log_debug(FMT_COMPILE("bad impostors in geometry of size: {}"), d.size());
+      return {};
+    }
+
+    auto s = reinterpret_cast<const plate::widget_spheres::inst*>(d.data() + start + sizeof(impostor_header));
+    auto c = reinterpret_cast<const plate::widget_cylinders::inst*>(s + ih->num_spheres);
+
+    return { { s, static_cast<std::size_t>(ih->num_spheres) }, { c, static_cast<std::size_t>(ih->num_cylinders) } };
+  }
+
+
+  void upload_impostors(geometry& f, std::span<const char> d, std::size_t vertex_size) noexcept
+  {
+    auto i = get_impostors(d, vertex_size);
+
+    f.spheres.upload(i.spheres.data(), i.spheres.size());
+    f.cylinders.upload(i.cylinders.data(), i.cylinders.size());
+  }
+
+
+  // draw the impostors of a frame, if it has any
+
+  void set_impostors(int frame_id) noexcept
+  {
+    auto& f = *store_[frame_id].g;
+
+    if (widget_spheres_)
+    {
+      if (f.spheres.count_)
+        widget_spheres_->set_instance_ptr(&f.spheres, &f.spheres_vao);
+      else
+        widget_spheres_->set_instance_ptr(nullptr, nullptr);
+    }
+
+    if (widget_cylinders_)
+    {
+      if (f.cylinders.count_)
+        widget_cylinders_->set_instance_ptr(&f.cylinders, &f.cylinders_vao);
+      else
+        widget_cylinders_->set_instance_ptr(nullptr, nullptr);
+    }
+  }
+
+
   void process_frame() noexcept
   {
     ++loaded_count_;
@@ -311,6 +913,13 @@ private:
   void clear()
   {
     store_.clear();
+    by_hash_.clear();
+
+    shown_frame_ = -1;
+    blending_    = false;
+
+    std::queue<int> r;
+    r.swap(to_recolor_);
 
     std::queue<int> x;
     x.swap(to_load_);
@@ -318,32 +927,65 @@ private:
     loaded_count_ = 0;
 
     script_.clear();
+    coarse_script_.clear();
+
+    progressive_ = false;
 
     if (widget_object_)
     {
       widget_object_->disconnect_from_parent();
       widget_object_.reset();
     }
+
+    if (widget_spheres_)
+    {
+      widget_spheres_->disconnect_from_parent();
+      widget_spheres_.reset();
+    }
+
+    if (widget_cylinders_)
+    {
+      widget_cylinders_->disconnect_from_parent();
+      widget_cylinders_.reset();
+    }
   }
 
 
-  std::shared_ptr<plate::widget_object<vert_with_color>> widget_object_;
+  std::shared_ptr<plate::widget_object<vert, vert_color>> widget_object_;
+  std::shared_ptr<plate::widget_spheres>                 widget_spheres_;
+  std::shared_ptr<plate::widget_cylinders>               widget_cylinders_;
 
-  struct frame
-  {
-    plate::buffer<vert_with_color> vertex;
-    plate::buffer<vert_with_color> vertex_strip;
-  };
+  std::vector<frame> store_; // each frame's geometry is stored here
+
+  std::unordered_map<std::uint64_t, std::weak_ptr<geometry>> by_hash_; // geometry by the hash of its result
+
+  int shown_frame_{-1}; // the frame given to the widgets, and its level
+  int shown_level_{0};
 
-  std::vector<frame> store_; // each frame's vertex and vertex_strip buffer is stored here
+  bool                         blending_{false}; // drawing between shown_frame_ and the next
+  level                        blend_;           // the vertices blended on the cpu
+  std::vector<vert>            blend_data_;
 
-  std::queue<int> to_load_; // the order in which to request frames
+  std::queue<int> to_load_;    // the order in which to request frames
+  std::queue<int> to_recolor_; // frames to request again with their colours
   int loaded_count_{0};
 
   std::string script_; // the molauto script in use
 
+  static constexpr int coarse_segments = 2; // of the first pass of progressive loading
+
+  // the angstroms the scale is the size of on screen. molscript (res_ in vertex.c) writes coordinates as shorts
+  // of 32768 / 400 = 81.92 to the angstrom, which are drawn as -1 to 1, so the scale spans 400 angstroms
+  static constexpr float scale_angstroms = 400.0f;
+
+  bool        progressive_{false}; // load every frame coarse then refine, if the script's segments can be lowered
+  std::string coarse_script_;
+
   M* main_{nullptr}; // tha main widget
 
+  std::shared_ptr<const frame_source> frames_; // where the frames come from, shared with main
+  std::shared_ptr<const frame_source> baked_;  // baked geometry of the frames, if available
+
 }; // class widget_layer_cartoon
 
 
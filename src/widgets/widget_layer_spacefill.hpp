@@ -1,6 +1,8 @@
 #pragma once
 
 #include <array>
+#include <memory>
+#include <unordered_map>
 #include <type_traits>
 
 #include "plate.hpp"
@@ -9,6 +11,8 @@
 #include "widgets/anim_alpha.hpp"
 
 #include "widget_layer.hpp"
+#include "frame_source.hpp"
+#include "../worker/geometry_bounds.hpp"
 
 
 namespace animol {
@@ -45,23 +49,27 @@ public:
 
   inline bool has_frame(int frame_id) noexcept override
   {
+    auto ready = [frame_id, this] (int layer) { return store_[layer][frame_id] && store_[layer][frame_id]->ibuf.is_ready(); };
+
     if (main_->is_remote())
-      return store_[0][frame_id].ibuf.is_ready() && store_[1][frame_id].ibuf.is_ready();
+      return ready(0) && ready(1);
     else
-      return store_[0][frame_id].ibuf.is_ready();
+      return ready(0);
   }
 
 
   bool set_frame(int frame_id) noexcept override
   {
+    trace_zone("layer_spacefill::set_frame");
+
     if (!has_frame(frame_id))
       return false;
 
     if (widget_spheres_[0])
-      widget_spheres_[0]->set_instance_ptr(&(store_[0][frame_id].ibuf), &(store_[0][frame_id].vao));
+      widget_spheres_[0]->set_instance_ptr(&(store_[0][frame_id]->ibuf), &(store_[0][frame_id]->vao));
 
     if (widget_spheres_[1])
-      widget_spheres_[1]->set_instance_ptr(&(store_[1][frame_id].ibuf), &(store_[1][frame_id].vao));
+      widget_spheres_[1]->set_instance_ptr(&(store_[1][frame_id]->ibuf), &(store_[1][frame_id]->vao));
 
     return true;
   }
@@ -80,7 +88,9 @@ private:
   {
     clear();
 
-    if (main_->get_total_frames() <= 0)
+    frames_ = main_->get_frames();
+
+    if (main_->get_total_frames() <= 0 || !frames_)
       return;
 
     widget_spheres_[0] = plate::ui_event_destination::make_ui<plate::widget_spheres>(this->ui_, this->coords_,
@@ -114,68 +124,87 @@ private:
     auto to_load = to_load_.front();
     to_load_.pop();
 
-    auto per_frame_files = main_->get_frame_files();
+    auto fns = get_atoms_fns();
 
     if (!main_->is_remote())
     {
-      main_->worker_->call("visualise_atoms_url", per_frame_files[to_load], [this, wself{this->weak_from_this()}, entry = to_load] (std::span<char> d)
+      main_->call_frame_cached(frames_, to_load, 0, fns[0], fns[1], fns[2], {}, [this, wself{this->weak_from_this()}, entry = to_load]
+                                                                                            (std::span<const char> d)
       {
         if (auto w = wself.lock())
         {
           emscripten_webgl_make_context_current(this->ui_->ctx_);
 
-          std::span<plate::widget_spheres::inst> s(reinterpret_cast<plate::widget_spheres::inst*>(d.data()), d.size() /
-                                                                                         sizeof(plate::widget_spheres::inst));
-
-          process_frame(entry, s, 0);
+          process_frame(entry, d, 0);
         }
       });
     }
     else // remote
     {
-      std::string u1 = main_->get_url() + main_->get_item() + "/" + per_frame_files[to_load];
-      std::string u2 = main_->get_url() + main_->get_item() + "/nonCA_" + per_frame_files[to_load];
-
-      main_->worker_->call("visualise_atoms_url", u1, [this, wself{this->weak_from_this()}, entry = to_load] (std::span<char> d)
+      main_->call_frame_cached(frames_, to_load, 0, fns[0], fns[1], fns[2], {}, [this, wself{this->weak_from_this()}, entry = to_load]
+                                                                                            (std::span<const char> d)
       {
         if (auto w = wself.lock())
         {
           emscripten_webgl_make_context_current(this->ui_->ctx_);
 
-          std::span<plate::widget_spheres::inst> s(reinterpret_cast<plate::widget_spheres::inst*>(d.data()), d.size() /
-                                                                                         sizeof(plate::widget_spheres::inst));
-
-          process_frame(entry, s, 0);
+          process_frame(entry, d, 0);
         }
       });
 
-      main_->worker_->call("visualise_atoms_url", u2, [this, wself{this->weak_from_this()}, entry = to_load] (std::span<char> d)
+      main_->call_frame_cached(frames_, to_load, 1, fns[0], fns[1], fns[2], {}, [this, wself{this->weak_from_this()}, entry = to_load]
+                                                                                            (std::span<const char> d)
       {
         if (auto w = wself.lock())
         {
           emscripten_webgl_make_context_current(this->ui_->ctx_);
 
-          std::span<plate::widget_spheres::inst> s(reinterpret_cast<plate::widget_spheres::inst*>(d.data()), d.size() /
-                                                                                         sizeof(plate::widget_spheres::inst));
-
-          process_frame(entry, s, 1);
+          process_frame(entry, d, 1);
         }
       });
     }
   }
 
 
-  void process_frame(int entry, std::span<plate::widget_spheres::inst> s, int layer) noexcept
+  // the worker functions for atoms from a url, from contents or from an atom table, in spatial order if the viewer
+  // asks for it. those from a url or contents return the atom table only if another layer will use it
+
+  std::array<const char*, 3> get_atoms_fns() const noexcept
   {
+    const bool table = main_->shares_atom_tables();
+
+    if (main_->get_spatial_order())
+      return { table ? "visualise_atoms_url_sorted_with_table"      : "visualise_atoms_url_sorted",
+               table ? "visualise_atoms_contents_sorted_with_table" : "visualise_atoms_contents_sorted", "visualise_atoms_table_sorted" };
+
+    return { table ? "visualise_atoms_url_with_table"      : "visualise_atoms_url",
+             table ? "visualise_atoms_contents_with_table" : "visualise_atoms_contents", "visualise_atoms_table" };
+  }
+
+
+  // d is the atoms as instances, then their bounds
+
+  void process_frame(int entry, std::span<const char> d, int layer) noexcept
+  {
+    auto bounds = geometry_bounds::strip(d);
+
+    std::span<const plate::widget_spheres::inst> s(reinterpret_cast<const plate::widget_spheres::inst*>(d.data()), d.size() /
+                                                                                   sizeof(plate::widget_spheres::inst));
+
     if (!main_->scale_has_been_set() && !s.empty())
     {
       int max = 0;
 
-      for (auto& s_entry : s)
-      { 
-        if (abs(s_entry.offset[0]) > max) max = abs(s_entry.offset[0]);
-        if (abs(s_entry.offset[1]) > max) max = abs(s_entry.offset[1]);
-        if (abs(s_entry.offset[2]) > max) max = abs(s_entry.offset[2]);
+      if (bounds)
+        max = geometry_bounds::get_extent(*bounds);
+      else
+      {
+        for (auto& s_entry : s)
+        {
+          if (abs(s_entry.offset[0]) > max) max = abs(s_entry.offset[0]);
+          if (abs(s_entry.offset[1]) > max) max = abs(s_entry.offset[1]);
+          if (abs(s_entry.offset[2]) > max) max = abs(s_entry.offset[2]);
+        }
       }
 
       log_debug(FMT_COMPILE("received: {} atoms max width: {}"), s.size(), max);
@@ -184,7 +213,23 @@ private:
         main_->set_scale((std::min(this->my_width(), this->my_height())/2.0) * (32'768.0 / max) * 0.8);
     }
 
-    store_[layer][entry].ibuf.upload(s.data(), s.size());
+    // atoms identical to a frame's already uploaded share its instances
+
+    auto& f = store_[layer][entry];
+
+    if (auto it = by_hash_.find(bounds ? bounds->hash : 0); it != by_hash_.end())
+      f = it->second.lock();
+
+    if (!f)
+    {
+      f = std::make_shared<instances>();
+
+      f->ibuf.set_tag(name(), entry, layer ? "instances remote" : "instances");
+      f->ibuf.upload(s.data(), s.size());
+
+      if (bounds)
+        by_hash_[bounds->hash] = f;
+    }
 
     if (main_->get_current_frame() == entry) // we've caught up with main frame position
       set_frame(entry);
@@ -221,35 +266,43 @@ private:
       widget_spheres_[1].reset();
     }
 
-    for (auto& s : store_[0])
-      if (s.vao)
-        glDeleteVertexArrays(1, &s.vao);
-
     store_[0].clear();
-    
-    for (auto& s : store_[1])
-      if (s.vao)
-        glDeleteVertexArrays(1, &s.vao);
-
     store_[1].clear();
+
+    by_hash_.clear();
   }
 
 
   std::shared_ptr<plate::widget_spheres> widget_spheres_[2];
 
-  struct frame
+  // the instances of a frame, shared by frames with identical atoms and reference counted by them
+
+  struct instances
   {
+    instances() = default;
+    instances(const instances&) = delete;
+
+    ~instances()
+    {
+      if (vao)
+        glDeleteVertexArrays(1, &vao);
+    }
+
     plate::buffer<plate::widget_spheres::inst> ibuf;
     std::uint32_t                              vao{0};
   };
 
-  std::vector<frame> store_[2]; // each frame's vertex and vertex_strip buffer is stored here
+  std::vector<std::shared_ptr<instances>> store_[2]; // each frame's instances are stored here
+
+  std::unordered_map<std::uint64_t, std::weak_ptr<instances>> by_hash_; // instances by the hash of their atoms
 
   std::queue<int> to_load_; // the order in which to request frames
   int loaded_count_{0};
 
   M* main_{nullptr}; // tha main widget
 
+  std::shared_ptr<const frame_source> frames_; // where the frames come from, shared with main
+
 }; // class widget_layer_spacefill
 
 
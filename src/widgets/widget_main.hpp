@@ -26,7 +26,16 @@
 #include "widget_menu_projection_button.hpp"
 #include "widget_menu_layer.hpp"
 
+#include "frame_source.hpp"
+#include "frame_blend.hpp"
+#include "atom_cache.hpp"
+#include "result_cache.hpp"
+
 #include "../worker/dcd2pdb.hpp"
+#include "../worker/xtc2pdb.hpp"
+#include "../worker/amtraj.hpp"
+#include "../worker/inflate.hpp"
+#include "../worker/decode_stats.hpp"
 
 // c++23 std::to_underlying funtion
 // should be in #include <utility>
@@ -107,19 +116,13 @@ public:
       {
         master_frame_id_ = 0;
         current_entry_   = 0;
-        total_frames_    = 1;
-        playing_         = false;
-
-        per_frame_files_.push_back(item_);
 
         item_            = item_.substr(0, item_.size() - 4);
 
-        auto l = ui_event_destination::make_ui<widget_layer_cartoon<widget_main>>(ui_, coords_, widget_object_, this);
-
-        layers_.push_back(l);
+        start_single(std::make_shared<frame_source_single>(url_ + item_ + "/", code, false));
       }
       else
-        load_movie_plan();
+        load_frames();
 
       set_title();
     }
@@ -132,6 +135,8 @@ public:
 
   void display() noexcept
   {
+    trace_zone("widget_main::display");
+
     if (current_entry_ < 0 || !playing_ || total_frames_ <= 1)
       return;
 
@@ -224,6 +229,20 @@ public:
   }
 
 
+  // the frame playback is heading for and how far there it is, from 0 to 1, for drawing between frames. at the
+  // ends playback waits a frame before turning, so it is heading nowhere
+
+  std::pair<int, float> get_blend() const noexcept
+  {
+    auto next = current_entry_ + std::to_underlying(frame_direction_);
+
+    if (current_entry_ < 0 || !playing_ || next < 0 || next >= total_frames_)
+      return { current_entry_, 0.0f };
+
+    return { next, std::min(1.0f, current_time_ / frame_time_) };
+  }
+
+
   inline bool has_frame() const noexcept
   {
     return total_frames_ > 0;
@@ -241,6 +260,8 @@ public:
     current_time_ = 0;
     current_entry_ = frame;
 
+    trace_counter("frame", current_entry_);
+
     for (auto& l : layers_)
       l->set_frame(current_entry_);
   
@@ -301,6 +322,75 @@ public:
   }
 
 
+  // whether cartoons are decoded with levels of detail, drawn by zoom
+
+  inline bool get_lod() const noexcept
+  {
+    return lod_;
+  }
+
+  constexpr void set_lod(const bool l) noexcept
+  {
+    lod_ = l;
+  }
+
+
+  // whether spacefill atoms are sorted into spatial order
+
+  inline bool get_spatial_order() const noexcept
+  {
+    return spatial_order_;
+  }
+
+  constexpr void set_spatial_order(const bool s) noexcept
+  {
+    spatial_order_ = s;
+  }
+
+
+  // whether frames are decoded with their atom tables, kept for another layer to make its representation from:
+  // if the dataset lists more than one layer to switch between, or more than one layer is still loading
+
+  bool shares_atom_tables() const noexcept
+  {
+    if (layers_config_.size() > 1)
+      return true;
+
+    int loading = 0;
+
+    for (auto& l : layers_)
+      loading += l->get_loaded_count() < total_frames_;
+
+    return loading > 1;
+  }
+
+
+  // whether cartoon frames are all loaded coarse before being refined from the playhead out
+
+  inline bool get_progressive() const noexcept
+  {
+    return progressive_;
+  }
+
+  constexpr void set_progressive(const bool p) noexcept
+  {
+    progressive_ = p;
+  }
+
+
+  // how cartoons are drawn between frames while playing
+
+  inline interpolation get_interpolation() const noexcept
+  {
+    return interpolation_;
+  }
+
+  constexpr void set_interpolation(const interpolation i) noexcept
+  {
+    interpolation_ = i;
+  }
+
+
   inline const std::string& get_item() const noexcept
   {
     return item_;
@@ -313,9 +403,116 @@ public:
   }
 
 
-  inline const std::vector<std::string>& get_frame_files() const noexcept
+  // the source of frames, shared with the layers. null until known
+
+  inline std::shared_ptr<const frame_source> get_frames() const noexcept
+  {
+    return frames_;
+  }
+
+
+  // baked cartoon geometry for frames_, null if there is none
+
+  inline std::shared_ptr<const frame_source> get_baked() const noexcept
+  {
+    return baked_;
+  }
+
+
+  // call the worker on part of frame from frames (0 the frame, 1 its nonCA_ companion) with data appended to head.
+  // data is the frame descriptor for url_fn, or for packed sources the frame contents for contents_fn
+
+  void call_frame(const std::shared_ptr<const frame_source>& frames, int frame, int part, const char* url_fn,
+               const char* contents_fn, std::vector<char> head, std::function< void (std::span<const char>)>&& cb) noexcept
   {
-    return per_frame_files_;
+    if (!frames->is_packed())
+    {
+      std::string u = frames->get(frame, part ? "nonCA_" : "");
+
+      head.insert(head.end(), u.begin(), u.end());
+
+      call_worker_cached(url_fn, head, std::move(cb));
+      return;
+    }
+
+    frames->fetch(frame, part, [this, wself{weak_from_this()}, contents_fn, head{std::move(head)}, cb{std::move(cb)}]
+                                                                                 (std::span<const char> d) mutable
+    {
+      if (auto p = wself.lock(); p && worker_)
+      {
+        head.insert(head.end(), d.begin(), d.end());
+
+        call_worker_cached(contents_fn, head, std::move(cb));
+      }
+    });
+  }
+
+
+  // call_frame for a representation of a frame: from its kept atom table with table_fn, otherwise with url_fn
+  // or contents_fn, keeping the table they return if they were asked for it
+
+  void call_frame_cached(const std::shared_ptr<const frame_source>& frames, int frame, int part, const char* url_fn,
+      const char* contents_fn, const char* table_fn, std::vector<char> head, std::function< void (std::span<const char>)>&& cb) noexcept
+  {
+    if (atom_cache_.append_to(frames, frame, part, head))
+    {
+      call_worker_cached(table_fn, head, std::move(cb));
+      return;
+    }
+
+    call_frame(frames, frame, part, url_fn, contents_fn, std::move(head), [this, wself{weak_from_this()}, frames, frame, part,
+                                                                                  cb{std::move(cb)}] (std::span<const char> d)
+    {
+      if (auto t = atom_table::strip(d); t && wself.lock() && frames == frames_)
+        atom_cache_.add(frames, frame, part, *t);
+
+      cb(d);
+    });
+  }
+
+
+  // call fname on a worker, recording the statistics trailer of the response before passing on the rest
+
+  template<class DATA>
+  void call_worker(const char* fname, DATA& data, std::function< void (std::span<char>)>&& cb) noexcept
+  {
+    worker_->call(fname, data, [this, wself{weak_from_this()}, start = emscripten_get_now(), cb{std::move(cb)}] (std::span<char> d)
+    {
+      if (auto t = decode_stats::strip(d); t && wself.lock())
+        decode_stats_.add(*t, emscripten_get_now() - start);
+
+      cb(d);
+    });
+  }
+
+
+  // call_worker for a frame, answered from results_ if the same call has been made
+
+  template<class DATA>
+  void call_worker_cached(const char* fname, DATA& data, std::function< void (std::span<const char>)>&& cb) noexcept
+  {
+    auto key = result_cache::get_key(fname, data);
+
+    if (results_.wait(key, std::move(cb)))
+      return;
+
+    call_worker(fname, data, [this, wself{weak_from_this()}, key] (std::span<char> d)
+    {
+      if (wself.lock())
+        results_.add(key, d);
+    });
+  }
+
+
+  // decodes the geometry deltas of a frame bundle on a worker
+
+  frame_source_bundle::decoder get_delta_decoder() noexcept
+  {
+    return [this, wself{weak_from_this()}] (std::vector<char>& data, std::function<void (std::span<char>)>&& cb)
+    {
+      if (auto p = wself.lock(); p && worker_)
+        call_worker("decode_delta", data, std::move(cb));
+    };
   }
 
 
@@ -439,6 +636,15 @@ public:
         return;
       }
 
+      if (code_utf8 == "KeyM") // toggle memory overlay
+      {
+        show_memory_ = !show_memory_;
+
+        update_memory();
+
+        return;
+      }
+
       if (code_utf8 == "KeyS") // test print style json
       {
         std::string s = fmt::format(FMT_COMPILE("{:s}"), *this);
@@ -502,6 +708,8 @@ public:
   {
     ui_->do_draw();
 
+    update_memory();
+
     std::string loading = loading_error_;
 
     if (loading.empty())
@@ -567,6 +775,9 @@ public:
   }
 
 
+  // start a local trajectory, dcd_url can be either a dcd or a gromacs xtc file, or an amt file which
+  // holds its own topology so psf_url is not used
+
   void start_local_dcd(std::string& psf_url, std::string& dcd_url) noexcept
   {
     clear();
@@ -579,7 +790,6 @@ public:
     current_entry_   = 0;
     current_time_    = 0;
     total_frames_    = 0;
-    per_frame_files_.clear();
 
     // first - parse the dcd header to extract the basic info needed: "number_frames, number_atoms, start_offset"
 
@@ -591,6 +801,49 @@ public:
       {
         emscripten_webgl_make_context_current(this->ui_->ctx_);
 
+        if (inflate::is_compressed(d.span())) // frames are read by range, so the dcd itself has to be uncompressed
+        {
+          log_debug("dcd file is compressed");
+          set_error("compressed dcd files are not supported");
+          return;
+        }
+
+        if (amtraj::is_amtraj(d.span()))
+        {
+          auto h = amtraj::read_header(d.span());
+
+          if (!h || h->number_frames == 0)
+          {
+            log_debug(FMT_COMPILE("failed to extract amt header, size: {} status: {}"), d.size(), status);
+            set_error("failed to extract amt header");
+            return;
+          }
+
+          frames_       = std::make_shared<frame_source_amt>(dcd_url, h->number_frames);
+          total_frames_ = h->number_frames;
+
+          start_local_frames();
+          return;
+        }
+
+        if (xtc2pdb::is_xtc(d.span()))
+        {
+          auto h = xtc2pdb::read_header(d.span());
+
+          if (!h)
+          {
+            log_debug(FMT_COMPILE("failed to extract xtc header, size: {} status: {}"), d.size(), status);
+            set_error("failed to extract xtc header");
+            return;
+          }
+
+          xtc_offsets_.clear();
+          xtc_sizes_.clear();
+
+          scan_xtc(psf_url, dcd_url, h->number_atoms, 0, d.span(), status);
+          return;
+        }
+
         auto info = dcd2pdb::get_dcd_data_info(d.span());
 
         if (!info)
@@ -600,41 +853,141 @@ public:
           return;
         }
 
-        json_handler_struct<dcd2pdb::interface> msg;
-        msg.data.psf_url = psf_url;
-        msg.data.dcd_url = dcd_url;
+        frames_       = std::make_shared<frame_source_dcd>(psf_url, dcd_url, *info);
+        total_frames_ = info->number_frames;
+
+        start_local_frames();
+      }
+    }, [this, wself{weak_from_this()}] (std::size_t error_code, int error_msg)
+    {
+      if (auto p = wself.lock())
+      {
+        log_debug(FMT_COMPILE("failed to download dcd header, error_code: {} msg: {}"), error_code, error_msg);
+        set_error("failed to download dcd header");
+      }
+    });
+  }
+
 
-        msg.data.number_atoms    = info->number_atoms;
-        msg.data.dcd_data_offset = info->start_offset;
+  /*
+      xtc frames are compressed so vary in size. build an index of frame offsets by scanning the frame
+      headers, fetching a window of the file at a time. once frames are known to be large only each
+      header is fetched. data holds the window starting at offset (or the whole file if the range was ignored)
+  */
 
-        for (int i = 0; i < info->number_frames; ++i)
-        {
-          msg.data.frame = i;
+  void scan_xtc(std::string psf_url, std::string xtc_url, int number_atoms, std::uint64_t offset,
+                                                          std::span<const std::byte> data, std::uint16_t status) noexcept
+  {
+    std::uint64_t next;
+
+    if (status == 200) // range ignored, so data is the whole file
+      next = xtc2pdb::scan(data.subspan(std::min<std::uint64_t>(offset, data.size())), offset, number_atoms, xtc_offsets_, xtc_sizes_);
+    else
+      next = xtc2pdb::scan(data, offset, number_atoms, xtc_offsets_, xtc_sizes_);
 
-          auto url = msg.to_json(); // not really a url..
+    if (status != 200 && next != offset) // more to scan
+    {
+      std::uint64_t window = xtc_sizes_.back() < 65536 ? 1024 * 1024 : xtc2pdb::header_size;
+
+      xtc_range_query_ = fmt::format(FMT_COMPILE("bytes={}-{}"), next, next + window - 1);
+
+      const char* headers[] = {"Range", xtc_range_query_.data(), NULL};
+
+      plate::async::fetch_get(xtc_url, headers, [this, wself{weak_from_this()}, psf_url, xtc_url, number_atoms, next]
+                                                              (std::size_t counter, plate::data_store&& d, std::uint16_t status)
+      {
+        if (auto p = wself.lock())
+        {
+          emscripten_webgl_make_context_current(this->ui_->ctx_);
 
-          per_frame_files_.push_back(url);
+          if (status == 416 || d.size() == 0) // past the end of the file
+            finish_xtc(psf_url, xtc_url, number_atoms);
+          else
+            scan_xtc(psf_url, xtc_url, number_atoms, next, d.span(), status);
+        }
+      }, [this, wself{weak_from_this()}, psf_url, xtc_url, number_atoms] (std::size_t error_code, int error_msg)
+      {
+        if (auto p = wself.lock())
+        {
+          log_debug(FMT_COMPILE("xtc scan ended, error_code: {} msg: {}"), error_code, error_msg);
+          finish_xtc(psf_url, xtc_url, number_atoms);
         }
+      });
 
-        total_frames_ = info->number_frames;
+      return;
+    }
 
-        auto l = ui_event_destination::make_ui<widget_layer_cartoon<widget_main>>(ui_, coords_, widget_object_, this);
+    finish_xtc(psf_url, xtc_url, number_atoms);
+  }
 
-        layers_.push_back(l);
 
-        log_debug(FMT_COMPILE("starting local dcd frames: {}"), total_frames_);
+  void finish_xtc(const std::string& psf_url, const std::string& xtc_url, int number_atoms) noexcept
+  {
+    if (xtc_offsets_.empty())
+    {
+      log_debug("no frames found in xtc file");
+      set_error("no frames found in xtc file");
+      return;
+    }
 
-        set_title();
+    total_frames_ = xtc_offsets_.size();
 
-        if (auto w = widget_control_.lock())
-          w->update_status();
-      }
-    }, [this, wself{weak_from_this()}] (std::size_t error_code, int error_msg)
+    frames_ = std::make_shared<frame_source_xtc>(psf_url, xtc_url, number_atoms, std::move(xtc_offsets_), std::move(xtc_sizes_));
+
+    xtc_offsets_.clear();
+    xtc_sizes_.clear();
+
+    start_local_frames();
+  }
+
+
+  void start_local_frames() noexcept
+  {
+    auto l = ui_event_destination::make_ui<widget_layer_cartoon<widget_main>>(ui_, coords_, widget_object_, this);
+
+    layers_.push_back(l);
+
+    log_debug(FMT_COMPILE("starting local {} frames: {}"), item_, total_frames_);
+
+    set_title();
+
+    if (auto w = widget_control_.lock())
+      w->update_status();
+  }
+
+
+  /*
+      a single structure file may hold a trajectory as MODEL records. single fetches the file once and keeps
+      it, giving the workers its models, played if there is more than one, or otherwise the whole file as a
+      single frame.
+  */
+
+  void start_single(std::shared_ptr<frame_source_single> single) noexcept
+  {
+    frames_       = single; // released by clear() if replaced while the file is fetched
+    total_frames_ = 0;
+
+    single->open([this, wself{weak_from_this()}, s = single.get()] (int number_frames)
     {
       if (auto p = wself.lock())
       {
-        log_debug(FMT_COMPILE("failed to download dcd header, error_code: {} msg: {}"), error_code, error_msg);
-        set_error("failed to download dcd header");
+        if (frames_.get() != s)
+          return;
+
+        emscripten_webgl_make_context_current(this->ui_->ctx_);
+
+        if (number_frames == 0)
+        {
+          set_error(fmt::format(FMT_COMPILE("unable to load: {}"), s->get(0)));
+          return;
+        }
+
+        total_frames_ = number_frames;
+        playing_      = number_frames > 1;
+
+        log_debug(FMT_COMPILE("single file: {} frames: {}"), s->get(0), number_frames);
+
+        start_local_frames();
       }
     });
   }
@@ -648,10 +1001,17 @@ public:
     description_     = "";
     url_             = "";
     item_            = dir_name;
-    per_frame_files_ = files;
     master_frame_id_ = 0;
     current_entry_   = 0;
     current_time_    = 0;
+
+    if (files.size() == 1)
+    {
+      start_single(std::make_shared<frame_source_single>("", files[0], true));
+      return;
+    }
+
+    frames_          = std::make_shared<frame_source_files>("", files, true);
     total_frames_    = files.size();
 
     auto l = ui_event_destination::make_ui<widget_layer_cartoon<widget_main>>(ui_, coords_, widget_object_, this);
@@ -885,7 +1245,7 @@ public:
       layers_config_ = std::move(hl.data);
     }
 
-    load_movie_plan();
+    load_frames();
 
     if (auto w = widget_control_.lock())
     {
@@ -900,6 +1260,168 @@ public:
 private:
 
 
+  /*
+      a dataset is either packed into a single movie.bundle, which is tried first, or is a movie.plan listing a
+      structure file per frame
+  */
+
+  void load_frames() noexcept
+  {
+    fetch_bundle(url_ + item_ + "/movie.bundle", [this] (std::optional<frame_bundle> bundle)
+    {
+      if (!bundle)
+      {
+        load_movie_plan();
+        return;
+      }
+
+      emscripten_webgl_make_context_current(this->ui_->ctx_);
+
+      master_frame_id_ = bundle->get_header().master_frame;
+      total_frames_    = bundle->get_header().number_frames;
+
+      if (master_frame_id_ >= total_frames_)
+        master_frame_id_ = -1;
+
+      frames_ = std::make_shared<frame_source_bundle>(url_ + item_ + "/movie.bundle", std::move(*bundle), get_delta_decoder());
+
+      start_remote_frames("movie.bundle");
+    });
+
+    update_loading();
+  }
+
+
+  // open the frame bundle at url, cb is given nullopt if there isn't one. the start of the file is fetched
+  // first, which normally holds the whole index
+
+  void fetch_bundle(std::string url, std::function<void (std::optional<frame_bundle>)> cb) noexcept
+  {
+    static const char* headers[] = {"Range", "bytes=0-65535", NULL};
+
+    plate::async::fetch_get(url, headers, [this, wself{weak_from_this()}, url, cb]
+                                                             (std::size_t counter, plate::data_store&& d, std::uint16_t status)
+    {
+      if (auto p = wself.lock())
+      {
+        auto h = frame_bundle::read_header(d.span());
+
+        if (h && d.size() < frame_bundle::get_index_end(*h))
+        {
+          bundle_range_query_ = fmt::format(FMT_COMPILE("bytes=0-{}"), frame_bundle::get_index_end(*h) - 1);
+
+          const char* headers[] = {"Range", bundle_range_query_.data(), NULL};
+
+          plate::async::fetch_get(url, headers, [wself, cb] (std::size_t counter, plate::data_store&& d, std::uint16_t status)
+          {
+            if (auto p = wself.lock())
+            {
+              frame_bundle bundle;
+
+              if (bundle.open(d.span()))
+                cb(std::move(bundle));
+              else
+                cb(std::nullopt);
+            }
+          }, [wself, cb] (std::size_t error_code, int error_msg)
+          {
+            log_debug(FMT_COMPILE("unable to load frame bundle index: {}"), error_msg);
+
+            if (auto p = wself.lock())
+              cb(std::nullopt);
+          });
+
+          return;
+        }
+
+        frame_bundle bundle;
+
+        if (h && bundle.open(d.span()))
+          cb(std::move(bundle));
+        else
+          cb(std::nullopt);
+      }
+    }, [wself{weak_from_this()}, cb] (std::size_t error_code, int error_msg)
+    {
+      if (auto p = wself.lock()) // no bundle
+        cb(std::nullopt);
+    });
+  }
+
+
+  // frames_ and master_frame_id_ (-1 for the middle frame) are known, so start the configured layer
+
+  void start_remote_frames(std::string_view from) noexcept
+  {
+    if (total_frames_ == 0)
+    {
+      loading_error_ = fmt::format(FMT_COMPILE("{} contains no frames"), from);
+
+      log_debug(FMT_COMPILE("{}"), loading_error_);
+
+      update_loading();
+
+      return;
+    }
+
+    // if an initial structure wasn't specified, assume it's the middle one
+
+    if (master_frame_id_ == -1)
+      master_frame_id_ = std::max(0, total_frames_ / 2 - 1);
+
+    if (current_entry_ == -1)
+      current_entry_ = master_frame_id_;
+
+    log_debug(FMT_COMPILE("remote has: {} frames, main: {}"), total_frames_, master_frame_id_);
+
+    // use baked cartoon geometry if the dataset has it
+
+    fetch_bundle(url_ + item_ + "/movie.geometry", [this, frames{frames_}] (std::optional<frame_bundle> bundle)
+    {
+      if (frames_ != frames) // another dataset was loaded meanwhile
+        return;
+
+      emscripten_webgl_make_context_current(this->ui_->ctx_);
+
+      if (bundle && bundle->is_geometry() && bundle->is_non_interleaved() &&
+                                                  static_cast<int>(bundle->get_header().number_frames) == total_frames_)
+      {
+        log_debug("using baked geometry");
+
+        baked_ = std::make_shared<frame_source_bundle>(url_ + item_ + "/movie.geometry", std::move(*bundle), get_delta_decoder());
+      }
+
+      start_layers();
+    });
+  }
+
+
+  void start_layers() noexcept
+  {
+    std::shared_ptr<widget_layer<widget_main>> l;
+
+    for (auto& lc : layers_config_)
+      if (lc.display == visible::show)
+      {
+        if (lc.type == "layer_cartoon")
+        {
+          l = ui_event_destination::make_ui<widget_layer_cartoon<widget_main>>(ui_, coords_, widget_object_, this);
+          break;
+        }
+        if (lc.type == "layer_spacefill")
+        {
+          l = ui_event_destination::make_ui<widget_layer_spacefill<widget_main>>(ui_, coords_, widget_object_, this);
+          break;
+        }
+      }
+
+    if (!l)
+      l = ui_event_destination::make_ui<widget_layer_cartoon<widget_main>>(ui_, coords_, widget_object_, this);
+
+    layers_.push_back(l);
+  }
+
+
   void load_movie_plan() noexcept
   {
     auto h = plate::async::request(url_ + item_ + "/movie.plan", "GET", "", [this] (std::uint32_t handle, plate::data_store&& d)
@@ -923,6 +1445,8 @@ private:
 
       std::string_view sv{reinterpret_cast<char*>(d.span().data()), d.span().size()};
 
+      std::vector<std::string> files;
+
       int start;
       int end = -1;
 
@@ -933,57 +1457,18 @@ private:
         // if there's a blank line, the previous line was the initial structure
         if (end == start)
         {
-          master_frame_id_ = std::max(0ul, per_frame_files_.size() - 1);
+          master_frame_id_ = std::max(0ul, files.size() - 1);
           continue;
         }
 
-        per_frame_files_.push_back(std::string(sv.substr(start, end - start)));
-      }
-
-      total_frames_ = per_frame_files_.size();
-
-      if (total_frames_ == 0)
-      {
-        loading_error_ = "movie.plan contains no frames";
-
-        log_debug(FMT_COMPILE("{}"), loading_error_);
-
-        update_loading();
-
-        return;
+        files.push_back(std::string(sv.substr(start, end - start)));
       }
 
-      // if an initial structure wasn't specified, assume it's the middle one
-
-      if (master_frame_id_ == -1)
-        master_frame_id_ = std::max(0, total_frames_ / 2 - 1);
-
-      if (current_entry_ == -1)
-        current_entry_ = master_frame_id_;
-
-      log_debug(FMT_COMPILE("remote has: {} frames, main: {}"), total_frames_, master_frame_id_);
-
-      std::shared_ptr<widget_layer<widget_main>> l;
+      total_frames_ = files.size();
 
-      for (auto& lc : layers_config_)
-        if (lc.display == visible::show)
-        {
-          if (lc.type == "layer_cartoon")
-          {
-            l = ui_event_destination::make_ui<widget_layer_cartoon<widget_main>>(ui_, coords_, widget_object_, this);
-            break;
-          }
-          if (lc.type == "layer_spacefill")
-          {
-            l = ui_event_destination::make_ui<widget_layer_spacefill<widget_main>>(ui_, coords_, widget_object_, this);
-            break;
-          }
-        }
+      frames_ = std::make_shared<frame_source_files>(url_ + item_ + "/", std::move(files), false);
 
-      if (!l)
-        l = ui_event_destination::make_ui<widget_layer_cartoon<widget_main>>(ui_, coords_, widget_object_, this);
-
-      layers_.push_back(l);
+      start_remote_frames("movie.plan");
     },
 
     [this] (std::uint32_t handle, int error_code, std::string error_string)
@@ -1022,16 +1507,24 @@ private:
 
     for (auto& l : layers_)
       if (!l->set_frame(next_entry))
+      {
+        trace_counter("frame not ready", next_entry);
         return; // not yet ready for next frame
+      }
 
     current_time_    = 0;
     current_entry_   = next_entry;
     frame_direction_ = next_frame_direction;
+
+    trace_counter("frame", current_entry_);
   }
 
 
   void clear()
   {
+    atom_cache_.clear();
+    results_.clear();
+
     playing_         = true;
     current_entry_   = -1;
     total_frames_    = 0;
@@ -1041,34 +1534,11 @@ private:
     item_        = "";
     url_         = "";
 
-    if (!is_remote_)
-    {
-      for (auto& f : per_frame_files_)
-      {
-        if (f.size() >= 1) // is this a dcd json url?
-        {
-          if (f[0] == '{')
-          {
-            auto msg = json_parse_struct<dcd2pdb::interface>(f);
+    if (frames_)
+      frames_->release();
 
-            if (msg.ok)
-            {
-              plate::ui_event::clear_file_object(msg.data.psf_url);
-              plate::ui_event::clear_file_object(msg.data.dcd_url);
-            }
-            else
-            {
-              log_debug(FMT_COMPILE("Unable to parse dcd url msg: {}"), f);
-            }
-
-            break; // as all the per_frame_files reference the same two objects/urls
-          }
-        }
-        plate::ui_event::clear_file_object(f);
-      }
-    }
-
-    per_frame_files_.clear();
+    frames_.reset();
+    baked_.reset();
 
     master_frame_id_ = 0;
 
@@ -1097,10 +1567,10 @@ private:
         title = item_;
       else
       {
-        if (per_frame_files_.empty())
+        if (!frames_ || frames_->size() == 0)
           title = "";
         else
-          title = fmt::format(FMT_COMPILE("{} local file{}"), per_frame_files_.size(), per_frame_files_.size() == 1 ? "" : "s");
+          title = fmt::format(FMT_COMPILE("{} local file{}"), frames_->size(), frames_->size() == 1 ? "" : "s");
       }
     }
     else
@@ -1126,8 +1596,106 @@ private:
 
 
 
+  // gpu memory by layer and frame, and the heaps of this module and the workers
+
+  std::string memory_json() const noexcept
+  {
+    auto [heap_size, heap_used] = gpu_memory::get_heap();
+
+    std::string s = fmt::format(FMT_COMPILE(R"({{ "gpu":{{ "bytes":{}, "buffers":{}, "owners":[)"), gpu_memory::get_total(),
+                                                                                                    gpu_memory::get_buffers());
+    bool first = true;
+
+    for (auto& [key, t] : gpu_memory::by_owner())
+    {
+      s += fmt::format(FMT_COMPILE(R"({}{{ "owner":"{}", "usage":"{}", "buffers":{}, "bytes":{} }})"), first ? "" : ", ",
+                                                                                key.first, key.second, t.buffers, t.bytes);
+      first = false;
+    }
+
+    s += R"(], "frames":{)";
+
+    first = true;
+
+    for (auto& l : layers_)
+    {
+      s += fmt::format(FMT_COMPILE(R"({}"{}":[)"), first ? "" : ", ", l->name());
+
+      auto frames = gpu_memory::by_frame(l->name());
+
+      for (std::size_t i = 0; i < frames.size(); ++i)
+        s += fmt::format(FMT_COMPILE("{}{}"), i ? "," : "", frames[i]);
+
+      s += "]";
+      first = false;
+    }
+
+    s += fmt::format(FMT_COMPILE(R"(}} }}, "atom_cache":{{ "tables":{}, "topologies":{}, "bytes":{} }})"), atom_cache_.get_tables(),
+                                                                            atom_cache_.get_topologies(), atom_cache_.get_bytes());
+
+    s += fmt::format(FMT_COMPILE(R"(, "result_cache":{{ "results":{}, "bytes":{}, "hits":{} }})"), results_.get_results(),
+                                                                                results_.get_bytes(), results_.get_hits());
+
+    return s + fmt::format(FMT_COMPILE(R"(, "heap":{{ "size":{}, "used":{}, "worker_high":{} }} }})"), heap_size, heap_used,
+                                                                                            decode_stats_.get_heap_high());
+  }
+
+
+  // the memory overlay, a line at the top left while shown
+
+  void update_memory() noexcept
+  {
+    if (!show_memory_)
+    {
+      if (widget_memory_)
+        widget_memory_->hide();
+
+      return;
+    }
+
+    constexpr double mb = 1024 * 1024;
+
+    auto [heap_size, heap_used] = gpu_memory::get_heap();
+
+    std::string text = fmt::format(FMT_COMPILE("gpu: {:.1f} MB"), gpu_memory::get_total() / mb);
+
+    for (auto& l : layers_)
+    {
+      auto frames = gpu_memory::by_frame(l->name());
+
+      std::size_t total = 0;
+
+      for (auto b : frames)
+        total += b;
+
+      text += fmt::format(FMT_COMPILE(" {}: {:.1f} MB"), l->name(), total / mb);
+    }
+
+    text += fmt::format(FMT_COMPILE(" atoms: {:.1f} MB results: {:.1f} MB"), atom_cache_.get_bytes() / mb, results_.get_bytes() / mb);
+
+    text += fmt::format(FMT_COMPILE(" heap: {:.1f}/{:.1f} MB worker heap: {:.1f} MB"), heap_used / mb, heap_size / mb,
+                                                                                       decode_stats_.get_heap_high() / mb);
+    gpu::int_box c = coords_;
+    c.p1.y = my_height() - (100 * ui_->pixel_ratio_);
+    c.p2.y = my_height() - (70 * ui_->pixel_ratio_);
+
+    if (widget_memory_)
+    {
+      widget_memory_->show();
+      widget_memory_->set_text(text);
+      widget_memory_->set_geometry(c);
+    }
+    else
+      widget_memory_ = ui_event_destination::make_ui<widget_text>(ui_, c, Prop::Display, shared_from_this(), text,
+                                                        gpu::align::LEFT, ui_->txt_color_, gpu::rotation{0.0f,0.0f,0.0f}, 0.5f);
+
+    ui_->do_draw();
+  }
+
+
   std::shared_ptr<plate::widget_text>         widget_title_;
   std::shared_ptr<plate::widget_text>         widget_loading_;
+  std::shared_ptr<plate::widget_text>         widget_memory_;
 
   std::shared_ptr<plate::widget_object<vert_with_color>> widget_object_;
 
@@ -1148,19 +1716,40 @@ private:
 
   bool is_remote_{true};
 
+  bool lod_{false};
+  bool progressive_{false};
+  bool spatial_order_{false};
+
+  interpolation interpolation_{interpolation::none};
+
   std::string description_{}; // description of animation
 
   std::string item_;      // item to load (either a protein code if remote, or a local directory name)
   std::string url_;       // location of remote pdb files
   int json_style_number_; // number of json style used
 
-  std::vector<std::string> per_frame_files_;
+  std::shared_ptr<frame_source> frames_; // shared with the layers
+  std::shared_ptr<frame_source> baked_;  // baked cartoon geometry of the frames, if available
   int master_frame_id_;
 
+  std::vector<std::uint64_t> xtc_offsets_; // frame index built while scanning a local xtc file
+  std::vector<std::uint64_t> xtc_sizes_;
+  std::string xtc_range_query_;
+
+  std::string bundle_range_query_;
+
+  decode_stats decode_stats_; // of worker responses, kept across datasets
+
+  atom_cache atom_cache_; // atom tables of the frames, shared by the layers
+
+  result_cache results_; // of worker calls on frames, for repeated calls
+
   std::vector<std::shared_ptr<widget_layer<widget_main>>> layers_;
 
   bool scale_has_been_set_ = false;
 
+  bool show_memory_{false};
+
   visible visible_control_     {visible::show};
   visible visible_menu_layer_  {visible::show};
   visible visible_menu_option_ {visible::show};
@@ -1206,8 +1795,8 @@ struct fmt::formatter<animol::widget_main>
       return format_to(ctx.out(), FMT_COMPILE(R"({{ "description":"{}", "projection":"{}", "view":{}, "layers":{{ "display":"{}", "type":"{}" }} }})"),
         w.description_, magic_enum::enum_name(w.ui_->projection_.get_view()), *w.widget_object_, "show", w.layers_[0]->is_hidden()?w.layers_[1]->name():w.layers_[0]->name());
     else
-      return format_to(ctx.out(), FMT_COMPILE(R"({{ "protein_db":"{}", "protein_id":"{}", "description":"{}", "projection":"{}", "view":{}, "current_frame":{}, "playing":{}, "direction":"{}", "layers":{{ "display":"{}", "type":"{}" }} }})"),
-        w.url_, w.item_, w.description_, magic_enum::enum_name(w.ui_->projection_.get_view()), *w.widget_object_, w.current_entry_, w.playing_, magic_enum::enum_name(w.frame_direction_), "show", w.layers_[0]->is_hidden()?w.layers_[1]->name():w.layers_[0]->name());
+      return format_to(ctx.out(), FMT_COMPILE(R"({{ "protein_db":"{}", "protein_id":"{}", "description":"{}", "projection":"{}", "view":{}, "current_frame":{}, "playing":{}, "direction":"{}", "layers":{{ "display":"{}", "type":"{}" }}, "stats":{}, "memory":{} }})"),
+        w.url_, w.item_, w.description_, magic_enum::enum_name(w.ui_->projection_.get_view()), *w.widget_object_, w.current_entry_, w.playing_, magic_enum::enum_name(w.frame_direction_), "show", w.layers_[0]->is_hidden()?w.layers_[1]->name():w.layers_[0]->name(), w.decode_stats_, w.memory_json());
 
   }
 };
@@ -190,6 +190,9 @@ protected:
 
     list.push_back("Download data"sv);
     list.push_back("Download QR code"sv);
+#ifdef PLATE_TRACE
+    list.push_back("Download trace"sv);
+#endif
 
     widget_menu_list_->set_text(std::move(list));
 
@@ -227,6 +230,25 @@ protected:
         return;
       }
 
+#ifdef PLATE_TRACE
+      if (s == "Download trace")
+      {
+        auto trace = plate::trace::to_json();
+
+        EM_ASM({
+          var a = document.createElement('a');
+          a.href = URL.createObjectURL(new Blob([UTF8ToString($0, $1)], { type: 'application/json' }));
+          a.download = 'trace.json';
+          a.click();
+          URL.revokeObjectURL(a.href);
+        }, trace.data(), trace.size());
+
+        widget_menu_list_->clear_selection();
+        delete_menu_list();
+        return;
+      }
+#endif
+
     });
 
     auto merged = make_anim_merge(ui_, widget_menu_, widget_menu_list_);
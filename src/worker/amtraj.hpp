@@ -0,0 +1,502 @@
+#pragma once
+
+#include "system/webgl/log.hpp"
+#include "system/common/json/json.hpp"
+
+#include "inflate.hpp"
+
+#include <string_view>
+#include <string>
+#include <span>
+#include <vector>
+#include <optional>
+#include <array>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+
+/*
+    animol trajectory (.amt): a compact, range readable trajectory container
+
+      header      64 bytes, little endian
+      index       one entry per frame giving its byte range, so any frame can be fetched by http Range
+      topology    the psf file, optionally zlib compressed
+      frames      coordinates quantised to 1/precision angstroms. every keyframe_interval frames is a
+                  keyframe storing quantised values directly, other frames store the difference from
+                  their keyframe so errors never accumulate and any frame needs at most two blocks
+
+    each frame block holds x, y and z planes. a plane is an int32 base, a byte width (1, 2 or 4), a
+    predictor byte, two padding bytes, then number_atoms values of that width stored byte planar (all low
+    bytes, then the next bytes..) so the slowly changing high bytes compress well.
+    value = base + sign extended stored value. with the previous atom predictor each value is the
+    difference from the previous atom's, which suits keyframes (bonded atoms are close) and the
+    correlated motion of neighbouring atoms. a block may be zlib compressed as a whole.
+*/
+
+namespace animol {
+
+class amtraj
+{
+
+public:
+
+  static constexpr std::string_view magic = "AMTR";
+  static constexpr std::uint32_t    version = 1;
+
+  enum class frame_flags : std::uint32_t { none = 0, keyframe = 1, deflate = 2 };
+
+  enum class predictor : std::uint8_t { none = 0, previous_atom = 1 };
+
+
+  struct header
+  {
+    char          magic[4];
+    std::uint32_t version;
+    std::uint32_t number_atoms;
+    std::uint32_t number_frames;
+    std::uint32_t keyframe_interval;
+    float         precision;         // quantisation steps per angstrom
+    float         time_step;         // picoseconds between frames, 0 if unknown
+    std::uint32_t reserved;
+    std::uint64_t index_offset;
+    std::uint64_t topology_offset;
+    std::uint64_t topology_size;
+    std::uint64_t frames_offset;
+  };
+
+  static_assert(sizeof(header) == 64);
+
+
+  struct index_entry
+  {
+    std::uint64_t offset;
+    std::uint32_t size;      // bytes stored in the file
+    std::uint32_t raw_size;  // bytes once decompressed
+    std::uint32_t keyframe;  // frame this frame is delta coded against, itself for a keyframe
+    std::uint32_t flags;     // frame_flags
+  };
+
+  static_assert(sizeof(index_entry) == 24);
+
+
+  // interface structure to allow passing key details between processes using json
+
+  struct interface
+  {
+    std::string_view amt_url;
+
+    int frame;
+
+    static constexpr std::array<std::string_view, 2> lookup_ =
+    {{
+      "amt_url", "frame"
+    }};
+
+    static constexpr std::uint64_t must_ = plate::mask_of(std::array<std::string_view, 2>
+    {{
+      "amt_url", "frame"
+    }}, lookup_);
+
+    static constexpr std::uint64_t may_  = std::numeric_limits<std::uint64_t>::max();
+  };
+
+
+  static bool is_amtraj(std::span<const std::byte> data) noexcept
+  {
+    return data.size() >= magic.size() && std::memcmp(data.data(), magic.data(), magic.size()) == 0;
+  }
+
+
+  // read and check the header at the start of data
+
+  static std::optional<header> read_header(std::span<const std::byte> data) noexcept
+  {
+    if (data.size() < sizeof(header) || !is_amtraj(data))
+    {
+      log_debug(FMT_COMPILE("amtraj: bad header, size: {}"), data.size());
+      return std::nullopt;
+    }
+
+    header h;
+    std::memcpy(&h, data.data(), sizeof(header));
+
+    if (h.version != version || h.number_atoms == 0 || !(h.precision > 0) || h.keyframe_interval == 0)
+    {
+      log_debug(FMT_COMPILE("amtraj: unsupported header, version: {} atoms: {} precision: {}"), h.version, h.number_atoms, h.precision);
+      return std::nullopt;
+    }
+
+    return h;
+  }
+
+
+  // bytes following the header that hold the index and topology
+
+  static std::uint64_t get_index_and_topology_size(const header& h) noexcept
+  {
+    return std::max(h.index_offset + h.number_frames * sizeof(index_entry), h.topology_offset + h.topology_size) - sizeof(header);
+  }
+
+
+  amtraj()
+  {
+  }
+
+
+  // data is the file from its start, at least up to the end of the topology
+
+  bool open(std::span<const std::byte> data) noexcept
+  {
+    auto h = read_header(data);
+
+    if (!h)
+      return false;
+
+    if (data.size() < sizeof(header) + get_index_and_topology_size(*h))
+    {
+      log_debug(FMT_COMPILE("amtraj: short index and topology, have: {}"), data.size());
+      return false;
+    }
+
+    header_ = *h;
+
+    index_.resize(header_.number_frames);
+    std::memcpy(index_.data(), data.data() + header_.index_offset, index_.size() * sizeof(index_entry));
+
+    for (std::uint32_t i = 0; i < header_.number_frames; ++i)
+    {
+      auto& e = index_[i];
+
+      if (e.keyframe > i || !(index_[e.keyframe].flags & static_cast<std::uint32_t>(frame_flags::keyframe)))
+      {
+        log_debug(FMT_COMPILE("amtraj: frame: {} has bad keyframe: {}"), i, e.keyframe);
+        return false;
+      }
+    }
+
+    auto topology = data.subspan(header_.topology_offset, header_.topology_size);
+
+    topology_.clear();
+
+    if (inflate::is_compressed(topology))
+    {
+      if (!inflate::decompress(topology, topology_))
+      {
+        log_debug("amtraj: unable to decompress topology");
+        return false;
+      }
+    }
+    else
+      topology_.assign(reinterpret_cast<const char*>(topology.data()), topology.size());
+
+    key_frame_ = -1;
+
+    return true;
+  }
+
+
+  const header& get_header() const noexcept
+  {
+    return header_;
+  }
+
+
+  std::span<const char> get_topology() const noexcept
+  {
+    return topology_;
+  }
+
+
+  /*
+      file byte range [first, last) to fetch next to decode frame. this covers the frame and its keyframe,
+      unless the keyframe is already decoded. when the frames between them would more than double the
+      size of the range only the keyframe is covered: decode it with decode_keyframe then ask again
+  */
+
+  std::pair<std::uint64_t, std::uint64_t> get_frame_range(int frame) const noexcept
+  {
+    auto& e = index_[frame];
+    auto& k = index_[e.keyframe];
+
+    if (static_cast<int>(e.keyframe) == key_frame_ || e.keyframe == static_cast<std::uint32_t>(frame))
+      return { e.offset, e.offset + e.size };
+
+    if (e.offset - (k.offset + k.size) > k.size + e.size)
+      return { k.offset, k.offset + k.size };
+
+    return { k.offset, e.offset + e.size };
+  }
+
+
+  // true if data of size bytes at data_offset holds everything needed to decode frame
+
+  bool covers(int frame, std::uint64_t data_offset, std::size_t size) const noexcept
+  {
+    auto& e = index_[frame];
+    auto& k = index_[e.keyframe];
+
+    auto in = [&] (const index_entry& b) { return b.offset >= data_offset && b.offset + b.size <= data_offset + size; };
+
+    return in(e) && (static_cast<int>(e.keyframe) == key_frame_ || in(k));
+  }
+
+
+  // decode just the keyframe frame depends on, keeping it for following frames
+
+  bool decode_keyframe(int frame, std::span<const std::byte> data, std::uint64_t data_offset) noexcept
+  {
+    auto& e = index_[frame];
+
+    if (static_cast<int>(e.keyframe) == key_frame_)
+      return true;
+
+    key_.resize(header_.number_atoms * 3);
+    key_frame_ = -1;
+
+    if (!decode_block(index_[e.keyframe], data, data_offset, {}, key_))
+      return false;
+
+    key_frame_ = e.keyframe;
+
+    return true;
+  }
+
+
+  /*
+      decode frame into xyz as interleaved x,y,z coordinates in angstroms. data holds the file bytes
+      starting at data_offset, which must cover get_frame_range(frame)
+  */
+
+  bool decode(int frame, std::span<const std::byte> data, std::uint64_t data_offset, std::vector<float>& xyz) noexcept
+  {
+    if (frame < 0 || frame >= static_cast<int>(index_.size()))
+    {
+      log_debug(FMT_COMPILE("amtraj: bad frame: {}"), frame);
+      return false;
+    }
+
+    auto& e = index_[frame];
+
+    if (!decode_keyframe(frame, data, data_offset))
+      return false;
+
+    const std::int32_t* q = key_.data();
+
+    if (e.keyframe != static_cast<std::uint32_t>(frame))
+    {
+      delta_.resize(header_.number_atoms * 3);
+
+      if (!decode_block(e, data, data_offset, key_, delta_))
+        return false;
+
+      q = delta_.data();
+    }
+
+    // planar to interleaved angstroms
+
+    const std::uint32_t n = header_.number_atoms;
+    const float scale = 1.0f / header_.precision;
+
+    xyz.resize(n * 3);
+
+    for (std::uint32_t i = 0; i < n; ++i)
+    {
+      xyz[i * 3 + 0] = q[i]         * scale;
+      xyz[i * 3 + 1] = q[i + n]     * scale;
+      xyz[i * 3 + 2] = q[i + n * 2] * scale;
+    }
+
+    return true;
+  }
+
+
+  static std::int32_t quantise(float v, float precision) noexcept
+  {
+    return static_cast<std::int32_t>(std::lround(static_cast<double>(v) * precision));
+  }
+
+
+  /*
+      encode planar quantised coordinates q (x values, then y, then z) into a raw frame block appended
+      to out. ref is the keyframe for a delta frame, or empty for a keyframe
+  */
+
+  static void encode_block(std::span<const std::int32_t> q, std::span<const std::int32_t> ref, std::uint32_t number_atoms, std::string& out)
+  {
+    std::vector<std::int64_t> d(number_atoms), v(number_atoms);
+
+    for (int a = 0; a < 3; ++a)
+    {
+      for (std::uint32_t i = 0; i < number_atoms; ++i)
+        d[i] = q[a * number_atoms + i] - (ref.empty() ? 0 : static_cast<std::int64_t>(ref[a * number_atoms + i]));
+
+      for (std::uint32_t i = 0; i < number_atoms; ++i)
+        v[i] = d[i] - (i ? d[i - 1] : 0);
+
+      auto [base, width]         = plane_range(d);
+      auto [base_prev, width_prev] = plane_range(v);
+
+      auto pred = predictor::none;
+
+      if (width_prev < width)
+      {
+        pred  = predictor::previous_atom;
+        base  = base_prev;
+        width = width_prev;
+        std::swap(d, v);
+      }
+
+      const std::uint8_t plane_header[8] = { static_cast<std::uint8_t>(base), static_cast<std::uint8_t>(base >> 8),
+                                             static_cast<std::uint8_t>(base >> 16), static_cast<std::uint8_t>(base >> 24),
+                                             width, static_cast<std::uint8_t>(pred), 0, 0 };
+
+      out.append(reinterpret_cast<const char*>(plane_header), sizeof(plane_header));
+
+      auto start = out.size();
+
+      out.resize(start + number_atoms * width);
+
+      for (int b = 0; b < width; ++b)
+        for (std::uint32_t i = 0; i < number_atoms; ++i)
+          out[start + b * number_atoms + i] = static_cast<char>((d[i] - base) >> (b * 8));
+    }
+  }
+
+
+private:
+
+
+  // base and byte width needed to store values as base + stored value
+
+  static std::pair<std::int32_t, std::uint8_t> plane_range(const std::vector<std::int64_t>& v) noexcept
+  {
+    if (v.empty())
+      return { 0, 1 };
+
+    auto [lo, hi] = std::minmax_element(v.begin(), v.end());
+
+    const auto base  = static_cast<std::int32_t>(*lo + (*hi - *lo) / 2);
+    const auto range = std::max(*hi - base, base - *lo);
+
+    const std::uint8_t width = range <= std::numeric_limits<std::int8_t>::max()  ? 1 :
+                               range <= std::numeric_limits<std::int16_t>::max() ? 2 : 4;
+
+    return { base, width };
+  }
+
+
+  bool decode_block(const index_entry& e, std::span<const std::byte> data, std::uint64_t data_offset,
+                                                     std::span<const std::int32_t> ref, std::vector<std::int32_t>& q) noexcept
+  {
+    if (e.offset < data_offset || e.offset + e.size > data_offset + data.size())
+    {
+      log_debug(FMT_COMPILE("amtraj: frame at: {} not in data at: {} size: {}"), e.offset, data_offset, data.size());
+      return false;
+    }
+
+    auto block = data.subspan(e.offset - data_offset, e.size);
+
+    if (e.flags & static_cast<std::uint32_t>(frame_flags::deflate))
+    {
+      if (!inflate::decompress(block, raw_, e.raw_size) || raw_.size() != e.raw_size)
+      {
+        log_debug("amtraj: unable to decompress frame");
+        return false;
+      }
+
+      block = std::span(reinterpret_cast<const std::byte*>(raw_.data()), raw_.size());
+    }
+
+    auto p   = reinterpret_cast<const std::uint8_t*>(block.data());
+    auto end = p + block.size();
+
+    const std::uint32_t n = header_.number_atoms;
+
+    for (int a = 0; a < 3; ++a)
+    {
+      if (end - p < 8)
+        return false;
+
+      std::int32_t base;
+      std::memcpy(&base, p, 4);
+
+      const int  width = p[4];
+      const auto pred  = static_cast<predictor>(p[5]);
+
+      p += 8;
+
+      if (static_cast<std::size_t>(end - p) < static_cast<std::size_t>(n) * width)
+      {
+        log_debug(FMT_COMPILE("amtraj: short plane, width: {}"), width);
+        return false;
+      }
+
+      auto out = q.data() + a * n;
+      auto r   = ref.empty() ? nullptr : ref.data() + a * n;
+
+      if (width == 1)
+      {
+        auto s = reinterpret_cast<const std::int8_t*>(p);
+
+        if (r) for (std::uint32_t i = 0; i < n; ++i) out[i] = r[i] + base + s[i];
+        else   for (std::uint32_t i = 0; i < n; ++i) out[i] = base + s[i];
+      }
+      else if (width == 2)
+      {
+        auto b0 = p;
+        auto b1 = reinterpret_cast<const std::int8_t*>(p + n);
+
+        if (r) for (std::uint32_t i = 0; i < n; ++i) out[i] = r[i] + base + (b0[i] | (b1[i] * 256));
+        else   for (std::uint32_t i = 0; i < n; ++i) out[i] = base + (b0[i] | (b1[i] * 256));
+      }
+      else if (width == 4)
+      {
+        auto b0 = p, b1 = p + n, b2 = p + n * 2, b3 = p + n * 3;
+
+        for (std::uint32_t i = 0; i < n; ++i)
+        {
+          auto v = static_cast<std::int32_t>(b0[i] | (b1[i] << 8) | (b2[i] << 16) | (static_cast<std::uint32_t>(b3[i]) << 24));
+
+          out[i] = (r ? r[i] : 0) + base + v;
+        }
+      }
+      else
+      {
+        log_debug(FMT_COMPILE("amtraj: bad plane width: {}"), width);
+        return false;
+      }
+
+      if (pred == predictor::previous_atom) // undo the differences, a prefix sum of the values relative to ref
+      {
+        std::int32_t sum = 0;
+
+        if (r) for (std::uint32_t i = 0; i < n; ++i) { sum += out[i] - r[i]; out[i] = r[i] + sum; }
+        else   for (std::uint32_t i = 0; i < n; ++i) { sum += out[i];        out[i] = sum; }
+      }
+
+      p += n * width;
+    }
+
+    return true;
+  }
+
+
+  header header_;
+
+  std::vector<index_entry> index_;
+
+  std::string topology_;
+
+  std::string raw_;                   // decompressed frame block
+
+  int key_frame_{-1};                 // id of the keyframe held in key_
+  std::vector<std::int32_t> key_;     // planar quantised keyframe
+  std::vector<std::int32_t> delta_;   // planar quantised delta frame
+
+
+}; // class amtraj
+
+} // namespace animol
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "visual.hpp"
+
+#include <vector>
+#include <array>
+#include <numeric>
+#include <cstdint>
+
+
+/*
+    spacefill atoms in spatial order: atoms are sorted by the morton code of their position, so atoms near each
+    other in space are near each other in the instance buffer, and so are drawn together.
+
+    codes are made a coordinate at a time over plain arrays, so the loop vectorises when built for simd. the sort
+    is a stable radix sort of the codes.
+*/
+
+namespace animol {
+
+class atom_order
+{
+
+public:
+
+  // sort atoms into spatial order
+
+  static void sort(std::vector<visualise::atom>& atoms) noexcept
+  {
+    const std::size_t n = atoms.size();
+
+    std::vector<std::uint32_t> codes(n), order(n);
+
+    for (int c = 0; c < 3; ++c)
+      for (std::size_t i = 0; i < n; ++i)
+        codes[i] |= spread(static_cast<std::uint32_t>(atoms[i].position[c] + 32768) >> 6) << c; // to 10 bits
+
+    std::iota(order.begin(), order.end(), 0);
+
+    radix_sort(codes, order);
+
+    std::vector<visualise::atom> sorted(n);
+
+    for (std::size_t i = 0; i < n; ++i)
+      sorted[i] = atoms[order[i]];
+
+    atoms.swap(sorted);
+  }
+
+
+private:
+
+  // the 10 bits of v spread to every third bit
+
+  static std::uint32_t spread(std::uint32_t v) noexcept
+  {
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v <<  8)) & 0x0300f00f;
+    v = (v | (v <<  4)) & 0x030c30c3;
+    v = (v | (v <<  2)) & 0x09249249;
+
+    return v;
+  }
+
+
+  // sort the 30 bit codes with order alongside, 10 bits a pass. each pass is stable, so is the sort
+
+  static void radix_sort(std::vector<std::uint32_t>& codes, std::vector<std::uint32_t>& order) noexcept
+  {
+    constexpr int bits = 10, buckets = 1 << bits;
+
+    std::vector<std::uint32_t> codes_out(codes.size()), order_out(order.size());
+
+    for (int shift = 0; shift < 30; shift += bits)
+    {
+      std::array<std::uint32_t, buckets> count{};
+
+      for (auto c : codes)
+        ++count[(c >> shift) & (buckets - 1)];
+
+      std::exclusive_scan(count.begin(), count.end(), count.begin(), 0u);
+
+      for (std::size_t i = 0; i < codes.size(); ++i)
+      {
+        auto& to = count[(codes[i] >> shift) & (buckets - 1)];
+
+        codes_out[to] = codes[i];
+        order_out[to] = order[i];
+
+        ++to;
+      }
+
+      codes.swap(codes_out);
+      order.swap(order_out);
+    }
+  }
+};
+
+} // namespace animol
@@ -0,0 +1,313 @@
+#pragma once
+
+#include "system/webgl/log.hpp"
+
+#include <string>
+#include <string_view>
+#include <span>
+#include <vector>
+#include <optional>
+#include <cstdint>
+#include <climits>
+#include <cstring>
+
+
+/*
+    an atom table: the atoms of a pdb as its topology, the pdb with the coordinates of its ATOM and HETATM records
+    blanked, and the coordinates as thousandths of an angstrom, x then y then z for all atoms. frames of a
+    trajectory share their topology, so it is sent and kept once for them while the coordinates are per frame.
+
+    the pdb is rebuilt exactly from the table: a pdb with coordinates not as %8.3f has no table.
+
+    a table is the topology, the coordinates and a footer ending with its size and magic, so it can be appended
+    to a response and stripped off again. the footer says whether the pdb is a pdb file (or a model of one) as
+    given, with all its atoms whatever was asked for, or was converted to the atoms asked for.
+*/
+
+namespace animol {
+
+class atom_table
+{
+
+public:
+
+  static constexpr char magic[4] = { 'A', 'M', 'A', 'T' };
+
+  static constexpr std::uint32_t version = 2;
+
+
+  struct footer
+  {
+    std::uint64_t topology_hash;
+    std::uint32_t atoms;
+    std::uint32_t topology_size;
+    std::uint32_t as_given;      // 1 if the pdb was not converted
+    std::uint32_t version;
+    std::uint32_t size;          // of the whole table
+    char          magic[4];
+  };
+
+  static_assert(sizeof(footer) == 32);
+
+
+  // append the table of pdb to out, returns false, leaving out unchanged, if pdb has no table
+
+  static bool append(std::span<const char> pdb, bool as_given, std::vector<char>& out) noexcept
+  {
+    auto start = out.size();
+
+    out.insert(out.end(), pdb.begin(), pdb.end());
+
+    auto topology = out.data() + start;
+
+    std::vector<std::int32_t> xyz;
+
+    for (std::size_t pos = 0; pos < pdb.size();)
+    {
+      auto end = std::min(std::string_view(pdb.data(), pdb.size()).find('\n', pos), pdb.size());
+
+      if (is_atom({ pdb.data() + pos, end - pos }))
+      {
+        if (end - pos < 54)
+        {
+          out.resize(start);
+          return false;
+        }
+
+        for (int c = 0; c < 3; ++c)
+        {
+          std::int32_t v;
+
+          if (!read_coord(pdb.data() + pos + 30 + c * 8, v))
+          {
+            out.resize(start);
+            return false;
+          }
+
+          xyz.push_back(v);
+        }
+
+        std::memset(topology + pos + 30, ' ', 24);
+      }
+
+      pos = end + 1;
+    }
+
+    if (xyz.empty())
+    {
+      out.resize(start);
+      return false;
+    }
+
+    footer f;
+
+    f.topology_hash = hash({ topology, pdb.size() });
+    f.atoms         = xyz.size() / 3;
+    f.topology_size = pdb.size();
+    f.as_given      = as_given;
+    f.version       = version;
+    f.size          = pdb.size() + xyz.size() * sizeof(std::int32_t) + sizeof(footer);
+
+    std::memcpy(f.magic, magic, sizeof(magic));
+
+    // as structure of arrays
+
+    auto p = out.size();
+
+    out.resize(start + f.size);
+
+    for (int c = 0; c < 3; ++c)
+      for (std::uint32_t i = 0; i < f.atoms; ++i, p += sizeof(std::int32_t))
+        std::memcpy(out.data() + p, &xyz[i * 3 + c], sizeof(std::int32_t));
+
+    std::memcpy(out.data() + p, &f, sizeof(footer));
+
+    return true;
+  }
+
+
+  // the footer of a table ending data, if it has one
+
+  static std::optional<footer> get_footer(std::span<const char> data) noexcept
+  {
+    if (data.size() < sizeof(footer))
+      return std::nullopt;
+
+    footer f;
+    std::memcpy(&f, data.data() + data.size() - sizeof(footer), sizeof(footer));
+
+    if (std::memcmp(f.magic, magic, sizeof(magic)) != 0 || f.version != version || f.size > data.size() ||
+                               f.size != f.topology_size + std::uint64_t(f.atoms) * 3 * sizeof(std::int32_t) + sizeof(footer))
+      return std::nullopt;
+
+    return f;
+  }
+
+
+  // remove a table from the end of data if it has one, returning it
+
+  static std::optional<std::span<const char>> strip(std::span<const char>& data) noexcept
+  {
+    auto f = get_footer(data);
+
+    if (!f)
+      return std::nullopt;
+
+    std::span<const char> t(data.data() + data.size() - f->size, f->size);
+
+    data = data.first(data.size() - f->size);
+
+    return t;
+  }
+
+
+  // the pdb of a table
+
+  static bool to_pdb(std::span<const char> table, std::string& pdb) noexcept
+  {
+    auto f = get_footer(table);
+
+    if (!f || f->size != table.size())
+    {
+      log_debug(FMT_COMPILE("bad atom table of size: {}"), table.size());
+      return false;
+    }
+
+    pdb.assign(table.data(), f->topology_size);
+
+    auto coords = table.data() + f->topology_size;
+
+    std::uint32_t i = 0;
+
+    for (std::size_t pos = 0; pos < pdb.size();)
+    {
+      auto end = std::min(pdb.find('\n', pos), pdb.size());
+
+      if (is_atom({ pdb.data() + pos, end - pos }) && end - pos >= 54 && i < f->atoms)
+      {
+        for (int c = 0; c < 3; ++c)
+        {
+          std::int32_t v;
+          std::memcpy(&v, coords + (std::size_t(c) * f->atoms + i) * sizeof(std::int32_t), sizeof(v));
+
+          write_coord(pdb.data() + pos + 30 + c * 8, v);
+        }
+
+        ++i;
+      }
+
+      pos = end + 1;
+    }
+
+    if (i != f->atoms)
+    {
+      log_debug(FMT_COMPILE("atom table has: {} atoms, topology: {}"), f->atoms, i);
+      return false;
+    }
+
+    return true;
+  }
+
+
+  static std::uint64_t hash(std::string_view data) noexcept
+  {
+    std::uint64_t h = 0xcbf29ce484222325;
+
+    for (unsigned char c : data)
+      h = (h ^ c) * 0x100000001b3;
+
+    return h;
+  }
+
+
+private:
+
+  static constexpr std::int32_t negative_zero = INT32_MIN; // "-0.000", as written for small negative values
+
+  static bool is_atom(std::string_view line) noexcept
+  {
+    return line.starts_with("ATOM  ") || line.starts_with("HETATM");
+  }
+
+
+  // an 8 column coordinate as written by write_coord, so that it is rebuilt exactly
+
+  static bool read_coord(const char* p, std::int32_t& v) noexcept
+  {
+    int i = 0;
+
+    while (i < 8 && p[i] == ' ')
+      ++i;
+
+    bool negative = i < 8 && p[i] == '-';
+
+    if (negative)
+      ++i;
+
+    std::int64_t u = 0;
+    int digits = 0, decimals = -1;
+
+    for (; i < 8; ++i)
+    {
+      if (p[i] == '.' && decimals < 0)
+        decimals = 0;
+      else if (p[i] >= '0' && p[i] <= '9')
+      {
+        u = u * 10 + (p[i] - '0');
+
+        if (decimals >= 0)
+          ++decimals;
+        else
+          ++digits;
+      }
+      else
+        return false;
+    }
+
+    if (digits == 0 || decimals != 3)
+      return false;
+
+    v = negative ? (u ? -u : negative_zero) : u;
+
+    char check[8];
+    write_coord(check, v);
+
+    return std::memcmp(check, p, 8) == 0;
+  }
+
+
+  // v thousandths as %8.3f
+
+  static void write_coord(char* p, std::int32_t v) noexcept
+  {
+    if (v == negative_zero)
+    {
+      std::memcpy(p, "  -0.000", 8);
+      return;
+    }
+
+    std::uint32_t u = v < 0 ? -static_cast<std::int64_t>(v) : v;
+
+    char* c = p + 8;
+
+    for (int i = 0; i < 3; ++i, u /= 10)
+      *--c = '0' + u % 10;
+
+    *--c = '.';
+
+    do
+    {
+      *--c = '0' + u % 10;
+      u /= 10;
+    }
+    while (u && c > p);
+
+    if (v < 0 && c > p)
+      *--c = '-';
+
+    while (c > p)
+      *--c = ' ';
+  }
+};
+
+} // namespace animol
@@ -0,0 +1,987 @@
+#pragma once
+
+#include "system/webgl/log.hpp"
+
+// https://github.com/molstar/BinaryCIF
+
+#include <string_view>
+#include <string>
+#include <span>
+#include <map>
+#include <vector>
+#include <array>
+#include <bit>
+#include <charconv>
+
+#include "magic_enum.hpp"
+
+#include "msgpack.hpp"
+#include "cif2pdb.hpp"
+
+
+/*
+    convert a BinaryCIF file to pdb format, extracting the same information as cif2pdb does from text mmCIF.
+
+    BinaryCIF is MessagePack encoded, with each category stored as columns. Each column is a byte array with a
+    list of encodings that were applied to it (ByteArray, FixedPoint, IntervalQuantization, RunLength, Delta,
+    IntegerPacking and StringArray). These are undone in reverse order, so no float text parsing is needed.
+
+    The integer decoders are written as simple loops over contiguous arrays so they are auto-vectorised
+    (wasm simd128 or sse/avx natively). Delta is a prefix sum and so remains serial.
+*/
+
+namespace animol {
+
+class bcif2pdb
+{
+
+public:
+
+  using options = cif2pdb::options;
+
+
+  bcif2pdb(std::span<const std::byte> bcif_data, options o) noexcept :
+    data_(bcif_data),
+    options_(o)
+  {
+  }
+
+
+  // BinaryCIF files are a msgpack map with keys: encoder, version and dataBlocks
+
+  static bool is_bcif(std::span<const std::byte> data) noexcept
+  {
+    return msgpack::starts_with_map_key(data, "dataBlocks") || msgpack::starts_with_map_key(data, "encoder");
+  }
+
+
+  std::string* convert() noexcept
+  {
+    using namespace magic_enum::bitwise_operators;
+
+    msgpack::object root;
+
+    if (!msgpack::parse(data_, root))
+    {
+      log_debug("bcif: unable to parse msgpack");
+      return nullptr;
+    }
+
+    auto blocks = root.find("dataBlocks");
+
+    if (!blocks || !blocks->is_array() || blocks->a.empty())
+    {
+      log_debug("bcif: no dataBlocks found");
+      return nullptr;
+    }
+
+    auto categories = blocks->a[0].find("categories");
+
+    if (!categories || !categories->is_array())
+    {
+      log_debug("bcif: no categories found");
+      return nullptr;
+    }
+
+    // categories are processed in file order, matching the text cif output order
+
+    for (auto& cat : categories->a)
+    {
+      auto n = cat.find("name");
+
+      if (!n)
+        continue;
+
+      auto name = n->as_string();
+
+      if (name == "_atom_site" && ((options_ & options::ca_atoms)     != options::none ||
+                                   (options_ & options::non_ca_atoms) != options::none ||
+                                   (options_ & options::hetatm)       != options::none))
+      {
+        if (!process_atom_site(cat))
+          return nullptr;
+
+        continue;
+      }
+
+      if (name == "_struct_conf" && (options_ & options::helix) != options::none)
+      {
+        process_struct_conf(cat); // as with text cif, a bad helix section is not fatal
+        continue;
+      }
+
+      if (name == "_struct_sheet" && (options_ & options::sheet) != options::none)
+      {
+        if (!process_struct_sheet(cat))
+          return nullptr;
+
+        continue;
+      }
+
+      if (name == "_struct_sheet_order" && (options_ & options::sheet) != options::none)
+      {
+        if (!process_struct_sheet_order(cat))
+          return nullptr;
+
+        continue;
+      }
+
+      if (name == "_struct_sheet_range" && (options_ & options::sheet) != options::none)
+      {
+        if (!process_struct_sheet_range(cat))
+          return nullptr;
+
+        continue;
+      }
+    }
+
+    return &pdb_;
+  }
+
+
+private:
+
+
+  static_assert(std::endian::native == std::endian::little, "bcif byte arrays are little endian");
+
+
+  // a fully decoded column
+
+  struct column
+  {
+    enum class kind { none, integer, floating, string };
+
+    kind k{kind::none};
+
+    std::vector<std::int32_t>     ints;
+    std::vector<float>            floats;
+    std::vector<std::string_view> strings;
+
+    std::vector<std::int32_t>     mask; // per row: 0 present, 1 '.', 2 '?'
+
+    mutable std::array<char, 24>  buf;  // storage for numbers returned as text
+
+
+    std::size_t size() const noexcept
+    {
+      switch (k)
+      {
+        case kind::integer:  return ints.size();
+        case kind::floating: return floats.size();
+        case kind::string:   return strings.size();
+        default:             return 0;
+      }
+    }
+
+
+    // the text that would appear in the text cif file for this row
+
+    std::string_view text(std::size_t row) const noexcept
+    {
+      if (!mask.empty())
+      {
+        if (mask[row] == 1) return ".";
+        if (mask[row] == 2) return "?";
+      }
+
+      switch (k)
+      {
+        case kind::string:
+          return strings[row];
+
+        case kind::integer:
+        {
+          auto [p, ec] = std::to_chars(buf.data(), buf.data() + buf.size(), ints[row]);
+          return { buf.data(), static_cast<std::size_t>(p - buf.data()) };
+        }
+
+        case kind::floating:
+        {
+          auto [p, ec] = std::to_chars(buf.data(), buf.data() + buf.size(), floats[row]);
+          return { buf.data(), static_cast<std::size_t>(p - buf.data()) };
+        }
+
+        default:
+          return "";
+      }
+    }
+
+
+    bool get_float(std::size_t row, float& f) const noexcept
+    {
+      switch (k)
+      {
+        case kind::floating: f = floats[row]; return true;
+        case kind::integer:  f = ints[row];   return true;
+        case kind::string:   return string_data::parse_float(f, strings[row]);
+        default:             return false;
+      }
+    }
+  };
+
+
+  // the columns wanted from a category
+
+  struct wanted
+  {
+    wanted(std::string_view n, bool m, int l) noexcept :
+      name(n),
+      must(m),
+      max_len(l)
+    {
+    }
+
+    std::string_view name;    // column name
+    bool             must;    // must have this
+    int              max_len; // the maximum allowable char length (-1 for do not check)
+    column           c{};
+    bool             found{false};
+  };
+
+
+  template<std::size_t N>
+  bool read_columns(const msgpack::object& cat, std::array<wanted, N>& w, std::size_t& rows) noexcept
+  {
+    auto row_count = cat.find("rowCount");
+    auto columns   = cat.find("columns");
+
+    if (!row_count || !columns || !columns->is_array())
+    {
+      log_debug("bcif: category missing rowCount or columns");
+      return false;
+    }
+
+    if (row_count->as_int() < 0)
+    {
+      log_debug(FMT_COMPILE("bcif: bad rowCount: {}"), row_count->as_int());
+      return false;
+    }
+
+    rows = row_count->as_int();
+
+    for (auto& col : columns->a)
+    {
+      auto n = col.find("name");
+
+      if (!n)
+        continue;
+
+      for (auto& e : w)
+      {
+        if (e.name != n->as_string())
+          continue;
+
+        if (!decode_column(col, e.c, rows))
+        {
+          log_debug(FMT_COMPILE("bcif: unable to decode column: {}"), e.name);
+          return false;
+        }
+
+        if (e.c.size() != rows || (!e.c.mask.empty() && e.c.mask.size() != rows))
+        {
+          log_debug(FMT_COMPILE("bcif: column: {} has: {} rows, expected: {}"), e.name, e.c.size(), rows);
+          return false;
+        }
+
+        e.found = true;
+        break;
+      }
+    }
+
+    for (auto& e : w)
+      if (e.must && !e.found)
+      {
+        log_debug(FMT_COMPILE("bcif: missing column: {}"), e.name);
+        return false;
+      }
+
+    return true;
+  }
+
+
+  // check strings are within limits
+
+  template<std::size_t N>
+  bool check_lengths(const std::array<wanted, N>& w, std::size_t row) const noexcept
+  {
+    for (auto& e : w)
+    {
+      if (!e.found || e.max_len < 0)
+        continue;
+
+      if (auto t = e.c.text(row); std::ssize(t) > e.max_len)
+      {
+        log_debug(FMT_COMPILE("bad length: {} is greater than: {} for: {}"), t.size(), e.max_len, e.name);
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+
+  bool decode_column(const msgpack::object& col, column& c, std::size_t rows) noexcept
+  {
+    auto data = col.find("data");
+
+    if (!data)
+      return false;
+
+    auto bytes    = data->find("data");
+    auto encoding = data->find("encoding");
+
+    if (!bytes || !encoding || !encoding->is_array())
+      return false;
+
+    if (!decode(bytes->as_bytes(), *encoding, c, rows))
+      return false;
+
+    if (auto mask = col.find("mask"); mask && !mask->is_nil())
+    {
+      auto mbytes    = mask->find("data");
+      auto mencoding = mask->find("encoding");
+
+      if (!mbytes || !mencoding || !mencoding->is_array())
+        return false;
+
+      column m;
+
+      if (!decode(mbytes->as_bytes(), *mencoding, m, rows) || m.k != column::kind::integer)
+        return false;
+
+      c.mask = std::move(m.ints);
+    }
+
+    return true;
+  }
+
+
+  // undo the encodings in reverse order. the sizes the encodings give are checked against max_size, the values the
+  // column can have, before anything is allocated for them
+
+  bool decode(std::span<const std::byte> bytes, const msgpack::object& encoding, column& c, std::size_t max_size) noexcept
+  {
+    bool raw = true; // still a byte array
+
+    for (auto e = encoding.a.rbegin(); e != encoding.a.rend(); ++e)
+    {
+      auto k = e->find("kind");
+
+      if (!k)
+        return false;
+
+      auto kind = k->as_string();
+
+      if (kind == "StringArray")
+      {
+        if (!raw)
+          return false;
+
+        if (!decode_string_array(bytes, *e, c, max_size))
+          return false;
+
+        raw = false;
+        continue;
+      }
+
+      if (kind == "ByteArray")
+      {
+        if (!raw)
+          return false;
+
+        if (!decode_byte_array(bytes, get_int(*e, "type"), c))
+          return false;
+
+        raw = false;
+        continue;
+      }
+
+      if (raw) // everything else works on typed arrays
+        return false;
+
+      if (kind == "IntegerPacking")
+      {
+        if (c.k != column::kind::integer)
+          return false;
+
+        if (!decode_integer_packing(c.ints, get_int(*e, "byteCount"), get_int(*e, "isUnsigned") != 0, get_int(*e, "srcSize"),
+                                                                                                              max_size))
+          return false;
+
+        continue;
+      }
+
+      if (kind == "Delta")
+      {
+        if (c.k != column::kind::integer)
+          return false;
+
+        decode_delta(c.ints, get_int(*e, "origin"));
+        continue;
+      }
+
+      if (kind == "RunLength")
+      {
+        if (c.k != column::kind::integer)
+          return false;
+
+        if (!decode_run_length(c.ints, get_int(*e, "srcSize"), max_size))
+          return false;
+
+        continue;
+      }
+
+      if (kind == "FixedPoint")
+      {
+        if (c.k != column::kind::integer)
+          return false;
+
+        decode_fixed_point(c, get_double(*e, "factor"));
+        continue;
+      }
+
+      if (kind == "IntervalQuantization")
+      {
+        if (c.k != column::kind::integer)
+          return false;
+
+        decode_interval_quantization(c, get_double(*e, "min"), get_double(*e, "max"), get_int(*e, "numSteps"));
+        continue;
+      }
+
+      log_debug(FMT_COMPILE("bcif: unknown encoding: {}"), kind);
+      return false;
+    }
+
+    return !raw;
+  }
+
+
+  static std::int64_t get_int(const msgpack::object& o, std::string_view key) noexcept
+  {
+    auto v = o.find(key);
+    return v ? v->as_int() : 0;
+  }
+
+
+  static double get_double(const msgpack::object& o, std::string_view key) noexcept
+  {
+    auto v = o.find(key);
+    return v ? v->as_double() : 0;
+  }
+
+
+  template<class T>
+  static void widen(std::span<const std::byte> b, std::vector<std::int32_t>& out) noexcept
+  {
+    const auto n = b.size() / sizeof(T);
+
+    out.resize(n);
+
+    const auto src = b.data();
+    const auto dst = out.data();
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      T v;
+      std::memcpy(&v, src + i * sizeof(T), sizeof(T)); // unaligned little endian load
+      dst[i] = static_cast<std::int32_t>(v);
+    }
+  }
+
+
+  template<class T>
+  static void narrow(std::span<const std::byte> b, std::vector<float>& out) noexcept
+  {
+    const auto n = b.size() / sizeof(T);
+
+    out.resize(n);
+
+    const auto src = b.data();
+    const auto dst = out.data();
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      T v;
+      std::memcpy(&v, src + i * sizeof(T), sizeof(T));
+      dst[i] = static_cast<float>(v);
+    }
+  }
+
+
+  static bool decode_byte_array(std::span<const std::byte> b, std::int64_t type, column& c) noexcept
+  {
+    c.k = column::kind::integer;
+
+    switch (type)
+    {
+      case 1: widen<std::int8_t>  (b, c.ints); return true;
+      case 2: widen<std::int16_t> (b, c.ints); return true;
+      case 3: widen<std::int32_t> (b, c.ints); return true;
+      case 4: widen<std::uint8_t> (b, c.ints); return true;
+      case 5: widen<std::uint16_t>(b, c.ints); return true;
+      case 6: widen<std::uint32_t>(b, c.ints); return true;
+    }
+
+    c.k = column::kind::floating;
+
+    switch (type)
+    {
+      case 32: narrow<float> (b, c.floats); return true;
+      case 33: narrow<double>(b, c.floats); return true;
+    }
+
+    log_debug(FMT_COMPILE("bcif: unknown byte array type: {}"), type);
+
+    return false;
+  }
+
+
+  // values at the limits of the packed type continue into the next value
+
+  static bool decode_integer_packing(std::vector<std::int32_t>& v, std::int64_t byte_count, bool is_unsigned,
+                                                                  std::int64_t src_size, std::size_t max_size) noexcept
+  {
+    if ((byte_count != 1 && byte_count != 2) || src_size < 0 || static_cast<std::uint64_t>(src_size) > max_size ||
+                                                                                            src_size > std::ssize(v))
+    {
+      log_debug(FMT_COMPILE("bcif: bad integer packing of byteCount: {} srcSize: {} from: {} of at most: {}"),
+                                                                            byte_count, src_size, v.size(), max_size);
+      return false;
+    }
+
+    if (src_size == std::ssize(v)) // nothing was split, so the widened byte array is already the result
+      return true;
+
+    std::int32_t upper, lower;
+
+    if (is_unsigned)
+    {
+      upper = (byte_count == 1) ? 0xff : 0xffff;
+      lower = -1; // never matches
+    }
+    else
+    {
+      upper = (byte_count == 1) ? 0x7f : 0x7fff;
+      lower = (byte_count == 1) ? -0x80 : -0x8000;
+    }
+
+    std::vector<std::int32_t> out(src_size);
+
+    std::size_t i = 0, j = 0;
+
+    for (; i < out.size() && j < v.size(); ++i)
+    {
+      std::int32_t value = 0;
+      std::int32_t t = v[j];
+
+      while ((t == upper || t == lower) && j + 1 < v.size())
+      {
+        value += t;
+        t = v[++j];
+      }
+
+      out[i] = value + t;
+      ++j;
+    }
+
+    if (i != out.size() || j != v.size())
+    {
+      log_debug(FMT_COMPILE("bcif: integer packing of: {} values gave: {} of srcSize: {}"), v.size(), i, out.size());
+      return false;
+    }
+
+    v = std::move(out);
+
+    return true;
+  }
+
+
+  static void decode_delta(std::vector<std::int32_t>& v, std::int64_t origin) noexcept
+  {
+    if (v.empty())
+      return;
+
+    auto p = v.data();
+
+    p[0] += origin;
+
+    for (std::size_t i = 1; i < v.size(); ++i)
+      p[i] += p[i - 1];
+  }
+
+
+  static bool decode_run_length(std::vector<std::int32_t>& v, std::int64_t src_size, std::size_t max_size) noexcept
+  {
+    if (src_size < 0 || static_cast<std::uint64_t>(src_size) > max_size)
+    {
+      log_debug(FMT_COMPILE("bcif: bad run length srcSize: {} of at most: {}"), src_size, max_size);
+      return false;
+    }
+
+    std::vector<std::int32_t> out(src_size);
+
+    std::size_t pos = 0;
+
+    for (std::size_t i = 0; i + 1 < v.size(); i += 2)
+    {
+      const auto value = v[i];
+      const auto count = v[i + 1];
+
+      if (count < 0 || pos + count > out.size())
+      {
+        log_debug(FMT_COMPILE("bcif: bad run length: {} at: {} of: {}"), count, pos, out.size());
+        return false;
+      }
+
+      std::fill_n(out.data() + pos, count, value);
+      pos += count;
+    }
+
+    v = std::move(out);
+
+    return pos == v.size();
+  }
+
+
+  static void decode_fixed_point(column& c, double factor) noexcept
+  {
+    const auto n = c.ints.size();
+
+    c.floats.resize(n);
+
+    const float f = static_cast<float>(factor); // same rounding as text parse for factors of 10
+
+    const auto src = c.ints.data();
+    const auto dst = c.floats.data();
+
+    for (std::size_t i = 0; i < n; ++i)
+      dst[i] = static_cast<float>(src[i]) / f;
+
+    c.k = column::kind::floating;
+    c.ints.clear();
+  }
+
+
+  static void decode_interval_quantization(column& c, double min, double max, std::int64_t steps) noexcept
+  {
+    const auto n = c.ints.size();
+
+    c.floats.resize(n);
+
+    const float delta = steps > 1 ? static_cast<float>((max - min) / (steps - 1)) : 0.0f;
+    const float fmin  = static_cast<float>(min);
+
+    const auto src = c.ints.data();
+    const auto dst = c.floats.data();
+
+    for (std::size_t i = 0; i < n; ++i)
+      dst[i] = fmin + delta * src[i];
+
+    c.k = column::kind::floating;
+    c.ints.clear();
+  }
+
+
+  bool decode_string_array(std::span<const std::byte> bytes, const msgpack::object& e, column& c, std::size_t max_size) noexcept
+  {
+    auto string_data     = e.find("stringData");
+    auto offsets         = e.find("offsets");
+    auto offset_encoding = e.find("offsetEncoding");
+    auto data_encoding   = e.find("dataEncoding");
+
+    if (!string_data || !offsets || !offset_encoding || !data_encoding)
+      return false;
+
+    column off, idx;
+
+    // a string for each value at most, and one more offset than strings
+
+    if (!decode(offsets->as_bytes(), *offset_encoding, off, max_size + 1) || off.k != column::kind::integer)
+      return false;
+
+    if (!decode(bytes, *data_encoding, idx, max_size) || idx.k != column::kind::integer)
+      return false;
+
+    auto sd = string_data->as_string();
+
+    // build the table of unique strings
+
+    std::vector<std::string_view> table;
+
+    if (!off.ints.empty())
+      table.resize(off.ints.size() - 1);
+
+    for (std::size_t i = 0; i < table.size(); ++i)
+    {
+      auto s = off.ints[i];
+      auto l = off.ints[i + 1] - s;
+
+      if (s < 0 || l < 0 || static_cast<std::size_t>(s + l) > sd.size())
+        return false;
+
+      table[i] = sd.substr(s, l);
+    }
+
+    c.k = column::kind::string;
+    c.strings.resize(idx.ints.size());
+
+    for (std::size_t i = 0; i < idx.ints.size(); ++i)
+    {
+      auto t = idx.ints[i];
+
+      if (t < 0) // null entry
+        c.strings[i] = "";
+      else if (static_cast<std::size_t>(t) < table.size())
+        c.strings[i] = table[t];
+      else
+        return false;
+    }
+
+    return true;
+  }
+
+
+  bool process_atom_site(const msgpack::object& cat) noexcept
+  {
+    using namespace magic_enum::bitwise_operators;
+
+    std::array<wanted, 8> w =
+    {{
+      { "group_PDB",     true, -1 },
+      { "label_atom_id", true,  4 },
+      { "label_comp_id", true,  3 },
+      { "label_asym_id", true,  2 },
+      { "label_seq_id",  true,  4 },
+      { "Cartn_x",       true, -1 },
+      { "Cartn_y",       true, -1 },
+      { "Cartn_z",       true, -1 }
+    }};
+
+    std::size_t rows;
+
+    if (!read_columns(cat, w, rows))
+      return false;
+
+    const bool want_atoms = (options_ & options::ca_atoms) != options::none || (options_ & options::non_ca_atoms) != options::none;
+    const bool want_ca    = (options_ & options::ca_atoms)     != options::none;
+    const bool want_nca   = (options_ & options::non_ca_atoms) != options::none;
+    const bool want_het   = (options_ & options::hetatm)       != options::none;
+
+    pdb_.reserve(pdb_.size() + rows * 55);
+
+    for (std::size_t row = 0; row < rows; ++row)
+    {
+      auto group = w[0].c.text(row);
+
+      const bool is_atom = (group == "ATOM");
+
+      if (!((is_atom && want_atoms) || (group == "HETATM" && want_het)))
+        continue;
+
+      if (!check_lengths(w, row))
+        return false;
+
+      auto atom = w[1].c.text(row);
+
+      const bool isCA = (atom == "CA");
+
+      if (is_atom && !((want_ca && isCA) || (want_nca && !isCA)))
+        continue;
+
+      float x, y, z;
+
+      if (!w[5].c.get_float(row, x) || !w[6].c.get_float(row, y) || !w[7].c.get_float(row, z))
+      {
+        log_debug(FMT_COMPILE("bcif: bad coordinate in row: {}"), row);
+        return false;
+      }
+
+      auto asym = w[3].c.text(row);
+
+      cif2pdb::append_atom(pdb_, group, atom, w[2].c.text(row), asym.empty() ? ' ' : asym[0], w[4].c.text(row), x, y, z);
+    }
+
+    return true;
+  }
+
+
+  bool process_struct_conf(const msgpack::object& cat) noexcept
+  {
+    std::array<wanted, 11> w =
+    {{
+      { "pdbx_PDB_helix_id",     true,  3 },
+      { "beg_label_comp_id",     true,  3 },
+      { "beg_label_asym_id",     true,  1 },
+      { "beg_label_seq_id",      true,  4 },
+      { "pdbx_beg_PDB_ins_code", false, 1 },
+      { "end_label_comp_id",     true,  3 },
+      { "end_label_asym_id",     true,  1 },
+      { "end_label_seq_id",      true,  4 },
+      { "pdbx_end_PDB_ins_code", false, 1 },
+      { "pdbx_PDB_helix_class",  true,  2 },
+      { "pdbx_PDB_helix_length", true,  4 }
+    }};
+
+    std::size_t rows;
+
+    if (!read_columns(cat, w, rows))
+      return false;
+
+    for (std::size_t row = 0; row < rows; ++row)
+    {
+      if (!check_lengths(w, row))
+        return false;
+
+      if (row + 1 >= 1000) // max 3 digits
+        return false;
+
+      cif2pdb::append_helix(pdb_, row + 1, w[0].c.text(row), w[1].c.text(row), w[2].c.text(row), w[3].c.text(row),
+            ins_code(w[4], row), w[5].c.text(row), w[6].c.text(row), w[7].c.text(row),
+            ins_code(w[8], row), w[9].c.text(row), w[10].c.text(row));
+    }
+
+    return true;
+  }
+
+
+  bool process_struct_sheet(const msgpack::object& cat) noexcept
+  {
+    std::array<wanted, 2> w =
+    {{
+      { "id",             true, -1 },
+      { "number_strands", true, -1 }
+    }};
+
+    std::size_t rows;
+
+    if (!read_columns(cat, w, rows))
+      return false;
+
+    for (std::size_t row = 0; row < rows; ++row)
+    {
+      int x;
+
+      auto t = w[1].c.text(row);
+
+      if (auto [p, ec] = std::from_chars(t.begin(), t.end(), x); ec != std::errc() || p != t.end())
+      {
+        log_debug(FMT_COMPILE("from_chars error for number_strands: {}"), t);
+        return false;
+      }
+
+      sheet_num_strands_[std::string(w[0].c.text(row))] = x;
+    }
+
+    return true;
+  }
+
+
+  bool process_struct_sheet_order(const msgpack::object& cat) noexcept
+  {
+    std::array<wanted, 3> w =
+    {{
+      { "sheet_id",   true, -1 },
+      { "range_id_2", true, -1 },
+      { "sense",      true, -1 }
+    }};
+
+    std::size_t rows;
+
+    if (!read_columns(cat, w, rows))
+      return false;
+
+    for (std::size_t row = 0; row < rows; ++row)
+    {
+      int r = (w[2].c.text(row) == "anti-parallel") ? -1 : 1;
+
+      sheet_order_[std::make_pair(std::string(w[0].c.text(row)), std::string(w[1].c.text(row)))] = r;
+    }
+
+    return true;
+  }
+
+
+  bool process_struct_sheet_range(const msgpack::object& cat) noexcept
+  {
+    std::array<wanted, 10> w =
+    {{
+      { "id",                    true,  3 },
+      { "sheet_id",              true,  3 },
+      { "beg_label_comp_id",     true,  3 },
+      { "beg_label_asym_id",     true,  1 },
+      { "beg_label_seq_id",      true,  4 },
+      { "pdbx_beg_PDB_ins_code", false, 1 },
+      { "end_label_comp_id",     true,  3 },
+      { "end_label_asym_id",     true,  1 },
+      { "end_label_seq_id",      true,  4 },
+      { "pdbx_end_PDB_ins_code", false, 1 }
+    }};
+
+    std::size_t rows;
+
+    if (!read_columns(cat, w, rows))
+      return false;
+
+    for (std::size_t row = 0; row < rows; ++row)
+    {
+      if (!check_lengths(w, row))
+        return false;
+
+      auto sheet_id = w[1].c.text(row);
+
+      auto num = sheet_num_strands_.find(sheet_id);
+
+      if (num == sheet_num_strands_.end())
+      {
+        log_debug(FMT_COMPILE("unable to find: {}"), sheet_id);
+        return false;
+      }
+
+      int dir = 0;
+      auto lu = sheet_order_.find({std::string(sheet_id), std::string(w[0].c.text(row))});
+
+      if (lu != sheet_order_.end())
+        dir = lu->second;
+
+      cif2pdb::append_sheet(pdb_, w[0].c.text(row), sheet_id, num->second,
+            w[2].c.text(row), w[3].c.text(row), w[4].c.text(row),
+            ins_code(w[5], row), w[6].c.text(row), w[7].c.text(row),
+            w[8].c.text(row), ins_code(w[9], row), dir);
+    }
+
+    return true;
+  }
+
+
+  static char ins_code(const wanted& w, std::size_t row) noexcept
+  {
+    if (!w.found)
+      return ' ';
+
+    auto t = w.c.text(row);
+
+    if (t.size() != 1 || t == "?")
+      return ' ';
+
+    return t[0];
+  }
+
+
+  std::span<const std::byte> data_;
+
+  options options_;
+
+  std::string pdb_; // output
+
+  // map of sheet_id -> num_strands
+
+  std::map<std::string, int, std::less<>> sheet_num_strands_;
+
+  // map of (sheet_id, strand_num) -> anti-parallel | parallel
+
+  std::map<std::pair<std::string, std::string>, int> sheet_order_;
+
+}; // class bcif2pdb
+
+} // namespace animol
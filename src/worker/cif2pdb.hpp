@@ -1,3 +1,5 @@
+#pragma once
+
 #include "system/webgl/log.hpp"
 
 // https://mmcif.wwpdb.org/pdbx-mmcif-home-page.html
@@ -69,6 +71,68 @@ public:
   }
 
 
+  // pdb record output, shared with the binary formats that are also converted to pdb
+
+  // serial is only written if > 0, it is needed when CONECT records follow
+
+  static void append_atom(std::string& pdb, std::string_view group, std::string_view atom, std::string_view comp,
+                          char asym, std::string_view seq, float x, float y, float z, int serial = 0) noexcept
+  {
+    if (serial > 0)
+    {
+      if (atom.size() == 4)
+        pdb += fmt::format(FMT_COMPILE("{: <6}{: >5} {: <4} {: <3} {:1}{: >4}     {: >7.3f} {: >7.3f} {: >7.3f}\n"),
+            group, serial, atom, comp, asym, seq, x, y, z);
+      else
+        pdb += fmt::format(FMT_COMPILE("{: <6}{: >5}  {: <3} {: <3} {:1}{: >4}     {: >7.3f} {: >7.3f} {: >7.3f}\n"),
+            group, serial, atom, comp, asym, seq, x, y, z);
+
+      return;
+    }
+
+    if (atom.size() == 4) // left shifted as atom has 4 characters
+      pdb += fmt::format(FMT_COMPILE("{: <6}      {: <4} {: <3} {:1}{: >4}     {: >7.3f} {: >7.3f} {: >7.3f}\n"),
+          group, atom, comp, asym, seq, x, y, z);
+    else
+      pdb += fmt::format(FMT_COMPILE("{: <6}       {: <3} {: <3} {:1}{: >4}     {: >7.3f} {: >7.3f} {: >7.3f}\n"),
+          group, atom, comp, asym, seq, x, y, z);
+  }
+
+
+  // CONECT record for an atom and up to 4 bonded atoms, unused entries are 0
+
+  static void append_conect(std::string& pdb, int serial, int b1, int b2 = 0, int b3 = 0, int b4 = 0) noexcept
+  {
+    pdb += fmt::format(FMT_COMPILE("CONECT{: >5}{: >5}"), serial, b1);
+
+    if (b2 > 0) pdb += fmt::format(FMT_COMPILE("{: >5}"), b2);
+    if (b3 > 0) pdb += fmt::format(FMT_COMPILE("{: >5}"), b3);
+    if (b4 > 0) pdb += fmt::format(FMT_COMPILE("{: >5}"), b4);
+
+    pdb += '\n';
+  }
+
+
+  static void append_helix(std::string& pdb, int serial, std::string_view id,
+                           std::string_view comp_beg, std::string_view asym_beg, std::string_view seq_beg, char ins_beg,
+                           std::string_view comp_end, std::string_view asym_end, std::string_view seq_end, char ins_end,
+                           std::string_view helix_class, std::string_view length) noexcept
+  {
+    pdb += fmt::format(FMT_COMPILE("HELIX  {: >3} {: >3} {: >3} {:1} {: >4}{:1} {: >3} {:1} {: >4}{:1}{: >2}{: >36}\n"),
+         serial, id, comp_beg, asym_beg, seq_beg, ins_beg, comp_end, asym_end, seq_end, ins_end, helix_class, length);
+  }
+
+
+  static void append_sheet(std::string& pdb, std::string_view id, std::string_view sheet_id, int num_strands,
+                           std::string_view comp_beg, std::string_view asym_beg, std::string_view seq_beg, char ins_beg,
+                           std::string_view comp_end, std::string_view asym_end, std::string_view seq_end, char ins_end,
+                           int sense) noexcept
+  {
+    pdb += fmt::format(FMT_COMPILE("SHEET  {: >3} {: >3}{: >2} {: >3} {:1}{: >4}{:1} {: >3} {:1}{: >4}{:1}{: >2}\n"),
+          id, sheet_id, num_strands, comp_beg, asym_beg, seq_beg, ins_beg, comp_end, asym_end, seq_end, ins_end, sense);
+  }
+
+
 private:
 
 
@@ -352,12 +416,7 @@ private:
         return false;
       }
 
-      if (v[offsets[1].pos].size() == 4) // left shifted as atom has 4 characters
-        pdb_ += fmt::format(FMT_COMPILE("{: <6}      {: <4} {: <3} {:1}{: >4}     {: >7.3f} {: >7.3f} {: >7.3f}\n"),
-            v[offsets[0].pos], v[offsets[1].pos], v[offsets[2].pos], v[offsets[3].pos][0], v[offsets[4].pos], x, y, z);
-      else
-        pdb_ += fmt::format(FMT_COMPILE("{: <6}       {: <3} {: <3} {:1}{: >4}     {: >7.3f} {: >7.3f} {: >7.3f}\n"),
-            v[offsets[0].pos], v[offsets[1].pos], v[offsets[2].pos], v[offsets[3].pos][0], v[offsets[4].pos], x, y, z);
+      append_atom(pdb_, v[offsets[0].pos], v[offsets[1].pos], v[offsets[2].pos], v[offsets[3].pos][0], v[offsets[4].pos], x, y, z);
 
       return true;
     }, atom_type);
@@ -399,8 +458,7 @@ private:
       if (offsets[8].pos != -1 && v[offsets[8].pos] != "?" && v[offsets[8].pos].size() == 1)
         id_end = v[offsets[8].pos][0]; 
 
-      pdb_ += fmt::format(FMT_COMPILE("HELIX  {: >3} {: >3} {: >3} {:1} {: >4}{:1} {: >3} {:1} {: >4}{:1}{: >2}{: >36}\n"),
-           i, v[offsets[0].pos], v[offsets[1].pos], v[offsets[2].pos], v[offsets[3].pos],
+      append_helix(pdb_, i, v[offsets[0].pos], v[offsets[1].pos], v[offsets[2].pos], v[offsets[3].pos],
               id_beg, v[offsets[5].pos], v[offsets[6].pos], v[offsets[7].pos],
               id_end, v[offsets[9].pos], v[offsets[10].pos]);
 
@@ -515,8 +573,7 @@ private:
       if (offsets[9].pos != -1 && v[offsets[9].pos] != "?" && v[offsets[9].pos].size() == 1)
         id_end = v[offsets[9].pos][0];
 
-      pdb_ += fmt::format(FMT_COMPILE("SHEET  {: >3} {: >3}{: >2} {: >3} {:1}{: >4}{:1} {: >3} {:1}{: >4}{:1}{: >2}\n"),
-            v[offsets[0].pos], v[offsets[1].pos], num->second,
+      append_sheet(pdb_, v[offsets[0].pos], v[offsets[1].pos], num->second,
             v[offsets[2].pos], v[offsets[3].pos], v[offsets[4].pos],
             id_beg, v[offsets[6].pos], v[offsets[7].pos],
             v[offsets[8].pos], id_end, dir);
@@ -1,3 +1,5 @@
+#pragma once
+
 #include "system/webgl/log.hpp"
 #include "system/common/json/json.hpp"
 
@@ -10,6 +12,7 @@
 #include <unordered_map>
 #include <vector>
 #include <optional>
+#include <algorithm>
 
 #include "string_data.hpp"
 
@@ -277,7 +280,28 @@ public:
     }
 
     for (std::int32_t i = 0; i < static_cast<std::int32_t>(indexes_.size()); ++i)
-      fmt::format_to(&pdb_data_[i*55+31], FMT_COMPILE("{: >7.3f} {: >7.3f} {: >7.3f}\n"), p[0][indexes_[i]], p[1][indexes_[i]], p[2][indexes_[i]]);
+      fmt::format_to(&pdb_data_[i*55+30], FMT_COMPILE("{: >8.3f}{: >8.3f}{: >8.3f}\n"), to_field(p[0][indexes_[i]]),
+                                                                   to_field(p[1][indexes_[i]]), to_field(p[2][indexes_[i]]));
+
+    return true;
+  }
+
+
+
+  bool populate_template(std::span<const float> xyz) // interleaved x,y,z per atom, as decoded from other trajectory formats
+  {
+    if (xyz.size() != static_cast<std::size_t>(number_atoms_) * 3)
+    {
+      log_debug(FMT_COMPILE("bad xyz size: {} wanted: {}"), xyz.size(), number_atoms_ * 3);
+      return false;
+    }
+
+    for (std::int32_t i = 0; i < static_cast<std::int32_t>(indexes_.size()); ++i)
+    {
+      auto p = &xyz[indexes_[i] * 3];
+
+      fmt::format_to(&pdb_data_[i*55+30], FMT_COMPILE("{: >8.3f}{: >8.3f}{: >8.3f}\n"), to_field(p[0]), to_field(p[1]), to_field(p[2]));
+    }
 
     return true;
   }
@@ -399,6 +423,14 @@ public:
 private:
 
 
+  // a coordinate that fits the 8 characters of its pdb field, which a larger one would write past
+
+  static float to_field(float v) noexcept
+  {
+    return v == v ? std::clamp(v, -999.999f, 9999.999f) : 0.0f;
+  }
+
+
   std::vector<std::int32_t> indexes_;
 
   std::string pdb_data_;
@@ -0,0 +1,227 @@
+#pragma once
+
+#include "system/webgl/log.hpp"
+#include "system/trace.hpp"
+
+#include <string_view>
+#include <span>
+#include <vector>
+#include <array>
+#include <optional>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+
+/*
+    decode statistics: the worker appends a trailer to each non empty response saying where the time went,
+    and the main thread strips it off and keeps rolling statistics of the last window responses.
+
+    the trailer is the last sizeof(trailer) bytes of a response, ending with its size and magic, so responses
+    without one (eg. from an older worker) are passed through unchanged.
+*/
+
+namespace animol {
+
+class decode_stats
+{
+
+public:
+
+  static constexpr std::array<char, 4> magic = { 'A', 'M', 'S', 'T' };
+
+  static constexpr int window = 128;
+
+  enum class stage { fetch, convert, molauto, molscript, compact, visualise, store, number_stages };
+
+  static constexpr int number_stages = static_cast<int>(stage::number_stages);
+
+  static constexpr std::array<std::string_view, number_stages> stage_names = { "fetch", "convert", "molauto", "molscript",
+                                                                               "compact", "visualise", "store" };
+
+
+  struct trailer
+  {
+    std::array<float, number_stages> stage_ms; // time in each stage, fetch being from request to load
+    std::uint32_t atoms;                       // parsed by molauto, molscript or visualise
+    std::uint32_t vertices;                    // emitted by compact
+    std::uint32_t stored;                      // results answered from the result store
+    std::uint64_t bytes_fetched;
+    std::uint64_t heap_high;                   // worker heap size, which only grows
+    std::uint32_t size;                        // sizeof(trailer)
+    char          magic[4];
+  };
+
+  static_assert(sizeof(trailer) == 64);
+
+
+  // adds the time from construction to destruction to a stage
+
+  class timer
+  {
+
+  public:
+
+    timer(trailer& t, stage s) noexcept :
+      ms_(t.stage_ms[static_cast<int>(s)]),
+#ifdef PLATE_TRACE
+      zone_(stage_names[static_cast<int>(s)].data()),
+#endif
+      start_(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~timer() noexcept
+    {
+      ms_ += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start_).count();
+    }
+
+  private:
+
+    float& ms_;
+
+#ifdef PLATE_TRACE
+    plate::trace::zone zone_; // the stage is also a trace zone
+#endif
+
+    std::chrono::steady_clock::time_point start_;
+  };
+
+
+  // response data followed by the trailer t
+
+  static void append(std::span<const char> data, trailer t, std::vector<char>& out) noexcept
+  {
+    t.size = sizeof(trailer);
+    std::memcpy(t.magic, magic.data(), magic.size());
+
+    out.resize(data.size() + sizeof(trailer));
+
+    std::memcpy(out.data(), data.data(), data.size());
+    std::memcpy(out.data() + data.size(), &t, sizeof(trailer));
+  }
+
+
+  // remove the trailer from the end of data if it has one
+
+  static std::optional<trailer> strip(std::span<char>& data) noexcept
+  {
+    if (data.size() < sizeof(trailer))
+      return std::nullopt;
+
+    trailer t;
+    std::memcpy(&t, data.data() + data.size() - sizeof(trailer), sizeof(trailer));
+
+    if (t.size != sizeof(trailer) || std::memcmp(t.magic, magic.data(), magic.size()) != 0)
+      return std::nullopt;
+
+    data = data.first(data.size() - sizeof(trailer));
+
+    return t;
+  }
+
+
+  // record a response: its trailer and the time from the call to the response, which includes any queueing
+
+  void add(const trailer& t, float round_trip_ms) noexcept
+  {
+    if (samples_.size() < window)
+      samples_.push_back({ t, round_trip_ms });
+    else
+      samples_[responses_ % window] = { t, round_trip_ms };
+
+    ++responses_;
+
+    bytes_fetched_ += t.bytes_fetched;
+    atoms_         += t.atoms;
+    vertices_      += t.vertices;
+    stored_        += t.stored;
+    heap_high_      = std::max(heap_high_, t.heap_high);
+  }
+
+
+  void clear() noexcept
+  {
+    *this = decode_stats();
+  }
+
+
+  std::uint64_t get_responses() const noexcept
+  {
+    return responses_;
+  }
+
+
+  // mean and max of the stage, or of the round trip if s is number_stages, over the window
+
+  std::pair<float, float> get_window(int s) const noexcept
+  {
+    float sum = 0, max = 0;
+
+    for (auto& [t, round_trip_ms] : samples_)
+    {
+      auto v = s == number_stages ? round_trip_ms : t.stage_ms[s];
+
+      sum += v;
+      max  = std::max(max, v);
+    }
+
+    return { samples_.empty() ? 0 : sum / samples_.size(), max };
+  }
+
+
+  std::uint64_t get_bytes_fetched() const noexcept { return bytes_fetched_; }
+  std::uint64_t get_atoms()         const noexcept { return atoms_;         }
+  std::uint64_t get_vertices()      const noexcept { return vertices_;      }
+  std::uint64_t get_stored()        const noexcept { return stored_;        }
+  std::uint64_t get_heap_high()     const noexcept { return heap_high_;     }
+
+
+private:
+
+  struct sample
+  {
+    trailer t;
+    float   round_trip_ms;
+  };
+
+  std::vector<sample> samples_; // the last window responses, as a ring
+
+  std::uint64_t responses_{0};
+  std::uint64_t bytes_fetched_{0};
+  std::uint64_t atoms_{0};
+  std::uint64_t vertices_{0};
+  std::uint64_t stored_{0};
+  std::uint64_t heap_high_{0};
+};
+
+} // namespace animol
+
+
+template <>
+struct fmt::formatter<animol::decode_stats>
+{
+  constexpr auto parse(format_parse_context& ctx)
+  {
+    return ctx.begin();
+  }
+
+  template<typename FormatContext>
+  auto format(const animol::decode_stats& s, FormatContext& ctx) const
+  {
+    auto out = format_to(ctx.out(), FMT_COMPILE(R"({{ "responses":{}, "window":{})"), s.get_responses(), animol::decode_stats::window);
+
+    for (int i = 0; i <= animol::decode_stats::number_stages; ++i)
+    {
+      auto [mean, max] = s.get_window(i);
+
+      auto name = i == animol::decode_stats::number_stages ? "round_trip" : animol::decode_stats::stage_names[i];
+
+      out = format_to(out, FMT_COMPILE(R"(, "{}_ms":{{ "mean":{:.3f}, "max":{:.3f} }})"), name, mean, max);
+    }
+
+    return format_to(out, FMT_COMPILE(R"(, "bytes_fetched":{}, "atoms":{}, "vertices":{}, "stored":{}, "heap_high":{} }})"),
+                              s.get_bytes_fetched(), s.get_atoms(), s.get_vertices(), s.get_stored(), s.get_heap_high());
+  }
+};
@@ -3,27 +3,17 @@
 #include <emscripten/emscripten.h>
 #include <emscripten/bind.h>
 #include <emscripten/fetch.h>
+#include <emscripten/heap.h>
 
-#include "visual.hpp"
+#include <ctime>
+#include <random>
 
-#include "cif2pdb.hpp"
-#include "dcd2pdb.hpp"
+#include "pipeline.hpp"
+#include "geometry_delta.hpp"
 
 
 extern "C" {
 
-extern void vertex_free();
-extern void vertex_clear();
-
-extern int molauto (int argc, char *argv[]);
-extern int molscript (int argc, char *argv[]);
-
-#define OPTION_COLOR      1
-#define OPTION_INTERLEAVE 2
-
-extern int compact(char** cdata, int options);
-
-
 float fast_float_c(const char* s)
 {
   float f;
@@ -35,179 +25,381 @@ float fast_float_c(const char* s)
   return 0;
 }
 
+} // extern "C"
 
-// basic check to see if a file is in PDBx/mmCIF format
-// currently just check it starts with data_
 
-bool is_cif(std::span<const std::byte> data)
+// the pipeline's input fetched with plate::async. range headers must outlive the fetch, so are kept by the callbacks
+
+struct async_fetcher : public animol::fetcher
 {
-  if (data.size() < 5)
-    return false;
+  void get(const std::string& url, const std::string& range, load_cb on_load, error_cb on_error) noexcept override
+  {
+    if (range.empty())
+    {
+      plate::async::request(url, "GET", "", [on_load] (std::uint32_t handle, plate::data_store&& d)
+      {
+        on_load(d.span(), 200);
 
-  return std::memcmp(data.data(), "data_", 5) == 0;
-}
+      }, [on_error] (std::uint32_t handle, int error_code, std::string error_msg)
+      {
+        on_error(error_code, error_msg);
+      },
+      {});
 
+      return;
+    }
 
-struct fp
-{
-  short vert[3];
-  short norm[3];
-  unsigned char col[4];
-};
+    auto range_query = std::make_shared<std::string>(range);
 
+    const char* headers[] = {"Range", range_query->data(), NULL};
+
+    plate::async::fetch_get(url, headers, [on_load, range_query] (std::size_t counter, plate::data_store&& d, std::uint16_t status)
+    {
+      on_load(d.span(), status);
+
+    }, [on_error, range_query] (std::size_t error_code, int error_msg)
+    {
+      on_error(error_code, std::to_string(error_msg));
+    });
+  }
+};
 
-void save_to_file(std::span<const char> data, std::string filename);
-void do_script();
-void visualise_atoms(const char* data, int size);
 
+// the pipeline's results kept in indexeddb, each a record named by its key. indexeddb cannot list its records, so
+// an index record of each result's size and last use is kept to trim by. uses are gathered for index_delay_ms after
+// the first, then the index is read once, updated with them, trimmed and written back, so scrubbing through stored
+// frames costs an index update a batch rather than one a frame. workers share the database without a lock, so the
+// index carries a version and the worker that last wrote it: an update is checked against the index just before it
+// is written and read back after, and merged again into the newer index if another worker's update came between.
+// the records trimmed are deleted only once the update that drops them has won
 
-// helper for handling a dcd frame extraction
-struct dcd_process : public std::enable_shared_from_this<dcd_process>
+class idb_store : public animol::result_store
 {
-  std::function< void ()> cb_;
 
-  int frame_;
+public:
+
+  static constexpr std::uint64_t max_bytes = 256 * 1024 * 1024;
+
+
+  void get(const std::string& key, load_cb on_load) noexcept override
+  {
+    auto cb = new std::pair<idb_store*, std::pair<std::string, load_cb>>(this, { key, std::move(on_load) });
+
+    emscripten_idb_async_load(db, key.c_str(), cb, [] (void* arg, void* buf, int size)
+    {
+      auto cb = static_cast<std::pair<idb_store*, std::pair<std::string, load_cb>>*>(arg);
+
+      cb->second.second({ static_cast<const char*>(buf), static_cast<std::size_t>(size) });
+
+      cb->first->used_.push_back({ cb->second.first, static_cast<std::uint32_t>(size) });
+      cb->first->update_index();
+
+      delete cb; // buf is freed by emscripten
+
+    }, [] (void* arg) // not stored
+    {
+      auto cb = static_cast<std::pair<idb_store*, std::pair<std::string, load_cb>>*>(arg);
+
+      cb->second.second({});
+
+      delete cb;
+    });
+  }
+
+
+  void put(const std::string& key, std::span<const char> data) noexcept override
+  {
+    if (data.empty() || data.size() > max_bytes)
+      return;
+
+    // the data is copied before the call returns
+
+    emscripten_idb_async_store(db, key.c_str(), const_cast<char*>(data.data()), data.size(), nullptr, [] (void*) {}, [] (void*)
+    {
+      log_debug("result store failed to store");
+    });
+
+    used_.push_back({ key, static_cast<std::uint32_t>(data.size()) });
+
+    update_index();
+  }
+
 
-  std::string psf_url_;
-  std::string dcd_url_;
+private:
 
-  int           number_atoms_;
-  std::uint64_t dcd_data_offset_;
+  static constexpr const char* db         = "animol_results";
+  static constexpr const char* index_name = "index";
 
-  animol::dcd2pdb converter_;
+  static constexpr int index_delay_ms = 1000;
+  static constexpr int max_retries    = 8;
 
-  bool keepCAs_;
-  bool keepNonCAs_;
 
-  std::string range_query_;
+  struct entry
+  {
+    char          key[32];
+    std::uint32_t size;
+    std::uint32_t used; // seconds
+  };
 
-  std::uint64_t get_frame_offset(int frame_id) const noexcept
+  struct index_header
   {
-    return dcd_data_offset_ + (frame_id * get_frame_size());
+    std::uint32_t version;
+    std::uint32_t writer;
+
+    bool operator==(const index_header&) const = default;
+  };
+
+  static_assert(sizeof(entry) % sizeof(index_header) == 0);
+
+  enum class step { merging, checking, verifying };
+
+
+  // update the index with the uses since it was last updated, index_delay_ms from now
+
+  void update_index() noexcept
+  {
+    if (updating_)
+      return; // the uses are added by the update waiting or in progress
+
+    updating_ = true;
+    step_     = step::merging;
+    retries_  = 0;
+
+    emscripten_async_call([] (void* arg)
+    {
+      static_cast<idb_store*>(arg)->load_index();
+
+    }, this, index_delay_ms);
   }
 
-  std::uint64_t get_frame_size() const noexcept
+
+  // read the index and take the next step of the update with it. an index written before it had a header is
+  // version 0
+
+  void load_index() noexcept
   {
-    // Each coordinate (x, y and z) has:
-    // 4 bytes for start_length
-    // 4 bytes for end_length
-    // 4 bytes per atom for the float cordinate
+    emscripten_idb_async_load(db, index_name, this, [] (void* arg, void* buf, int size)
+    {
+      auto self = static_cast<idb_store*>(arg);
+
+      index_header head{};
+      std::size_t  skip = 0;
+
+      if (size % sizeof(entry) == sizeof(index_header))
+      {
+        std::memcpy(&head, buf, sizeof(head));
+        skip = sizeof(head);
+      }
+
+      std::vector<entry> index((size - skip) / sizeof(entry));
+      std::memcpy(index.data(), static_cast<const char*>(buf) + skip, index.size() * sizeof(entry));
 
-    return (4 + 4 + (4 * number_atoms_)) * 3;
+      self->update_index(head, std::move(index));
+
+    }, [] (void* arg) // no index yet
+    {
+      static_cast<idb_store*>(arg)->update_index({}, {});
+    });
   }
 
 
-  bool start(char* data, int size)
+  // merge the uses into index, check it is still the latest before writing it, and verify the write was not
+  // overwritten, merging again into any newer index found
+
+  void update_index(index_header head, std::vector<entry> index) noexcept
   {
-    std::string_view s(data, size);
+    if (step_ == step::checking && head == base_)
+    {
+      store_index();
+      return;
+    }
 
-    auto msg = plate::json_parse_struct<animol::dcd2pdb::interface>(s);
+    if (step_ == step::verifying && head == written_)
+    {
+      for (auto& key : trimmed_)
+        emscripten_idb_async_delete(db, key.c_str(), nullptr, [] (void*) {}, [] (void*) {});
 
-    if (!msg.ok)
-    { 
-      log_debug(FMT_COMPILE("process dcd: unable to parse: {}"), size);
-      emscripten_worker_respond(nullptr, 0);
-      return false;
+      used_.erase(used_.begin(), used_.begin() + merged_);
+
+      finish_update();
+      return;
     }
 
-    frame_           = msg.data.frame;
-    psf_url_         = msg.data.psf_url;
-    dcd_url_         = msg.data.dcd_url;
-    number_atoms_    = msg.data.number_atoms;
-    dcd_data_offset_ = msg.data.dcd_data_offset;
+    if (step_ != step::merging && ++retries_ > max_retries)
+    {
+      log_debug("result store index is contended, its update is left for the next");
+
+      finish_update();
+      return;
+    }
+
+    merge(head, std::move(index));
+
+    step_ = step::checking;
+    load_index();
+  }
 
-    // load in psf file
 
-    plate::async::request(psf_url_, "GET", "", [this, self(shared_from_this())] (std::uint32_t handle, plate::data_store&& d)
+  // the index of base_ with the uses added and trimmed to max_bytes, to write
+
+  void merge(index_header head, std::vector<entry> index) noexcept
+  {
+    const auto now = static_cast<std::uint32_t>(std::time(nullptr));
+
+    for (auto& u : used_)
     {
-      if (!converter_.generate_template(d.span(), keepCAs_, keepNonCAs_))
+      auto it = std::find_if(index.begin(), index.end(), [&u] (const entry& e) { return u.first.compare(0, sizeof(e.key), e.key, sizeof(e.key)) == 0; });
+
+      if (it == index.end())
       {
-        log_debug("generate_template failed");
-        emscripten_worker_respond(nullptr, 0);
-        return;
+        it = index.insert(index.end(), entry{});
+        std::memcpy(it->key, u.first.data(), std::min(u.first.size(), sizeof(it->key)));
       }
 
-      if (number_atoms_ != converter_.get_number_of_atoms())
+      it->size = u.second;
+      it->used = now;
+    }
+
+    merged_ = used_.size();
+
+    trimmed_.clear();
+
+    std::uint64_t total = 0;
+
+    for (auto& e : index)
+      total += e.size;
+
+    if (total > max_bytes)
+    {
+      std::sort(index.begin(), index.end(), [] (const entry& a, const entry& b) { return a.used > b.used; });
+
+      while (total > max_bytes && !index.empty())
       {
-        log_debug(FMT_COMPILE("number of atoms mismatch, dcd has: {} psf has: {}"), number_atoms_, converter_.get_number_of_atoms());
-        emscripten_worker_respond(nullptr, 0);
-        return;
+        trimmed_.emplace_back(index.back().key, sizeof(index.back().key));
+
+        total -= index.back().size;
+        index.pop_back();
       }
+    }
 
-      // load in the data part of the dcd file for this frame
+    base_    = head;
+    written_ = { head.version + 1, writer_ };
 
-      range_query_ = fmt::format(FMT_COMPILE("bytes={}-{}"), get_frame_offset(frame_), get_frame_offset(frame_) + get_frame_size() - 1);
+    index_.resize(sizeof(index_header) + index.size() * sizeof(entry));
 
-      const char* headers[] = {"Range", range_query_.data(), NULL};
+    std::memcpy(index_.data(), &written_, sizeof(written_));
+    std::memcpy(index_.data() + sizeof(written_), index.data(), index.size() * sizeof(entry));
+  }
 
-      plate::async::fetch_get(dcd_url_, headers, [this, self] (std::size_t counter, plate::data_store&& d, std::uint16_t status)
-      {
-        if (!converter_.populate_template(d.span()))
-        {
-          log_debug("Unable to populate template");
-          emscripten_worker_respond(nullptr, 0);
-          return;
-        }
-
-        auto& r = converter_.get_pdb_data();
-
-        if (cb_)
-        {
-          save_to_file(std::span<const char>(r.data(), r.size()), "/i.pdb");
-          cb_();
-        }
-        else
-          visualise_atoms(r.data(), r.size());
-          
-      }, [] (std::size_t error_code, int error_msg)
-      {
-        log_debug(FMT_COMPILE("failed to download frame dcd range, error_code: {} msg: {}"), error_code, error_msg);
-        emscripten_worker_respond(nullptr, 0);
-      });
 
-    }, [] (std::uint32_t handle, int error_code, std::string error_msg)
+  void store_index() noexcept
+  {
+    emscripten_idb_async_store(db, index_name, index_.data(), index_.size(), this, [] (void* arg)
+    {
+      auto self = static_cast<idb_store*>(arg);
+
+      self->step_ = step::verifying;
+      self->load_index();
+
+    }, [] (void* arg)
     {
-      log_debug(FMT_COMPILE("failed to download psf_file, error_code: {} msg: {}"), error_code, error_msg);
+      log_debug("result store failed to store its index");
+
+      static_cast<idb_store*>(arg)->finish_update();
+    });
+  }
+
+
+  void finish_update() noexcept
+  {
+    updating_ = false;
 
-      emscripten_worker_respond(nullptr, 0);
-    },
-    {});
+    index_.clear();
+    trimmed_.clear();
 
-    return true;
+    if (!used_.empty())
+      update_index();
   }
+
+
+  std::vector<std::pair<std::string, std::uint32_t>> used_; // the keys and sizes used since the index was updated
+
+  bool updating_{false}; // an update is waiting or in progress
+
+  step         step_{step::merging};
+  int          retries_{0};
+  std::size_t  merged_{0}; // of used_ in index_
+
+  index_header base_{};    // the index merged into
+  index_header written_{}; // and as written
+
+  std::vector<char>        index_;
+  std::vector<std::string> trimmed_; // records dropped from index_
+
+  const std::uint32_t writer_{std::random_device{}()};
 };
 
 
-void save_to_file(std::span<const char> data, std::string filename)
-{
-  auto f = fopen(filename.c_str(), "w");
-  fwrite(data.data(), 1, data.size(), f);
-  fclose(f);
-}
+static animol::pipeline pipeline_(std::make_shared<async_fetcher>(), "/", std::make_shared<idb_store>());
+
+
+// respond with r followed by the statistics trailer, or with nothing on failure. when tracing, the events
+// recorded since the last response follow, even on failure
 
-void save_bytes_to_file(std::span<std::byte> data, std::string filename)
+static void respond(std::span<const char> r)
 {
-  auto f = fopen(filename.c_str(), "w");
-  fwrite(reinterpret_cast<char*>(data.data()), 1, data.size(), f);
-  fclose(f);
+  auto stats = animol::pipeline::take_stats();
+
+  static std::vector<char> response;
+
+  response.clear();
+
+  if (!r.empty())
+  {
+    stats.heap_high = emscripten_get_heap_size();
+
+    animol::decode_stats::append(r, stats, response);
+  }
+
+#ifdef PLATE_TRACE
+  plate::trace::append_to(response);
+#endif
+
+  if (response.empty())
+    emscripten_worker_respond(nullptr, 0);
+  else
+    emscripten_worker_respond(response.data(), response.size());
 }
 
 
-void read_from_file(std::vector<char>& data, std::string filename)
+// split data into: size_of_script, script_contents, remainder. returns false if too small
+
+static bool split_script(const char* fname, char* data, int size, std::string_view& script, std::string_view& remainder)
 {
-  auto f = fopen(filename.c_str(), "r");
+  if (size < 4)
+  {
+    log_debug(FMT_COMPILE("{}: size too small: {}"), fname, size);
+    return false;
+  }
 
-  fseek(f, 0, SEEK_END);
-  auto fsize = ftell(f);
-  fseek(f, 0, SEEK_SET);
+  std::uint32_t script_sz;
+  std::memcpy(&script_sz, data, 4);
 
-  data.resize(fsize);
+  if (script_sz + 4 >= static_cast<std::uint32_t>(size))
+  {
+    log_debug(FMT_COMPILE("{}: size too small for script and input: {} script_size: {}"), fname, size, script_sz);
+    return false;
+  }
 
-  fread(data.data(), 1, data.size(), f);
-  fclose(f);
+  script    = std::string_view(data + 4, script_sz);
+  remainder = std::string_view(data + 4 + script_sz, size - (script_sz + 4));
+
+  return true;
 }
 
 
+extern "C" {
+
 void end_worker(char* data, int size)
 {
   emscripten_worker_respond(nullptr, 0);
@@ -227,246 +419,270 @@ end_plot
 
 */
 
-void do_script()
+
+// data is the url of the pdb file, or a frame descriptor, to download and auto script
+
+void script(char* data, int size)
 {
-  //const char *argv[] = { "molauto", "-cpk", "-out", "/i.script", "/i.pdb" }; // -stick
-  const char *argv[] = { "molauto", "-out", "/i.script", "/i.pdb" };
-  
-  molauto(sizeof(argv) / sizeof(argv[0]), const_cast<char**>(argv));
-  
-  std::vector<char> script_file;
-  
-  read_from_file(script_file, "/i.script");
-  
-  emscripten_worker_respond(script_file.data(), script_file.size());
+  log_debug(FMT_COMPILE("scipt: {}"), std::string_view(data, size));
+
+  pipeline_.script({ data, static_cast<std::size_t>(size) }, respond);
 }
 
 
-// data is the url of the pdb file to download and auto script
+// data is the pdb file contents
 
-void script(char* data, int size)
+void script_with(char* data, int size)
 {
-  using namespace magic_enum::bitwise_operators;
+  pipeline_.script_contents(std::as_bytes(std::span<char>(data, size)), respond);
+}
 
-  std::string s(data, size);
 
-  log_debug(FMT_COMPILE("scipt: {}"), s);
+// data is an atom table
+
+void script_table(char* data, int size)
+{
+  pipeline_.script_table({ data, static_cast<std::size_t>(size) }, respond);
+}
 
-  if (s.starts_with("{")) // this is a combined dcd url
-  {
-    auto process = std::make_shared<dcd_process>();
 
-    process->cb_         = [] { do_script(); };
-    process->keepCAs_    = true;
-    process->keepNonCAs_ = false;
+// data is: size_of_script, script_contents, pdb_url file to download and decode
+
+void decode_url(char* data, int size, int options, bool with_table = false)
+{
+  std::string_view script, url;
 
-    process->start(data, size);
+  if (!split_script("decode_url", data, size, script, url))
+  {
+    emscripten_worker_respond(nullptr, 0);
     return;
   }
 
-  auto h = plate::async::request(s, "GET", "", [s] (std::uint32_t handle, plate::data_store&& d)
-  {
-    if (is_cif(d.span()))
-    {
-      animol::cif2pdb converter(d.span(), animol::cif2pdb::options::ca_atoms | animol::cif2pdb::options::sheet | animol::cif2pdb::options::helix);
+  pipeline_.decode(script, url, options, respond, with_table);
+}
 
-      auto r = converter.convert();
 
-      if (r)
-      {
-        //log_debug(FMT_COMPILE("script converted cif to: {}"), *r);
-        save_to_file(std::span<const char>(r->data(), r->size()), "/i.pdb");
-      }
-      else
-      {
-        log_debug("script failed to convert cif");
-        emscripten_worker_respond(nullptr, 0);
-        return;
-      }
-    }
-    else
-      save_bytes_to_file(d.span(), "/i.pdb");
+// data is: size_of_script, script_data, pdb_url
+
+void decode_url_color_interleaved(char* data, int size)
+{
+  decode_url(data, size, OPTION_COLOR | OPTION_INTERLEAVE);
+}
 
-    do_script();
 
-  }, [] (std::uint32_t handle, int error_code, std::string error_msg)
-  {
-    log_debug(FMT_COMPILE("failed to download, error_code: {} msg: {}"), error_code, error_msg);
+void decode_url_color_non_interleaved(char* data, int size)
+{
+  decode_url(data, size, OPTION_COLOR);
+}
 
-    emscripten_worker_respond(nullptr, 0);
-  },
-  {});
+
+void decode_url_no_color(char* data, int size)
+{
+  decode_url(data, size, 0);
 }
 
 
-// data is the pdb file contents
+// as decode_url_color_non_interleaved with spheres and cylinders as impostors. the colours follow the vertices, so
+// the viewer uploads them without splitting them out and tells those of the master frame by their hash
 
-void script_with(char* data, int size)
+void decode_url_color_non_interleaved_impostors(char* data, int size)
 {
-  save_to_file(std::span<char>(data, size), "/i.pdb");
-  
-  do_script();
+  decode_url(data, size, OPTION_COLOR | OPTION_IMPOSTORS);
 }
 
 
-void do_decode(int options)
+// as decode_url_color_non_interleaved_impostors with levels of detail, if the script sets its segments
+
+void decode_url_color_non_interleaved_lod(char* data, int size)
 {
-  vertex_clear();
+  decode_url(data, size, OPTION_COLOR | OPTION_IMPOSTORS | OPTION_LOD);
+}
+
 
-  const char *argv[] = { "molscript", "-vertex", "-s", "-in", "/i.script" };
-    
-  molscript(sizeof(argv) / sizeof(argv[0]), const_cast<char**>(argv));
+// positions and normals only, for frames drawn with the colours of another with the same vertices
 
-  char* cdata = nullptr;
-  int csize = compact(&cdata, options);
+void decode_url_no_color_impostors(char* data, int size)
+{
+  decode_url(data, size, OPTION_IMPOSTORS);
+}
 
-  emscripten_worker_respond(cdata, csize);
 
-  free(cdata);
+void decode_url_no_color_lod(char* data, int size)
+{
+  decode_url(data, size, OPTION_IMPOSTORS | OPTION_LOD);
 }
 
 
-// data is: size_of_script, script_contents, pdb_url file to download and decode
+// as decode_url_color_non_interleaved_impostors, followed by the atom table of the pdb for another layer to use
+
+void decode_url_color_non_interleaved_with_table(char* data, int size)
+{
+  decode_url(data, size, OPTION_COLOR | OPTION_IMPOSTORS, true);
+}
+
 
-void decode_url(char* data, int size, int options)
+// as decode_url_color_non_interleaved_with_table with levels of detail, if the script sets its segments
+
+void decode_url_color_non_interleaved_lod_with_table(char* data, int size)
 {
-  using namespace magic_enum::bitwise_operators;
+  decode_url(data, size, OPTION_COLOR | OPTION_IMPOSTORS | OPTION_LOD, true);
+}
 
-  if (size < 4)
-  {
-    log_debug(FMT_COMPILE("decode_url: size too small: {}"), size);
-    emscripten_worker_respond(nullptr, 0);
-  }
 
-  std::uint32_t script_sz;
-  std::memcpy(&script_sz, data, 4);
+void decode_url_no_color_with_table(char* data, int size)
+{
+  decode_url(data, size, OPTION_IMPOSTORS, true);
+}
 
-  if (script_sz + 4 >= size)
-  {
-    log_debug(FMT_COMPILE("decode_url: size too small for script and url: {}"), size);
-    emscripten_worker_respond(nullptr, 0);
-  }
 
-  std::span<char> script(data + 4, script_sz);
+void decode_url_no_color_lod_with_table(char* data, int size)
+{
+  decode_url(data, size, OPTION_IMPOSTORS | OPTION_LOD, true);
+}
 
-  std::string url(data + 4 + script_sz, size - (script_sz + 4));
 
-  save_to_file(script, "i.script");
+// data is: size_of_script, script_contents, pdb file contents
+
+void decode_contents(char* data, int size, int options, bool with_table = false)
+{
+  std::string_view script, contents;
 
-  if (url.starts_with("{")) // this is a combined dcd url
+  if (!split_script("decode_contents", data, size, script, contents))
   {
-    auto process = std::make_shared<dcd_process>();
-  
-    process->cb_         = [options] { do_decode(options); };
-    process->keepCAs_    = true;
-    process->keepNonCAs_ = false;
-  
-    process->start(data + 4 + script_sz, size - (script_sz + 4));
+    emscripten_worker_respond(nullptr, 0);
     return;
   }
 
-  auto h = plate::async::request(url, "GET", "", [url, options] (std::uint32_t handle, plate::data_store&& d)
-  {
-    if (is_cif(d.span()))
-    {
-      animol::cif2pdb converter(d.span(), animol::cif2pdb::options::ca_atoms | animol::cif2pdb::options::sheet | animol::cif2pdb::options::helix);
+  pipeline_.decode_contents(script, std::as_bytes(std::span(contents.data(), contents.size())), options, respond, with_table);
+}
 
-      auto r = converter.convert();
 
-      if (r)
-      {
-        //log_debug(FMT_COMPILE("decode_url converted cif to: {}"), *r);
-        save_to_file(std::span<const char>(r->data(), r->size()), "/i.pdb");
-      }
-      else
-      {
-        log_debug("decode_url failed to convert cif");
-        emscripten_worker_respond(nullptr, 0);
-        return;
-      }
-    }
-    else
-      save_bytes_to_file(d.span(), "/i.pdb");
+void decode_contents_color_interleaved(char* data, int size)
+{
+  decode_contents(data, size, OPTION_COLOR | OPTION_INTERLEAVE);
+}
 
-    do_decode(options);
 
-  }, [] (std::uint32_t handle, int error_code, std::string error_msg)
-  {
-    log_debug(FMT_COMPILE("failed to download, error_code: {} msg: {}"), error_code, error_msg);
-  
-    emscripten_worker_respond(nullptr, 0);
-  },
-  {});
+void decode_contents_color_non_interleaved(char* data, int size)
+{
+  decode_contents(data, size, OPTION_COLOR);
 }
 
 
-// data is: size_of_script, script_data, pdb_url
+void decode_contents_no_color(char* data, int size)
+{
+  decode_contents(data, size, 0);
+}
 
-void decode_url_color_interleaved(char* data, int size)
+
+void decode_contents_color_non_interleaved_impostors(char* data, int size)
 {
-  decode_url(data, size, OPTION_COLOR | OPTION_INTERLEAVE);
+  decode_contents(data, size, OPTION_COLOR | OPTION_IMPOSTORS);
 }
 
 
-void decode_url_color_non_interleaved(char* data, int size)
+void decode_contents_color_non_interleaved_lod(char* data, int size)
 {
-  decode_url(data, size, OPTION_COLOR);
+  decode_contents(data, size, OPTION_COLOR | OPTION_IMPOSTORS | OPTION_LOD);
 }
 
 
-void decode_url_no_color(char* data, int size)
+void decode_contents_no_color_impostors(char* data, int size)
 {
-  decode_url(data, size, 0);
+  decode_contents(data, size, OPTION_IMPOSTORS);
 }
 
 
-// data is: size_of_script, script_contents, pdb file contents
+void decode_contents_no_color_lod(char* data, int size)
+{
+  decode_contents(data, size, OPTION_IMPOSTORS | OPTION_LOD);
+}
+
 
-void decode_contents(char* data, int size, int options)
+void decode_contents_color_non_interleaved_with_table(char* data, int size)
 {
-  if (size < 4)
-  {
-    log_debug(FMT_COMPILE("decode_contents: size too small: {}"), size);
-    emscripten_worker_respond(nullptr, 0);
-  }
-    
-  std::uint32_t script_sz;
-  std::memcpy(&script_sz, data, 4);
-      
-  if (script_sz + 4 >= size)
+  decode_contents(data, size, OPTION_COLOR | OPTION_IMPOSTORS, true);
+}
+
+
+void decode_contents_color_non_interleaved_lod_with_table(char* data, int size)
+{
+  decode_contents(data, size, OPTION_COLOR | OPTION_IMPOSTORS | OPTION_LOD, true);
+}
+
+
+void decode_contents_no_color_with_table(char* data, int size)
+{
+  decode_contents(data, size, OPTION_IMPOSTORS, true);
+}
+
+
+void decode_contents_no_color_lod_with_table(char* data, int size)
+{
+  decode_contents(data, size, OPTION_IMPOSTORS | OPTION_LOD, true);
+}
+
+
+// data is: size_of_script, script_contents, atom table
+
+void decode_table(char* data, int size, int options)
+{
+  std::string_view script, table;
+
+  if (!split_script("decode_table", data, size, script, table))
   {
-    log_debug(FMT_COMPILE("decode_contents: size too small for script and pdb contents: {} script_size: {}"),
-                                                                                                size, script_sz);
     emscripten_worker_respond(nullptr, 0);
+    return;
   }
-    
-  std::span<char> script(data + 4, script_sz);
-    
-  save_to_file(script, "/i.script");
 
-  std::span<char> contents(data + 4 + script_sz, size - (script_sz + 4));
-  
-  save_to_file(contents, "/i.pdb");
+  pipeline_.decode_table(script, table, options, respond);
+}
+
+
+// spheres and cylinders are impostors
+
+void decode_table_color_non_interleaved(char* data, int size)
+{
+  decode_table(data, size, OPTION_COLOR | OPTION_IMPOSTORS);
+}
+
 
-  do_decode(options);
+void decode_table_color_non_interleaved_lod(char* data, int size)
+{
+  decode_table(data, size, OPTION_COLOR | OPTION_IMPOSTORS | OPTION_LOD);
 }
 
 
-void decode_contents_color_interleaved(char* data, int size)
+void decode_table_no_color(char* data, int size)
 {
-  decode_contents(data, size, OPTION_COLOR | OPTION_INTERLEAVE);
+  decode_table(data, size, OPTION_IMPOSTORS);
 }
 
 
-void decode_contents_color_non_interleaved(char* data, int size)
+void decode_table_no_color_lod(char* data, int size)
 {
-  decode_contents(data, size, OPTION_COLOR);
+  decode_table(data, size, OPTION_IMPOSTORS | OPTION_LOD);
 }
 
 
-void decode_contents_no_color(char* data, int size)
+// data is a geometry delta of a frame bundle followed by its reference, responded to with the frame
+
+void decode_delta(char* data, int size)
 {
-  decode_contents(data, size, 0);
+  std::span<const char> d(data, size);
+
+  auto coded = animol::geometry_delta::get_size(d);
+
+  static std::vector<char> out;
+
+  if (coded == 0 || coded > d.size() || !animol::geometry_delta::decode(d.first(coded), d.subspan(coded), out))
+  {
+    log_debug(FMT_COMPILE("decode_delta: bad delta of size: {} in: {}"), coded, d.size());
+    respond({});
+    return;
+  }
+
+  respond(out);
 }
 
 
@@ -474,63 +690,78 @@ void decode_contents_no_color(char* data, int size)
 
 void visualise_atoms(const char* data, int size)
 {
-  using namespace animol;
-
-  visualise v({data, static_cast<std::size_t>(size) });
+  animol::pipeline::make_atoms({ data, static_cast<std::size_t>(size) }, respond);
+}
 
-  std::vector<visualise::atom> res;
 
-  v.generate_atoms(res, visualise::ATOMS | visualise::HETATOMS | visualise::SHIFT_TO_CENTER_OF_MASS);
+// data is structure file contents in any supported format, possibly compressed
 
-  emscripten_worker_respond(reinterpret_cast<char*>(res.data()), res.size() * sizeof(visualise::atom));
+void visualise_atoms_contents(char* data, int size)
+{
+  pipeline_.atoms_contents(std::as_bytes(std::span<char>(data, size)), respond);
 }
 
+
+// data is the url of a structure file, or a frame descriptor
+
 void visualise_atoms_url(char* data, int size)
 {
-  using namespace magic_enum::bitwise_operators;
+  pipeline_.atoms({ data, static_cast<std::size_t>(size) }, respond);
+}
 
-  std::string url(data, size);
 
-  if (url.starts_with("{")) // this is a combined dcd url
-  {
-    auto process = std::make_shared<dcd_process>();
-      
-    process->keepCAs_    = true;
-    process->keepNonCAs_ = true;
-      
-    process->start(data, size);
-    return;
-  }
+// as visualise_atoms_contents and visualise_atoms_url, followed by the atom table of the pdb
 
-  auto h = plate::async::request(url, "GET", "", [url] (std::uint32_t handle, plate::data_store&& d)
-  {
-    if (is_cif(d.span()))
-    {
-      animol::cif2pdb converter(d.span(), animol::cif2pdb::options::ca_atoms | animol::cif2pdb::options::non_ca_atoms);
+void visualise_atoms_contents_with_table(char* data, int size)
+{
+  pipeline_.atoms_contents(std::as_bytes(std::span<char>(data, size)), respond, true);
+}
 
-      auto r = converter.convert();
 
-      if (r)
-      {
-        //log_debug(FMT_COMPILE("visualise_atoms_url converted cif to: {}"), *r);
-        visualise_atoms(r->data(), r->size());
-      }
-      else
-      {
-        log_debug("visualise_atoms_url failed to convert cif");
-        emscripten_worker_respond(nullptr, 0);
-      }
-    }
-    else
-      visualise_atoms(reinterpret_cast<char*>(d.data()), d.size());
+void visualise_atoms_url_with_table(char* data, int size)
+{
+  pipeline_.atoms({ data, static_cast<std::size_t>(size) }, respond, true);
+}
 
-  }, [] (std::uint32_t handle, int error_code, std::string error_msg)
-  {
-    log_debug(FMT_COMPILE("failed to download, error_code: {} msg: {}"), error_code, error_msg);
 
-    emscripten_worker_respond(nullptr, 0);
-  },
-  {});
+// data is an atom table
+
+void visualise_atoms_table(char* data, int size)
+{
+  animol::pipeline::atoms_table({ data, static_cast<std::size_t>(size) }, respond);
+}
+
+
+// as visualise_atoms_contents, visualise_atoms_url and their with_table forms, and visualise_atoms_table, with the
+// atoms in spatial order
+
+void visualise_atoms_contents_sorted(char* data, int size)
+{
+  pipeline_.atoms_contents(std::as_bytes(std::span<char>(data, size)), respond, false, true);
+}
+
+
+void visualise_atoms_url_sorted(char* data, int size)
+{
+  pipeline_.atoms({ data, static_cast<std::size_t>(size) }, respond, false, true);
+}
+
+
+void visualise_atoms_contents_sorted_with_table(char* data, int size)
+{
+  pipeline_.atoms_contents(std::as_bytes(std::span<char>(data, size)), respond, true, true);
+}
+
+
+void visualise_atoms_url_sorted_with_table(char* data, int size)
+{
+  pipeline_.atoms({ data, static_cast<std::size_t>(size) }, respond, true, true);
+}
+
+
+void visualise_atoms_table_sorted(char* data, int size)
+{
+  animol::pipeline::atoms_table({ data, static_cast<std::size_t>(size) }, respond, true);
 }
 
 
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "system/webgl/log.hpp"
+
+#include <string_view>
+#include <string>
+#include <span>
+#include <functional>
+#include <unordered_map>
+#include <fstream>
+#include <charconv>
+#include <limits>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+
+/*
+    how the decode pipeline reads its input: whole files, or byte ranges of them, by url. the worker fetches
+    with plate::async, native builds read local files (or files held in memory) with file_fetcher.
+
+    callbacks may be made before get returns (file_fetcher) or later (the worker), and data is only valid
+    during the callback.
+*/
+
+namespace animol {
+
+class fetcher
+{
+
+public:
+
+  using load_cb  = std::function<void (std::span<const std::byte> data, std::uint16_t status)>;
+  using error_cb = std::function<void (int error_code, std::string_view error_msg)>;
+
+
+  virtual ~fetcher()
+  {
+  }
+
+
+  // fetch url, or only range of it (a http Range value, eg. "bytes=0-99") if not empty. status is 200 if the
+  // whole file is given, which a server may do even when a range is asked for, and 206 for a range
+
+  virtual void get(const std::string& url, const std::string& range, load_cb on_load, error_cb on_error) noexcept = 0;
+};
+
+
+// local files, or files added in memory, read synchronously
+
+class file_fetcher : public fetcher
+{
+
+public:
+
+  // serve data for url rather than reading a file
+
+  void add(std::string url, std::string data) noexcept
+  {
+    memory_[std::move(url)] = std::move(data);
+  }
+
+
+  void get(const std::string& url, const std::string& range, load_cb on_load, error_cb on_error) noexcept override
+  {
+    std::uint64_t first = 0, last = std::numeric_limits<std::uint64_t>::max();
+
+    if (!range.empty() && !parse_range(range, first, last))
+    {
+      on_error(400, "bad range");
+      return;
+    }
+
+    const std::uint16_t status = range.empty() ? 200 : 206;
+
+    if (auto it = memory_.find(url); it != memory_.end())
+    {
+      std::string_view d(it->second);
+
+      if (first >= d.size() && !d.empty())
+      {
+        on_error(416, "range not satisfiable");
+        return;
+      }
+
+      d = d.substr(std::min<std::uint64_t>(first, d.size()), last == std::numeric_limits<std::uint64_t>::max() ? d.size() : last - first + 1);
+
+      on_load(std::as_bytes(std::span(d.data(), d.size())), status);
+      return;
+    }
+
+    std::ifstream in(url, std::ios::binary | std::ios::ate);
+
+    if (!in)
+    {
+      on_error(404, "cannot open file");
+      return;
+    }
+
+    std::uint64_t size = in.tellg();
+
+    if (first >= size && size)
+    {
+      on_error(416, "range not satisfiable");
+      return;
+    }
+
+    last = std::min(last, size - 1);
+
+    std::string buffer(size ? last - first + 1 : 0, '\0'); // local, as on_load may fetch again
+
+    in.seekg(first);
+    in.read(buffer.data(), buffer.size());
+
+    on_load(std::as_bytes(std::span(buffer.data(), buffer.size())), status);
+  }
+
+
+private:
+
+  // "bytes=first-last", last inclusive
+
+  static bool parse_range(std::string_view range, std::uint64_t& first, std::uint64_t& last) noexcept
+  {
+    if (!range.starts_with("bytes="))
+      return false;
+
+    range.remove_prefix(6);
+
+    auto dash = range.find('-');
+
+    if (dash == std::string_view::npos)
+      return false;
+
+    auto a = range.substr(0, dash), b = range.substr(dash + 1);
+
+    return std::from_chars(a.data(), a.data() + a.size(), first).ec == std::errc() &&
+           std::from_chars(b.data(), b.data() + b.size(), last).ec  == std::errc() && first <= last;
+  }
+
+
+  std::unordered_map<std::string, std::string> memory_;
+};
+
+} // namespace animol
@@ -0,0 +1,231 @@
+#pragma once
+
+#include "system/webgl/log.hpp"
+
+#include <string_view>
+#include <span>
+#include <vector>
+#include <optional>
+#include <array>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+
+/*
+    a frame bundle packs the structure files of a movie.plan dataset into one file, so the frames can be read
+    by range rather than with a request per file.
+
+      header        - 40 bytes, below
+      index         - number_frames * number_parts index_entry, frame major
+      payloads      - the files in index order. each is stored as is or zlib compressed, which the worker
+                      detects and inflates. those of geometry bundles start at multiples of 4 bytes
+
+    part 0 of a frame is its file from the movie.plan, part 1 (if present) its nonCA_ companion. parts of
+    neighbouring frames are adjacent, so a run of frames is a single range. frames are grouped into windows
+    of about window_bytes which are fetched whole.
+
+    all values are little endian.
+*/
+
+namespace animol {
+
+class frame_bundle
+{
+
+public:
+
+  static constexpr std::array<char, 4> magic = { 'A', 'M', 'B', 'N' };
+
+  static constexpr std::uint32_t version = 1;
+
+  static constexpr std::uint64_t window_bytes = 4 * 1024 * 1024;
+
+
+  // geometry bundles hold baked cartoon geometry rather than structure files: each frame is what the worker's
+  // decode_url_color_interleaved would return for it, or with non_interleaved its
+  // decode_url_color_non_interleaved_impostors, so can be uploaded directly. the viewer only uses non_interleaved
+  // bundles. with delta, a frame may instead be stored as a geometry_delta of an earlier frame, see
+  // geometry_delta.hpp
+
+  enum class bundle_flags : std::uint32_t { geometry = 1, delta = 2, non_interleaved = 4 };
+
+
+  struct header
+  {
+    char          magic[4];
+    std::uint32_t version;
+    std::uint32_t number_frames;
+    std::int32_t  master_frame;  // initial structure, -1 for the middle frame
+    std::uint32_t number_parts;  // 1, or 2 with nonCA_ files
+    std::uint32_t flags;         // bundle_flags
+    std::uint64_t index_offset;
+    std::uint64_t data_offset;
+  };
+
+  static_assert(sizeof(header) == 40);
+
+
+  struct index_entry
+  {
+    std::uint64_t offset;   // from the start of the file
+    std::uint32_t size;     // stored bytes, 0 if the part is missing
+    std::uint32_t raw_size; // bytes once inflated, equal to size if stored as is
+  };
+
+  static_assert(sizeof(index_entry) == 16);
+
+
+  static bool is_bundle(std::span<const std::byte> data) noexcept
+  {
+    return data.size() >= sizeof(header) && std::memcmp(data.data(), magic.data(), magic.size()) == 0;
+  }
+
+
+  static std::optional<header> read_header(std::span<const std::byte> data) noexcept
+  {
+    if (!is_bundle(data))
+      return std::nullopt;
+
+    header h;
+    std::memcpy(&h, data.data(), sizeof(h));
+
+    if (h.version != version || h.number_parts < 1 || h.number_parts > 2 || h.index_offset < sizeof(header) ||
+                                                               h.data_offset < get_index_end(h))
+    {
+      log_debug(FMT_COMPILE("bad frame bundle header, version: {} parts: {}"), h.version, h.number_parts);
+      return std::nullopt;
+    }
+
+    return h;
+  }
+
+
+  // bytes needed from the start of the file to read the index
+
+  static std::uint64_t get_index_end(const header& h) noexcept
+  {
+    return h.index_offset + static_cast<std::uint64_t>(h.number_frames) * h.number_parts * sizeof(index_entry);
+  }
+
+
+  // read the header and index from data, the start of the file, and group the frames into windows
+
+  bool open(std::span<const std::byte> data) noexcept
+  {
+    auto h = read_header(data);
+
+    if (!h || data.size() < get_index_end(*h))
+      return false;
+
+    header_ = *h;
+
+    index_.resize(header_.number_frames * header_.number_parts);
+
+    std::memcpy(index_.data(), data.data() + header_.index_offset, index_.size() * sizeof(index_entry));
+
+    window_.resize(header_.number_frames);
+    window_start_.clear();
+
+    std::uint64_t bytes = 0;
+
+    for (std::uint32_t f = 0; f < header_.number_frames; ++f)
+    {
+      auto [first, last] = get_frame_range(f);
+
+      if (window_start_.empty() || bytes + (last - first) > window_bytes)
+      {
+        window_start_.push_back(f);
+        bytes = 0;
+      }
+
+      bytes     += last - first;
+      window_[f] = window_start_.size() - 1;
+    }
+
+    window_start_.push_back(header_.number_frames);
+
+    return true;
+  }
+
+
+  const header& get_header() const noexcept
+  {
+    return header_;
+  }
+
+
+  bool is_geometry() const noexcept
+  {
+    return header_.flags & static_cast<std::uint32_t>(bundle_flags::geometry);
+  }
+
+
+  bool is_delta() const noexcept
+  {
+    return header_.flags & static_cast<std::uint32_t>(bundle_flags::delta);
+  }
+
+
+  bool is_non_interleaved() const noexcept
+  {
+    return header_.flags & static_cast<std::uint32_t>(bundle_flags::non_interleaved);
+  }
+
+
+  const index_entry& get_entry(int frame, int part) const noexcept
+  {
+    return index_[frame * header_.number_parts + part];
+  }
+
+
+  int get_number_windows() const noexcept
+  {
+    return window_start_.size() - 1;
+  }
+
+
+  int get_window(int frame) const noexcept
+  {
+    return window_[frame];
+  }
+
+
+  // file range [first, last) covering all parts of frame
+
+  std::pair<std::uint64_t, std::uint64_t> get_frame_range(int frame) const noexcept
+  {
+    auto first = index_.begin() + frame * header_.number_parts;
+
+    std::uint64_t begin = first->offset, end = first->offset;
+
+    for (auto e = first; e != first + header_.number_parts; ++e)
+      if (e->size)
+      {
+        begin = std::min(begin, e->offset);
+        end   = std::max(end,   e->offset + e->size);
+      }
+
+    return { begin, end };
+  }
+
+
+  // file range [first, last) of window
+
+  std::pair<std::uint64_t, std::uint64_t> get_window_range(int window) const noexcept
+  {
+    return { get_frame_range(window_start_[window]).first, get_frame_range(window_start_[window + 1] - 1).second };
+  }
+
+
+private:
+
+  header header_{};
+
+  std::vector<index_entry>   index_;
+  std::vector<int>           window_;       // by frame
+  std::vector<std::uint32_t> window_start_; // first frame of each window, then number_frames
+};
+
+} // namespace animol
@@ -0,0 +1,282 @@
+#pragma once
+
+#include "system/webgl/log.hpp"
+
+#include <span>
+#include <vector>
+#include <array>
+#include <optional>
+#include <algorithm>
+#include <limits>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+
+
+/*
+    bounds of a result: the worker appends a footer to cartoon geometry and to atoms giving the box about their
+    positions, their centroid, their counts and a hash of the result, so the viewer can scale to a frame as it
+    arrives without scanning it, and tell identical frames apart by hash. geometry with its colours after its
+    vertices has a hash of them too, of every level, so the viewer can tell a frame coloured as another without
+    comparing them.
+
+    the footer is the last sizeof(footer) bytes of the result, ending with its size and magic, so results without
+    one (eg. geometry baked before it) are read as before. it follows any lod table, and is of the finest level.
+    fields are only added to the end of the footer, with version raised.
+*/
+
+namespace animol {
+
+class geometry_bounds
+{
+
+public:
+
+  static constexpr char magic[4] = { 'A', 'M', 'B', 'D' };
+
+  static constexpr std::uint32_t version = 2;
+
+  static constexpr std::size_t sphere_size   = 12; // the impostor instances of compact, see vertex.c
+  static constexpr std::size_t cylinder_size = 20;
+
+
+  struct footer
+  {
+    std::uint32_t        version;
+    std::array<short, 3> min;
+    std::array<short, 3> max;
+    std::array<short, 3> centroid;
+    short                reserved;
+    std::uint32_t        vertices;  // triangle and strip vertices
+    std::uint32_t        instances; // spheres and cylinders, or atoms
+    std::uint64_t        hash;      // of the result before the footer
+    std::uint64_t        colors;    // of the colours following the vertices of each level, 0 if none do
+    std::uint32_t        size;      // sizeof(footer)
+    char                 magic[4];
+  };
+
+  static_assert(sizeof(footer) == 56);
+
+
+  // the bounds of compacted geometry g, of vertex_size bytes a vertex followed by color_size bytes a vertex of
+  // colours, with impostors following them if impostors. the footer is empty if g is not geometry
+
+  static footer of_geometry(std::span<const char> g, std::size_t vertex_size, std::size_t color_size, bool impostors) noexcept
+  {
+    reduction r;
+
+    footer f{};
+
+    std::int32_t h[2];
+
+    if (g.size() < sizeof(h))
+      return f;
+
+    std::memcpy(h, g.data(), sizeof(h));
+
+    auto vertices = static_cast<std::size_t>(h[0]) + h[1];
+
+    if (h[0] < 0 || h[1] < 0 || g.size() < sizeof(h) + vertices * (vertex_size + color_size))
+      return f;
+
+    r.add(g.data() + sizeof(h), vertices, vertex_size, 1);
+
+    f.vertices = vertices;
+    f.colors   = add_colors(g, vertex_size, color_size);
+
+    auto p = sizeof(h) + vertices * (vertex_size + color_size);
+
+    if (impostors && g.size() >= p + sizeof(h))
+    {
+      std::memcpy(h, g.data() + p, sizeof(h));
+
+      p += sizeof(h);
+
+      if (h[0] >= 0 && h[1] >= 0 && g.size() >= p + h[0] * sphere_size + h[1] * cylinder_size)
+      {
+        r.add(g.data() + p, h[0], sphere_size, 1);
+        r.add(g.data() + p + h[0] * sphere_size, h[1], cylinder_size, 2); // both ends
+
+        f.instances = h[0] + h[1];
+      }
+    }
+
+    r.get(f);
+
+    return f;
+  }
+
+
+  // the bounds of instances, each stride bytes starting with its position
+
+  static footer of_instances(std::span<const char> d, std::size_t stride) noexcept
+  {
+    reduction r;
+
+    footer f{};
+
+    f.instances = d.size() / stride;
+
+    r.add(d.data(), f.instances, stride, 1);
+    r.get(f);
+
+    return f;
+  }
+
+
+  // the hash of the counts and colours of geometry g, laid out as for of_geometry, continuing h as hash does. 0
+  // if it has none
+
+  static std::uint64_t add_colors(std::span<const char> g, std::size_t vertex_size, std::size_t color_size,
+                                                                     std::uint64_t h = 0xcbf29ce484222325) noexcept
+  {
+    std::int32_t n[2];
+
+    if (color_size == 0 || g.size() < sizeof(n))
+      return 0;
+
+    std::memcpy(n, g.data(), sizeof(n));
+
+    auto vertices = static_cast<std::size_t>(n[0]) + n[1];
+
+    if (n[0] < 0 || n[1] < 0 || g.size() < sizeof(n) + vertices * (vertex_size + color_size))
+      return 0;
+
+    return hash(g.subspan(sizeof(n) + vertices * vertex_size, vertices * color_size), hash(g.first(sizeof(n)), h));
+  }
+
+
+  // data followed by the footer f, hashed
+
+  static void append(std::span<const char> data, footer f, std::vector<char>& out) noexcept
+  {
+    f.version = version;
+    f.hash    = hash(data);
+    f.size    = sizeof(footer);
+
+    std::memcpy(f.magic, magic, sizeof(magic));
+
+    out.resize(data.size() + sizeof(footer));
+
+    std::memcpy(out.data(), data.data(), data.size());
+    std::memcpy(out.data() + data.size(), &f, sizeof(footer));
+  }
+
+
+  // remove the footer from the end of data, of char or const char, if it has one
+
+  template<class C>
+  static std::optional<footer> strip(std::span<C>& data) noexcept
+  {
+    if (data.size() < sizeof(footer))
+      return std::nullopt;
+
+    footer f;
+    std::memcpy(&f, data.data() + data.size() - sizeof(footer), sizeof(footer));
+
+    if (f.size != sizeof(footer) || std::memcmp(f.magic, magic, sizeof(magic)) != 0)
+      return std::nullopt;
+
+    data = data.first(data.size() - sizeof(footer));
+
+    return f;
+  }
+
+
+  // the largest distance from the centre along any axis, as the viewer scales by
+
+  static int get_extent(const footer& f) noexcept
+  {
+    int e = 0;
+
+    for (int c = 0; c < 3; ++c)
+      e = std::max({ e, std::abs(f.min[c]), std::abs(f.max[c]) });
+
+    return e;
+  }
+
+
+  // 64 bit fnv-1a over 8 bytes at a time, then the bytes left. not cryptographic, for telling frames apart. a
+  // hash is continued over more data by passing it as h
+
+  static std::uint64_t hash(std::span<const char> data, std::uint64_t h = 0xcbf29ce484222325) noexcept
+  {
+
+    std::size_t i = 0;
+
+    for (; i + 8 <= data.size(); i += 8)
+    {
+      std::uint64_t w;
+      std::memcpy(&w, data.data() + i, 8);
+
+      h = (h ^ w) * 0x100000001b3;
+      h ^= h >> 29;
+    }
+
+    for (; i < data.size(); ++i)
+      h = (h ^ static_cast<unsigned char>(data[i])) * 0x100000001b3;
+
+    return h;
+  }
+
+
+private:
+
+  // running min, max and sum of positions. each axis is reduced separately over plain arrays so the loops
+  // vectorise when built for simd
+
+  struct reduction
+  {
+    std::array<int, 3>          lo{ std::numeric_limits<int>::max(), std::numeric_limits<int>::max(), std::numeric_limits<int>::max() };
+    std::array<int, 3>          hi{ std::numeric_limits<int>::min(), std::numeric_limits<int>::min(), std::numeric_limits<int>::min() };
+    std::array<std::int64_t, 3> sum{};
+    std::uint64_t               count{0};
+
+
+    // count items of stride bytes from p, each starting with positions of 3 shorts
+
+    void add(const char* p, std::size_t count, std::size_t stride, int positions) noexcept
+    {
+      for (int k = 0; k < positions; ++k)
+        for (int c = 0; c < 3; ++c)
+        {
+          int l = lo[c], h = hi[c];
+          std::int64_t s = 0;
+
+          auto q = p + (k * 3 + c) * sizeof(short);
+
+          for (std::size_t i = 0; i < count; ++i, q += stride)
+          {
+            short v;
+            std::memcpy(&v, q, sizeof(v));
+
+            l  = std::min<int>(l, v);
+            h  = std::max<int>(h, v);
+            s += v;
+          }
+
+          lo[c] = l;
+          hi[c] = h;
+          sum[c] += s;
+        }
+
+      this->count += count * positions;
+    }
+
+
+    void get(footer& f) const noexcept
+    {
+      if (count == 0)
+        return;
+
+      for (int c = 0; c < 3; ++c)
+      {
+        f.min[c]      = lo[c];
+        f.max[c]      = hi[c];
+        f.centroid[c] = sum[c] / static_cast<std::int64_t>(count);
+      }
+    }
+  };
+};
+
+} // namespace animol
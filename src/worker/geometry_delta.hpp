@@ -0,0 +1,270 @@
+#pragma once
+
+#include "system/webgl/log.hpp"
+
+#include <span>
+#include <vector>
+#include <array>
+#include <optional>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+
+/*
+    temporal delta coding of baked geometry: consecutive frames of a trajectory run through the same script give
+    the same vertices in the same order, each moved a few quantisation steps. a frame the size of its reference
+    frame is coded as the difference of each 16 bit word from the reference's, zig-zagged so that small changes
+    either way are small numbers, then bit packed.
+
+      header   - 16 bytes, below
+      blocks   - of block_words words: a byte of their bit width w, then the words packed at w bits
+
+    each group of 8 words of a block is packed into exactly w bytes, so groups are byte aligned and are unpacked
+    with the constant shifts of their width rather than a bit at a time. the last block is padded with zeros to
+    a whole block. a block of unchanged words, eg. colours, is its width byte alone.
+
+    all values are little endian.
+*/
+
+namespace animol {
+
+class geometry_delta
+{
+
+public:
+
+  static constexpr char magic[4] = { 'A', 'M', 'D', 'L' };
+
+  static constexpr std::size_t block_words = 128;
+
+
+  struct header
+  {
+    char          magic[4];
+    std::uint32_t reference; // frame coded against
+    std::uint32_t raw_size;  // bytes decoded, the size of the reference
+    std::uint32_t size;      // bytes coded, including this header
+  };
+
+  static_assert(sizeof(header) == 16);
+
+
+  // frame coded against reference, or empty if it cannot be or would be no smaller
+
+  static std::vector<char> encode(std::span<const char> frame, std::span<const char> reference,
+                                                                           std::uint32_t reference_frame) noexcept
+  {
+    std::vector<char> out;
+
+    if (frame.size() != reference.size() || frame.size() % 2 != 0 || frame.empty())
+      return out;
+
+    out.resize(sizeof(header));
+
+    const std::size_t words = frame.size() / 2;
+
+    std::array<std::uint16_t, block_words> z;
+
+    for (std::size_t start = 0; start < words; start += block_words)
+    {
+      auto n = std::min(block_words, words - start);
+
+      std::uint16_t all = 0;
+
+      for (std::size_t i = 0; i < n; ++i)
+      {
+        z[i] = zigzag(load(frame.data(), start + i) - load(reference.data(), start + i));
+        all |= z[i];
+      }
+
+      std::fill(z.begin() + n, z.end(), 0);
+
+      const int width = std::bit_width(all);
+
+      out.push_back(static_cast<char>(width));
+
+      if (width)
+        pack(z, width, out);
+
+      if (out.size() >= frame.size())
+        return {};
+    }
+
+    header h;
+
+    std::memcpy(h.magic, magic, sizeof(magic));
+
+    h.reference = reference_frame;
+    h.raw_size  = frame.size();
+    h.size      = out.size();
+
+    std::memcpy(out.data(), &h, sizeof(h));
+
+    return out;
+  }
+
+
+  // the frame data is coded against, if data is coded
+
+  static std::optional<std::uint32_t> get_reference(std::span<const char> data) noexcept
+  {
+    if (data.size() < sizeof(header) || std::memcmp(data.data(), magic, sizeof(magic)) != 0)
+      return std::nullopt;
+
+    header h;
+    std::memcpy(&h, data.data(), sizeof(h));
+
+    return h.reference;
+  }
+
+
+  // the bytes coded of data, including its header, or 0 if data is not coded
+
+  static std::size_t get_size(std::span<const char> data) noexcept
+  {
+    if (!get_reference(data))
+      return 0;
+
+    header h;
+    std::memcpy(&h, data.data(), sizeof(h));
+
+    return h.size;
+  }
+
+
+  // decode data, coded against reference, to out
+
+  static bool decode(std::span<const char> data, std::span<const char> reference, std::vector<char>& out) noexcept
+  {
+    header h;
+
+    if (data.size() >= sizeof(header))
+      std::memcpy(&h, data.data(), sizeof(h));
+
+    if (data.size() < sizeof(header) || std::memcmp(h.magic, magic, sizeof(magic)) != 0 || h.size != data.size() ||
+                                                      h.raw_size != reference.size() || h.raw_size % 2 != 0)
+    {
+      log_debug(FMT_COMPILE("bad geometry delta of size: {} against reference of size: {}"), data.size(), reference.size());
+      return false;
+    }
+
+    out.resize(h.raw_size);
+
+    const std::size_t words = h.raw_size / 2;
+
+    auto p   = reinterpret_cast<const std::uint8_t*>(data.data()) + sizeof(header);
+    auto end = reinterpret_cast<const std::uint8_t*>(data.data()) + data.size();
+
+    for (std::size_t start = 0; start < words; start += block_words)
+    {
+      auto n = std::min(block_words, words - start);
+
+      const int width = p < end ? *p++ : 0xff;
+
+      if (width > 16 || static_cast<std::size_t>(end - p) < width * block_words / 8)
+      {
+        log_debug(FMT_COMPILE("bad geometry delta block at word: {} of: {}"), start, words);
+        return false;
+      }
+
+      auto r = reference.data() + start * 2;
+      auto o = out.data() + start * 2;
+
+      switch (width)
+      {
+        case 0:  std::memcpy(o, r, n * 2); break;
+        case 1:  unpack<1>(p, r, o, n);  break;
+        case 2:  unpack<2>(p, r, o, n);  break;
+        case 3:  unpack<3>(p, r, o, n);  break;
+        case 4:  unpack<4>(p, r, o, n);  break;
+        case 5:  unpack<5>(p, r, o, n);  break;
+        case 6:  unpack<6>(p, r, o, n);  break;
+        case 7:  unpack<7>(p, r, o, n);  break;
+        case 8:  unpack<8>(p, r, o, n);  break;
+        case 9:  unpack<9>(p, r, o, n);  break;
+        case 10: unpack<10>(p, r, o, n); break;
+        case 11: unpack<11>(p, r, o, n); break;
+        case 12: unpack<12>(p, r, o, n); break;
+        case 13: unpack<13>(p, r, o, n); break;
+        case 14: unpack<14>(p, r, o, n); break;
+        case 15: unpack<15>(p, r, o, n); break;
+        case 16: unpack<16>(p, r, o, n); break;
+      }
+
+      p += width * block_words / 8;
+    }
+
+    return p == end;
+  }
+
+
+private:
+
+  static std::uint16_t load(const char* p, std::size_t word) noexcept
+  {
+    std::uint16_t v;
+    std::memcpy(&v, p + word * 2, 2);
+
+    return v;
+  }
+
+
+  static std::uint16_t zigzag(int d) noexcept
+  {
+    auto s = static_cast<std::int16_t>(d);
+
+    return static_cast<std::uint16_t>((s << 1) ^ (s >> 15));
+  }
+
+
+  static std::uint16_t unzigzag(std::uint16_t z) noexcept
+  {
+    return (z >> 1) ^ static_cast<std::uint16_t>(-(z & 1));
+  }
+
+
+  // each group of 8 words to width bytes
+
+  static void pack(const std::array<std::uint16_t, block_words>& z, int width, std::vector<char>& out) noexcept
+  {
+    for (std::size_t g = 0; g < block_words; g += 8)
+    {
+      unsigned __int128 v = 0;
+
+      for (int k = 0; k < 8; ++k)
+        v |= static_cast<unsigned __int128>(z[g + k]) << (k * width);
+
+      auto b = reinterpret_cast<const char*>(&v);
+
+      out.insert(out.end(), b, b + width);
+    }
+  }
+
+
+  // n words of a block packed at W bits from p, added to reference
+
+  template<int W>
+  static void unpack(const std::uint8_t* p, const char* reference, char* out, std::size_t n) noexcept
+  {
+    constexpr std::uint16_t mask = (1u << W) - 1;
+
+    for (std::size_t g = 0; g < n; g += 8, p += W)
+    {
+      unsigned __int128 v = 0;
+      std::memcpy(&v, p, W);
+
+      const std::size_t m = std::min<std::size_t>(8, n - g);
+
+      for (std::size_t k = 0; k < m; ++k)
+      {
+        auto d = static_cast<std::uint16_t>(unzigzag(static_cast<std::uint16_t>(v >> (k * W)) & mask) +
+                                                                                     load(reference, g + k));
+        std::memcpy(out + (g + k) * 2, &d, 2);
+      }
+    }
+  }
+};
+
+} // namespace animol
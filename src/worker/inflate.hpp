@@ -0,0 +1,588 @@
+#pragma once
+
+#include "system/webgl/log.hpp"
+
+// https://www.rfc-editor.org/rfc/rfc1951 (deflate), rfc1950 (zlib), rfc1952 (gzip)
+
+#include <span>
+#include <string>
+#include <array>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+
+/*
+    self contained inflate for gzip and zlib wrapped deflate data, used so compressed structure and topology
+    files can be read directly.
+
+    huffman codes up to fast_bits_ long are decoded with a single table lookup, longer codes fall back to a
+    canonical decode. Output goes into a buffer pre-sized from the gzip trailer, so it is normally written
+    without reallocation.
+
+    the gzip crc is not checked (the transfer is already checked), but the decompressed size is.
+*/
+
+namespace animol {
+
+class inflate
+{
+
+public:
+
+  static bool is_gzip(std::span<const std::byte> data) noexcept
+  {
+    return data.size() >= 18 && data[0] == std::byte{0x1f} && data[1] == std::byte{0x8b} && data[2] == std::byte{8};
+  }
+
+
+  // zlib header: deflate with a 32k window and a valid check value. Other window sizes are not accepted as their
+  // first byte could be the start of a text file
+
+  static bool is_zlib(std::span<const std::byte> data) noexcept
+  {
+    if (data.size() < 6)
+      return false;
+
+    const auto cmf = static_cast<unsigned>(data[0]);
+    const auto flg = static_cast<unsigned>(data[1]);
+
+    return cmf == 0x78 && ((cmf << 8) | flg) % 31 == 0 && (flg & 0x20) == 0;
+  }
+
+
+  static bool is_compressed(std::span<const std::byte> data) noexcept
+  {
+    return is_gzip(data) || is_zlib(data);
+  }
+
+
+  // decompress gzip (including multiple members) or zlib data into out, returns false on error.
+  // size_hint is the expected size of zlib output if known (gzip records its own)
+
+  static bool decompress(std::span<const std::byte> data, std::string& out, std::size_t size_hint = 0) noexcept
+  {
+    if (is_gzip(data))
+      return gunzip(data, out);
+
+    if (is_zlib(data))
+    {
+      out.resize(size_hint ? size_hint : data.size() * 4);
+
+      inflate d(data.subspan(2), out);
+
+      d.op_ = 0;
+
+      if (!d.run())
+        return false;
+
+      out.resize(d.op_);
+      return true;
+    }
+
+    return false;
+  }
+
+
+private:
+
+
+  inflate(std::span<const std::byte> in, std::string& out) noexcept :
+    in_(reinterpret_cast<const std::uint8_t*>(in.data())),
+    end_(in_ + in.size()),
+    out_(out),
+    op_(out.size())
+  {
+  }
+
+
+  static bool gunzip(std::span<const std::byte> data, std::string& out) noexcept
+  {
+    out.clear();
+
+    while (is_gzip(data))
+    {
+      auto p = reinterpret_cast<const std::uint8_t*>(data.data());
+
+      const auto flags = p[3];
+
+      std::size_t pos = 10;
+
+      if (flags & 4) // FEXTRA
+      {
+        if (pos + 2 > data.size())
+          return false;
+
+        pos += 2 + (p[pos] | (p[pos + 1] << 8));
+      }
+
+      if (flags & 8) // FNAME
+        while (pos < data.size() && p[pos++] != 0) {}
+
+      if (flags & 16) // FCOMMENT
+        while (pos < data.size() && p[pos++] != 0) {}
+
+      if (flags & 2) // FHCRC
+        pos += 2;
+
+      if (pos + 8 > data.size())
+      {
+        log_debug(FMT_COMPILE("gzip: truncated header, size: {}"), data.size());
+        return false;
+      }
+
+      // the trailer of the last member gives the size, use it to size the output if this is the only member
+
+      const std::size_t start = out.size();
+
+      if (start == 0)
+      {
+        auto t = p + data.size() - 4;
+        std::uint32_t isize = t[0] | (t[1] << 8) | (t[2] << 16) | (static_cast<std::uint32_t>(t[3]) << 24);
+
+        out.resize(std::max<std::size_t>(isize, data.size() * 2));
+      }
+
+      inflate d(data.subspan(pos), out);
+
+      d.op_ = start;
+
+      if (!d.run())
+        return false;
+
+      auto used = reinterpret_cast<const std::byte*>(d.in_) - data.data();
+
+      if (used + 8 > std::ssize(data))
+      {
+        log_debug("gzip: missing trailer");
+        return false;
+      }
+
+      auto t = reinterpret_cast<const std::uint8_t*>(data.data()) + used + 4;
+      std::uint32_t isize = t[0] | (t[1] << 8) | (t[2] << 16) | (static_cast<std::uint32_t>(t[3]) << 24);
+
+      if (static_cast<std::uint32_t>(d.op_ - start) != isize)
+      {
+        log_debug(FMT_COMPILE("gzip: size mismatch: {} expected: {}"), d.op_ - start, isize);
+        return false;
+      }
+
+      out.resize(d.op_);
+
+      data = data.subspan(used + 8);
+    }
+
+    return true;
+  }
+
+
+  static constexpr int fast_bits_ = 10;
+
+
+  struct huffman
+  {
+    std::array<std::uint16_t, 16>              count;
+    std::array<std::uint16_t, 288>             symbol;
+    std::array<std::uint16_t, 1 << fast_bits_> fast; // symbol | length << 12, 0 if the code is longer than fast_bits_
+
+
+    bool build(const std::uint8_t* lengths, int n) noexcept
+    {
+      count.fill(0);
+      fast.fill(0);
+
+      for (int i = 0; i < n; ++i)
+        ++count[lengths[i]];
+
+      if (count[0] == n) // no codes, valid but cannot be used
+        return true;
+
+      int left = 1;
+
+      for (int len = 1; len < 16; ++len)
+      {
+        left <<= 1;
+        left -= count[len];
+
+        if (left < 0) // over subscribed
+          return false;
+      }
+
+      std::array<std::uint16_t, 16> offs;
+
+      offs[1] = 0;
+      for (int len = 1; len < 15; ++len)
+        offs[len + 1] = offs[len] + count[len];
+
+      for (int i = 0; i < n; ++i)
+        if (lengths[i] != 0)
+          symbol[offs[lengths[i]]++] = i;
+
+      // canonical codes, reversed as deflate stores them lsb first
+
+      std::array<std::uint16_t, 16> next;
+
+      int code = 0;
+      count[0] = 0;
+
+      for (int len = 1; len < 16; ++len)
+      {
+        code = (code + count[len - 1]) << 1;
+        next[len] = code;
+      }
+
+      for (int i = 0; i < n; ++i)
+      {
+        const int len = lengths[i];
+
+        if (len == 0 || len > fast_bits_)
+          continue;
+
+        const int c = next[len]++;
+
+        int r = 0;
+        for (int b = 0; b < len; ++b)
+          r |= ((c >> b) & 1) << (len - 1 - b);
+
+        for (int j = r; j < (1 << fast_bits_); j += 1 << len)
+          fast[j] = static_cast<std::uint16_t>(i | (len << 12));
+      }
+
+      return true;
+    }
+  };
+
+
+  inline void refill() noexcept
+  {
+    while (bitcnt_ <= 56)
+    {
+      if (in_ < end_)
+        bitbuf_ |= static_cast<std::uint64_t>(*in_++) << bitcnt_;
+      else
+        ++overrun_; // reading past the end gives zero bits, only an error if they are used
+
+      bitcnt_ += 8;
+    }
+  }
+
+
+  inline std::uint32_t bits(int n) noexcept
+  {
+    if (bitcnt_ < n)
+      refill();
+
+    const auto v = static_cast<std::uint32_t>(bitbuf_ & ((std::uint64_t{1} << n) - 1));
+
+    bitbuf_ >>= n;
+    bitcnt_ -= n;
+
+    return v;
+  }
+
+
+  // true if more bits have been used than were in the input
+
+  inline bool overrun() const noexcept
+  {
+    return overrun_ * 8 > bitcnt_;
+  }
+
+
+  inline int decode(const huffman& h) noexcept
+  {
+    if (bitcnt_ < 16)
+      refill();
+
+    if (auto e = h.fast[bitbuf_ & ((1 << fast_bits_) - 1)]; e)
+    {
+      const int len = e >> 12;
+
+      bitbuf_ >>= len;
+      bitcnt_ -= len;
+
+      return e & 0xfff;
+    }
+
+    int code = 0, first = 0, index = 0;
+
+    for (int len = 1; len < 16; ++len)
+    {
+      code |= (bitbuf_ >> (len - 1)) & 1;
+
+      const int count = h.count[len];
+
+      if (code - count < first)
+      {
+        bitbuf_ >>= len;
+        bitcnt_ -= len;
+
+        return h.symbol[index + (code - first)];
+      }
+
+      index += count;
+      first += count;
+      first <<= 1;
+      code  <<= 1;
+    }
+
+    return -1;
+  }
+
+
+  inline void ensure(std::size_t n) noexcept
+  {
+    if (op_ + n > out_.size())
+      out_.resize(std::max(out_.size() * 2, op_ + n + 65536));
+  }
+
+
+  bool run() noexcept
+  {
+    for (;;)
+    {
+      const auto last = bits(1);
+      const auto type = bits(2);
+
+      bool ok = false;
+
+      switch (type)
+      {
+        case 0: ok = stored(); break;
+        case 1: ok = fixed();  break;
+        case 2: ok = dynamic(); break;
+      }
+
+      if (!ok || overrun())
+      {
+        log_debug(FMT_COMPILE("inflate: bad block of type: {} at output: {}"), type, op_);
+        return false;
+      }
+
+      if (last)
+        break;
+    }
+
+    // return unused whole bytes, so the caller can find the trailer
+
+    while (bitcnt_ >= 8 && overrun_ > 0)
+    {
+      bitcnt_ -= 8;
+      --overrun_;
+    }
+
+    in_ -= bitcnt_ / 8;
+    bitcnt_ = 0;
+
+    return true;
+  }
+
+
+  bool stored() noexcept
+  {
+    // discard to a byte boundary, then any whole bytes still buffered are returned to the input
+
+    bits(bitcnt_ & 7);
+
+    while (bitcnt_ >= 8 && overrun_ > 0)
+    {
+      bitcnt_ -= 8;
+      --overrun_;
+    }
+
+    in_ -= bitcnt_ / 8;
+    bitbuf_ = 0;
+    bitcnt_ = 0;
+
+    if (end_ - in_ < 4)
+      return false;
+
+    const std::uint32_t len  = in_[0] | (in_[1] << 8);
+    const std::uint32_t nlen = in_[2] | (in_[3] << 8);
+
+    in_ += 4;
+
+    if (len != (~nlen & 0xffff) || static_cast<std::size_t>(end_ - in_) < len)
+      return false;
+
+    ensure(len);
+
+    std::memcpy(out_.data() + op_, in_, len);
+
+    op_ += len;
+    in_ += len;
+
+    return true;
+  }
+
+
+  bool fixed() noexcept
+  {
+    static const auto tables = []
+    {
+      std::array<huffman, 2> t;
+      std::array<std::uint8_t, 288> lengths;
+
+      for (int i = 0;   i < 144; ++i) lengths[i] = 8;
+      for (int i = 144; i < 256; ++i) lengths[i] = 9;
+      for (int i = 256; i < 280; ++i) lengths[i] = 7;
+      for (int i = 280; i < 288; ++i) lengths[i] = 8;
+
+      t[0].build(lengths.data(), 288);
+
+      lengths.fill(5);
+
+      t[1].build(lengths.data(), 30);
+
+      return t;
+    }();
+
+    return codes(tables[0], tables[1]);
+  }
+
+
+  bool dynamic() noexcept
+  {
+    static constexpr std::uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    const int nlen  = bits(5) + 257;
+    const int ndist = bits(5) + 1;
+    const int ncode = bits(4) + 4;
+
+    if (nlen > 286 || ndist > 30)
+      return false;
+
+    std::array<std::uint8_t, 320> lengths{};
+
+    for (int i = 0; i < ncode; ++i)
+      lengths[order[i]] = bits(3);
+
+    huffman lencode, distcode;
+
+    if (!lencode.build(lengths.data(), 19))
+      return false;
+
+    for (int i = 0; i < nlen + ndist;)
+    {
+      const int symbol = decode(lencode);
+
+      if (symbol < 0)
+        return false;
+
+      if (symbol < 16)
+      {
+        lengths[i++] = symbol;
+        continue;
+      }
+
+      int len = 0, repeat;
+
+      if (symbol == 16)
+      {
+        if (i == 0)
+          return false;
+
+        len    = lengths[i - 1];
+        repeat = 3 + bits(2);
+      }
+      else if (symbol == 17)
+        repeat = 3 + bits(3);
+      else
+        repeat = 11 + bits(7);
+
+      if (i + repeat > nlen + ndist)
+        return false;
+
+      while (repeat--)
+        lengths[i++] = len;
+    }
+
+    if (lengths[256] == 0) // no end of block code
+      return false;
+
+    if (!lencode.build(lengths.data(), nlen) || !distcode.build(lengths.data() + nlen, ndist))
+      return false;
+
+    return codes(lencode, distcode);
+  }
+
+
+  bool codes(const huffman& lencode, const huffman& distcode) noexcept
+  {
+    static constexpr std::uint16_t len_base[29]  = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                                     35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    static constexpr std::uint8_t  len_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                                     3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    static constexpr std::uint16_t dist_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                                     257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                                     8193, 12289, 16385, 24577 };
+    static constexpr std::uint8_t  dist_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                                      7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    for (;;)
+    {
+      int symbol = decode(lencode);
+
+      if (symbol < 0)
+        return false;
+
+      if (symbol < 256)
+      {
+        ensure(1);
+        out_[op_++] = static_cast<char>(symbol);
+        continue;
+      }
+
+      if (symbol == 256)
+        return true;
+
+      symbol -= 257;
+
+      if (symbol >= 29)
+        return false;
+
+      const std::size_t len = len_base[symbol] + bits(len_extra[symbol]);
+
+      symbol = decode(distcode);
+
+      if (symbol < 0 || symbol >= 30)
+        return false;
+
+      const std::size_t dist = dist_base[symbol] + bits(dist_extra[symbol]);
+
+      if (dist > op_)
+        return false;
+
+      if (overrun())
+        return false;
+
+      ensure(len);
+
+      auto dst = out_.data() + op_;
+      auto src = dst - dist;
+
+      if (dist >= len)
+        std::memcpy(dst, src, len);
+      else
+        for (std::size_t i = 0; i < len; ++i) // overlapping, repeats the last dist bytes
+          dst[i] = src[i];
+
+      op_ += len;
+    }
+  }
+
+
+  const std::uint8_t* in_;
+  const std::uint8_t* end_;
+
+  std::uint64_t bitbuf_{0};
+  int           bitcnt_{0};
+  int           overrun_{0}; // bytes of zero padding added after the end of input
+
+  std::string& out_;
+  std::size_t  op_;
+
+}; // class inflate
+
+} // namespace animol
@@ -0,0 +1,196 @@
+#pragma once
+
+#include "system/webgl/log.hpp"
+
+#include <string>
+#include <string_view>
+#include <span>
+#include <vector>
+#include <array>
+#include <charconv>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+
+/*
+    levels of detail of cartoon geometry: the molauto script is run at its own segments (the hermite segments
+    per residue of coils, helices and strands, which also set the sphere and cylinder tessellation), and again
+    at fewer, finest first. the compacted geometry of each level follows the one before, then a table of their
+    sizes and segments ending with its size and magic, so geometry without levels is read as a single level.
+
+    the viewer draws the coarsest level whose segments are no longer on screen than max_segment_pixels.
+*/
+
+namespace animol {
+
+class lod_table
+{
+
+public:
+
+  static constexpr char magic[4] = { 'A', 'M', 'L', 'D' };
+
+  static constexpr int max_levels = 3;
+
+  static constexpr float residue_length = 3.8; // angstroms between alpha carbons
+
+  static constexpr float max_segment_pixels = 4.0;
+
+
+  struct footer
+  {
+    std::uint32_t                           levels;
+    std::array<std::uint32_t, max_levels>   segments;
+    std::array<std::uint32_t, max_levels>   sizes;
+    std::uint32_t                           size;     // sizeof(footer)
+    char                                    magic[4];
+  };
+
+  static_assert(sizeof(footer) == 36);
+
+
+  // the segments of each level of script, finest first, or none if the script does not set them
+
+  static std::vector<int> get_segments(std::string_view script, int min_segments) noexcept
+  {
+    std::vector<int> r;
+
+    auto pos = find_segments(script, 0);
+
+    if (pos == std::string_view::npos)
+      return r;
+
+    int s = 0;
+
+    std::from_chars(script.data() + pos, script.data() + script.size(), s);
+
+    if (s <= 0)
+      return r;
+
+    for (int i = 0; i < max_levels && s >= min_segments; ++i, s /= 2)
+      if (r.empty() || r.back() != s)
+        r.push_back(s);
+
+    if (r.empty()) // already coarser than min_segments
+      r.push_back(s);
+
+    return r;
+  }
+
+
+  // script with all its segments set to segments
+
+  static std::string set_segments(std::string_view script, int segments)
+  {
+    std::string r;
+
+    std::size_t done = 0;
+
+    for (auto pos = find_segments(script, 0); pos != std::string_view::npos; pos = find_segments(script, pos))
+    {
+      r.append(script.substr(done, pos - done));
+      r.append(std::to_string(segments));
+
+      while (pos < script.size() && script[pos] >= '0' && script[pos] <= '9')
+        ++pos;
+
+      done = pos;
+    }
+
+    r.append(script.substr(done));
+
+    return r;
+  }
+
+
+  // append the table of levels, whose geometry is already in out, to out
+
+  static void append(std::span<const int> segments, std::span<const std::uint32_t> sizes, std::vector<char>& out) noexcept
+  {
+    footer f{};
+
+    f.levels = std::min<std::size_t>(sizes.size(), max_levels);
+
+    for (std::uint32_t i = 0; i < f.levels; ++i)
+    {
+      f.segments[i] = segments[i];
+      f.sizes[i]    = sizes[i];
+    }
+
+    f.size = sizeof(footer);
+    std::memcpy(f.magic, magic, sizeof(magic));
+
+    auto p = reinterpret_cast<const char*>(&f);
+
+    out.insert(out.end(), p, p + sizeof(footer));
+  }
+
+
+  // the levels of data, finest first, with their segments (0 if unknown). data without a table is one level,
+  // with a bad one none
+
+  static std::vector<std::pair<std::span<const char>, int>> get_levels(std::span<const char> data) noexcept
+  {
+    std::vector<std::pair<std::span<const char>, int>> r;
+
+    footer f;
+
+    if (data.size() >= sizeof(footer))
+      std::memcpy(&f, data.data() + data.size() - sizeof(footer), sizeof(footer));
+
+    if (data.size() < sizeof(footer) || f.size != sizeof(footer) || std::memcmp(f.magic, magic, sizeof(magic)) != 0)
+    {
+      r.push_back({ data, 0 });
+      return r;
+    }
+
+    std::uint64_t total = sizeof(footer);
+
+    for (std::uint32_t i = 0; i < f.levels && i < max_levels; ++i)
+      total += f.sizes[i];
+
+    if (f.levels == 0 || f.levels > max_levels || total != data.size())
+    {
+      log_debug(FMT_COMPILE("bad lod table of levels: {} in data of size: {}"), f.levels, data.size());
+      return r;
+    }
+
+    auto p = data.data();
+
+    for (std::uint32_t i = 0; i < f.levels; p += f.sizes[i], ++i)
+      r.push_back({ { p, f.sizes[i] }, static_cast<int>(f.segments[i]) });
+
+    return r;
+  }
+
+
+  // the level to draw, of levels with segments (finest first), when an angstrom is pixels_per_angstrom on screen
+
+  static int select(std::span<const int> segments, float pixels_per_angstrom) noexcept
+  {
+    int level = 0;
+
+    for (int i = 0; i < static_cast<int>(segments.size()); ++i)
+      if (segments[i] > 0 && residue_length * pixels_per_angstrom / segments[i] <= max_segment_pixels)
+        level = i;
+
+    return level;
+  }
+
+
+private:
+
+  // the position of the value of the next "set segments" from pos
+
+  static std::size_t find_segments(std::string_view script, std::size_t pos) noexcept
+  {
+    static constexpr std::string_view set = "set segments ";
+
+    pos = script.find(set, pos);
+
+    return pos == std::string_view::npos ? pos : pos + set.size();
+  }
+};
+
+} // namespace animol
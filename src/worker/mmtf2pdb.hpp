@@ -0,0 +1,830 @@
+#pragma once
+
+#include "system/webgl/log.hpp"
+
+// https://github.com/rcsb/mmtf/blob/master/spec.md
+
+#include <string_view>
+#include <string>
+#include <span>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <charconv>
+#include <limits>
+#include <bit>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+
+#include "magic_enum.hpp"
+
+#include "msgpack.hpp"
+#include "cif2pdb.hpp"
+
+
+/*
+    convert an MMTF file to pdb format, extracting the same information as cif2pdb does from text mmCIF.
+
+    MMTF is MessagePack encoded. Per atom data is stored as big endian binary columns with a 12 byte header
+    (codec, decoded length, parameter), using split-list, delta, run-length and integer packing codecs. Atom
+    names come from group (residue) templates so only coordinates are stored per atom.
+
+    Residue and chain naming follows the label_ fields as cif2pdb does. Secondary structure is taken from the
+    per group DSSP codes and written as HELIX and SHEET records (one sheet per strand). Bonds are stored in the
+    file, both within groups (from the templates) and between groups, so rather than leaving them to be found
+    by distance they are written as CONECT records for any bond to a HETATM, which molscript then uses directly.
+*/
+
+namespace animol {
+
+class mmtf2pdb
+{
+
+public:
+
+  using options = cif2pdb::options;
+
+
+  mmtf2pdb(std::span<const std::byte> mmtf_data, options o) noexcept :
+    data_(mmtf_data),
+    options_(o)
+  {
+  }
+
+
+  // MMTF files are a msgpack map, with the version and producer normally the first keys
+
+  static bool is_mmtf(std::span<const std::byte> data) noexcept
+  {
+    return msgpack::starts_with_map_key(data, "mmtfVersion") || msgpack::starts_with_map_key(data, "mmtfProducer");
+  }
+
+
+  std::string* convert() noexcept
+  {
+    msgpack::object root;
+
+    if (!msgpack::parse(data_, root))
+    {
+      log_debug("mmtf: unable to parse msgpack");
+      return nullptr;
+    }
+
+    if (!read_structure(root))
+      return nullptr;
+
+    if (!build_groups())
+      return nullptr;
+
+    write_secondary_structure();
+
+    if (!write_atoms())
+      return nullptr;
+
+    write_bonds(root);
+
+    return &pdb_;
+  }
+
+
+private:
+
+
+  // a group (residue) template
+
+  struct group_type
+  {
+    std::string_view              name;
+    std::vector<std::string_view> atom_names;
+    std::vector<std::int32_t>     bonds;     // pairs of atom indices within the group
+    bool                          polymer;   // chemCompType is a linking type
+  };
+
+
+  // a group instance
+
+  struct group
+  {
+    std::int32_t type;
+    std::int32_t seq_index;  // index into the entity sequence, -1 for non-polymer
+    std::int32_t chain;      // index into chain_ids_
+    std::int32_t first_atom;
+    std::int8_t  sec_struct; // DSSP code, -1 for undefined
+    bool         first_model;
+  };
+
+
+  bool read_structure(const msgpack::object& root) noexcept
+  {
+    auto group_list = root.find("groupList");
+
+    if (!group_list || !group_list->is_array())
+    {
+      log_debug("mmtf: missing groupList");
+      return false;
+    }
+
+    group_types_.resize(group_list->a.size());
+
+    for (std::size_t i = 0; i < group_types_.size(); ++i)
+    {
+      auto& g = group_list->a[i];
+      auto& t = group_types_[i];
+
+      auto name  = g.find("groupName");
+      auto atoms = g.find("atomNameList");
+
+      if (!name || !atoms || !atoms->is_array())
+      {
+        log_debug(FMT_COMPILE("mmtf: bad group type: {}"), i);
+        return false;
+      }
+
+      t.name = name->as_string();
+
+      t.atom_names.reserve(atoms->a.size());
+      for (auto& a : atoms->a)
+        t.atom_names.push_back(a.as_string());
+
+      if (auto bonds = g.find("bondAtomList"); bonds && bonds->is_array())
+      {
+        t.bonds.reserve(bonds->a.size());
+        for (auto& b : bonds->a)
+          t.bonds.push_back(b.as_int());
+      }
+
+      t.polymer = false;
+
+      if (auto type = g.find("chemCompType"))
+      {
+        std::string upper(type->as_string());
+
+        std::transform(upper.begin(), upper.end(), upper.begin(), [](unsigned char c) { return std::toupper(c); });
+
+        t.polymer = upper.find("LINKING") != std::string::npos;
+      }
+    }
+
+    if (!read_column(root, "xCoordList", x_) || !read_column(root, "yCoordList", y_) || !read_column(root, "zCoordList", z_))
+      return false;
+
+    if (!read_column(root, "groupTypeList", group_type_list_) || !read_column(root, "chainIdList", chain_ids_))
+      return false;
+
+    if (!read_column(root, "sequenceIndexList", sequence_index_list_))
+      return false;
+
+    if (root.find("secStructList") && !read_column(root, "secStructList", sec_struct_list_))
+      return false;
+
+    if (!read_int_array(root, "groupsPerChain", groups_per_chain_) || !read_int_array(root, "chainsPerModel", chains_per_model_))
+      return false;
+
+    if (x_.size() != y_.size() || x_.size() != z_.size())
+    {
+      log_debug(FMT_COMPILE("mmtf: coordinate lists differ in size: {} {} {}"), x_.size(), y_.size(), z_.size());
+      return false;
+    }
+
+    if (sequence_index_list_.size() != group_type_list_.size() ||
+        (!sec_struct_list_.empty() && sec_struct_list_.size() != group_type_list_.size()))
+    {
+      log_debug("mmtf: group lists differ in size");
+      return false;
+    }
+
+    return true;
+  }
+
+
+  // walk the model -> chain -> group hierarchy to find where each group's atoms start
+
+  bool build_groups() noexcept
+  {
+    groups_.reserve(group_type_list_.size());
+
+    std::size_t chain = 0;
+    std::size_t group_index = 0;
+    std::int32_t atom = 0;
+
+    for (std::size_t model = 0; model < chains_per_model_.size(); ++model)
+    {
+      for (std::int32_t c = 0; c < chains_per_model_[model]; ++c, ++chain)
+      {
+        if (chain >= groups_per_chain_.size() || chain >= chain_ids_.strings.size())
+        {
+          log_debug(FMT_COMPILE("mmtf: chain index: {} out of range"), chain);
+          return false;
+        }
+
+        for (std::int32_t g = 0; g < groups_per_chain_[chain]; ++g, ++group_index)
+        {
+          if (group_index >= group_type_list_.ints.size())
+          {
+            log_debug(FMT_COMPILE("mmtf: group index: {} out of range"), group_index);
+            return false;
+          }
+
+          auto type = group_type_list_.ints[group_index];
+
+          if (type < 0 || type >= std::ssize(group_types_))
+          {
+            log_debug(FMT_COMPILE("mmtf: bad group type: {}"), type);
+            return false;
+          }
+
+          groups_.push_back({ type, sequence_index_list_.ints[group_index], static_cast<std::int32_t>(chain), atom,
+                  static_cast<std::int8_t>(sec_struct_list_.empty() ? -1 : sec_struct_list_.ints[group_index]), model == 0 });
+
+          atom += group_types_[type].atom_names.size();
+        }
+      }
+    }
+
+    if (static_cast<std::size_t>(atom) != x_.floats.size())
+    {
+      log_debug(FMT_COMPILE("mmtf: group atoms: {} do not match coordinates: {}"), atom, x_.floats.size());
+      return false;
+    }
+
+    return true;
+  }
+
+
+  bool is_hetatm(const group& g) const noexcept
+  {
+    return !(g.seq_index >= 0 && group_types_[g.type].polymer);
+  }
+
+
+  // the label_seq_id as it would appear in the cif file
+
+  std::string_view seq_id(const group& g) noexcept
+  {
+    if (g.seq_index < 0)
+      return ".";
+
+    auto [p, ec] = std::to_chars(seq_buf_.data(), seq_buf_.data() + seq_buf_.size(), g.seq_index + 1);
+
+    return { seq_buf_.data(), static_cast<std::size_t>(p - seq_buf_.data()) };
+  }
+
+
+  bool write_atoms() noexcept
+  {
+    using namespace magic_enum::bitwise_operators;
+
+    const bool want_atoms = (options_ & options::ca_atoms) != options::none || (options_ & options::non_ca_atoms) != options::none;
+    const bool want_ca    = (options_ & options::ca_atoms)     != options::none;
+    const bool want_nca   = (options_ & options::non_ca_atoms) != options::none;
+    const bool want_het   = (options_ & options::hetatm)       != options::none;
+
+    if (!want_atoms && !want_het)
+      return true;
+
+    // serial numbers are written so bonds can be given as CONECT records, unless there are too many for the field
+
+    const bool use_serials = x_.floats.size() <= max_serial_;
+
+    if (use_serials)
+      serials_.assign(x_.floats.size(), 0);
+
+    pdb_.reserve(pdb_.size() + x_.floats.size() * 61);
+
+    int serial = 0;
+
+    for (auto& g : groups_)
+    {
+      auto& t = group_types_[g.type];
+
+      const bool het = is_hetatm(g);
+
+      if (het ? !want_het : !want_atoms)
+        continue;
+
+      auto comp = t.name;
+      auto asym = chain_ids_.strings[g.chain];
+      auto seq  = seq_id(g);
+
+      if (comp.size() > 3 || asym.size() > 2 || seq.size() > 4)
+      {
+        log_debug(FMT_COMPILE("bad length for group: {} chain: {} seq: {}"), comp, asym, seq);
+        return false;
+      }
+
+      for (std::size_t i = 0; i < t.atom_names.size(); ++i)
+      {
+        auto atom = t.atom_names[i];
+
+        if (atom.size() > 4)
+        {
+          log_debug(FMT_COMPILE("bad length: {} is greater than: 4 for: atom"), atom.size());
+          return false;
+        }
+
+        if (!het)
+        {
+          const bool isCA = (atom == "CA");
+
+          if (!((want_ca && isCA) || (want_nca && !isCA)))
+            continue;
+        }
+
+        const auto a = g.first_atom + i;
+
+        if (use_serials)
+          serials_[a] = ++serial;
+
+        cif2pdb::append_atom(pdb_, het ? "HETATM" : "ATOM", atom, comp, asym.empty() ? ' ' : asym[0], seq,
+                    x_.floats[a], y_.floats[a], z_.floats[a], use_serials ? serial : 0);
+      }
+    }
+
+    return true;
+  }
+
+
+  // DSSP codes: 0 pi helix, 1 bend, 2 alpha helix, 3 extended, 4 3-10 helix, 5 bridge, 6 turn, 7 coil
+
+  static int helix_class(std::int8_t ss) noexcept
+  {
+    switch (ss)
+    {
+      case 0: return 3;
+      case 2: return 1;
+      case 4: return 5;
+      default: return 0;
+    }
+  }
+
+
+  void write_secondary_structure() noexcept
+  {
+    using namespace magic_enum::bitwise_operators;
+
+    const bool want_helix = (options_ & options::helix) != options::none;
+    const bool want_sheet = (options_ & options::sheet) != options::none;
+
+    if ((!want_helix && !want_sheet) || sec_struct_list_.empty())
+      return;
+
+    int helix_serial = 0;
+    int strand_serial = 0;
+
+    for (std::size_t i = 0; i < groups_.size() && groups_[i].first_model;)
+    {
+      auto& beg = groups_[i];
+
+      const bool is_helix  = helix_class(beg.sec_struct) != 0;
+      const bool is_strand = beg.sec_struct == 3;
+
+      std::size_t j = i + 1;
+
+      while (j < groups_.size() && groups_[j].first_model && groups_[j].chain == beg.chain && groups_[j].sec_struct == beg.sec_struct)
+        ++j;
+
+      auto& end = groups_[j - 1];
+
+      i = j;
+
+      if (!(is_helix && want_helix) && !(is_strand && want_sheet))
+        continue;
+
+      auto asym = chain_ids_.strings[beg.chain];
+
+      if (asym.size() > 1 || beg.seq_index < 0 || end.seq_index < 0 ||
+          group_types_[beg.type].name.size() > 3 || group_types_[end.type].name.size() > 3)
+        continue;
+
+      auto seq_beg = std::to_string(beg.seq_index + 1);
+      auto seq_end = std::to_string(end.seq_index + 1);
+
+      if (seq_beg.size() > 4 || seq_end.size() > 4)
+        continue;
+
+      if (is_helix)
+      {
+        if (helix_serial + 1 >= 1000) // max 3 digits
+          continue;
+
+        ++helix_serial;
+
+        cif2pdb::append_helix(pdb_, helix_serial, std::to_string(helix_serial),
+                    group_types_[beg.type].name, asym, seq_beg, ' ',
+                    group_types_[end.type].name, asym, seq_end, ' ',
+                    std::to_string(helix_class(beg.sec_struct)), std::to_string(end.seq_index - beg.seq_index + 1));
+      }
+      else
+      {
+        if (strand_serial + 1 >= 1000)
+          continue;
+
+        ++strand_serial;
+
+        cif2pdb::append_sheet(pdb_, "1", std::to_string(strand_serial), 1,
+                    group_types_[beg.type].name, asym, seq_beg, ' ',
+                    group_types_[end.type].name, asym, seq_end, ' ', 0);
+      }
+    }
+  }
+
+
+  // write CONECT records for all bonds that involve a HETATM, with both atoms output
+
+  void write_bonds(const msgpack::object& root) noexcept
+  {
+    if (serials_.empty())
+      return;
+
+    std::vector<std::pair<std::int32_t, std::int32_t>> bonds; // (serial, bonded serial)
+
+    std::vector<bool> het_atom(serials_.size(), false);
+
+    for (auto& g : groups_)
+      if (is_hetatm(g))
+        std::fill_n(het_atom.begin() + g.first_atom, group_types_[g.type].atom_names.size(), true);
+
+    auto add = [&](std::int32_t a, std::int32_t b)
+    {
+      if (a < 0 || b < 0 || a >= std::ssize(serials_) || b >= std::ssize(serials_) || a == b)
+        return;
+
+      if (!(het_atom[a] || het_atom[b]) || serials_[a] == 0 || serials_[b] == 0)
+        return;
+
+      bonds.emplace_back(serials_[a], serials_[b]);
+      bonds.emplace_back(serials_[b], serials_[a]);
+    };
+
+    for (auto& g : groups_)
+    {
+      if (!is_hetatm(g))
+        continue;
+
+      auto& t = group_types_[g.type];
+
+      for (std::size_t i = 0; i + 1 < t.bonds.size(); i += 2)
+        if (t.bonds[i] < std::ssize(t.atom_names) && t.bonds[i + 1] < std::ssize(t.atom_names))
+          add(g.first_atom + t.bonds[i], g.first_atom + t.bonds[i + 1]);
+    }
+
+    if (root.find("bondAtomList"))
+    {
+      column inter;
+
+      if (read_column(root, "bondAtomList", inter))
+        for (std::size_t i = 0; i + 1 < inter.ints.size(); i += 2)
+          add(inter.ints[i], inter.ints[i + 1]);
+    }
+
+    if (bonds.empty())
+      return;
+
+    std::sort(bonds.begin(), bonds.end());
+    bonds.erase(std::unique(bonds.begin(), bonds.end()), bonds.end());
+
+    for (std::size_t i = 0; i < bonds.size();)
+    {
+      std::array<int, 4> b{};
+
+      std::size_t n = 0;
+
+      for (; n < 4 && i + n < bonds.size() && bonds[i + n].first == bonds[i].first; ++n)
+        b[n] = bonds[i + n].second;
+
+      cif2pdb::append_conect(pdb_, bonds[i].first, b[0], b[1], b[2], b[3]);
+
+      i += n;
+    }
+  }
+
+
+  // a decoded binary column
+
+  struct column
+  {
+    std::vector<std::int32_t>     ints;
+    std::vector<float>            floats;
+    std::vector<std::string_view> strings;
+
+
+    std::size_t size() const noexcept
+    {
+      return !floats.empty() ? floats.size() : !strings.empty() ? strings.size() : ints.size();
+    }
+
+
+    bool empty() const noexcept { return size() == 0; }
+  };
+
+
+  template<class T>
+  static inline T read_be(const std::byte* p) noexcept
+  {
+    T v;
+    std::memcpy(&v, p, sizeof(T));
+
+    if constexpr (std::endian::native == std::endian::little && sizeof(T) == 2)
+      v = static_cast<T>(__builtin_bswap16(static_cast<std::uint16_t>(v)));
+    else if constexpr (std::endian::native == std::endian::little && sizeof(T) == 4)
+      v = static_cast<T>(__builtin_bswap32(static_cast<std::uint32_t>(v)));
+
+    return v;
+  }
+
+
+  static bool read_int_array(const msgpack::object& root, std::string_view key, std::vector<std::int32_t>& out) noexcept
+  {
+    auto o = root.find(key);
+
+    if (!o || !o->is_array())
+    {
+      log_debug(FMT_COMPILE("mmtf: missing: {}"), key);
+      return false;
+    }
+
+    out.reserve(o->a.size());
+
+    for (auto& e : o->a)
+      out.push_back(e.as_int());
+
+    return true;
+  }
+
+
+  bool read_column(const msgpack::object& root, std::string_view key, column& c) noexcept
+  {
+    auto o = root.find(key);
+
+    if (!o || !o->is_binary())
+    {
+      log_debug(FMT_COMPILE("mmtf: missing: {}"), key);
+      return false;
+    }
+
+    if (!decode(o->as_bytes(), c))
+    {
+      log_debug(FMT_COMPILE("mmtf: unable to decode: {}"), key);
+      return false;
+    }
+
+    return true;
+  }
+
+
+  // codec ids from the spec
+
+  static bool decode(std::span<const std::byte> b, column& c) noexcept
+  {
+    if (b.size() < 12)
+      return false;
+
+    const auto codec  = read_be<std::int32_t>(b.data());
+    const auto length = read_be<std::int32_t>(b.data() + 4);
+    const auto param  = read_be<std::int32_t>(b.data() + 8);
+
+    if (length < 0)
+      return false;
+
+    auto d = b.subspan(12);
+
+    switch (codec)
+    {
+      case 1: // float32
+      {
+        c.floats.resize(d.size() / 4);
+        for (std::size_t i = 0; i < c.floats.size(); ++i)
+        {
+          auto u = read_be<std::uint32_t>(d.data() + i * 4);
+          std::memcpy(&c.floats[i], &u, 4);
+        }
+        break;
+      }
+
+      case 2:  widen<std::int8_t> (d, c.ints); break;
+      case 3:  widen<std::int16_t>(d, c.ints); break;
+      case 4:  widen<std::int32_t>(d, c.ints); break;
+
+      case 5: // fixed length strings, null padded
+      {
+        if (param <= 0)
+          return false;
+
+        const std::size_t n = d.size() / param;
+
+        c.strings.resize(n);
+
+        for (std::size_t i = 0; i < n; ++i)
+        {
+          std::string_view s(reinterpret_cast<const char*>(d.data()) + i * param, param);
+          c.strings[i] = s.substr(0, s.find('\0'));
+        }
+        break;
+      }
+
+      case 6: // run-length chars
+        widen<std::int32_t>(d, c.ints);
+        if (!run_length(c.ints, length))
+          return false;
+        break;
+
+      case 7:
+        widen<std::int32_t>(d, c.ints);
+        if (!run_length(c.ints, length))
+          return false;
+        break;
+
+      case 8:
+        widen<std::int32_t>(d, c.ints);
+        if (!run_length(c.ints, length))
+          return false;
+        delta(c.ints);
+        break;
+
+      case 9:
+        widen<std::int32_t>(d, c.ints);
+        if (!run_length(c.ints, length))
+          return false;
+        divide(c, param);
+        break;
+
+      case 10:
+        widen<std::int16_t>(d, c.ints);
+        recursive_index<std::int16_t>(c.ints, length);
+        delta(c.ints);
+        divide(c, param);
+        break;
+
+      case 11:
+        widen<std::int16_t>(d, c.ints);
+        divide(c, param);
+        break;
+
+      case 12:
+        widen<std::int16_t>(d, c.ints);
+        recursive_index<std::int16_t>(c.ints, length);
+        divide(c, param);
+        break;
+
+      case 13:
+        widen<std::int8_t>(d, c.ints);
+        recursive_index<std::int8_t>(c.ints, length);
+        divide(c, param);
+        break;
+
+      case 14:
+        widen<std::int16_t>(d, c.ints);
+        recursive_index<std::int16_t>(c.ints, length);
+        break;
+
+      case 15:
+        widen<std::int8_t>(d, c.ints);
+        recursive_index<std::int8_t>(c.ints, length);
+        break;
+
+      default:
+        log_debug(FMT_COMPILE("mmtf: unknown codec: {}"), codec);
+        return false;
+    }
+
+    const std::size_t n = c.size();
+
+    if (n != static_cast<std::size_t>(length))
+    {
+      log_debug(FMT_COMPILE("mmtf: decoded length: {} expected: {}"), n, length);
+      return false;
+    }
+
+    return true;
+  }
+
+
+  template<class T>
+  static void widen(std::span<const std::byte> b, std::vector<std::int32_t>& out) noexcept
+  {
+    const auto n = b.size() / sizeof(T);
+
+    out.resize(n);
+
+    const auto src = b.data();
+    const auto dst = out.data();
+
+    for (std::size_t i = 0; i < n; ++i)
+      dst[i] = static_cast<std::int32_t>(read_be<T>(src + i * sizeof(T)));
+  }
+
+
+  static bool run_length(std::vector<std::int32_t>& v, std::int32_t length) noexcept
+  {
+    std::vector<std::int32_t> out(length);
+
+    std::size_t pos = 0;
+
+    for (std::size_t i = 0; i + 1 < v.size(); i += 2)
+    {
+      const auto value = v[i];
+      const auto count = v[i + 1];
+
+      if (count < 0 || pos + count > out.size())
+      {
+        log_debug(FMT_COMPILE("mmtf: bad run length: {} at: {} of: {}"), count, pos, out.size());
+        return false;
+      }
+
+      std::fill_n(out.data() + pos, count, value);
+      pos += count;
+    }
+
+    v = std::move(out);
+
+    return pos == v.size();
+  }
+
+
+  static void delta(std::vector<std::int32_t>& v) noexcept
+  {
+    auto p = v.data();
+
+    for (std::size_t i = 1; i < v.size(); ++i)
+      p[i] += p[i - 1];
+  }
+
+
+  // values at the limits of the packed type continue into the next value
+
+  template<class T>
+  static void recursive_index(std::vector<std::int32_t>& v, std::int32_t length) noexcept
+  {
+    constexpr std::int32_t upper = std::numeric_limits<T>::max();
+    constexpr std::int32_t lower = std::numeric_limits<T>::min();
+
+    if (std::ssize(v) == length) // nothing was split
+      return;
+
+    std::vector<std::int32_t> out(length);
+
+    std::size_t j = 0;
+
+    for (std::size_t i = 0; i < out.size() && j < v.size(); ++i)
+    {
+      std::int32_t value = 0;
+      std::int32_t t = v[j];
+
+      while ((t == upper || t == lower) && j + 1 < v.size())
+      {
+        value += t;
+        t = v[++j];
+      }
+
+      out[i] = value + t;
+      ++j;
+    }
+
+    v = std::move(out);
+  }
+
+
+  static void divide(column& c, std::int32_t divisor) noexcept
+  {
+    const auto n = c.ints.size();
+
+    c.floats.resize(n);
+
+    const float f = static_cast<float>(divisor ? divisor : 1);
+
+    const auto src = c.ints.data();
+    const auto dst = c.floats.data();
+
+    for (std::size_t i = 0; i < n; ++i)
+      dst[i] = static_cast<float>(src[i]) / f;
+
+    c.ints.clear();
+  }
+
+
+  static constexpr std::size_t max_serial_ = 99999; // 5 digit pdb field
+
+
+  std::span<const std::byte> data_;
+
+  options options_;
+
+  std::string pdb_; // output
+
+  std::vector<group_type> group_types_;
+  std::vector<group>      groups_;
+
+  column x_, y_, z_;
+  column group_type_list_, chain_ids_, sequence_index_list_, sec_struct_list_;
+
+  std::vector<std::int32_t> groups_per_chain_;
+  std::vector<std::int32_t> chains_per_model_;
+
+  std::vector<std::int32_t> serials_; // per atom serial, 0 if not output
+
+  std::array<char, 12> seq_buf_;
+
+}; // class mmtf2pdb
+
+} // namespace animol
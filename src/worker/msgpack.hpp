@@ -0,0 +1,307 @@
+#pragma once
+
+#include "system/webgl/log.hpp"
+
+// https://github.com/msgpack/msgpack/blob/master/spec.md
+
+#include <string_view>
+#include <span>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <bit>
+
+
+/*
+    minimal non-owning MessagePack reader, used by the binary structure formats (BinaryCIF and MMTF)
+
+    the whole document is parsed into a tree of objects. strings and binary blobs are views into the
+    source data, which must outlive the tree.
+*/
+
+namespace animol {
+
+class msgpack
+{
+
+public:
+
+  enum class type { nil, boolean, integer, floating, string, binary, array, map };
+
+
+  struct object
+  {
+    type t{type::nil};
+
+    std::int64_t     i{0};    // boolean and integer
+    double           d{0};    // floating
+    std::string_view s;       // string and binary
+
+    std::vector<object> a;    // array entries, or for a map: key, value, key, value..
+
+
+    bool is_nil()    const noexcept { return t == type::nil; }
+    bool is_array()  const noexcept { return t == type::array; }
+    bool is_map()    const noexcept { return t == type::map; }
+    bool is_string() const noexcept { return t == type::string; }
+    bool is_binary() const noexcept { return t == type::binary; }
+
+    bool is_number() const noexcept { return t == type::integer || t == type::floating; }
+
+
+    // lookup a key in a map, returns nullptr if not found
+
+    const object* find(std::string_view key) const noexcept
+    {
+      if (t != type::map)
+        return nullptr;
+
+      for (std::size_t j = 0; j + 1 < a.size(); j += 2)
+        if (a[j].t == type::string && a[j].s == key)
+          return &a[j + 1];
+
+      return nullptr;
+    }
+
+
+    std::int64_t as_int(std::int64_t def = 0) const noexcept
+    {
+      if (t == type::integer || t == type::boolean) return i;
+      if (t == type::floating) return static_cast<std::int64_t>(d);
+
+      return def;
+    }
+
+
+    double as_double(double def = 0) const noexcept
+    {
+      if (t == type::floating) return d;
+      if (t == type::integer)  return static_cast<double>(i);
+
+      return def;
+    }
+
+
+    std::string_view as_string() const noexcept
+    {
+      return (t == type::string || t == type::binary) ? s : std::string_view{};
+    }
+
+
+    std::span<const std::byte> as_bytes() const noexcept
+    {
+      return { reinterpret_cast<const std::byte*>(s.data()), s.size() };
+    }
+
+
+    // number of entries in an array or pairs in a map
+
+    std::size_t size() const noexcept
+    {
+      return t == type::map ? a.size() / 2 : a.size();
+    }
+  };
+
+
+  // parse the first object in data into o, returns false if the data is malformed
+
+  static bool parse(std::span<const std::byte> data, object& o) noexcept
+  {
+    auto p = reinterpret_cast<const std::uint8_t*>(data.data());
+
+    return parse_object(p, p + data.size(), o, 0);
+  }
+
+
+  // cheap check to see if data looks like it starts with a msgpack map containing the given key in the first few entries
+
+  static bool starts_with_map_key(std::span<const std::byte> data, std::string_view key) noexcept
+  {
+    if (data.size() < key.size() + 2)
+      return false;
+
+    auto c = static_cast<std::uint8_t>(data[0]);
+
+    if (!((c & 0xf0) == 0x80 || c == 0xde || c == 0xdf)) // fixmap, map16 or map32
+      return false;
+
+    auto search = std::string_view(reinterpret_cast<const char*>(data.data()), std::min<std::size_t>(data.size(), 256));
+
+    return search.find(key) != std::string_view::npos;
+  }
+
+
+private:
+
+
+  static constexpr int max_depth_ = 64;
+
+
+  template<class T>
+  static inline T read_be(const std::uint8_t* p) noexcept
+  {
+    T v;
+    std::memcpy(&v, p, sizeof(T));
+
+    if constexpr (std::endian::native == std::endian::little && sizeof(T) > 1)
+      v = byteswap(v);
+
+    return v;
+  }
+
+
+  template<class T>
+  static inline T byteswap(T v) noexcept
+  {
+    if constexpr (sizeof(T) == 2)
+    {
+      std::uint16_t u; std::memcpy(&u, &v, 2); u = __builtin_bswap16(u); std::memcpy(&v, &u, 2);
+    }
+    else if constexpr (sizeof(T) == 4)
+    {
+      std::uint32_t u; std::memcpy(&u, &v, 4); u = __builtin_bswap32(u); std::memcpy(&v, &u, 4);
+    }
+    else if constexpr (sizeof(T) == 8)
+    {
+      std::uint64_t u; std::memcpy(&u, &v, 8); u = __builtin_bswap64(u); std::memcpy(&v, &u, 8);
+    }
+
+    return v;
+  }
+
+
+  static bool parse_bytes(const std::uint8_t*& p, const std::uint8_t* end, std::size_t len, type t, object& o) noexcept
+  {
+    if (static_cast<std::size_t>(end - p) < len)
+      return false;
+
+    o.t = t;
+    o.s = std::string_view(reinterpret_cast<const char*>(p), len);
+    p += len;
+
+    return true;
+  }
+
+
+  static bool parse_array(const std::uint8_t*& p, const std::uint8_t* end, std::size_t len, object& o, int depth) noexcept
+  {
+    if (static_cast<std::size_t>(end - p) < len) // each entry is at least 1 byte
+      return false;
+
+    o.t = type::array;
+    o.a.resize(len);
+
+    for (auto& e : o.a)
+      if (!parse_object(p, end, e, depth + 1))
+        return false;
+
+    return true;
+  }
+
+
+  static bool parse_map(const std::uint8_t*& p, const std::uint8_t* end, std::size_t len, object& o, int depth) noexcept
+  {
+    if (static_cast<std::size_t>(end - p) < len * 2)
+      return false;
+
+    o.t = type::map;
+    o.a.resize(len * 2);
+
+    for (auto& e : o.a)
+      if (!parse_object(p, end, e, depth + 1))
+        return false;
+
+    return true;
+  }
+
+
+  template<class T>
+  static bool need(const std::uint8_t* p, const std::uint8_t* end) noexcept
+  {
+    return static_cast<std::size_t>(end - p) >= sizeof(T);
+  }
+
+
+  static bool parse_object(const std::uint8_t*& p, const std::uint8_t* end, object& o, int depth) noexcept
+  {
+    if (p >= end || depth > max_depth_)
+      return false;
+
+    const std::uint8_t c = *p++;
+
+    if (c <= 0x7f) { o.t = type::integer; o.i = c; return true; }                              // positive fixint
+    if (c >= 0xe0) { o.t = type::integer; o.i = static_cast<std::int8_t>(c); return true; }    // negative fixint
+
+    if ((c & 0xf0) == 0x80) return parse_map(p, end, c & 0x0f, o, depth);                      // fixmap
+    if ((c & 0xf0) == 0x90) return parse_array(p, end, c & 0x0f, o, depth);                    // fixarray
+    if ((c & 0xe0) == 0xa0) return parse_bytes(p, end, c & 0x1f, type::string, o);             // fixstr
+
+    switch (c)
+    {
+      case 0xc0: o.t = type::nil; return true;
+      case 0xc2: o.t = type::boolean; o.i = 0; return true;
+      case 0xc3: o.t = type::boolean; o.i = 1; return true;
+
+      case 0xc4: if (!need<std::uint8_t>(p, end))  return false; p += 1; return parse_bytes(p, end, read_be<std::uint8_t>(p - 1),  type::binary, o);
+      case 0xc5: if (!need<std::uint16_t>(p, end)) return false; p += 2; return parse_bytes(p, end, read_be<std::uint16_t>(p - 2), type::binary, o);
+      case 0xc6: if (!need<std::uint32_t>(p, end)) return false; p += 4; return parse_bytes(p, end, read_be<std::uint32_t>(p - 4), type::binary, o);
+
+      case 0xc7: case 0xc8: case 0xc9: // ext, skipped
+      {
+        std::size_t len;
+        if (c == 0xc7) { if (!need<std::uint8_t>(p, end))  return false; len = read_be<std::uint8_t>(p);  p += 1; }
+        if (c == 0xc8) { if (!need<std::uint16_t>(p, end)) return false; len = read_be<std::uint16_t>(p); p += 2; }
+        if (c == 0xc9) { if (!need<std::uint32_t>(p, end)) return false; len = read_be<std::uint32_t>(p); p += 4; }
+
+        if (static_cast<std::size_t>(end - p) < len + 1)
+          return false;
+
+        p += len + 1;
+        o.t = type::nil;
+        return true;
+      }
+
+      case 0xca: if (!need<float>(p, end))  return false; o.t = type::floating; o.d = read_be<float>(p);  p += 4; return true;
+      case 0xcb: if (!need<double>(p, end)) return false; o.t = type::floating; o.d = read_be<double>(p); p += 8; return true;
+
+      case 0xcc: if (!need<std::uint8_t>(p, end))  return false; o.t = type::integer; o.i = read_be<std::uint8_t>(p);  p += 1; return true;
+      case 0xcd: if (!need<std::uint16_t>(p, end)) return false; o.t = type::integer; o.i = read_be<std::uint16_t>(p); p += 2; return true;
+      case 0xce: if (!need<std::uint32_t>(p, end)) return false; o.t = type::integer; o.i = read_be<std::uint32_t>(p); p += 4; return true;
+      case 0xcf: if (!need<std::uint64_t>(p, end)) return false; o.t = type::integer; o.i = read_be<std::uint64_t>(p); p += 8; return true;
+
+      case 0xd0: if (!need<std::int8_t>(p, end))  return false; o.t = type::integer; o.i = read_be<std::int8_t>(p);  p += 1; return true;
+      case 0xd1: if (!need<std::int16_t>(p, end)) return false; o.t = type::integer; o.i = read_be<std::int16_t>(p); p += 2; return true;
+      case 0xd2: if (!need<std::int32_t>(p, end)) return false; o.t = type::integer; o.i = read_be<std::int32_t>(p); p += 4; return true;
+      case 0xd3: if (!need<std::int64_t>(p, end)) return false; o.t = type::integer; o.i = read_be<std::int64_t>(p); p += 8; return true;
+
+      case 0xd4: case 0xd5: case 0xd6: case 0xd7: case 0xd8: // fixext, skipped
+      {
+        std::size_t len = 1 + (std::size_t{1} << (c - 0xd4));
+
+        if (static_cast<std::size_t>(end - p) < len)
+          return false;
+
+        p += len;
+        o.t = type::nil;
+        return true;
+      }
+
+      case 0xd9: if (!need<std::uint8_t>(p, end))  return false; p += 1; return parse_bytes(p, end, read_be<std::uint8_t>(p - 1),  type::string, o);
+      case 0xda: if (!need<std::uint16_t>(p, end)) return false; p += 2; return parse_bytes(p, end, read_be<std::uint16_t>(p - 2), type::string, o);
+      case 0xdb: if (!need<std::uint32_t>(p, end)) return false; p += 4; return parse_bytes(p, end, read_be<std::uint32_t>(p - 4), type::string, o);
+
+      case 0xdc: if (!need<std::uint16_t>(p, end)) return false; p += 2; return parse_array(p, end, read_be<std::uint16_t>(p - 2), o, depth);
+      case 0xdd: if (!need<std::uint32_t>(p, end)) return false; p += 4; return parse_array(p, end, read_be<std::uint32_t>(p - 4), o, depth);
+
+      case 0xde: if (!need<std::uint16_t>(p, end)) return false; p += 2; return parse_map(p, end, read_be<std::uint16_t>(p - 2), o, depth);
+      case 0xdf: if (!need<std::uint32_t>(p, end)) return false; p += 4; return parse_map(p, end, read_be<std::uint32_t>(p - 4), o, depth);
+    }
+
+    log_debug(FMT_COMPILE("msgpack: unknown type byte: {:#x}"), c);
+
+    return false;
+  }
+
+}; // class msgpack
+
+} // namespace animol
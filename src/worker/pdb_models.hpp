@@ -0,0 +1,146 @@
+#pragma once
+
+#include "system/webgl/log.hpp"
+
+// pdb files holding a trajectory as MODEL / ENDMDL blocks: https://www.wwpdb.org/documentation/file-format-content/format33/sect9.html#MODEL
+//
+// the file is indexed once by scanning for the MODEL records. a model is then served as the records before the
+// first model (so HELIX and SHEET are kept for the cartoon), the model itself and the records after the last
+// model (eg. CONECT), without copying or splitting the file.
+
+#include <string_view>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <bit>
+
+
+namespace animol {
+
+class pdb_models
+{
+
+public:
+
+  struct model
+  {
+    std::size_t offset; // of the MODEL record
+    std::size_t size;   // up to and including the ENDMDL record
+  };
+
+
+  // build the index of models in data, returns false if there are no MODEL records
+
+  bool index(std::string_view data) noexcept
+  {
+    models_.clear();
+
+    header_size_    = 0;
+    trailer_offset_ = data.size();
+
+    for (auto p = find_record(data, 0, "MODEL"); p < data.size(); p = find_record(data, p + 5, "MODEL"))
+      models_.push_back({ p, 0 });
+
+    if (models_.empty())
+      return false;
+
+    for (std::size_t i = 0; i < models_.size() - 1; ++i)
+      models_[i].size = models_[i + 1].offset - models_[i].offset;
+
+    // the last model ends at its ENDMDL, anything after that is shared by all models
+
+    auto& last = models_.back();
+
+    if (auto e = find_record(data, last.offset, "ENDMDL"); e < data.size())
+    {
+      auto eol = data.find('\n', e);
+
+      trailer_offset_ = eol == std::string_view::npos ? data.size() : eol + 1;
+    }
+
+    last.size    = trailer_offset_ - last.offset;
+    header_size_ = models_.front().offset;
+
+    return true;
+  }
+
+
+  int size() const noexcept
+  {
+    return models_.size();
+  }
+
+
+  const std::vector<model>& get_models() const noexcept
+  {
+    return models_;
+  }
+
+
+  // the pdb of model m from the indexed data: header, model and trailer
+
+  void get_model(std::string_view data, int m, std::string& out) const noexcept
+  {
+    const auto& e = models_[m];
+
+    out.clear();
+    out.reserve(header_size_ + e.size + (data.size() - trailer_offset_));
+
+    out.append(data.substr(0, header_size_));
+    out.append(data.substr(e.offset, e.size));
+    out.append(data.substr(trailer_offset_));
+  }
+
+
+  /*
+      offset of the first line at or after from starting with record, or data.size() if there is none.
+
+      candidates are found 8 bytes at a time by looking for the first character of the record with the
+      zero byte test on the xor of the data. this can flag bytes after a true match, but never misses one,
+      so every candidate is checked. assumes a little endian target (wasm and x86).
+  */
+
+  static std::size_t find_record(std::string_view data, std::size_t from, std::string_view record) noexcept
+  {
+    constexpr std::uint64_t ones = 0x0101010101010101ull;
+    constexpr std::uint64_t high = 0x8080808080808080ull;
+
+    const std::uint64_t pattern = ones * static_cast<unsigned char>(record[0]);
+
+    auto is_record = [&] (std::size_t p)
+    {
+      return (p == 0 || data[p - 1] == '\n') && data.substr(p, record.size()) == record;
+    };
+
+    std::size_t p = from;
+
+    for (; p + 8 <= data.size(); p += 8)
+    {
+      std::uint64_t v;
+      std::memcpy(&v, data.data() + p, 8);
+
+      v ^= pattern;
+
+      for (auto m = (v - ones) & ~v & high; m; m &= m - 1)
+        if (auto c = p + std::countr_zero(m) / 8; is_record(c))
+          return c;
+    }
+
+    for (; p < data.size(); ++p)
+      if (data[p] == record[0] && is_record(p))
+        return p;
+
+    return data.size();
+  }
+
+
+private:
+
+  std::vector<model> models_;
+
+  std::size_t header_size_{0};    // bytes before the first model
+  std::size_t trailer_offset_{0}; // first byte after the last model
+};
+
+} // namespace animol
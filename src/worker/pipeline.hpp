@@ -0,0 +1,1149 @@
+#pragma once
+
+#include "system/webgl/log.hpp"
+
+#include "visual.hpp"
+#include "dcd2pdb.hpp"
+#include "xtc2pdb.hpp"
+#include "amtraj.hpp"
+#include "inflate.hpp"
+#include "to_pdb.hpp"
+#include "fetcher.hpp"
+#include "decode_stats.hpp"
+#include "atom_table.hpp"
+#include "lod_table.hpp"
+#include "geometry_bounds.hpp"
+#include "result_store.hpp"
+#include "atom_order.hpp"
+
+#include <string_view>
+#include <string>
+#include <span>
+#include <vector>
+#include <array>
+#include <memory>
+#include <functional>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+
+
+/*
+    the decode pipeline, independent of where it runs: input is fetched through a fetcher, converted to pdb,
+    then run through molauto (script), molscript and compact (cartoon geometry) or visualise (atoms). results
+    are given to a callback, an empty result meaning failure.
+
+    input is either the url of a structure file or a json frame descriptor (dcd, xtc or amt) as built by the
+    viewer's frame sources.
+
+    molauto and molscript read and write files, which are placed in work_dir: the script names the pdb file by
+    its path there. they keep state in globals, so one pipeline runs at a time in a process.
+
+    with_table results are followed by the atom table of the pdb they were made from, for the viewer to keep and
+    make other representations of the frame from without fetching and converting it again. the pdb then has all
+    atoms and the secondary structure, so suits both, and the cartoon is made from only those of its atoms it
+    would have been converted with alone. the viewer asks for tables only when another layer will use them.
+
+    sorted atoms are in spatial order.
+
+    with a result_store, results are looked up there before they are made, and kept there once made. those of
+    structure files and frame descriptors are keyed by the pdb fetched for them, not by their url, so a file
+    changed on the server is not answered with the results of the old one.
+*/
+
+extern "C" {
+
+extern void vertex_free();
+extern void vertex_clear();
+extern void vertex_set_impostors(int on);
+
+extern int molauto (int argc, char *argv[]);
+extern int molscript (int argc, char *argv[]);
+
+#define OPTION_COLOR      1
+#define OPTION_INTERLEAVE 2
+#define OPTION_IMPOSTORS  4 // spheres and cylinders as instances following the strips
+#define OPTION_LOD        8 // levels of detail followed by a lod_table, of the pipeline rather than compact
+
+extern int compact(char** cdata, int options);
+
+} // extern "C"
+
+
+namespace animol {
+
+class pipeline
+{
+
+public:
+
+  using result_cb = std::function<void (std::span<const char>)>;
+
+  using pdb_cb = std::function<void (std::span<const char> pdb, bool as_given)>; // as_given if not converted
+
+  static constexpr std::uint32_t version = 2; // of the results, raised when they change so stored ones are not used
+
+
+  // results are kept in store if given
+
+  pipeline(std::shared_ptr<fetcher> f, std::string work_dir, std::shared_ptr<result_store> store = {}) noexcept :
+    fetcher_(std::move(f)),
+    store_(std::move(store)),
+    work_dir_(std::move(work_dir))
+  {
+  }
+
+
+  // the statistics of the work since the last call
+
+  static decode_stats::trailer take_stats() noexcept
+  {
+    auto t = stats_;
+
+    stats_ = {};
+
+    return t;
+  }
+
+
+  // the molauto script for input. it names the pdb by its path in work_dir_, so is stored by it
+
+  void script(std::string_view input, result_cb done) noexcept
+  {
+    stored_pdb("script" + work_dir_, 0, {}, input, cartoon_options, std::move(done),
+                                                            [this] (std::span<const char> pdb, bool, result_cb done)
+    {
+      auto s = make_script(pdb);
+
+      done(s);
+    });
+  }
+
+
+  void script_contents(std::span<const std::byte> contents, result_cb done) noexcept
+  {
+    auto c = std::make_shared<std::vector<std::byte>>(contents.begin(), contents.end()); // the store may answer later
+
+    stored(get_key("script_contents" + work_dir_, 0, {}, as_chars(contents)), std::move(done), [this, c] (result_cb done)
+    {
+      std::string converted;
+
+      auto pdb = convert(*c, cartoon_options, converted);
+
+      if (!pdb)
+      {
+        log_debug("script_contents failed to convert to pdb");
+        done({});
+        return;
+      }
+
+      auto s = make_script(*pdb);
+
+      done(s);
+    });
+  }
+
+
+  void script_table(std::span<const char> table, result_cb done) noexcept
+  {
+    std::string pdb, kept;
+
+    if (!atom_table::to_pdb(table, pdb))
+    {
+      done({});
+      return;
+    }
+
+    auto s = make_script(cartoon_pdb(pdb, atom_table::get_footer(table)->as_given, kept));
+
+    done(s);
+  }
+
+
+  // the compacted cartoon geometry of input using script, options are the OPTION_ compact options
+
+  void decode(std::string_view script, std::string_view input, int options, result_cb done, bool with_table = false) noexcept
+  {
+    stored_pdb(with_table ? "decode_with_table" : "decode", options, script, input, with_table ? table_options : cartoon_options,
+               std::move(done), [this, script = std::string(script), options, with_table] (std::span<const char> pdb,
+                                                                                        bool as_given, result_cb done)
+    {
+      if (!with_table)
+      {
+        make_geometry(script, pdb, options, done);
+        return;
+      }
+
+      std::string kept;
+
+      make_geometry(script, cartoon_pdb(pdb, as_given, kept), options, add_table(pdb, as_given, done));
+    });
+  }
+
+
+  void decode_contents(std::string_view script, std::span<const std::byte> contents, int options, result_cb done,
+                                                                                      bool with_table = false) noexcept
+  {
+    auto c = std::make_shared<std::vector<std::byte>>(contents.begin(), contents.end());
+
+    stored(get_key(with_table ? "decode_contents_with_table" : "decode_contents", options, script, as_chars(contents)),
+                           std::move(done), [this, script = std::string(script), c, options, with_table] (result_cb done)
+    {
+      std::string converted;
+      bool        as_given;
+
+      auto pdb = convert(*c, with_table ? table_options : cartoon_options, converted, &as_given);
+
+      if (!pdb)
+      {
+        log_debug("decode_contents failed to convert to pdb");
+        done({});
+        return;
+      }
+
+      if (!with_table)
+      {
+        make_geometry(script, *pdb, options, done);
+        return;
+      }
+
+      std::string kept;
+
+      make_geometry(script, cartoon_pdb(*pdb, as_given, kept), options, add_table(*pdb, as_given, done));
+    });
+  }
+
+
+  // the cartoon geometry from an atom table
+
+  void decode_table(std::string_view script, std::span<const char> table, int options, result_cb done) noexcept
+  {
+    std::string pdb, kept;
+
+    if (!atom_table::to_pdb(table, pdb))
+    {
+      done({});
+      return;
+    }
+
+    make_geometry(script, cartoon_pdb(pdb, atom_table::get_footer(table)->as_given, kept), options, done);
+  }
+
+
+  // the visualise::atom array of input
+
+  void atoms(std::string_view input, result_cb done, bool with_table = false, bool sorted = false) noexcept
+  {
+    stored_pdb(with_table ? "atoms_with_table" : "atoms", sorted, {}, input, with_table ? table_options : atom_options,
+               std::move(done), [with_table, sorted] (std::span<const char> pdb, bool as_given, result_cb done)
+    {
+      make_atoms(pdb, with_table ? add_table(pdb, as_given, done) : done, sorted);
+    });
+  }
+
+
+  void atoms_contents(std::span<const std::byte> contents, result_cb done, bool with_table = false, bool sorted = false) noexcept
+  {
+    auto c = std::make_shared<std::vector<std::byte>>(contents.begin(), contents.end());
+
+    stored(get_key(with_table ? "atoms_contents_with_table" : "atoms_contents", sorted, {}, as_chars(contents)),
+                                                             std::move(done), [c, with_table, sorted] (result_cb done)
+    {
+      std::string converted;
+      bool        as_given;
+
+      auto pdb = convert(*c, with_table ? table_options : atom_options, converted, &as_given);
+
+      if (!pdb)
+      {
+        log_debug("atoms_contents failed to convert to pdb");
+        done({});
+        return;
+      }
+
+      make_atoms(*pdb, with_table ? add_table(*pdb, as_given, done) : done, sorted);
+    });
+  }
+
+
+  // the visualise::atom array from an atom table
+
+  static void atoms_table(std::span<const char> table, result_cb done, bool sorted = false) noexcept
+  {
+    std::string pdb;
+
+    if (!atom_table::to_pdb(table, pdb))
+    {
+      done({});
+      return;
+    }
+
+    make_atoms(pdb, done, sorted);
+  }
+
+
+  // the pdb of input, a url or frame descriptor, keeping the atoms options asks for unless it is given as pdb
+
+  void get_pdb(std::string_view input, cif2pdb::options options, pdb_cb done) noexcept
+  {
+    using namespace magic_enum::bitwise_operators;
+
+    if (input.starts_with("{")) // a frame descriptor
+    {
+      auto process = std::make_shared<frame_process>(fetcher_, [done] (std::span<const char> pdb)
+      {
+        done(pdb, false);
+      });
+
+      process->keepCAs_    = (options & cif2pdb::options::ca_atoms)     == cif2pdb::options::ca_atoms;
+      process->keepNonCAs_ = (options & cif2pdb::options::non_ca_atoms) == cif2pdb::options::non_ca_atoms;
+
+      process->start(input);
+      return;
+    }
+
+    timed_get(*fetcher_, std::string(input), "", [options, done] (std::span<const std::byte> d, std::uint16_t status)
+    {
+      std::string converted;
+      bool        as_given;
+
+      auto pdb = convert(d, options, converted, &as_given);
+
+      if (!pdb)
+      {
+        log_debug("failed to convert to pdb");
+        done({}, false);
+        return;
+      }
+
+      done(*pdb, as_given);
+
+    }, [done] (int error_code, std::string_view error_msg)
+    {
+      log_debug(FMT_COMPILE("failed to download, error_code: {} msg: {}"), error_code, error_msg);
+      done({}, false);
+    });
+  }
+
+
+  // run molauto on pdb
+
+  std::string make_script(std::span<const char> pdb) noexcept
+  {
+    save_to_file(pdb, work_dir_ + "i.pdb");
+
+    auto pdb_file    = work_dir_ + "i.pdb";
+    auto script_file = work_dir_ + "i.script";
+
+    const char *argv[] = { "molauto", "-out", script_file.c_str(), pdb_file.c_str() };
+
+    {
+      decode_stats::timer t(stats_, decode_stats::stage::molauto);
+
+      molauto(sizeof(argv) / sizeof(argv[0]), const_cast<char**>(argv));
+    }
+
+    stats_.atoms = count_atoms(pdb);
+
+    return read_from_file(script_file);
+  }
+
+
+  // run molscript with script on pdb, and compact the geometry. with OPTION_LOD at each level of detail. followed
+  // by the bounds of the finest level
+
+  void make_geometry(std::string_view script, std::span<const char> pdb, int options, result_cb done) noexcept
+  {
+    save_to_file(pdb, work_dir_ + "i.pdb");
+
+    stats_.atoms    = count_atoms(pdb);
+    stats_.vertices = 0;
+
+    auto segments = (options & OPTION_LOD) ? lod_table::get_segments(script, options & OPTION_IMPOSTORS ? 2 : 4) : std::vector<int>();
+
+    // as struct fp of vertex.c, with or without its colour, which compact may instead put after the vertices
+
+    const bool interleaved = (options & OPTION_COLOR) && (options & OPTION_INTERLEAVE);
+
+    const std::size_t vertex_size = interleaved ? 16 : 12;
+    const std::size_t color_size  = (options & OPTION_COLOR) && !interleaved ? 4 : 0;
+
+    if (segments.size() < 2)
+    {
+      make_level(script, options, [&done, vertex_size, color_size, options] (std::span<const char> g)
+      {
+        if (g.empty())
+        {
+          done({});
+          return;
+        }
+
+        std::vector<char> r;
+
+        geometry_bounds::append(g, geometry_bounds::of_geometry(g, vertex_size, color_size, options & OPTION_IMPOSTORS), r);
+
+        done(r);
+      });
+
+      return;
+    }
+
+    std::vector<char> levels;
+    std::vector<std::uint32_t> sizes;
+
+    for (auto s : segments)
+    {
+      make_level(lod_table::set_segments(script, s), options, [&levels, &sizes] (std::span<const char> g)
+      {
+        levels.insert(levels.end(), g.begin(), g.end());
+        sizes.push_back(g.size());
+      });
+
+      if (sizes.back() == 0)
+      {
+        done({});
+        return;
+      }
+    }
+
+    auto f = geometry_bounds::of_geometry({ levels.data(), sizes[0] }, vertex_size, color_size, options & OPTION_IMPOSTORS);
+
+    for (std::size_t i = 1, offset = sizes[0]; i < sizes.size() && f.colors; offset += sizes[i++])
+      f.colors = geometry_bounds::add_colors({ levels.data() + offset, sizes[i] }, vertex_size, color_size, f.colors);
+
+    lod_table::append(segments, sizes, levels);
+
+    std::vector<char> r;
+
+    geometry_bounds::append(levels, f, r);
+
+    done(r);
+  }
+
+
+  // run molscript with script on the pdb saved, and compact the geometry
+
+  void make_level(std::string_view script, int options, result_cb done) noexcept
+  {
+    save_to_file(script, work_dir_ + "i.script");
+
+    vertex_clear();
+    vertex_set_impostors(options & OPTION_IMPOSTORS);
+
+    auto script_file = work_dir_ + "i.script";
+
+    const char *argv[] = { "molscript", "-vertex", "-s", "-in", script_file.c_str() };
+
+    {
+      decode_stats::timer t(stats_, decode_stats::stage::molscript);
+
+      molscript(sizeof(argv) / sizeof(argv[0]), const_cast<char**>(argv));
+    }
+
+    char* cdata = nullptr;
+    int csize;
+
+    {
+      decode_stats::timer t(stats_, decode_stats::stage::compact);
+
+      csize = compact(&cdata, options & ~OPTION_LOD);
+    }
+
+    if (csize >= 8) // the header is the number of triangle and strip vertices
+    {
+      std::int32_t n[2];
+      std::memcpy(n, cdata, sizeof(n));
+
+      stats_.vertices += n[0] + n[1];
+    }
+
+    done({ cdata, static_cast<std::size_t>(csize) });
+
+    free(cdata);
+  }
+
+
+  static void make_atoms(std::span<const char> pdb, result_cb done, bool sorted = false) noexcept
+  {
+    visualise v({ pdb.data(), pdb.size() });
+
+    std::vector<visualise::atom> res;
+
+    {
+      decode_stats::timer t(stats_, decode_stats::stage::visualise);
+
+      v.generate_atoms(res, visualise::ATOMS | visualise::HETATOMS | visualise::SHIFT_TO_CENTER_OF_MASS);
+
+      if (sorted)
+        atom_order::sort(res);
+    }
+
+    stats_.atoms = res.size();
+
+    std::span<const char> atoms(reinterpret_cast<const char*>(res.data()), res.size() * sizeof(visualise::atom));
+
+    std::vector<char> r;
+
+    geometry_bounds::append(atoms, geometry_bounds::of_instances(atoms, sizeof(visualise::atom)), r);
+
+    done(r);
+  }
+
+
+private:
+
+  static constexpr cif2pdb::options cartoon_options = static_cast<cif2pdb::options>(static_cast<int>(cif2pdb::options::ca_atoms) |
+                                           static_cast<int>(cif2pdb::options::sheet) | static_cast<int>(cif2pdb::options::helix));
+
+  static constexpr cif2pdb::options atom_options = static_cast<cif2pdb::options>(static_cast<int>(cif2pdb::options::ca_atoms) |
+                                                                                  static_cast<int>(cif2pdb::options::non_ca_atoms));
+
+  static constexpr cif2pdb::options table_options = static_cast<cif2pdb::options>(static_cast<int>(cartoon_options) |
+                                                                                  static_cast<int>(atom_options));
+
+
+  inline static decode_stats::trailer stats_{};
+
+
+  // fetch through f, adding the time to the response and bytes to the statistics
+
+  static void timed_get(fetcher& f, const std::string& url, const std::string& range, fetcher::load_cb on_load,
+                                                                                fetcher::error_cb on_error) noexcept
+  {
+    f.get(url, range, [start = std::chrono::steady_clock::now(), on_load] (std::span<const std::byte> d, std::uint16_t status)
+    {
+      stats_.stage_ms[static_cast<int>(decode_stats::stage::fetch)] +=
+                           std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+      stats_.bytes_fetched += d.size();
+
+      on_load(d, status);
+
+    }, std::move(on_error));
+  }
+
+
+  // the store key of a call of function on input. the script names the pdb by its path in work_dir_, which is
+  // left out so that pipelines working in different directories share results
+
+  std::string get_key(std::string_view function, int options, std::string_view script, std::span<const char> input,
+                                                                                   bool as_given = false) const noexcept
+  {
+    std::string s(script);
+
+    if (!work_dir_.empty())
+      for (auto p = s.find(work_dir_); p != std::string::npos; p = s.find(work_dir_, p))
+        s.erase(p, work_dir_.size());
+
+    const char given = as_given;
+
+    return result_store::make_key({ { reinterpret_cast<const char*>(&version), sizeof(version) }, function,
+                                    { reinterpret_cast<const char*>(&options), sizeof(options) }, s, input, { &given, 1 } });
+  }
+
+
+  static std::span<const char> as_chars(std::span<const std::byte> d) noexcept
+  {
+    return { reinterpret_cast<const char*>(d.data()), d.size() };
+  }
+
+
+  // done with the stored result of key, or if there is none the result of make, which is then stored
+
+  void stored(std::string key, result_cb done, std::function<void (result_cb)> make) noexcept
+  {
+    if (!store_)
+    {
+      make(std::move(done));
+      return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    store_->get(key, [this, key, done, make, start] (std::span<const char> d)
+    {
+      stats_.stage_ms[static_cast<int>(decode_stats::stage::store)] +=
+                           std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+      if (!d.empty())
+      {
+        ++stats_.stored;
+        done(d);
+        return;
+      }
+
+      make([this, key, done] (std::span<const char> r)
+      {
+        if (!r.empty())
+        {
+          decode_stats::timer t(stats_, decode_stats::stage::store);
+
+          store_->put(key, r);
+        }
+
+        done(r);
+      });
+    });
+  }
+
+
+  // done with the stored result of function on the pdb of input, or if there is none make's from it, which is then
+  // stored. the result is keyed by the pdb rather than by input, which names a file that may change: the fetch is
+  // left to the browser's cache to revalidate, and what is saved is the work after it
+
+  void stored_pdb(std::string_view function, int options, std::string_view script, std::string_view input,
+                  cif2pdb::options pdb_options, result_cb done,
+                  std::function<void (std::span<const char> pdb, bool as_given, result_cb done)> make) noexcept
+  {
+    get_pdb(input, pdb_options, [this, function = std::string(function), options, script = std::string(script),
+                                 done = std::move(done), make = std::move(make)] (std::span<const char> pdb, bool as_given)
+    {
+      if (pdb.empty())
+      {
+        done({});
+        return;
+      }
+
+      if (!store_)
+      {
+        make(pdb, as_given, done);
+        return;
+      }
+
+      auto p = std::make_shared<std::string>(pdb.data(), pdb.size()); // the store may answer later
+
+      stored(get_key(function, options, script, pdb, as_given), done, [p, as_given, make] (result_cb done)
+      {
+        make(*p, as_given, std::move(done));
+      });
+    });
+  }
+
+
+  // done with the atom table of pdb after a non empty result, or the result alone if pdb has no table. pdb must
+  // outlive the call of the callback returned
+
+  static result_cb add_table(std::span<const char> pdb, bool as_given, result_cb done) noexcept
+  {
+    return [pdb, as_given, done] (std::span<const char> r)
+    {
+      if (r.empty())
+      {
+        done(r);
+        return;
+      }
+
+      std::vector<char> out(r.begin(), r.end());
+
+      atom_table::append(pdb, as_given, out);
+
+      done(out);
+    };
+  }
+
+
+  static std::optional<std::span<const char>> convert(std::span<const std::byte> data, cif2pdb::options options,
+                                                               std::string& converted, bool* as_given = nullptr) noexcept
+  {
+    decode_stats::timer t(stats_, decode_stats::stage::convert);
+
+    return to_pdb(data, options, converted, as_given);
+  }
+
+
+  // the pdb the cartoon is made from: as converted with cartoon_options, so one converted with table_options
+  // keeps only the CA atoms of its ATOM records. a pdb as given keeps all its atoms, as it does without a table
+
+  static std::span<const char> cartoon_pdb(std::span<const char> pdb, bool as_given, std::string& kept) noexcept
+  {
+    if (as_given)
+      return pdb;
+
+    decode_stats::timer t(stats_, decode_stats::stage::convert);
+
+    kept.reserve(pdb.size() / 4);
+
+    for (auto p = pdb.data(), end = pdb.data() + pdb.size(); p < end;)
+    {
+      auto nl   = static_cast<const char*>(std::memchr(p, '\n', end - p));
+      auto next = nl ? nl + 1 : end;
+
+      std::string_view line(p, next - p);
+
+      if (!line.starts_with("ATOM  ") || is_ca(line))
+        kept.append(line);
+
+      p = next;
+    }
+
+    return { kept.data(), kept.size() };
+  }
+
+
+  // whether the atom name of an ATOM record, columns 13 to 16, is CA
+
+  static bool is_ca(std::string_view line) noexcept
+  {
+    if (line.size() < 16)
+      return false;
+
+    auto name = line.substr(12, 4);
+
+    auto first = name.find_first_not_of(' ');
+    auto last  = name.find_last_not_of(' ');
+
+    return first != std::string_view::npos && name.substr(first, last - first + 1) == "CA";
+  }
+
+
+  // the number of ATOM and HETATM records
+
+  static std::uint32_t count_atoms(std::span<const char> pdb) noexcept
+  {
+    std::uint32_t n = 0;
+
+    for (auto p = pdb.data(), end = pdb.data() + pdb.size(); p < end;)
+    {
+      if (end - p >= 6 && (std::memcmp(p, "ATOM  ", 6) == 0 || std::memcmp(p, "HETATM", 6) == 0))
+        ++n;
+
+      auto nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+
+      p = nl ? nl + 1 : end;
+    }
+
+    return n;
+  }
+
+
+  static void save_to_file(std::span<const char> data, const std::string& filename) noexcept
+  {
+    auto f = fopen(filename.c_str(), "w");
+    fwrite(data.data(), 1, data.size(), f);
+    fclose(f);
+  }
+
+
+  static void save_to_file(std::string_view data, const std::string& filename) noexcept
+  {
+    save_to_file(std::span<const char>(data.data(), data.size()), filename);
+  }
+
+
+  static std::string read_from_file(const std::string& filename) noexcept
+  {
+    std::string data;
+
+    auto f = fopen(filename.c_str(), "r");
+
+    if (!f)
+      return data;
+
+    fseek(f, 0, SEEK_END);
+    data.resize(ftell(f));
+    fseek(f, 0, SEEK_SET);
+
+    data.resize(fread(data.data(), 1, data.size(), f));
+    fclose(f);
+
+    return data;
+  }
+
+
+  // amt files hold their own topology, so the opened file and its templates are kept between frames
+
+  struct amt_cache
+  {
+    std::string url;
+
+    amtraj reader;
+
+    std::array<std::unique_ptr<dcd2pdb>, 4> converters; // by keepCAs * 2 + keepNonCAs
+  };
+
+  inline static amt_cache amt_;
+
+
+  // extraction of a frame of a dcd, xtc or amt trajectory
+
+  struct frame_process : public std::enable_shared_from_this<frame_process>
+  {
+    frame_process(std::shared_ptr<fetcher> f, result_cb done) noexcept :
+      fetcher_(std::move(f)),
+      done_(std::move(done))
+    {
+    }
+
+
+    std::shared_ptr<fetcher> fetcher_;
+
+    result_cb done_;
+
+    int frame_;
+
+    std::string psf_url_;
+    std::string dcd_url_;
+
+    int           number_atoms_;
+    std::uint64_t dcd_data_offset_;
+
+    dcd2pdb converter_;
+
+    bool xtc_{false};                // frames are compressed xtc frames rather than dcd
+
+    std::uint64_t xtc_frame_offset_;
+    std::uint64_t xtc_frame_size_;
+
+    xtc2pdb xtc_decoder_;
+    std::vector<float> xyz_;
+
+    bool keepCAs_;
+    bool keepNonCAs_;
+
+    int amt_retries_{0};
+
+
+    std::uint64_t get_frame_offset(int frame_id) const noexcept
+    {
+      if (xtc_)
+        return xtc_frame_offset_;
+
+      return dcd_data_offset_ + (frame_id * get_frame_size());
+    }
+
+
+    std::uint64_t get_frame_size() const noexcept
+    {
+      if (xtc_)
+        return xtc_frame_size_;
+
+      // Each coordinate (x, y and z) has:
+      // 4 bytes for start_length
+      // 4 bytes for end_length
+      // 4 bytes per atom for the float cordinate
+
+      return (4 + 4 + (4 * number_atoms_)) * 3;
+    }
+
+
+    void fail() noexcept
+    {
+      done_({});
+    }
+
+
+    void start(std::string_view s) noexcept
+    {
+      if (s.find("\"amt_url\"") != std::string_view::npos)
+      {
+        auto msg = plate::json_parse_struct<amtraj::interface>(s);
+
+        if (!msg.ok)
+        {
+          log_debug(FMT_COMPILE("process amt: unable to parse: {}"), s.size());
+          fail();
+          return;
+        }
+
+        frame_   = msg.data.frame;
+        dcd_url_ = msg.data.amt_url;
+
+        load_amt();
+        return;
+      }
+
+      if (s.find("\"xtc_url\"") != std::string_view::npos)
+      {
+        auto msg = plate::json_parse_struct<xtc2pdb::interface>(s);
+
+        if (!msg.ok)
+        {
+          log_debug(FMT_COMPILE("process xtc: unable to parse: {}"), s.size());
+          fail();
+          return;
+        }
+
+        xtc_              = true;
+        frame_            = msg.data.frame;
+        psf_url_          = msg.data.psf_url;
+        dcd_url_          = msg.data.xtc_url;
+        number_atoms_     = msg.data.number_atoms;
+        xtc_frame_offset_ = msg.data.frame_offset;
+        xtc_frame_size_   = msg.data.frame_size;
+
+        load();
+        return;
+      }
+
+      auto msg = plate::json_parse_struct<dcd2pdb::interface>(s);
+
+      if (!msg.ok)
+      {
+        log_debug(FMT_COMPILE("process dcd: unable to parse: {}"), s.size());
+        fail();
+        return;
+      }
+
+      frame_           = msg.data.frame;
+      psf_url_         = msg.data.psf_url;
+      dcd_url_         = msg.data.dcd_url;
+      number_atoms_    = msg.data.number_atoms;
+      dcd_data_offset_ = msg.data.dcd_data_offset;
+
+      load();
+    }
+
+
+    void load() noexcept
+    {
+      // load in psf file
+
+      timed_get(*fetcher_, psf_url_, "", [this, self(shared_from_this())] (std::span<const std::byte> psf, std::uint16_t status)
+      {
+        if (!make_template(psf))
+        {
+          fail();
+          return;
+        }
+
+        // load in the data part of the dcd file for this frame
+
+        auto range = fmt::format(FMT_COMPILE("bytes={}-{}"), get_frame_offset(frame_), get_frame_offset(frame_) + get_frame_size() - 1);
+
+        timed_get(*fetcher_, dcd_url_, range, [this, self] (std::span<const std::byte> d, std::uint16_t status)
+        {
+          if (!populate(d))
+          {
+            fail();
+            return;
+          }
+
+          done_(converter_.get_pdb_data());
+
+        }, [this, self] (int error_code, std::string_view error_msg)
+        {
+          log_debug(FMT_COMPILE("failed to download frame dcd range, error_code: {} msg: {}"), error_code, error_msg);
+          fail();
+        });
+
+      }, [this, self(shared_from_this())] (int error_code, std::string_view error_msg)
+      {
+        log_debug(FMT_COMPILE("failed to download psf_file, error_code: {} msg: {}"), error_code, error_msg);
+        fail();
+      });
+    }
+
+
+    // the pdb template from the psf file
+
+    bool make_template(std::span<const std::byte> psf) noexcept
+    {
+      decode_stats::timer t(stats_, decode_stats::stage::convert);
+
+      std::string inflated;
+
+      if (inflate::is_compressed(psf))
+      {
+        if (!inflate::decompress(psf, inflated))
+        {
+          log_debug("unable to decompress psf");
+          return false;
+        }
+
+        psf = std::span(reinterpret_cast<const std::byte*>(inflated.data()), inflated.size());
+      }
+
+      if (!converter_.generate_template(psf, keepCAs_, keepNonCAs_))
+      {
+        log_debug("generate_template failed");
+        return false;
+      }
+
+      if (number_atoms_ != converter_.get_number_of_atoms())
+      {
+        log_debug(FMT_COMPILE("number of atoms mismatch, dcd has: {} psf has: {}"), number_atoms_, converter_.get_number_of_atoms());
+        return false;
+      }
+
+      return true;
+    }
+
+
+    // the template populated from the frame's dcd or xtc data
+
+    bool populate(std::span<const std::byte> d) noexcept
+    {
+      decode_stats::timer t(stats_, decode_stats::stage::convert);
+
+      if (xtc_)
+      {
+        if (!xtc_decoder_.decode(d, xyz_) || !converter_.populate_template(xyz_))
+        {
+          log_debug("Unable to decode xtc frame");
+          return false;
+        }
+      }
+      else if (!converter_.populate_template(d))
+      {
+        log_debug("Unable to populate template");
+        return false;
+      }
+
+      return true;
+    }
+
+
+    // open the amt file if not already cached: fetch the header, then the index and topology that follow it
+
+    void load_amt() noexcept
+    {
+      if (amt_.url == dcd_url_)
+      {
+        fetch_amt_frame();
+        return;
+      }
+
+      timed_get(*fetcher_, dcd_url_, "bytes=0-63", [this, self(shared_from_this())] (std::span<const std::byte> d, std::uint16_t status)
+      {
+        auto h = amtraj::read_header(d);
+
+        if (!h)
+        {
+          fail();
+          return;
+        }
+
+        auto range = fmt::format(FMT_COMPILE("bytes=0-{}"), sizeof(amtraj::header) + amtraj::get_index_and_topology_size(*h) - 1);
+
+        timed_get(*fetcher_, dcd_url_, range, [this, self] (std::span<const std::byte> d, std::uint16_t status)
+        {
+          amt_.url.clear();
+
+          for (auto& c : amt_.converters)
+            c.reset();
+
+          if (!amt_.reader.open(d))
+          {
+            fail();
+            return;
+          }
+
+          amt_.url = dcd_url_;
+
+          fetch_amt_frame();
+
+        }, [this, self] (int error_code, std::string_view error_msg)
+        {
+          log_debug(FMT_COMPILE("failed to download amt index, error_code: {} msg: {}"), error_code, error_msg);
+          fail();
+        });
+
+      }, [this, self(shared_from_this())] (int error_code, std::string_view error_msg)
+      {
+        log_debug(FMT_COMPILE("failed to download amt header, error_code: {} msg: {}"), error_code, error_msg);
+        fail();
+      });
+    }
+
+
+    // fetch the frame, along with its keyframe unless that is already decoded, as one range if close enough
+
+    void fetch_amt_frame() noexcept
+    {
+      auto& converter = amt_.converters[keepCAs_ * 2 + keepNonCAs_];
+
+      if (!converter)
+      {
+        decode_stats::timer t(stats_, decode_stats::stage::convert);
+
+        converter = std::make_unique<dcd2pdb>();
+
+        if (!converter->generate_template(amt_.reader.get_topology(), keepCAs_, keepNonCAs_) ||
+                       static_cast<std::uint32_t>(converter->get_number_of_atoms()) != amt_.reader.get_header().number_atoms)
+        {
+          log_debug("amt: generate_template failed");
+          converter.reset();
+          fail();
+          return;
+        }
+      }
+
+      if (frame_ < 0 || frame_ >= static_cast<int>(amt_.reader.get_header().number_frames))
+      {
+        log_debug(FMT_COMPILE("amt: bad frame: {}"), frame_);
+        fail();
+        return;
+      }
+
+      auto [first, last] = amt_.reader.get_frame_range(frame_);
+
+      auto range = fmt::format(FMT_COMPILE("bytes={}-{}"), first, last - 1);
+
+      timed_get(*fetcher_, dcd_url_, range, [this, self(shared_from_this()), first] (std::span<const std::byte> d, std::uint16_t status) mutable
+      {
+        if (amt_.url != dcd_url_) // another file was opened while fetching
+        {
+          load_amt();
+          return;
+        }
+
+        if (status == 200) // range ignored, so data is the whole file
+          first = 0;
+
+        if (!amt_.reader.covers(frame_, first, d.size())) // only the keyframe was fetched, or the cached keyframe changed while fetching
+        {
+          bool ok;
+
+          {
+            decode_stats::timer t(stats_, decode_stats::stage::convert);
+
+            ok = ++amt_retries_ <= 3 && amt_.reader.decode_keyframe(frame_, d, first);
+          }
+
+          if (!ok)
+          {
+            log_debug("amt: unable to fetch frame");
+            fail();
+            return;
+          }
+
+          fetch_amt_frame();
+          return;
+        }
+
+        auto& converter = amt_.converters[keepCAs_ * 2 + keepNonCAs_];
+
+        bool ok;
+
+        {
+          decode_stats::timer t(stats_, decode_stats::stage::convert);
+
+          ok = converter && amt_.reader.decode(frame_, d, first, xyz_) && converter->populate_template(xyz_);
+        }
+
+        if (!ok)
+        {
+          log_debug("Unable to decode amt frame");
+          fail();
+          return;
+        }
+
+        done_(converter->get_pdb_data());
+
+      }, [this, self(shared_from_this())] (int error_code, std::string_view error_msg)
+      {
+        log_debug(FMT_COMPILE("failed to download amt frame range, error_code: {} msg: {}"), error_code, error_msg);
+        fail();
+      });
+    }
+  };
+
+
+  std::shared_ptr<fetcher> fetcher_;
+
+  std::shared_ptr<result_store> store_; // null if results are not kept
+
+  std::string work_dir_; // where molauto and molscript files are written, with a trailing /, or empty for the current directory
+};
+
+} // namespace animol
@@ -0,0 +1,218 @@
+#pragma once
+
+#include "system/webgl/log.hpp"
+
+#include "geometry_bounds.hpp"
+
+#include <string_view>
+#include <string>
+#include <span>
+#include <vector>
+#include <functional>
+#include <initializer_list>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+#include <algorithm>
+#include <cstdint>
+
+
+/*
+    where the decode pipeline keeps its results between sessions, so that opening the same structure or
+    trajectory again is answered without decoding. results are addressed by a key made from what they depend
+    on: the function and its options, the script, the pdb of the input (or its contents when given them) and
+    the pipeline's version, raised when its results change. nothing is keyed by a url, as what it names may
+    change.
+
+    the worker keeps results in indexeddb, native builds in a directory with directory_store. either way they
+    are kept up to a size, the least recently used dropped first.
+
+    as with fetcher, callbacks may be made before get returns or later, and data is only valid during the
+    callback.
+*/
+
+namespace animol {
+
+class result_store
+{
+
+public:
+
+  using load_cb = std::function<void (std::span<const char> data)>; // empty if not stored
+
+
+  virtual ~result_store()
+  {
+  }
+
+
+  virtual void get(const std::string& key, load_cb on_load) noexcept = 0;
+
+  virtual void put(const std::string& key, std::span<const char> data) noexcept = 0;
+
+
+  // the key of parts, as 32 hex digits: two hashes of differing seeds, each part preceded by its size so parts
+  // are not confused by where they split
+
+  static std::string make_key(std::initializer_list<std::span<const char>> parts) noexcept
+  {
+    std::uint64_t h[2] = { 0xcbf29ce484222325, 0x84222325cbf29ce4 };
+
+    for (auto& p : parts)
+    {
+      std::uint64_t size = p.size();
+
+      for (auto& v : h)
+        v = geometry_bounds::hash(p, geometry_bounds::hash({ reinterpret_cast<const char*>(&size), sizeof(size) }, v));
+    }
+
+    return fmt::format(FMT_COMPILE("{:016x}{:016x}"), h[0], h[1]);
+  }
+};
+
+
+// results as files named by their key in a directory, the modification time of a file being when it was last
+// used. files are written whole then renamed so a reader never sees part of one, and the directory may be
+// shared between processes, each trimming it when it adds to it
+
+class directory_store : public result_store
+{
+
+public:
+
+  directory_store(std::filesystem::path dir, std::uint64_t max_bytes) noexcept :
+    dir_(std::move(dir)),
+    max_bytes_(max_bytes)
+  {
+    std::error_code ec;
+
+    std::filesystem::create_directories(dir_, ec);
+
+    if (ec)
+      log_debug(FMT_COMPILE("result store cannot create: {} error: {}"), dir_.string(), ec.message());
+  }
+
+
+  void get(const std::string& key, load_cb on_load) noexcept override
+  {
+    auto path = dir_ / key;
+
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+
+    if (!in)
+    {
+      on_load({});
+      return;
+    }
+
+    std::vector<char> data(in.tellg());
+
+    in.seekg(0);
+    in.read(data.data(), data.size());
+
+    if (!in)
+    {
+      on_load({});
+      return;
+    }
+
+    std::error_code ec;
+
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+
+    on_load(data);
+  }
+
+
+  void put(const std::string& key, std::span<const char> data) noexcept override
+  {
+    if (data.empty() || data.size() > max_bytes_)
+      return;
+
+    auto path = dir_ / key;
+    auto tmp  = dir_ / (key + ".tmp");
+
+    {
+      std::ofstream out(tmp, std::ios::binary);
+
+      out.write(data.data(), data.size());
+
+      if (!out)
+      {
+        log_debug(FMT_COMPILE("result store cannot write: {}"), tmp.string());
+        return;
+      }
+    }
+
+    std::error_code ec;
+
+    std::filesystem::rename(tmp, path, ec);
+
+    if (ec)
+    {
+      log_debug(FMT_COMPILE("result store cannot rename: {} error: {}"), tmp.string(), ec.message());
+      std::filesystem::remove(tmp, ec);
+      return;
+    }
+
+    trim();
+  }
+
+
+private:
+
+  // remove the least recently used files until within max_bytes_
+
+  void trim() noexcept
+  {
+    struct file
+    {
+      std::filesystem::path           path;
+      std::uint64_t                   size;
+      std::filesystem::file_time_type used;
+    };
+
+    std::vector<file> files;
+
+    std::uint64_t total = 0;
+
+    std::error_code ec;
+
+    for (auto& e : std::filesystem::directory_iterator(dir_, ec))
+    {
+      std::error_code fec;
+
+      if (!e.is_regular_file(fec) || e.path().extension() == ".tmp")
+        continue;
+
+      file f{ e.path(), e.file_size(fec), e.last_write_time(fec) };
+
+      if (fec)
+        continue;
+
+      total += f.size;
+
+      files.push_back(std::move(f));
+    }
+
+    if (total <= max_bytes_)
+      return;
+
+    std::sort(files.begin(), files.end(), [] (const file& a, const file& b) { return a.used < b.used; });
+
+    for (auto& f : files)
+    {
+      if (total <= max_bytes_)
+        break;
+
+      if (std::filesystem::remove(f.path, ec))
+        total -= f.size;
+    }
+  }
+
+
+  std::filesystem::path dir_;
+  std::uint64_t         max_bytes_;
+};
+
+} // namespace animol
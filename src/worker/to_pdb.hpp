@@ -0,0 +1,98 @@
+#pragma once
+
+#include "system/webgl/log.hpp"
+
+#include "cif2pdb.hpp"
+#include "bcif2pdb.hpp"
+#include "mmtf2pdb.hpp"
+#include "inflate.hpp"
+
+#include <span>
+#include <string>
+#include <optional>
+#include <cstring>
+
+
+// basic check to see if a file is in PDBx/mmCIF format
+// currently just check it starts with data_
+
+inline bool is_cif(std::span<const std::byte> data)
+{
+  if (data.size() < 5)
+    return false;
+
+  return std::memcmp(data.data(), "data_", 5) == 0;
+}
+
+
+// convert structure data to pdb format if it is in another supported format, decompressing it first if needed.
+//
+// returns a span of the pdb data, which is either data itself (no copy) or the converted data stored in converted.
+// as_given, if given, is set to whether data was pdb, so is returned with all its atoms whatever the options.
+
+inline std::optional<std::span<const char>> to_pdb(std::span<const std::byte> data, animol::cif2pdb::options options, std::string& converted,
+                                                                                                     bool* as_given = nullptr)
+{
+  std::string inflated;
+
+  if (animol::inflate::is_compressed(data))
+  {
+    if (!animol::inflate::decompress(data, inflated))
+    {
+      log_debug(FMT_COMPILE("unable to decompress: {} bytes"), data.size());
+      return std::nullopt;
+    }
+
+    data = std::span(reinterpret_cast<const std::byte*>(inflated.data()), inflated.size());
+  }
+
+  std::string* r = nullptr;
+
+  if (as_given)
+    *as_given = false;
+
+  if (animol::bcif2pdb::is_bcif(data))
+  {
+    animol::bcif2pdb converter(data, options);
+
+    r = converter.convert();
+
+    if (r)
+      converted = std::move(*r);
+  }
+  else if (animol::mmtf2pdb::is_mmtf(data))
+  {
+    animol::mmtf2pdb converter(data, options);
+
+    r = converter.convert();
+
+    if (r)
+      converted = std::move(*r);
+  }
+  else if (is_cif(data))
+  {
+    animol::cif2pdb converter(data, options);
+
+    r = converter.convert();
+
+    if (r)
+      converted = std::move(*r);
+  }
+  else
+  {
+    if (as_given)
+      *as_given = true;
+
+    if (inflated.empty())
+      return std::span<const char>(reinterpret_cast<const char*>(data.data()), data.size());
+
+    converted = std::move(inflated); // already pdb, but needs to outlive this function
+
+    return std::span<const char>(converted.data(), converted.size());
+  }
+
+  if (!r)
+    return std::nullopt;
+
+  return std::span<const char>(converted.data(), converted.size());
+}
@@ -0,0 +1,529 @@
+#pragma once
+
+#include "system/webgl/log.hpp"
+#include "system/common/json/json.hpp"
+
+// GROMACS xtc trajectories: https://manual.gromacs.org/current/reference-manual/file-formats.html#xtc
+// coordinates are compressed with xdr3dfcoord from the xdrfile library
+
+#include <string_view>
+#include <string>
+#include <span>
+#include <vector>
+#include <optional>
+#include <array>
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+#include <cstring>
+#include <bit>
+
+
+namespace animol {
+
+class xtc2pdb
+{
+
+public:
+
+  static constexpr std::int32_t magic = 1995;
+
+  // bytes needed to read the header of any frame, including the compressed coordinate block size
+
+  static constexpr std::size_t header_size = 92;
+
+
+  // interface structure to allow passing key details between processes using json
+
+  struct interface
+  {
+    std::string_view psf_url;
+    std::string_view xtc_url;
+
+    int           frame;
+    int           number_atoms;
+    std::uint64_t frame_offset;
+    std::uint64_t frame_size;
+
+    static constexpr std::array<std::string_view, 6> lookup_ =
+    {{
+      "psf_url", "xtc_url", "frame", "number_atoms", "frame_offset", "frame_size"
+    }};
+
+    static constexpr std::uint64_t must_ = plate::mask_of(std::array<std::string_view, 6>
+    {{
+      "psf_url", "xtc_url", "frame", "number_atoms", "frame_offset", "frame_size"
+    }}, lookup_);
+
+    static constexpr std::uint64_t may_  = std::numeric_limits<std::uint64_t>::max();
+  };
+
+
+  struct frame_header
+  {
+    std::int32_t  number_atoms;
+    std::int32_t  step;
+    float         time;
+    std::uint64_t frame_size; // total bytes in the frame, including this header
+  };
+
+
+  static bool is_xtc(std::span<const std::byte> data) noexcept
+  {
+    return data.size() >= 8 && read_int(data.data()) == magic;
+  }
+
+
+  // read the header of the frame at the start of data, which needs at least header_size bytes (or fewer for tiny systems)
+
+  static std::optional<frame_header> read_header(std::span<const std::byte> data) noexcept
+  {
+    if (data.size() < 56)
+      return std::nullopt;
+
+    auto p = data.data();
+
+    if (read_int(p) != magic)
+      return std::nullopt;
+
+    frame_header h;
+
+    h.number_atoms = read_int(p + 4);
+    h.step         = read_int(p + 8);
+    h.time         = read_float(p + 12);
+
+    if (h.number_atoms <= 0 || read_int(p + 52) != h.number_atoms)
+      return std::nullopt;
+
+    if (h.number_atoms <= 9) // small systems are stored uncompressed
+    {
+      h.frame_size = 56 + 12 * h.number_atoms;
+      return h;
+    }
+
+    if (data.size() < header_size)
+      return std::nullopt;
+
+    auto byte_count = read_int(p + 88);
+
+    if (byte_count < 0)
+      return std::nullopt;
+
+    h.frame_size = header_size + ((static_cast<std::uint64_t>(byte_count) + 3) & ~std::uint64_t{3});
+
+    return h;
+  }
+
+
+  /*
+      scan consecutive frame headers in data, which starts at file offset base. each frame found is
+      appended to offsets (its file offset) and sizes. returns the file offset of the first frame
+      header that could not be read, so the caller can continue from there with more data.
+  */
+
+  static std::uint64_t scan(std::span<const std::byte> data, std::uint64_t base, int number_atoms,
+                                    std::vector<std::uint64_t>& offsets, std::vector<std::uint64_t>& sizes) noexcept
+  {
+    std::size_t pos = 0;
+
+    while (pos < data.size())
+    {
+      auto h = read_header(data.subspan(pos));
+
+      if (!h || h->number_atoms != number_atoms)
+        break;
+
+      offsets.push_back(base + pos);
+      sizes.push_back(h->frame_size);
+
+      pos += h->frame_size;
+    }
+
+    return base + pos;
+  }
+
+
+  xtc2pdb()
+  {
+  }
+
+
+  /*
+      decode the frame in data (the exact block of data for one frame) into xyz as interleaved
+      x,y,z coordinates in angstroms
+  */
+
+  bool decode(std::span<const std::byte> data, std::vector<float>& xyz)
+  {
+    auto h = read_header(data);
+
+    if (!h || data.size() < h->frame_size)
+    {
+      log_debug(FMT_COMPILE("xtc: bad frame size: {}"), data.size());
+      return false;
+    }
+
+    const int natoms = h->number_atoms;
+
+    xyz.resize(natoms * 3);
+
+    auto p = data.data();
+
+    if (natoms <= 9)
+    {
+      for (int i = 0; i < natoms * 3; ++i)
+        xyz[i] = read_float(p + 56 + 4 * i) * 10.0f;
+
+      return true;
+    }
+
+    const float precision = read_float(p + 56);
+
+    if (!(precision > 0))
+    {
+      log_debug(FMT_COMPILE("xtc: bad precision: {}"), precision);
+      return false;
+    }
+
+    std::array<std::int32_t, 3> minint, maxint;
+    std::array<std::uint32_t, 3> sizeint, bitsizeint;
+
+    for (int j = 0; j < 3; ++j)
+    {
+      minint[j]  = read_int(p + 60 + 4 * j);
+      maxint[j]  = read_int(p + 72 + 4 * j);
+      sizeint[j] = static_cast<std::uint32_t>(maxint[j] - minint[j]) + 1;
+    }
+
+    int bitsize = 0; // zero flags the use of large sizes, with each coordinate stored separately
+
+    if ((sizeint[0] | sizeint[1] | sizeint[2]) > 0xffffff)
+    {
+      for (int j = 0; j < 3; ++j)
+        bitsizeint[j] = sizeofint(sizeint[j]);
+    }
+    else
+      bitsize = sizeofints(sizeint);
+
+    int smallidx = read_int(p + 84);
+
+    if (smallidx < first_idx || smallidx >= last_idx)
+    {
+      log_debug(FMT_COMPILE("xtc: bad smallidx: {}"), smallidx);
+      return false;
+    }
+
+    const std::size_t byte_count = read_int(p + 88);
+
+    // copy with padding so the bit reader can always load a full 64 bit window
+
+    buf_.resize(byte_count + padding_);
+    std::memcpy(buf_.data(), p + header_size, byte_count);
+    std::memset(buf_.data() + byte_count, 0, padding_);
+
+    bits_ = 0;
+
+    const std::uint64_t total_bits = byte_count * 8;
+
+    int smaller  = magicints[std::max(first_idx, smallidx - 1)] / 2;
+    int smallnum = magicints[smallidx] / 2;
+
+    std::uint32_t sizesmall = magicints[smallidx];
+
+    const float scale = 10.0f / precision; // nm to angstroms
+
+    float* out = xyz.data();
+    float* out_end = out + natoms * 3;
+
+    std::array<std::int32_t, 3> coord, prev;
+
+    int run = 0;
+
+    for (int i = 0; i < natoms; )
+    {
+      if (bits_ > total_bits)
+      {
+        log_debug("xtc: compressed data overrun");
+        return false;
+      }
+
+      if (bitsize == 0)
+      {
+        coord[0] = read_bits(bitsizeint[0]);
+        coord[1] = read_bits(bitsizeint[1]);
+        coord[2] = read_bits(bitsizeint[2]);
+      }
+      else
+        read_ints(bitsize, sizeint, coord);
+
+      ++i;
+
+      for (int j = 0; j < 3; ++j)
+        prev[j] = coord[j] += minint[j];
+
+      int is_smaller = 0;
+
+      if (read_bits(1))
+      {
+        run = read_bits(5);
+        is_smaller = run % 3;
+        run -= is_smaller;
+        --is_smaller;
+      }
+
+      if (run > 0)
+      {
+        if (out + run + 3 > out_end || i + run / 3 > natoms)
+        {
+          log_debug("xtc: run past end of atoms");
+          return false;
+        }
+
+        for (int k = 0; k < run; k += 3)
+        {
+          if (bits_ > total_bits)
+          {
+            log_debug("xtc: compressed data overrun");
+            return false;
+          }
+
+          read_ints(smallidx, { sizesmall, sizesmall, sizesmall }, coord);
+          ++i;
+
+          for (int j = 0; j < 3; ++j)
+            coord[j] += prev[j] - smallnum;
+
+          if (k == 0)
+          {
+            // the first two atoms are interchanged for better compression of water molecules
+
+            std::swap(coord, prev);
+
+            *out++ = prev[0] * scale;
+            *out++ = prev[1] * scale;
+            *out++ = prev[2] * scale;
+          }
+          else
+            prev = coord;
+
+          *out++ = coord[0] * scale;
+          *out++ = coord[1] * scale;
+          *out++ = coord[2] * scale;
+        }
+      }
+      else
+      {
+        if (out + 3 > out_end)
+          return false;
+
+        *out++ = coord[0] * scale;
+        *out++ = coord[1] * scale;
+        *out++ = coord[2] * scale;
+      }
+
+      smallidx += is_smaller;
+
+      if (smallidx < first_idx || smallidx >= last_idx)
+      {
+        log_debug(FMT_COMPILE("xtc: bad smallidx: {}"), smallidx);
+        return false;
+      }
+
+      if (is_smaller < 0)
+      {
+        smallnum = smaller;
+        smaller  = smallidx > first_idx ? magicints[smallidx - 1] / 2 : 0;
+      }
+      else if (is_smaller > 0)
+      {
+        smaller  = smallnum;
+        smallnum = magicints[smallidx] / 2;
+      }
+
+      sizesmall = magicints[smallidx];
+    }
+
+    if (out != out_end || bits_ > total_bits)
+    {
+      log_debug(FMT_COMPILE("xtc: decoded {} coordinates, wanted: {}"), out - xyz.data(), natoms * 3);
+      return false;
+    }
+
+    return true;
+  }
+
+
+private:
+
+
+  static constexpr int first_idx = 9;
+
+  static constexpr std::array<int, 73> magicints =
+  {{
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 10, 12, 16, 20, 25, 32, 40, 50, 64,
+    80, 101, 128, 161, 203, 256, 322, 406, 512, 645, 812, 1024, 1290,
+    1625, 2048, 2580, 3250, 4096, 5060, 6501, 8192, 10321, 13003,
+    16384, 20642, 26007, 32768, 41285, 52015, 65536, 82570, 104031,
+    131072, 165140, 208063, 262144, 330280, 416127, 524287, 660561,
+    832255, 1048576, 1321122, 1664510, 2097152, 2642245, 3329021,
+    4194304, 5284491, 6658042, 8388607, 10568983, 13316085, 16777216
+  }};
+
+  static constexpr int last_idx = magicints.size();
+
+  static constexpr std::size_t padding_ = 32;
+
+
+  static inline std::int32_t read_int(const std::byte* p) noexcept
+  {
+    std::uint32_t v;
+    std::memcpy(&v, p, 4);
+
+    if constexpr (std::endian::native == std::endian::little)
+      v = __builtin_bswap32(v);
+
+    return static_cast<std::int32_t>(v);
+  }
+
+
+  static inline float read_float(const std::byte* p) noexcept
+  {
+    return std::bit_cast<float>(read_int(p));
+  }
+
+
+  // number of bits needed to store size
+
+  static std::uint32_t sizeofint(std::uint32_t size) noexcept
+  {
+    std::uint32_t bits = 0;
+
+    for (std::uint64_t num = 1; size >= num && bits < 32; num <<= 1)
+      ++bits;
+
+    return bits;
+  }
+
+
+  // number of bits needed to store the product of the three sizes
+
+  static int sizeofints(const std::array<std::uint32_t, 3>& sizes) noexcept
+  {
+    std::array<std::uint32_t, 32> bytes;
+
+    int num_of_bytes = 1;
+    bytes[0] = 1;
+
+    for (auto size : sizes)
+    {
+      std::uint64_t tmp = 0;
+      int c = 0;
+
+      for (; c < num_of_bytes; ++c)
+      {
+        tmp = bytes[c] * static_cast<std::uint64_t>(size) + tmp;
+        bytes[c] = tmp & 0xff;
+        tmp >>= 8;
+      }
+
+      for (; tmp != 0; tmp >>= 8)
+        bytes[c++] = tmp & 0xff;
+
+      num_of_bytes = c;
+    }
+
+    int bits = 0;
+
+    for (std::uint32_t num = 1; bytes[num_of_bytes - 1] >= num; num *= 2)
+      ++bits;
+
+    return bits + (num_of_bytes - 1) * 8;
+  }
+
+
+  /*
+      read n (<= 32) bits, most significant first. a single unaligned 64 bit load covers any read,
+      replacing the byte at a time loop of the reference implementation. a field of a range of 1 has no
+      bits, and shifting by the full 64 would be undefined
+  */
+
+  inline std::uint32_t read_bits(std::uint32_t n) noexcept
+  {
+    if (n == 0)
+      return 0;
+
+    std::uint64_t w;
+    std::memcpy(&w, buf_.data() + (bits_ >> 3), 8);
+
+    if constexpr (std::endian::native == std::endian::little)
+      w = __builtin_bswap64(w);
+
+    auto r = static_cast<std::uint32_t>((w << (bits_ & 7)) >> (64 - n));
+
+    bits_ += n;
+
+    return r;
+  }
+
+
+  /*
+      read three integers packed as a single number of n bits, with sizes giving the range of each.
+      the number is stored as little endian bytes, each written most significant bit first
+  */
+
+  inline void read_ints(int n, const std::array<std::uint32_t, 3>& sizes, std::array<std::int32_t, 3>& nums) noexcept
+  {
+    if (n <= 64) // common case, do the division in a single 64 bit integer
+    {
+      std::uint64_t v = 0;
+      int shift = 0;
+
+      for (; n >= 8; n -= 8, shift += 8)
+        v |= static_cast<std::uint64_t>(read_bits(8)) << shift;
+
+      if (n > 0)
+        v |= static_cast<std::uint64_t>(read_bits(n)) << shift;
+
+      nums[2] = v % sizes[2]; v /= sizes[2];
+      nums[1] = v % sizes[1];
+      nums[0] = v / sizes[1];
+
+      return;
+    }
+
+    std::array<std::uint32_t, 16> bytes{};
+
+    int num_of_bytes = 0;
+
+    for (; n > 8; n -= 8)
+      bytes[num_of_bytes++] = read_bits(8);
+
+    if (n > 0)
+      bytes[num_of_bytes++] = read_bits(n);
+
+    for (int i = 2; i > 0; --i)
+    {
+      std::uint64_t num = 0;
+
+      for (int j = num_of_bytes - 1; j >= 0; --j)
+      {
+        num = (num << 8) | bytes[j];
+        auto q = num / sizes[i];
+        bytes[j] = q;
+        num -= q * sizes[i];
+      }
+
+      nums[i] = num;
+    }
+
+    nums[0] = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (bytes[3] << 24);
+  }
+
+
+  std::vector<std::byte> buf_;
+  std::uint64_t bits_{0};
+
+
+}; // class xtc2pdb
+
+} // namespace animol